@@ -0,0 +1,49 @@
+/* citus--6.2-3--6.2-4.sql */
+
+SET search_path = 'pg_catalog';
+
+CREATE FUNCTION percentile_sketch_add_sfunc(internal, float8, integer)
+    RETURNS internal
+    LANGUAGE C
+    AS 'MODULE_PATHNAME', $$percentile_sketch_add_sfunc$$;
+COMMENT ON FUNCTION percentile_sketch_add_sfunc(internal, float8, integer)
+    IS 'transition function for percentile_sketch_add_agg';
+
+CREATE FUNCTION percentile_sketch_union_sfunc(internal, float8[])
+    RETURNS internal
+    LANGUAGE C
+    AS 'MODULE_PATHNAME', $$percentile_sketch_union_sfunc$$;
+COMMENT ON FUNCTION percentile_sketch_union_sfunc(internal, float8[])
+    IS 'transition function for percentile_sketch_union_agg';
+
+CREATE FUNCTION percentile_sketch_ffunc(internal)
+    RETURNS float8[]
+    LANGUAGE C
+    AS 'MODULE_PATHNAME', $$percentile_sketch_ffunc$$;
+COMMENT ON FUNCTION percentile_sketch_ffunc(internal)
+    IS 'final function for percentile sketch aggregates';
+
+CREATE FUNCTION percentile_sketch_value(float8[], float8)
+    RETURNS float8
+    LANGUAGE C STRICT IMMUTABLE
+    AS 'MODULE_PATHNAME', $$percentile_sketch_value$$;
+COMMENT ON FUNCTION percentile_sketch_value(float8[], float8)
+    IS 'approximate the given percentile from a percentile sketch';
+
+CREATE AGGREGATE percentile_sketch_add_agg(float8, integer) (
+    STYPE = internal,
+    SFUNC = percentile_sketch_add_sfunc,
+    FINALFUNC = percentile_sketch_ffunc
+);
+COMMENT ON AGGREGATE percentile_sketch_add_agg(float8, integer)
+    IS 'build a percentile sketch with the given compression over the input values';
+
+CREATE AGGREGATE percentile_sketch_union_agg(float8[]) (
+    STYPE = internal,
+    SFUNC = percentile_sketch_union_sfunc,
+    FINALFUNC = percentile_sketch_ffunc
+);
+COMMENT ON AGGREGATE percentile_sketch_union_agg(float8[])
+    IS 'merge percentile sketches into a single sketch';
+
+RESET search_path;
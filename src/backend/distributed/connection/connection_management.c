@@ -24,12 +24,15 @@
 #include "distributed/metadata_cache.h"
 #include "distributed/hash_helpers.h"
 #include "distributed/placement_connection.h"
+#include "distributed/shared_connection_stats.h"
 #include "mb/pg_wchar.h"
 #include "utils/hsearch.h"
 #include "utils/memutils.h"
 
 
 int NodeConnectionTimeout = 5000;
+int MaxCachedConnectionsPerWorker = 0;
+int MaxCachedConnectionLifetime = 10 * 60 * 1000;
 HTAB *ConnectionHash = NULL;
 MemoryContext ConnectionContext = NULL;
 
@@ -38,6 +41,11 @@ static int ConnectionHashCompare(const void *a, const void *b, Size keysize);
 static MultiConnection * StartConnectionEstablishment(ConnectionHashKey *key);
 static void AfterXactHostConnectionHandling(ConnectionHashEntry *entry, bool isCommit);
 static MultiConnection * FindAvailableConnection(dlist_head *connections, uint32 flags);
+static bool ConnectionOutsideTransaction(MultiConnection *connection);
+static bool ConnectionLifetimeExceeded(MultiConnection *connection);
+static int CachedConnectionCount(dlist_head *connections);
+static void FreePreparedStatements(MultiConnection *connection);
+static void ReleaseConnectionReservation(MultiConnection *connection);
 
 
 /*
@@ -152,6 +160,8 @@ GetNodeUserDatabaseConnection(uint32 flags, const char *hostname, int32 port, co
  * following flags influence connection establishment behaviour:
  * - SESSION_LIFESPAN - the connection should persist after transaction end
  * - FORCE_NEW_CONNECTION - a new connection is required
+ * - OUTSIDE_TRANSACTION - an existing connection may only be returned if it
+ *   does not take part in the coordinated transaction
  *
  * The returned connection has only been initiated, not fully
  * established. That's useful to allow parallel connection establishment. If
@@ -263,6 +273,12 @@ FindAvailableConnection(dlist_head *connections, uint32 flags)
 			continue;
 		}
 
+		/* some callers run commands outside of the coordinated transaction */
+		if ((flags & OUTSIDE_TRANSACTION) && !ConnectionOutsideTransaction(connection))
+		{
+			continue;
+		}
+
 		return connection;
 	}
 
@@ -369,6 +385,8 @@ CloseConnection(MultiConnection *connection)
 		CloseShardPlacementAssociation(connection);
 
 		/* we leave the per-host entry alive */
+		FreePreparedStatements(connection);
+		ReleaseConnectionReservation(connection);
 		pfree(connection);
 	}
 	else
@@ -378,6 +396,126 @@ CloseConnection(MultiConnection *connection)
 }
 
 
+/*
+ * ReleaseConnection signals that the caller is done with a connection it used
+ * outside of the coordinated transaction. If the connection is healthy and
+ * idle, and fewer than citus.max_cached_conns_per_worker connections to the
+ * same node are idle already, the connection is kept open, so that later
+ * transactions of this session can reuse it. Otherwise, it is closed.
+ */
+void
+ReleaseConnection(MultiConnection *connection)
+{
+	ConnectionHashKey key;
+	ConnectionHashEntry *entry = NULL;
+	bool found = false;
+
+	if (MaxCachedConnectionsPerWorker == 0 ||
+		PQstatus(connection->pgConn) != CONNECTION_OK ||
+		PQtransactionStatus(connection->pgConn) != PQTRANS_IDLE ||
+		!ConnectionOutsideTransaction(connection) ||
+		ConnectionLifetimeExceeded(connection))
+	{
+		CloseConnection(connection);
+		return;
+	}
+
+	strlcpy(key.hostname, connection->hostname, MAX_NODE_LENGTH);
+	key.port = connection->port;
+	strlcpy(key.user, connection->user, NAMEDATALEN);
+	strlcpy(key.database, connection->database, NAMEDATALEN);
+
+	entry = hash_search(ConnectionHash, &key, HASH_FIND, &found);
+	if (!found || CachedConnectionCount(entry->connections) >=
+		MaxCachedConnectionsPerWorker)
+	{
+		CloseConnection(connection);
+		return;
+	}
+
+	connection->sessionLifespan = true;
+	UnclaimConnection(connection);
+}
+
+
+/*
+ * ReservedConnectionAvailable returns true if StartNodeConnection, called with
+ * the given flags, would reuse a connection to the given node that holds a
+ * reservation from the shared connection budget. Callers can then skip making
+ * a reservation of their own.
+ */
+bool
+ReservedConnectionAvailable(uint32 flags, const char *hostname, int32 port)
+{
+	ConnectionHashKey key;
+	ConnectionHashEntry *entry = NULL;
+	MultiConnection *connection = NULL;
+	bool found = false;
+
+	if (flags & FORCE_NEW_CONNECTION)
+	{
+		return false;
+	}
+
+	strlcpy(key.hostname, hostname, MAX_NODE_LENGTH);
+	key.port = port;
+	strlcpy(key.user, CurrentUserName(), NAMEDATALEN);
+	strlcpy(key.database, get_database_name(MyDatabaseId), NAMEDATALEN);
+
+	entry = hash_search(ConnectionHash, &key, HASH_FIND, &found);
+	if (!found)
+	{
+		return false;
+	}
+
+	connection = FindAvailableConnection(entry->connections, flags);
+	if (connection == NULL)
+	{
+		return false;
+	}
+
+	return connection->sharedConnectionReserved;
+}
+
+
+/*
+ * ReservedConnectionCount returns the number of open connections to the given
+ * node, for any user and database, that hold a reservation from the shared
+ * connection budget.
+ */
+uint32
+ReservedConnectionCount(const char *hostname, int32 port)
+{
+	uint32 reservedConnectionCount = 0;
+	HASH_SEQ_STATUS status;
+	ConnectionHashEntry *entry;
+
+	hash_seq_init(&status, ConnectionHash);
+	while ((entry = (ConnectionHashEntry *) hash_seq_search(&status)) != 0)
+	{
+		dlist_iter iter;
+
+		if (strcmp(entry->key.hostname, hostname) != 0 || entry->key.port != port)
+		{
+			continue;
+		}
+
+		dlist_foreach(iter, entry->connections)
+		{
+			MultiConnection *connection =
+				dlist_container(MultiConnection, connectionNode, iter.cur);
+
+			if (connection->sharedConnectionReserved)
+			{
+				reservedConnectionCount++;
+			}
+		}
+	}
+
+	return reservedConnectionCount;
+}
+
+
 /*
  * Close a previously established connection.
  *
@@ -673,11 +811,13 @@ AfterXactHostConnectionHandling(ConnectionHashEntry *entry, bool isCommit)
 		}
 
 		/*
-		 * Preserve session lifespan connections if they are still healthy.
+		 * Preserve session lifespan connections if they are still healthy, and
+		 * have not reached their maximum lifetime.
 		 */
 		if (!connection->sessionLifespan ||
 			PQstatus(connection->pgConn) != CONNECTION_OK ||
-			PQtransactionStatus(connection->pgConn) != PQTRANS_IDLE)
+			PQtransactionStatus(connection->pgConn) != PQTRANS_IDLE ||
+			ConnectionLifetimeExceeded(connection))
 		{
 			PQfinish(connection->pgConn);
 			connection->pgConn = NULL;
@@ -685,6 +825,8 @@ AfterXactHostConnectionHandling(ConnectionHashEntry *entry, bool isCommit)
 			/* unlink from list */
 			dlist_delete(iter.cur);
 
+			FreePreparedStatements(connection);
+			ReleaseConnectionReservation(connection);
 			pfree(connection);
 		}
 		else
@@ -697,3 +839,119 @@ AfterXactHostConnectionHandling(ConnectionHashEntry *entry, bool isCommit)
 		}
 	}
 }
+
+
+/*
+ * ConnectionOutsideTransaction returns true if the given connection neither
+ * takes part in the coordinated transaction, nor has been used to access
+ * shard placements in the current transaction.
+ */
+static bool
+ConnectionOutsideTransaction(MultiConnection *connection)
+{
+	RemoteTransaction *transaction = &connection->remoteTransaction;
+
+	if (transaction->transactionState != REMOTE_TRANS_INVALID ||
+		PQtransactionStatus(connection->pgConn) != PQTRANS_IDLE)
+	{
+		return false;
+	}
+
+	if (!dlist_is_empty(&connection->referencedPlacements))
+	{
+		return false;
+	}
+
+	return true;
+}
+
+
+/*
+ * ConnectionLifetimeExceeded returns true if the given connection has been open
+ * for longer than citus.max_cached_connection_lifetime. Such connections are no
+ * longer kept open across transactions, e.g. to let workers release memory
+ * their backends accumulated.
+ */
+static bool
+ConnectionLifetimeExceeded(MultiConnection *connection)
+{
+	if (MaxCachedConnectionLifetime < 0)
+	{
+		return false;
+	}
+
+	return TimestampDifferenceExceeds(connection->connectionStart,
+									  GetCurrentTimestamp(),
+									  MaxCachedConnectionLifetime);
+}
+
+
+/*
+ * CachedConnectionCount returns the number of connections in the given list
+ * that are kept open across transactions and currently not in use.
+ */
+static int
+CachedConnectionCount(dlist_head *connections)
+{
+	int cachedConnectionCount = 0;
+	dlist_iter iter;
+
+	dlist_foreach(iter, connections)
+	{
+		MultiConnection *connection =
+			dlist_container(MultiConnection, connectionNode, iter.cur);
+
+		if (connection->sessionLifespan && !connection->claimedExclusively)
+		{
+			cachedConnectionCount++;
+		}
+	}
+
+	return cachedConnectionCount;
+}
+
+
+/*
+ * FreePreparedStatements releases the memory used to track the statements
+ * prepared on the given connection. The statements themselves go away with
+ * the remote session, so callers must only use this when closing it.
+ */
+static void
+FreePreparedStatements(MultiConnection *connection)
+{
+	ListCell *preparedStatementCell = NULL;
+
+	foreach(preparedStatementCell, connection->preparedStatementList)
+	{
+		PreparedStatement *preparedStatement =
+			(PreparedStatement *) lfirst(preparedStatementCell);
+
+		pfree(preparedStatement->commandString);
+		if (preparedStatement->parameterTypes != NULL)
+		{
+			pfree(preparedStatement->parameterTypes);
+		}
+		pfree(preparedStatement);
+	}
+
+	list_free(connection->preparedStatementList);
+	connection->preparedStatementList = NIL;
+}
+
+
+/*
+ * ReleaseConnectionReservation returns the reservation the given connection
+ * holds, if any, to the shared connection budget. Callers must only use this
+ * when closing the connection.
+ */
+static void
+ReleaseConnectionReservation(MultiConnection *connection)
+{
+	if (!connection->sharedConnectionReserved)
+	{
+		return;
+	}
+
+	ReleaseSharedConnection(connection->hostname, connection->port);
+	connection->sharedConnectionReserved = false;
+}
@@ -12,15 +12,33 @@
 
 #include "libpq-fe.h"
 
+#include "access/hash.h"
 #include "distributed/connection_management.h"
 #include "distributed/remote_commands.h"
 #include "miscadmin.h"
 #include "storage/latch.h"
+#include "utils/memutils.h"
 
 
 /* GUC, determining whether statements sent to remote nodes are logged */
 bool LogRemoteCommands = false;
 
+/* GUC, the number of statements that may be prepared on a single connection */
+int MaxPreparedStatementsPerConnection = 0;
+
+/* counter used to give statements prepared by this backend unique names */
+static uint64 PreparedStatementCounter = 0;
+
+
+static PreparedStatement * FindPreparedStatement(MultiConnection *connection,
+												 const char *command,
+												 int parameterCount,
+												 const Oid *parameterTypes);
+static PreparedStatement * PrepareRemoteCommand(MultiConnection *connection,
+												const char *command,
+												int parameterCount,
+												const Oid *parameterTypes);
+
 
 /* simple helpers */
 
@@ -266,18 +284,20 @@ ExecuteOptionalRemoteCommand(MultiConnection *connection, const char *command,
 
 
 /*
- * SendRemoteCommand is a PQsendQuery wrapper that logs remote commands, and
- * accepts a MultiConnection instead of a plain PGconn.  It makes sure it can
- * send commands asynchronously without blocking (at the potential expense of
- * an additional memory allocation).
+ * SendRemoteCommandParams is a PQsendQueryParams wrapper that logs remote
+ * commands, and accepts a MultiConnection instead of a plain PGconn.  It makes
+ * sure it can send commands asynchronously without blocking (at the potential
+ * expense of an additional memory allocation). If binaryResults is set, the
+ * command's rows are returned in binary format.
  */
 int
 SendRemoteCommandParams(MultiConnection *connection, const char *command,
 						int parameterCount, const Oid *parameterTypes,
-						const char *const *parameterValues)
+						const char *const *parameterValues, bool binaryResults)
 {
 	PGconn *pgConn = connection->pgConn;
 	bool wasNonblocking = false;
+	int resultFormat = binaryResults ? 1 : 0;
 	int rc = 0;
 
 	LogRemoteCommand(connection, command);
@@ -300,7 +320,77 @@ SendRemoteCommandParams(MultiConnection *connection, const char *command,
 	}
 
 	rc = PQsendQueryParams(pgConn, command, parameterCount, parameterTypes,
-						   parameterValues, NULL, NULL, 0);
+						   parameterValues, NULL, NULL, resultFormat);
+
+	/* reset nonblocking connection to its original state */
+	if (!wasNonblocking)
+	{
+		PQsetnonblocking(pgConn, false);
+	}
+
+	return rc;
+}
+
+
+/*
+ * SendRemotePreparedCommand behaves like SendRemoteCommandParams, but prepares
+ * the command on the connection the first time it is sent and executes the
+ * prepared statement on subsequent calls, so the remote node doesn't have to
+ * parse and plan the same command over and over again. At most
+ * citus.max_prepared_statements_per_connection statements are prepared on a
+ * connection; once that limit is reached commands are sent as usual.
+ *
+ * Preparing a statement waits for the remote node to respond. If that fails,
+ * a warning is emitted and 0 is returned, like for a failed send.
+ */
+int
+SendRemotePreparedCommand(MultiConnection *connection, const char *command,
+						  int parameterCount, const Oid *parameterTypes,
+						  const char *const *parameterValues, bool binaryResults)
+{
+	PGconn *pgConn = connection->pgConn;
+	PreparedStatement *preparedStatement = NULL;
+	bool wasNonblocking = false;
+	int resultFormat = binaryResults ? 1 : 0;
+	int rc = 0;
+
+	if (!pgConn)
+	{
+		return 0;
+	}
+
+	preparedStatement = FindPreparedStatement(connection, command, parameterCount,
+											  parameterTypes);
+	if (preparedStatement == NULL)
+	{
+		if (list_length(connection->preparedStatementList) >=
+			MaxPreparedStatementsPerConnection)
+		{
+			return SendRemoteCommandParams(connection, command, parameterCount,
+										   parameterTypes, parameterValues,
+										   binaryResults);
+		}
+
+		preparedStatement = PrepareRemoteCommand(connection, command, parameterCount,
+												 parameterTypes);
+		if (preparedStatement == NULL)
+		{
+			return 0;
+		}
+	}
+
+	LogRemoteCommand(connection, command);
+
+	wasNonblocking = PQisnonblocking(pgConn);
+
+	/* make sure not to block anywhere */
+	if (!wasNonblocking)
+	{
+		PQsetnonblocking(pgConn, true);
+	}
+
+	rc = PQsendQueryPrepared(pgConn, preparedStatement->statementName, parameterCount,
+							 parameterValues, NULL, NULL, resultFormat);
 
 	/* reset nonblocking connection to its original state */
 	if (!wasNonblocking)
@@ -321,7 +411,7 @@ SendRemoteCommandParams(MultiConnection *connection, const char *command,
 int
 SendRemoteCommand(MultiConnection *connection, const char *command)
 {
-	return SendRemoteCommandParams(connection, command, 0, NULL, NULL);
+	return SendRemoteCommandParams(connection, command, 0, NULL, NULL, false);
 }
 
 
@@ -487,3 +577,143 @@ GetRemoteCommandResult(MultiConnection *connection, bool raiseInterrupts)
 
 	return result;
 }
+
+
+/*
+ * FindPreparedStatement returns the statement prepared on the given connection
+ * for the given command and parameter types, or NULL if there is none.
+ */
+static PreparedStatement *
+FindPreparedStatement(MultiConnection *connection, const char *command,
+					  int parameterCount, const Oid *parameterTypes)
+{
+	ListCell *preparedStatementCell = NULL;
+	uint32 commandHash = 0;
+
+	if (connection->preparedStatementList == NIL)
+	{
+		return NULL;
+	}
+
+	commandHash = DatumGetUInt32(hash_any((const unsigned char *) command,
+										  strlen(command)));
+
+	foreach(preparedStatementCell, connection->preparedStatementList)
+	{
+		PreparedStatement *preparedStatement =
+			(PreparedStatement *) lfirst(preparedStatementCell);
+
+		if (preparedStatement->commandHash != commandHash ||
+			preparedStatement->parameterCount != parameterCount)
+		{
+			continue;
+		}
+
+		if (parameterCount > 0 &&
+			memcmp(preparedStatement->parameterTypes, parameterTypes,
+				   parameterCount * sizeof(Oid)) != 0)
+		{
+			continue;
+		}
+
+		if (strcmp(preparedStatement->commandString, command) == 0)
+		{
+			return preparedStatement;
+		}
+	}
+
+	return NULL;
+}
+
+
+/*
+ * PrepareRemoteCommand prepares the given command on the connection, waits for
+ * the remote node to acknowledge it, and remembers the resulting statement on
+ * the connection. The function returns NULL if the command couldn't be
+ * prepared.
+ */
+static PreparedStatement *
+PrepareRemoteCommand(MultiConnection *connection, const char *command,
+					 int parameterCount, const Oid *parameterTypes)
+{
+	PGconn *pgConn = connection->pgConn;
+	PreparedStatement *preparedStatement = NULL;
+	char statementName[NAMEDATALEN];
+	PGresult *result = NULL;
+	MemoryContext oldContext = NULL;
+	bool wasNonblocking = false;
+	bool prepared = false;
+	int rc = 0;
+
+	snprintf(statementName, NAMEDATALEN, "citus_statement_" UINT64_FORMAT,
+			 ++PreparedStatementCounter);
+
+	LogRemoteCommand(connection, command);
+
+	wasNonblocking = PQisnonblocking(pgConn);
+
+	/* make sure not to block anywhere */
+	if (!wasNonblocking)
+	{
+		PQsetnonblocking(pgConn, true);
+	}
+
+	rc = PQsendPrepare(pgConn, statementName, command, parameterCount,
+					   parameterTypes);
+
+	/* reset nonblocking connection to its original state */
+	if (!wasNonblocking)
+	{
+		PQsetnonblocking(pgConn, false);
+	}
+
+	if (rc == 0)
+	{
+		return NULL;
+	}
+
+	/* consume all results, the statement is usable once all have been read */
+	while ((result = GetRemoteCommandResult(connection, true)) != NULL)
+	{
+		if (PQresultStatus(result) == PGRES_COMMAND_OK)
+		{
+			prepared = true;
+		}
+		else
+		{
+			ReportResultError(connection, result, WARNING);
+			prepared = false;
+		}
+
+		PQclear(result);
+	}
+
+	if (!prepared)
+	{
+		return NULL;
+	}
+
+	oldContext = MemoryContextSwitchTo(ConnectionContext);
+
+	preparedStatement = palloc0(sizeof(PreparedStatement));
+	strlcpy(preparedStatement->statementName, statementName, NAMEDATALEN);
+	preparedStatement->commandString = pstrdup(command);
+	preparedStatement->commandHash =
+		DatumGetUInt32(hash_any((const unsigned char *) command, strlen(command)));
+	preparedStatement->parameterCount = parameterCount;
+
+	if (parameterCount > 0)
+	{
+		Size parameterTypesSize = parameterCount * sizeof(Oid);
+
+		preparedStatement->parameterTypes = palloc(parameterTypesSize);
+		memcpy(preparedStatement->parameterTypes, parameterTypes, parameterTypesSize);
+	}
+
+	connection->preparedStatementList = lappend(connection->preparedStatementList,
+												preparedStatement);
+
+	MemoryContextSwitchTo(oldContext);
+
+	return preparedStatement;
+}
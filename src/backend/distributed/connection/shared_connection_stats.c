@@ -0,0 +1,536 @@
+/*-------------------------------------------------------------------------
+ *
+ * shared_connection_stats.c
+ *
+ * Routines for keeping a connection budget per worker node that is shared by
+ * all backends on this node. Connection throttling in the executors is per
+ * backend; with many concurrent sessions, the sum of their connections can
+ * still exceed max_connections on a worker. Before opening a connection, an
+ * executor therefore reserves it from the shared budget of the worker, and
+ * queues the task if the budget has been used up.
+ *
+ * A backend whose reservation failed waits on its latch, which is set by the
+ * next backend that returns a connection to any worker.
+ *
+ * A reservation belongs to the connection it was made for, and is returned
+ * when that connection is closed. Connections that are cached across
+ * transactions therefore keep counting against the budget while idle.
+ *
+ * Each backend also remembers its own reservations, so that these can be
+ * returned at transaction end or backend exit if the executor did not get
+ * a chance to pass them on to a connection, e.g. because of an error.
+ *
+ * Copyright (c) 2017, Citus Data, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+#include "miscadmin.h"
+
+#include "distributed/connection_management.h"
+#include "distributed/shared_connection_stats.h"
+#include "postmaster/autovacuum.h"
+#include "storage/ipc.h"
+#include "storage/proc.h"
+#include "storage/shmem.h"
+#include "utils/memutils.h"
+
+
+/* Config variable managed via guc.c */
+int MaxSharedConnectionsPerWorker = 0; /* 0 disables the shared budget */
+
+/* connection counts shared between backends */
+static SharedConnectionStatsData *SharedConnectionStats = NULL;
+
+/* connections reserved by this backend, with the same layout as the shared hash */
+static HTAB *LocalConnectionStatsHash = NULL;
+static uint32 LocalReservedConnectionCount = 0;
+
+static shmem_startup_hook_type prev_shmem_startup_hook = NULL;
+
+
+/* Local functions forward declarations */
+static Size SharedConnectionStatsShmemSize(void);
+static void SharedConnectionStatsShmemInit(void);
+static HTAB * LocalConnectionStats(void);
+static void ReleaseSharedConnections(const char *workerName, uint32 workerPort,
+									 uint32 connectionCount);
+static void ReleaseAllSharedConnections(void);
+static void ReleaseSharedConnectionsAtExit(int code, Datum arg);
+static void InitConnectionStatsKey(SharedConnectionStatsEntry *key,
+								   const char *workerName, uint32 workerPort);
+static int SharedConnectionStatsBackendSlotCount(void);
+static void RegisterWaitingBackend(void);
+static void WakeWaitingBackends(void);
+
+
+/* Organize, at startup, that the shared connection counts are allocated */
+void
+InitializeSharedConnectionStats(void)
+{
+	RequestAddinShmemSpace(SharedConnectionStatsShmemSize());
+
+	prev_shmem_startup_hook = shmem_startup_hook;
+	shmem_startup_hook = SharedConnectionStatsShmemInit;
+}
+
+
+/*
+ * TryReserveSharedConnection reserves one connection to the given worker node
+ * from the budget shared by all backends. The function returns true if the
+ * connection may be opened, and sets connectionReserved to whether it counts
+ * against the budget, which it does not if no budget is configured. If the
+ * budget of the worker is exhausted, the function returns false and the caller
+ * should retry once its latch is set, which happens when another connection is
+ * returned. Every reservation must be returned using ReleaseSharedConnection.
+ */
+bool
+TryReserveSharedConnection(const char *workerName, uint32 workerPort,
+						   bool *connectionReserved)
+{
+	SharedConnectionStatsEntry connectionStatsKey;
+	SharedConnectionStatsEntry *connectionStats = NULL;
+	SharedConnectionStatsEntry *localConnectionStats = NULL;
+	HTAB *localConnectionStatsHash = NULL;
+	bool reserved = false;
+	bool entryFound = false;
+
+	*connectionReserved = false;
+
+	if (MaxSharedConnectionsPerWorker == 0)
+	{
+		return true;
+	}
+
+	InitConnectionStatsKey(&connectionStatsKey, workerName, workerPort);
+
+	/* make sure we can remember the reservation before making it */
+	localConnectionStatsHash = LocalConnectionStats();
+	localConnectionStats = hash_search(localConnectionStatsHash, &connectionStatsKey,
+									   HASH_ENTER, &entryFound);
+	if (!entryFound)
+	{
+		localConnectionStats->connectionCount = 0;
+	}
+
+	LWLockAcquire(&SharedConnectionStats->connectionStatsLock, LW_EXCLUSIVE);
+
+	connectionStats = hash_search(SharedConnectionStats->connectionStatsHash,
+								  &connectionStatsKey, HASH_ENTER_NULL, &entryFound);
+	if (connectionStats == NULL)
+	{
+		/* out of shared memory; rather not throttle than fail the query */
+		reserved = true;
+	}
+	else
+	{
+		if (!entryFound)
+		{
+			connectionStats->connectionCount = 0;
+		}
+
+		if (connectionStats->connectionCount < MaxSharedConnectionsPerWorker)
+		{
+			connectionStats->connectionCount++;
+			localConnectionStats->connectionCount++;
+			LocalReservedConnectionCount++;
+
+			*connectionReserved = true;
+			reserved = true;
+		}
+		else
+		{
+			RegisterWaitingBackend();
+		}
+	}
+
+	LWLockRelease(&SharedConnectionStats->connectionStatsLock);
+
+	if (!reserved)
+	{
+		ereport(DEBUG4, (errmsg("connection budget for node \"%s:%u\" is exhausted",
+								workerName, workerPort)));
+	}
+
+	return reserved;
+}
+
+
+/*
+ * ReleaseSharedConnection returns a connection reserved using
+ * TryReserveSharedConnection to the budget of the given worker node.
+ */
+void
+ReleaseSharedConnection(const char *workerName, uint32 workerPort)
+{
+	SharedConnectionStatsEntry connectionStatsKey;
+	SharedConnectionStatsEntry *localConnectionStats = NULL;
+	bool entryFound = false;
+
+	if (LocalReservedConnectionCount == 0)
+	{
+		return;
+	}
+
+	InitConnectionStatsKey(&connectionStatsKey, workerName, workerPort);
+
+	localConnectionStats = hash_search(LocalConnectionStatsHash, &connectionStatsKey,
+									   HASH_FIND, &entryFound);
+	if (!entryFound || localConnectionStats->connectionCount == 0)
+	{
+		/* the connection was opened without a reservation, e.g. without a budget */
+		return;
+	}
+
+	localConnectionStats->connectionCount--;
+	LocalReservedConnectionCount--;
+
+	ReleaseSharedConnections(workerName, workerPort, 1);
+}
+
+
+/*
+ * ReleaseUnheldSharedConnections returns the reservations of this backend that
+ * are not held by an open connection, for instance because an error interrupted
+ * the executor before it could pass a reservation on to the new connection. The
+ * reservations of connections that are cached across transactions are kept
+ * until those connections are closed. This is called at transaction end.
+ */
+void
+ReleaseUnheldSharedConnections(void)
+{
+	SharedConnectionStatsEntry *localConnectionStats = NULL;
+	HASH_SEQ_STATUS status;
+
+	if (LocalReservedConnectionCount == 0)
+	{
+		return;
+	}
+
+	hash_seq_init(&status, LocalConnectionStatsHash);
+
+	localConnectionStats = (SharedConnectionStatsEntry *) hash_seq_search(&status);
+	while (localConnectionStats != NULL)
+	{
+		uint32 heldConnectionCount =
+			ReservedConnectionCount(localConnectionStats->workerName,
+									localConnectionStats->workerPort);
+
+		if (localConnectionStats->connectionCount > heldConnectionCount)
+		{
+			uint32 unheldConnectionCount =
+				localConnectionStats->connectionCount - heldConnectionCount;
+
+			ReleaseSharedConnections(localConnectionStats->workerName,
+									 localConnectionStats->workerPort,
+									 unheldConnectionCount);
+			localConnectionStats->connectionCount = heldConnectionCount;
+			LocalReservedConnectionCount -= unheldConnectionCount;
+		}
+
+		localConnectionStats = (SharedConnectionStatsEntry *) hash_seq_search(&status);
+	}
+}
+
+
+/*
+ * SharedConnectionCount returns the number of connections all backends have
+ * currently reserved to the given worker node.
+ */
+uint32
+SharedConnectionCount(const char *workerName, uint32 workerPort)
+{
+	SharedConnectionStatsEntry connectionStatsKey;
+	SharedConnectionStatsEntry *connectionStats = NULL;
+	uint32 connectionCount = 0;
+	bool entryFound = false;
+
+	InitConnectionStatsKey(&connectionStatsKey, workerName, workerPort);
+
+	LWLockAcquire(&SharedConnectionStats->connectionStatsLock, LW_SHARED);
+
+	connectionStats = hash_search(SharedConnectionStats->connectionStatsHash,
+								  &connectionStatsKey, HASH_FIND, &entryFound);
+	if (entryFound)
+	{
+		connectionCount = connectionStats->connectionCount;
+	}
+
+	LWLockRelease(&SharedConnectionStats->connectionStatsLock);
+
+	return connectionCount;
+}
+
+
+/*
+ * ReleaseSharedConnections decrements the shared connection count of the
+ * given worker node by connectionCount, and wakes up the backends that are
+ * waiting for a connection.
+ */
+static void
+ReleaseSharedConnections(const char *workerName, uint32 workerPort,
+						 uint32 connectionCount)
+{
+	SharedConnectionStatsEntry connectionStatsKey;
+	SharedConnectionStatsEntry *connectionStats = NULL;
+	bool entryFound = false;
+
+	InitConnectionStatsKey(&connectionStatsKey, workerName, workerPort);
+
+	LWLockAcquire(&SharedConnectionStats->connectionStatsLock, LW_EXCLUSIVE);
+
+	connectionStats = hash_search(SharedConnectionStats->connectionStatsHash,
+								  &connectionStatsKey, HASH_FIND, &entryFound);
+	if (entryFound)
+	{
+		Assert(connectionStats->connectionCount >= connectionCount);
+		connectionStats->connectionCount -= Min(connectionStats->connectionCount,
+												connectionCount);
+	}
+
+	WakeWaitingBackends();
+
+	LWLockRelease(&SharedConnectionStats->connectionStatsLock);
+}
+
+
+/*
+ * RegisterWaitingBackend marks this backend as waiting for a connection to be
+ * returned to the shared budget. The caller must hold the connection stats
+ * lock exclusively.
+ */
+static void
+RegisterWaitingBackend(void)
+{
+	int backendSlot = MyProc->pgprocno;
+
+	/* backends outside the array fall back to periodically retrying */
+	if (backendSlot >= SharedConnectionStats->backendSlotCount)
+	{
+		return;
+	}
+
+	if (!SharedConnectionStats->waitingBackendArray[backendSlot])
+	{
+		SharedConnectionStats->waitingBackendArray[backendSlot] = true;
+		SharedConnectionStats->waitingBackendCount++;
+	}
+}
+
+
+/*
+ * WakeWaitingBackends sets the latches of all backends that wait for a
+ * connection, so that they retry their reservations. Since we don't know
+ * which worker each backend waits for, we wake all of them. The caller must
+ * hold the connection stats lock exclusively.
+ */
+static void
+WakeWaitingBackends(void)
+{
+	int backendSlot = 0;
+
+	if (SharedConnectionStats->waitingBackendCount == 0)
+	{
+		return;
+	}
+
+	for (backendSlot = 0; backendSlot < SharedConnectionStats->backendSlotCount;
+		 backendSlot++)
+	{
+		if (SharedConnectionStats->waitingBackendArray[backendSlot])
+		{
+			SharedConnectionStats->waitingBackendArray[backendSlot] = false;
+			SetLatch(&ProcGlobal->allProcs[backendSlot].procLatch);
+		}
+	}
+
+	SharedConnectionStats->waitingBackendCount = 0;
+}
+
+
+/*
+ * LocalConnectionStats returns the hash that tracks the reservations made by
+ * this backend, and creates it on first use. At that time, the function also
+ * arranges for the reservations to be returned when the backend exits.
+ */
+static HTAB *
+LocalConnectionStats(void)
+{
+	HASHCTL info;
+	int hashFlags = 0;
+
+	if (LocalConnectionStatsHash != NULL)
+	{
+		return LocalConnectionStatsHash;
+	}
+
+	memset(&info, 0, sizeof(info));
+	info.keysize = WORKER_LENGTH + sizeof(uint32);
+	info.entrysize = sizeof(SharedConnectionStatsEntry);
+	info.hash = tag_hash;
+	info.hcxt = TopMemoryContext;
+	hashFlags = (HASH_ELEM | HASH_FUNCTION | HASH_CONTEXT);
+
+	LocalConnectionStatsHash = hash_create("Local connection stats hash", 32, &info,
+										   hashFlags);
+
+	before_shmem_exit(ReleaseSharedConnectionsAtExit, 0);
+
+	return LocalConnectionStatsHash;
+}
+
+
+/*
+ * ReleaseAllSharedConnections returns all connections this backend reserved
+ * to the shared budget. This is called when the backend exits, at which point
+ * its cached connections go away as well.
+ */
+static void
+ReleaseAllSharedConnections(void)
+{
+	SharedConnectionStatsEntry *localConnectionStats = NULL;
+	HASH_SEQ_STATUS status;
+
+	if (LocalReservedConnectionCount == 0)
+	{
+		return;
+	}
+
+	hash_seq_init(&status, LocalConnectionStatsHash);
+
+	localConnectionStats = (SharedConnectionStatsEntry *) hash_seq_search(&status);
+	while (localConnectionStats != NULL)
+	{
+		if (localConnectionStats->connectionCount > 0)
+		{
+			ReleaseSharedConnections(localConnectionStats->workerName,
+									 localConnectionStats->workerPort,
+									 localConnectionStats->connectionCount);
+			localConnectionStats->connectionCount = 0;
+		}
+
+		localConnectionStats = (SharedConnectionStatsEntry *) hash_seq_search(&status);
+	}
+
+	LocalReservedConnectionCount = 0;
+}
+
+
+/* ReleaseSharedConnectionsAtExit returns all reservations when the backend exits. */
+static void
+ReleaseSharedConnectionsAtExit(int code, Datum arg)
+{
+	ReleaseAllSharedConnections();
+}
+
+
+/*
+ * InitConnectionStatsKey initializes a hash key for the given worker node. Like
+ * the other worker node hashes, the key is hashed as a whole; we therefore zero
+ * it first.
+ */
+static void
+InitConnectionStatsKey(SharedConnectionStatsEntry *key, const char *workerName,
+					   uint32 workerPort)
+{
+	memset(key, 0, sizeof(SharedConnectionStatsEntry));
+	key->workerPort = workerPort;
+	strlcpy(key->workerName, workerName, WORKER_LENGTH);
+}
+
+
+/*
+ * SharedConnectionStatsBackendSlotCount returns the number of backends that can
+ * wait for connections, which are all backends with a pgprocno below
+ * MaxBackends. MaxBackends itself is only set after shared memory has been
+ * requested, so we compute it the same way postgres does.
+ */
+static int
+SharedConnectionStatsBackendSlotCount(void)
+{
+	return MaxConnections + autovacuum_max_workers + 1 + max_worker_processes;
+}
+
+
+/* Estimates the shared memory size used for keeping the connection counts. */
+static Size
+SharedConnectionStatsShmemSize(void)
+{
+	Size size = 0;
+	Size hashSize = 0;
+	Size backendArraySize = mul_size(sizeof(bool),
+									 SharedConnectionStatsBackendSlotCount());
+
+	size = add_size(size, offsetof(SharedConnectionStatsData, waitingBackendArray));
+	size = add_size(size, backendArraySize);
+
+	hashSize = hash_estimate_size(MaxWorkerNodesTracked,
+								  sizeof(SharedConnectionStatsEntry));
+	size = add_size(size, hashSize);
+
+	return size;
+}
+
+
+/* Initializes the shared memory used for keeping the connection counts. */
+static void
+SharedConnectionStatsShmemInit(void)
+{
+	bool alreadyInitialized = false;
+	HASHCTL info;
+	int hashFlags = 0;
+	long maxTableSize = (long) MaxWorkerNodesTracked;
+	long initTableSize = maxTableSize / 8;
+	int backendSlotCount = SharedConnectionStatsBackendSlotCount();
+	Size sharedConnectionStatsSize =
+		add_size(offsetof(SharedConnectionStatsData, waitingBackendArray),
+				 mul_size(sizeof(bool), backendSlotCount));
+
+	memset(&info, 0, sizeof(info));
+	info.keysize = WORKER_LENGTH + sizeof(uint32);
+	info.entrysize = sizeof(SharedConnectionStatsEntry);
+	info.hash = tag_hash;
+	hashFlags = (HASH_ELEM | HASH_FUNCTION);
+
+	LWLockAcquire(AddinShmemInitLock, LW_EXCLUSIVE);
+
+	SharedConnectionStats =
+		(SharedConnectionStatsData *) ShmemInitStruct("Shared Connection Stats",
+													  sharedConnectionStatsSize,
+													  &alreadyInitialized);
+
+	if (!alreadyInitialized)
+	{
+		/* initialize lwlock protecting the connection counts */
+		LWLockTranche *tranche = &SharedConnectionStats->connectionStatsLockTranche;
+
+		SharedConnectionStats->connectionStatsTrancheId = LWLockNewTrancheId();
+		tranche->array_base = &SharedConnectionStats->connectionStatsLock;
+		tranche->array_stride = sizeof(LWLock);
+		tranche->name = "Shared Connection Stats Tranche";
+		LWLockRegisterTranche(SharedConnectionStats->connectionStatsTrancheId, tranche);
+		LWLockInitialize(&SharedConnectionStats->connectionStatsLock,
+						 SharedConnectionStats->connectionStatsTrancheId);
+
+		/* no backend waits for a connection yet */
+		SharedConnectionStats->waitingBackendCount = 0;
+		SharedConnectionStats->backendSlotCount = backendSlotCount;
+		memset(SharedConnectionStats->waitingBackendArray, 0,
+			   mul_size(sizeof(bool), backendSlotCount));
+	}
+
+	SharedConnectionStats->connectionStatsHash =
+		ShmemInitHash("Shared Connection Stats Hash",
+					  initTableSize, maxTableSize,
+					  &info, hashFlags);
+
+	LWLockRelease(AddinShmemInitLock);
+
+	Assert(SharedConnectionStats->connectionStatsHash != NULL);
+
+	if (prev_shmem_startup_hook != NULL)
+	{
+		prev_shmem_startup_hook();
+	}
+}
@@ -23,6 +23,8 @@
 #include "distributed/multi_client_executor.h"
 #include "distributed/multi_server_executor.h"
 #include "distributed/remote_commands.h"
+#include "storage/latch.h"
+#include "utils/memutils.h"
 
 #include <errno.h>
 #include <unistd.h>
@@ -47,11 +49,39 @@ static MultiConnection *ClientConnectionArray[MAX_CONNECTION_COUNT];
  */
 static PostgresPollingStatusType ClientPollingStatusArray[MAX_CONNECTION_COUNT];
 
+/*
+ * ClientSocketGeneration is incremented whenever the socket behind a client
+ * connection may have been closed or replaced. Wait event sets built for an
+ * older generation may miss sockets, and therefore need to be rebuilt.
+ */
+static uint64 ClientSocketGeneration = 0;
+
+#if (PG_VERSION_NUM >= 90600)
+
+/* position of the first socket in the wait event set, after latch and postmaster */
+#define WAIT_EVENT_SET_SOCKET_OFFSET 2
+
+/*
+ * Wait event sets of all WaitInfos. The sets live in TopMemoryContext and are
+ * tracked here, so that sets left behind by executions that an error aborted
+ * can be released at transaction abort, instead of leaking kernel resources.
+ */
+static List *ClientWaitEventSetList = NIL;
+#endif
+
 
 /* Local functions forward declarations */
+static int ClientConnectionFlags(void);
 static void ClearRemainingResults(MultiConnection *connection);
 static bool ClientConnectionReady(MultiConnection *connection,
 								  PostgresPollingStatusType pollingStatus);
+#if (PG_VERSION_NUM >= 90600)
+static void UpdateClientWaitEventSet(WaitInfo *waitInfo);
+static bool ClientWaitEventSetStale(WaitInfo *waitInfo);
+static void RebuildClientWaitEventSet(WaitInfo *waitInfo);
+static void FreeClientWaitEventSet(WaitInfo *waitInfo);
+static uint32 WaitEventFlags(short pollEvents);
+#endif
 
 
 /* AllocateConnectionId returns a connection id from the connection pool. */
@@ -91,7 +121,7 @@ MultiClientConnect(const char *nodeName, uint32 nodePort, const char *nodeDataba
 	MultiConnection *connection = NULL;
 	ConnStatusType connStatusType = CONNECTION_OK;
 	int32 connectionId = AllocateConnectionId();
-	int connectionFlags = FORCE_NEW_CONNECTION; /* no cached connections for now */
+	int connectionFlags = ClientConnectionFlags();
 
 	if (connectionId == INVALID_CONNECTION_ID)
 	{
@@ -106,7 +136,7 @@ MultiClientConnect(const char *nodeName, uint32 nodePort, const char *nodeDataba
 							   "command within a transaction")));
 	}
 
-	/* establish synchronous connection to worker node */
+	/* establish synchronous connection to worker node, or reuse a cached one */
 	connection = GetNodeUserDatabaseConnection(connectionFlags, nodeName, nodePort,
 											   userName, nodeDatabase);
 
@@ -114,6 +144,7 @@ MultiClientConnect(const char *nodeName, uint32 nodePort, const char *nodeDataba
 
 	if (connStatusType == CONNECTION_OK)
 	{
+		ClaimConnectionExclusively(connection);
 		ClientConnectionArray[connectionId] = connection;
 	}
 	else
@@ -138,7 +169,7 @@ MultiClientConnectStart(const char *nodeName, uint32 nodePort, const char *nodeD
 	MultiConnection *connection = NULL;
 	ConnStatusType connStatusType = CONNECTION_OK;
 	int32 connectionId = AllocateConnectionId();
-	int connectionFlags = FORCE_NEW_CONNECTION; /* no cached connections for now */
+	int connectionFlags = ClientConnectionFlags();
 
 	if (connectionId == INVALID_CONNECTION_ID)
 	{
@@ -153,19 +184,29 @@ MultiClientConnectStart(const char *nodeName, uint32 nodePort, const char *nodeD
 							   "command within a transaction")));
 	}
 
-	/* prepare asynchronous request for worker node connection */
+	/* prepare asynchronous request for worker node connection, or reuse a cached one */
 	connection = StartNodeConnection(connectionFlags, nodeName, nodePort);
 	connStatusType = PQstatus(connection->pgConn);
 
 	/*
 	 * If prepared, we save the connection, and set its initial polling status
 	 * to PGRES_POLLING_WRITING as specified in "Database Connection Control
-	 * Functions" section of the PostgreSQL documentation.
+	 * Functions" section of the PostgreSQL documentation. Cached connections
+	 * are already established, and don't need to be polled.
 	 */
 	if (connStatusType != CONNECTION_BAD)
 	{
+		ClaimConnectionExclusively(connection);
 		ClientConnectionArray[connectionId] = connection;
-		ClientPollingStatusArray[connectionId] = PGRES_POLLING_WRITING;
+
+		if (connStatusType == CONNECTION_OK)
+		{
+			ClientPollingStatusArray[connectionId] = PGRES_POLLING_OK;
+		}
+		else
+		{
+			ClientPollingStatusArray[connectionId] = PGRES_POLLING_WRITING;
+		}
 	}
 	else
 	{
@@ -201,6 +242,9 @@ MultiClientConnectPoll(int32 connectionId)
 		bool readReady = ClientConnectionReady(connection, PGRES_POLLING_READING);
 		if (readReady)
 		{
+			/* libpq may switch to a new socket while establishing the connection */
+			ClientSocketGeneration++;
+
 			ClientPollingStatusArray[connectionId] = PQconnectPoll(connection->pgConn);
 			connectStatus = CLIENT_CONNECTION_BUSY;
 		}
@@ -214,6 +258,8 @@ MultiClientConnectPoll(int32 connectionId)
 		bool writeReady = ClientConnectionReady(connection, PGRES_POLLING_WRITING);
 		if (writeReady)
 		{
+			ClientSocketGeneration++;
+
 			ClientPollingStatusArray[connectionId] = PQconnectPoll(connection->pgConn);
 			connectStatus = CLIENT_CONNECTION_BUSY;
 		}
@@ -233,7 +279,11 @@ MultiClientConnectPoll(int32 connectionId)
 }
 
 
-/* MultiClientDisconnect disconnects the connection. */
+/*
+ * MultiClientDisconnect disconnects the connection. If connection caching is
+ * enabled, healthy and idle connections are kept open for reuse by later
+ * transactions instead.
+ */
 void
 MultiClientDisconnect(int32 connectionId)
 {
@@ -244,13 +294,84 @@ MultiClientDisconnect(int32 connectionId)
 	connection = ClientConnectionArray[connectionId];
 	Assert(connection != NULL);
 
-	CloseConnection(connection);
+	ReleaseConnection(connection);
+	ClientSocketGeneration++;
 
 	ClientConnectionArray[connectionId] = NULL;
 	ClientPollingStatusArray[connectionId] = InvalidPollingStatus;
 }
 
 
+/*
+ * MultiClientDisconnectAll closes all connections that remain in the connection
+ * pool. Executors disconnect their connections before they return, so we only
+ * find connections here if an error interrupted an execution. This function is
+ * therefore called on transaction abort, before the connections are freed.
+ */
+void
+MultiClientDisconnectAll(void)
+{
+	int32 connectionId = 0;
+	const int InvalidPollingStatus = -1;
+
+	for (connectionId = 0; connectionId < MAX_CONNECTION_COUNT; connectionId++)
+	{
+		MultiConnection *connection = ClientConnectionArray[connectionId];
+		if (connection == NULL)
+		{
+			continue;
+		}
+
+		CloseConnection(connection);
+		ClientSocketGeneration++;
+
+		ClientConnectionArray[connectionId] = NULL;
+		ClientPollingStatusArray[connectionId] = InvalidPollingStatus;
+	}
+}
+
+
+/*
+ * MultiClientReservedConnectionAvailable returns true if the next connection to
+ * the given node would be a cached connection that already holds a reservation
+ * from the shared connection budget.
+ */
+bool
+MultiClientReservedConnectionAvailable(const char *nodeName, uint32 nodePort)
+{
+	int connectionFlags = ClientConnectionFlags();
+
+	return ReservedConnectionAvailable(connectionFlags, nodeName, nodePort);
+}
+
+
+/*
+ * MultiClientHoldSharedConnection hands the reservation the caller made from the
+ * shared connection budget over to the given connection, which returns it once
+ * the connection is closed; this may be after the transaction if the connection
+ * is cached. If the connection is a cached one that already holds a reservation,
+ * the function returns false, and the caller should release its reservation.
+ */
+bool
+MultiClientHoldSharedConnection(int32 connectionId)
+{
+	MultiConnection *connection = NULL;
+
+	Assert(connectionId != INVALID_CONNECTION_ID);
+	connection = ClientConnectionArray[connectionId];
+	Assert(connection != NULL);
+
+	if (connection->sharedConnectionReserved)
+	{
+		return false;
+	}
+
+	connection->sharedConnectionReserved = true;
+
+	return true;
+}
+
+
 /*
  * MultiClientConnectionUp checks if the connection status is up, in other words,
  * it is not bad.
@@ -322,6 +443,64 @@ MultiClientSendQuery(int32 connectionId, const char *query)
 }
 
 
+/*
+ * MultiClientSendBinaryQuery sends the given query over the given connection
+ * like MultiClientSendQuery, but asks for the query's rows in binary format.
+ * The query must be a single statement.
+ */
+bool
+MultiClientSendBinaryQuery(int32 connectionId, const char *query)
+{
+	MultiConnection *connection = NULL;
+	bool success = true;
+	int querySent = 0;
+	int resultFormat = 1;
+
+	Assert(connectionId != INVALID_CONNECTION_ID);
+	connection = ClientConnectionArray[connectionId];
+	Assert(connection != NULL);
+
+	querySent = PQsendQueryParams(connection->pgConn, query, 0, NULL, NULL, NULL, NULL,
+								  resultFormat);
+	if (querySent == 0)
+	{
+		char *errorMessage = PQerrorMessage(connection->pgConn);
+		ereport(WARNING, (errmsg("could not send remote query \"%s\"", query),
+						  errdetail("Client error: %s", errorMessage)));
+
+		success = false;
+	}
+
+	return success;
+}
+
+
+/*
+ * MultiClientSetSingleRowMode makes the query that was just sent over the given
+ * connection return its rows one by one, so that they can be processed as they
+ * arrive. The function needs to be called right after MultiClientSendQuery.
+ */
+bool
+MultiClientSetSingleRowMode(int32 connectionId)
+{
+	MultiConnection *connection = NULL;
+	int singleRowMode = 0;
+
+	Assert(connectionId != INVALID_CONNECTION_ID);
+	connection = ClientConnectionArray[connectionId];
+	Assert(connection != NULL);
+
+	singleRowMode = PQsetSingleRowMode(connection->pgConn);
+	if (singleRowMode == 0)
+	{
+		ereport(WARNING, (errmsg("could not set single row mode for remote query")));
+		return false;
+	}
+
+	return true;
+}
+
+
 /* MultiClientCancel cancels the running query on the given connection. */
 bool
 MultiClientCancel(int32 connectionId)
@@ -397,6 +576,24 @@ MultiClientResultStatus(int32 connectionId)
 }
 
 
+/*
+ * MultiClientResultBusy checks if getting the next result for an asynchronous
+ * query would block. Unlike MultiClientResultStatus, the function only looks
+ * at input that has already been consumed from the connection.
+ */
+bool
+MultiClientResultBusy(int32 connectionId)
+{
+	MultiConnection *connection = NULL;
+
+	Assert(connectionId != INVALID_CONNECTION_ID);
+	connection = ClientConnectionArray[connectionId];
+	Assert(connection != NULL);
+
+	return PQisBusy(connection->pgConn) != 0;
+}
+
+
 /* MultiClientQueryResult gets results for an asynchronous query. */
 bool
 MultiClientQueryResult(int32 connectionId, void **queryResult, int *rowCount,
@@ -483,7 +680,7 @@ MultiClientBatchResult(int32 connectionId, void **queryResult, int *rowCount,
 	}
 
 	resultStatus = PQresultStatus(result);
-	if (resultStatus == PGRES_TUPLES_OK)
+	if (resultStatus == PGRES_TUPLES_OK || resultStatus == PGRES_SINGLE_TUPLE)
 	{
 		(*queryResult) = (void **) result;
 		(*rowCount) = PQntuples(result);
@@ -515,6 +712,15 @@ MultiClientGetValue(void *queryResult, int rowIndex, int columnIndex)
 }
 
 
+/* MultiClientGetValueLength returns the length of field at the given position. */
+int
+MultiClientGetValueLength(void *queryResult, int rowIndex, int columnIndex)
+{
+	int valueLength = PQgetlength((PGresult *) queryResult, rowIndex, columnIndex);
+	return valueLength;
+}
+
+
 /* MultiClientValueIsNull returns whether the value at the given position is null. */
 bool
 MultiClientValueIsNull(void *queryResult, int rowIndex, int columnIndex)
@@ -720,6 +926,13 @@ MultiClientCreateWaitInfo(int maxConnections)
 	waitInfo->maxWaiters = maxConnections;
 	waitInfo->pollfds = palloc(maxConnections * sizeof(struct pollfd));
 
+#if (PG_VERSION_NUM >= 90600)
+	waitInfo->waitEventSet = NULL;
+	waitInfo->waitEventPollfds = palloc(maxConnections * sizeof(struct pollfd));
+	waitInfo->waitEventSocketCount = 0;
+	waitInfo->waitEventSocketGeneration = ClientSocketGeneration;
+#endif
+
 	/* initialize remaining fields */
 	MultiClientResetWaitInfo(waitInfo);
 
@@ -741,11 +954,39 @@ MultiClientResetWaitInfo(WaitInfo *waitInfo)
 void
 MultiClientFreeWaitInfo(WaitInfo *waitInfo)
 {
+#if (PG_VERSION_NUM >= 90600)
+	FreeClientWaitEventSet(waitInfo);
+	pfree(waitInfo->waitEventPollfds);
+#endif
+
 	pfree(waitInfo->pollfds);
 	pfree(waitInfo);
 }
 
 
+/*
+ * MultiClientFreeAllWaitEventSets frees the wait event sets of executions that
+ * were interrupted by an error, and therefore never freed their WaitInfo. The
+ * function is called on transaction abort, when no execution is running.
+ */
+void
+MultiClientFreeAllWaitEventSets(void)
+{
+#if (PG_VERSION_NUM >= 90600)
+	ListCell *waitEventSetCell = NULL;
+
+	foreach(waitEventSetCell, ClientWaitEventSetList)
+	{
+		WaitEventSet *waitEventSet = (WaitEventSet *) lfirst(waitEventSetCell);
+		FreeWaitEventSet(waitEventSet);
+	}
+
+	list_free(ClientWaitEventSetList);
+	ClientWaitEventSetList = NIL;
+#endif
+}
+
+
 /*
  * MultiClientRegisterWait adds a connection to be waited upon, waiting for
  * executionStatus.
@@ -771,6 +1012,13 @@ MultiClientRegisterWait(WaitInfo *waitInfo, TaskExecutionStatus executionStatus,
 	}
 
 	connection = ClientConnectionArray[connectionId];
+	if (PQsocket(connection->pgConn) == PGINVALID_SOCKET)
+	{
+		/* the connection broke; processing it again will surface the failure */
+		waitInfo->haveReadyWaiter = true;
+		return;
+	}
+
 	pollfd = &waitInfo->pollfds[waitInfo->registeredWaiters];
 	pollfd->fd = PQsocket(connection->pgConn);
 	if (executionStatus == TASK_STATUS_SOCKET_READ)
@@ -788,6 +1036,14 @@ MultiClientRegisterWait(WaitInfo *waitInfo, TaskExecutionStatus executionStatus,
 /*
  * MultiClientWait waits until at least one connection added with
  * MultiClientRegisterWait is ready to be processed again.
+ *
+ * On PostgreSQL 9.6 and later, the function waits on a wait event set that
+ * also includes the process latch, so that interrupts, and backends returning
+ * connections to the shared connection budget, wake us up immediately.
+ * The set is kept across calls and only rebuilt when the registered sockets
+ * change; otherwise only the events of sockets whose wait condition changed
+ * are modified. Older versions fall back to poll(), which rebuilds its list
+ * of file descriptors on every call.
  */
 void
 MultiClientWait(WaitInfo *waitInfo)
@@ -798,9 +1054,7 @@ MultiClientWait(WaitInfo *waitInfo)
 	 */
 	if (waitInfo->haveFailedWaiter)
 	{
-		long sleepIntervalPerCycle = RemoteTaskCheckInterval * 1000L;
-
-		pg_usleep(sleepIntervalPerCycle);
+		MultiClientWaitForFailureBackoff();
 		return;
 	}
 
@@ -810,6 +1064,55 @@ MultiClientWait(WaitInfo *waitInfo)
 		return;
 	}
 
+#if (PG_VERSION_NUM >= 90600)
+	{
+		WaitEvent event;
+		int eventCount = 0;
+
+		UpdateClientWaitEventSet(waitInfo);
+
+		/*
+		 * Wait for activity on any of the sockets or the latch. Limit the
+		 * maximum time spent waiting in one wait cycle, as insurance against
+		 * edge cases; connection timeouts are also only checked when we wake
+		 * up. For efficiency we don't want wake up quite as often as
+		 * citus.remote_task_check_interval, so rather arbitrarily sleep ten
+		 * times as long.
+		 */
+		eventCount = WaitEventSetWait(waitInfo->waitEventSet,
+									  RemoteTaskCheckInterval * 10, &event, 1);
+		if (eventCount == 0)
+		{
+			ereport(DEBUG5,
+					(errmsg("waiting for activity on tasks took longer than %ld ms",
+							(long) RemoteTaskCheckInterval * 10)));
+		}
+		else if (event.events & WL_POSTMASTER_DEATH)
+		{
+			ereport(FATAL, (errcode(ERRCODE_ADMIN_SHUTDOWN),
+							errmsg("postmaster was shut down, exiting")));
+		}
+		else if (event.events & WL_LATCH_SET)
+		{
+			ResetLatch(MyLatch);
+
+			/*
+			 * Query cancellation is left to our callers, which first cancel the
+			 * remote tasks. Other interrupts are processed right away.
+			 */
+			if (!QueryCancelPending)
+			{
+				CHECK_FOR_INTERRUPTS();
+			}
+		}
+
+		/*
+		 * At least one socket or the latch received a readiness notification,
+		 * time to process tasks again.
+		 */
+		return;
+	}
+#else
 	while (true)
 	{
 		/*
@@ -825,16 +1128,17 @@ MultiClientWait(WaitInfo *waitInfo)
 		if (rc < 0)
 		{
 			/*
-			 * Signals that arrive can interrupt our poll(). In that case just
-			 * check for interrupts, and try again. Every other error is
+			 * Signals that arrive can interrupt our poll(). In that case
+			 * check for interrupts, and process tasks again: the signal may
+			 * also have set our latch because another backend returned a
+			 * connection to the shared budget. Every other error is
 			 * unexpected and treated as such.
 			 */
 			if (errno == EAGAIN || errno == EINTR)
 			{
 				CHECK_FOR_INTERRUPTS();
 
-				/* maximum wait starts at max again, but that's ok, it's just a stopgap */
-				continue;
+				return;
 			}
 			else
 			{
@@ -855,6 +1159,199 @@ MultiClientWait(WaitInfo *waitInfo)
 		 */
 		return;
 	}
+#endif
+}
+
+
+/*
+ * MultiClientWaitForFailureBackoff sleeps for citus.remote_task_check_interval
+ * after a task failure or cancellation. Unlike pg_usleep(), waiting on the
+ * process latch lets signals such as query cancellation cut the sleep short.
+ */
+void
+MultiClientWaitForFailureBackoff(void)
+{
+	int waitFlags = WL_LATCH_SET | WL_TIMEOUT | WL_POSTMASTER_DEATH;
+	int rc = WaitLatch(MyLatch, waitFlags, RemoteTaskCheckInterval);
+
+	if (rc & WL_POSTMASTER_DEATH)
+	{
+		ereport(FATAL, (errcode(ERRCODE_ADMIN_SHUTDOWN),
+						errmsg("postmaster was shut down, exiting")));
+	}
+
+	if (rc & WL_LATCH_SET)
+	{
+		ResetLatch(MyLatch);
+	}
+}
+
+
+#if (PG_VERSION_NUM >= 90600)
+
+/*
+ * UpdateClientWaitEventSet brings the wait event set in line with the waits
+ * registered in the current cycle. If the registered sockets are the same as
+ * the ones already in the set, we only modify the events of sockets that now
+ * wait for something else. Otherwise, we rebuild the set from scratch.
+ */
+static void
+UpdateClientWaitEventSet(WaitInfo *waitInfo)
+{
+	int waiterIndex = 0;
+
+	if (ClientWaitEventSetStale(waitInfo))
+	{
+		RebuildClientWaitEventSet(waitInfo);
+		return;
+	}
+
+	for (waiterIndex = 0; waiterIndex < waitInfo->registeredWaiters; waiterIndex++)
+	{
+		struct pollfd *pollfd = &waitInfo->pollfds[waiterIndex];
+		struct pollfd *waitEventPollfd = &waitInfo->waitEventPollfds[waiterIndex];
+
+		if (pollfd->events != waitEventPollfd->events)
+		{
+			int eventPosition = WAIT_EVENT_SET_SOCKET_OFFSET + waiterIndex;
+
+			ModifyWaitEvent(waitInfo->waitEventSet, eventPosition,
+							WaitEventFlags(pollfd->events), NULL);
+			waitEventPollfd->events = pollfd->events;
+		}
+	}
+}
+
+
+/*
+ * ClientWaitEventSetStale returns true if the wait event set cannot be reused
+ * for the waits registered in the current cycle, either because it does not
+ * exist yet, because sockets may have been closed since it was built, or
+ * because the registered sockets differ from the ones in the set.
+ */
+static bool
+ClientWaitEventSetStale(WaitInfo *waitInfo)
+{
+	int waiterIndex = 0;
+
+	if (waitInfo->waitEventSet == NULL)
+	{
+		return true;
+	}
+
+	if (waitInfo->waitEventSocketGeneration != ClientSocketGeneration ||
+		waitInfo->waitEventSocketCount != waitInfo->registeredWaiters)
+	{
+		return true;
+	}
+
+	for (waiterIndex = 0; waiterIndex < waitInfo->registeredWaiters; waiterIndex++)
+	{
+		if (waitInfo->pollfds[waiterIndex].fd != waitInfo->waitEventPollfds[waiterIndex].fd)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+/*
+ * RebuildClientWaitEventSet creates a new wait event set containing the
+ * process latch, postmaster death, and all sockets registered in the current
+ * cycle. Any previously created set is freed first.
+ */
+static void
+RebuildClientWaitEventSet(WaitInfo *waitInfo)
+{
+	int eventSetSize = waitInfo->maxWaiters + WAIT_EVENT_SET_SOCKET_OFFSET;
+	int waiterIndex = 0;
+	WaitEventSet *waitEventSet = NULL;
+	MemoryContext oldContext = NULL;
+
+	FreeClientWaitEventSet(waitInfo);
+
+	waitEventSet = CreateWaitEventSet(TopMemoryContext, eventSetSize);
+	AddWaitEventToSet(waitEventSet, WL_LATCH_SET, PGINVALID_SOCKET, MyLatch, NULL);
+	AddWaitEventToSet(waitEventSet, WL_POSTMASTER_DEATH, PGINVALID_SOCKET, NULL, NULL);
+
+	oldContext = MemoryContextSwitchTo(TopMemoryContext);
+	ClientWaitEventSetList = lappend(ClientWaitEventSetList, waitEventSet);
+	MemoryContextSwitchTo(oldContext);
+
+	waitInfo->waitEventSet = waitEventSet;
+
+	for (waiterIndex = 0; waiterIndex < waitInfo->registeredWaiters; waiterIndex++)
+	{
+		struct pollfd *pollfd = &waitInfo->pollfds[waiterIndex];
+		int eventPosition PG_USED_FOR_ASSERTS_ONLY = 0;
+
+		eventPosition = AddWaitEventToSet(waitEventSet, WaitEventFlags(pollfd->events),
+										  pollfd->fd, NULL, NULL);
+		Assert(eventPosition == WAIT_EVENT_SET_SOCKET_OFFSET + waiterIndex);
+
+		waitInfo->waitEventPollfds[waiterIndex] = *pollfd;
+	}
+
+	waitInfo->waitEventSocketCount = waitInfo->registeredWaiters;
+	waitInfo->waitEventSocketGeneration = ClientSocketGeneration;
+}
+
+
+/* FreeClientWaitEventSet frees the wait event set of the given WaitInfo, if any. */
+static void
+FreeClientWaitEventSet(WaitInfo *waitInfo)
+{
+	WaitEventSet *waitEventSet = waitInfo->waitEventSet;
+
+	if (waitEventSet != NULL)
+	{
+		ClientWaitEventSetList = list_delete_ptr(ClientWaitEventSetList, waitEventSet);
+		FreeWaitEventSet(waitEventSet);
+		waitInfo->waitEventSet = NULL;
+	}
+}
+
+
+/* WaitEventFlags converts poll() event flags into wait event set flags. */
+static uint32
+WaitEventFlags(short pollEvents)
+{
+	uint32 waitEventFlags = 0;
+
+	if (pollEvents & POLLIN)
+	{
+		waitEventFlags |= WL_SOCKET_READABLE;
+	}
+
+	if (pollEvents & POLLOUT)
+	{
+		waitEventFlags |= WL_SOCKET_WRITEABLE;
+	}
+
+	return waitEventFlags;
+}
+
+
+#endif
+
+
+/*
+ * ClientConnectionFlags returns the flags to use when opening a client
+ * connection. Without connection caching, we always open new connections.
+ * Otherwise, we may reuse an idle connection of the session, as long as it
+ * does not take part in the coordinated transaction.
+ */
+static int
+ClientConnectionFlags(void)
+{
+	if (MaxCachedConnectionsPerWorker == 0)
+	{
+		return FORCE_NEW_CONNECTION;
+	}
+
+	return OUTSIDE_TRANSACTION;
 }
 
 
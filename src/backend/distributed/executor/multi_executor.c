@@ -12,6 +12,7 @@
 
 #include "miscadmin.h"
 
+#include "access/parallel.h"
 #include "access/xact.h"
 #include "catalog/dependency.h"
 #include "catalog/namespace.h"
@@ -19,17 +20,78 @@
 #include "distributed/multi_master_planner.h"
 #include "distributed/multi_planner.h"
 #include "distributed/multi_router_executor.h"
+#include "distributed/multi_router_planner.h"
 #include "distributed/multi_resowner.h"
 #include "distributed/multi_server_executor.h"
 #include "distributed/multi_utility.h"
 #include "distributed/worker_protocol.h"
 #include "executor/execdebug.h"
 #include "commands/copy.h"
+#include "lib/binaryheap.h"
 #include "nodes/makefuncs.h"
+#include "nodes/nodeFuncs.h"
+#include "optimizer/tlist.h"
+#include "port/atomics.h"
 #include "storage/lmgr.h"
 #include "tcop/utility.h"
 #include "utils/snapmgr.h"
 #include "utils/memutils.h"
+#include "utils/sortsupport.h"
+
+
+/*
+ * SortedMerge keeps the state of a k-way merge over task result files whose
+ * rows are sorted by the master query's sort clause. For each task, it keeps
+ * the file's copy state and the file's current row. A binary heap then keeps
+ * the tasks ordered by their current rows.
+ */
+typedef struct SortedMerge
+{
+	MemoryContext mergeContext;
+	int taskCount;
+	CopyState *copyStateArray;    /* NULL for tasks with no rows left */
+	TupleTableSlot **slotArray;
+	MemoryContext *rowContextArray;
+	int sortKeyCount;
+	SortSupport sortKeyArray;
+	binaryheap *taskHeap;
+	bool initialized;
+} SortedMerge;
+
+
+/*
+ * ParallelTaskResults is kept in dynamic shared memory, and lets the master
+ * backend and its parallel workers read task result files in parallel. Each
+ * process takes the next unread file until all files have been read.
+ */
+typedef struct ParallelTaskResults
+{
+	uint64 jobId;
+	pg_atomic_uint32 nextTaskIndex;
+	uint32 taskCount;
+	uint32 taskIdArray[FLEXIBLE_ARRAY_MEMBER];
+} ParallelTaskResults;
+
+
+/*
+ * ParallelTaskScan keeps the state of a process that reads task result files
+ * through ParallelTaskResults.
+ */
+typedef struct ParallelTaskScan
+{
+	ParallelTaskResults *taskResults;
+	CopyState copyState;          /* NULL if no file is being read */
+	MemoryContext tupleContext;
+} ParallelTaskScan;
+
+
+#if (PG_VERSION_NUM >= 90600)
+static Size CitusEstimateDSMScan(CustomScanState *node, ParallelContext *parallelContext);
+static void CitusInitializeDSMScan(CustomScanState *node,
+								   ParallelContext *parallelContext, void *coordinate);
+static void CitusInitializeWorkerScan(CustomScanState *node, shm_toc *toc,
+									  void *coordinate);
+#endif
 
 
 /*
@@ -41,6 +103,11 @@ static CustomExecMethods RealTimeCustomExecMethods = {
 	.ExecCustomScan = RealTimeExecScan,
 	.EndCustomScan = CitusEndScan,
 	.ReScanCustomScan = CitusReScan,
+#if (PG_VERSION_NUM >= 90600)
+	.EstimateDSMCustomScan = CitusEstimateDSMScan,
+	.InitializeDSMCustomScan = CitusInitializeDSMScan,
+	.InitializeWorkerCustomScan = CitusInitializeWorkerScan,
+#endif
 	.ExplainCustomScan = CitusExplainScan
 };
 
@@ -50,6 +117,11 @@ static CustomExecMethods TaskTrackerCustomExecMethods = {
 	.ExecCustomScan = TaskTrackerExecScan,
 	.EndCustomScan = CitusEndScan,
 	.ReScanCustomScan = CitusReScan,
+#if (PG_VERSION_NUM >= 90600)
+	.EstimateDSMCustomScan = CitusEstimateDSMScan,
+	.InitializeDSMCustomScan = CitusInitializeDSMScan,
+	.InitializeWorkerCustomScan = CitusInitializeWorkerScan,
+#endif
 	.ExplainCustomScan = CitusExplainScan
 };
 
@@ -83,7 +155,21 @@ static CustomExecMethods RouterSelectCustomExecMethods = {
 
 /* local function forward declarations */
 static void PrepareMasterJobDirectory(Job *workerJob);
+static void LoadTaskResults(CitusScanState *scanState, Job *workerJob);
+static TupleTableSlot * ReturnTaskResult(CitusScanState *scanState);
 static void LoadTuplesIntoTupleStore(CitusScanState *citusScanState, Job *workerJob);
+static List * TaskResultCopyOptions(void);
+static TupleTableSlot * ReturnStreamedTuple(CitusScanState *scanState);
+static void BeginSortedMerge(CitusScanState *scanState, Job *workerJob);
+static TupleTableSlot * ReturnTupleFromSortedMerge(CitusScanState *scanState);
+static bool ReadNextMergeTuple(CitusScanState *scanState, int taskIndex);
+static int CompareMergeTuples(Datum leftTask, Datum rightTask, void *arg);
+static void LoadMergedTuplesIntoTupleStore(CitusScanState *scanState);
+static void EndSortedMerge(CitusScanState *scanState);
+static void BeginParallelTaskScan(CitusScanState *scanState,
+								  ParallelTaskResults *taskResults);
+static TupleTableSlot * ReturnTupleFromParallelTaskScan(CitusScanState *scanState);
+static void RewindParallelTaskScan(CitusScanState *scanState);
 static Relation StubRelation(TupleDesc tupleDescriptor);
 
 
@@ -145,8 +231,11 @@ RouterCreateScan(CustomScan *scan)
 
 	isModificationQuery = IsModifyMultiPlan(multiPlan);
 
-	/* check if this is a single shard query */
-	if (list_length(taskList) == 1)
+	/*
+	 * Check if this is a single shard query. Selects with deferred shard
+	 * pruning also run a single task, which is picked when the scan begins.
+	 */
+	if (list_length(taskList) == 1 || workerJob->deferredPruningParam != NULL)
 	{
 		if (isModificationQuery)
 		{
@@ -189,12 +278,39 @@ DelayedErrorCreateScan(CustomScan *scan)
 
 
 /*
- * CitusSelectBeginScan is an empty function for BeginCustomScan callback.
+ * CitusSelectBeginScan is the BeginCustomScan callback for select queries. It
+ * decides whether a real-time execution streams its results. Scans that may need
+ * to move backwards keep all results instead. So do scans that merge sorted task
+ * results, as the merge needs the complete result of each task, and scans that
+ * share the task results with parallel workers.
+ *
+ * For router plans that defer shard pruning to execution, it also picks the
+ * task to run based on the parameter values of the execution.
  */
 void
 CitusSelectBeginScan(CustomScanState *node, EState *estate, int eflags)
 {
-	/* just an empty function */
+	CitusScanState *scanState = (CitusScanState *) node;
+	MultiPlan *multiPlan = scanState->multiPlan;
+	Job *workerJob = multiPlan->workerJob;
+	bool parallelAware = false;
+
+#if (PG_VERSION_NUM >= 90600)
+	parallelAware = node->ss.ps.plan->parallel_aware;
+#endif
+
+	if (workerJob->deferredPruningParam != NULL)
+	{
+		PruneDeferredTaskList(workerJob, estate->es_param_list_info);
+	}
+
+	scanState->randomAccess = (eflags & EXEC_FLAG_BACKWARD) != 0;
+
+	if (scanState->executorType == MULTI_EXECUTOR_REAL_TIME && EnableResultStreaming &&
+		!scanState->randomAccess && !multiPlan->sortedMerge && !parallelAware)
+	{
+		scanState->streamResults = true;
+	}
 }
 
 
@@ -202,7 +318,11 @@ CitusSelectBeginScan(CustomScanState *node, EState *estate, int eflags)
  * RealTimeExecScan is a callback function which returns next tuple from a real-time
  * execution. In the first call, it executes distributed real-time plan and loads
  * results from temporary files into custom scan's tuple store. Then, it returns
- * tuples one by one from this tuple store.
+ * tuples one by one from this tuple store. If results are streamed, tuples are
+ * instead returned as they arrive from the workers. If task results are sorted,
+ * tuples are returned in order by merging the results. If task results are read
+ * together with parallel workers, tuples are returned from the result files that
+ * this process takes.
  */
 TupleTableSlot *
 RealTimeExecScan(CustomScanState *node)
@@ -210,6 +330,16 @@ RealTimeExecScan(CustomScanState *node)
 	CitusScanState *scanState = (CitusScanState *) node;
 	TupleTableSlot *resultSlot = NULL;
 
+	if (scanState->streamResults)
+	{
+		return ReturnStreamedTuple(scanState);
+	}
+
+	if (scanState->parallelTaskScan != NULL)
+	{
+		return ReturnTupleFromParallelTaskScan(scanState);
+	}
+
 	if (!scanState->finishedRemoteScan)
 	{
 		MultiPlan *multiPlan = scanState->multiPlan;
@@ -218,13 +348,65 @@ RealTimeExecScan(CustomScanState *node)
 		PrepareMasterJobDirectory(workerJob);
 		MultiRealTimeExecute(workerJob);
 
-		LoadTuplesIntoTupleStore(scanState, workerJob);
+		LoadTaskResults(scanState, workerJob);
 
 		scanState->finishedRemoteScan = true;
 	}
 
+	resultSlot = ReturnTaskResult(scanState);
+
+	return resultSlot;
+}
+
+
+/*
+ * ReturnStreamedTuple returns the next tuple of a real-time execution that
+ * streams its results. In the first call, it starts the execution, which stores
+ * the rows it receives in the custom scan's tuple store. Whenever all tuples in
+ * the store have been returned, the function clears the store and continues the
+ * execution until new rows arrive, or until the execution is finished.
+ */
+static TupleTableSlot *
+ReturnStreamedTuple(CitusScanState *scanState)
+{
+	TupleTableSlot *resultSlot = NULL;
+
+	if (scanState->realTimeExecution == NULL && !scanState->finishedRemoteScan)
+	{
+		Job *workerJob = scanState->multiPlan->workerJob;
+		TupleDesc tupleDescriptor =
+			scanState->customScanState.ss.ps.ps_ResultTupleSlot->tts_tupleDescriptor;
+		bool randomAccess = false;
+		bool interTransactions = false;
+
+		Assert(scanState->tuplestorestate == NULL);
+		scanState->tuplestorestate =
+			tuplestore_begin_heap(randomAccess, interTransactions, work_mem);
+
+		scanState->realTimeExecution =
+			MultiRealTimeExecuteStart(workerJob, scanState->tuplestorestate,
+									  tupleDescriptor);
+	}
+
 	resultSlot = ReturnTupleFromTuplestore(scanState);
 
+	while (TupIsNull(resultSlot) && !scanState->finishedRemoteScan)
+	{
+		bool moreResults = false;
+
+		/* all tuples of the previous batch were returned, make room for new ones */
+		tuplestore_clear(scanState->tuplestorestate);
+
+		moreResults = MultiRealTimeExecuteNext(scanState->realTimeExecution);
+		if (!moreResults)
+		{
+			scanState->realTimeExecution = NULL;
+			scanState->finishedRemoteScan = true;
+		}
+
+		resultSlot = ReturnTupleFromTuplestore(scanState);
+	}
+
 	return resultSlot;
 }
 
@@ -245,6 +427,48 @@ PrepareMasterJobDirectory(Job *workerJob)
 }
 
 
+/*
+ * LoadTaskResults prepares the task result files of the given job for reading.
+ * If the task results are sorted, the function starts merging them; scans that
+ * may move backwards load the merged results into the tuple store instead. In
+ * other cases, the function loads the results into the tuple store as they are.
+ */
+static void
+LoadTaskResults(CitusScanState *scanState, Job *workerJob)
+{
+	MultiPlan *multiPlan = scanState->multiPlan;
+
+	if (!multiPlan->sortedMerge)
+	{
+		LoadTuplesIntoTupleStore(scanState, workerJob);
+		return;
+	}
+
+	BeginSortedMerge(scanState, workerJob);
+
+	if (scanState->randomAccess)
+	{
+		LoadMergedTuplesIntoTupleStore(scanState);
+	}
+}
+
+
+/*
+ * ReturnTaskResult returns the next tuple of the task results loaded by
+ * LoadTaskResults, either from an ongoing merge, or from the tuple store.
+ */
+static TupleTableSlot *
+ReturnTaskResult(CitusScanState *scanState)
+{
+	if (scanState->sortedMerge != NULL)
+	{
+		return ReturnTupleFromSortedMerge(scanState);
+	}
+
+	return ReturnTupleFromTuplestore(scanState);
+}
+
+
 /*
  * Load data collected by real-time or task-tracker executors into the tuplestore
  * of CitusScanState. For that, we first create a tuple store, and then copy the
@@ -286,11 +510,7 @@ LoadTuplesIntoTupleStore(CitusScanState *citusScanState, Job *workerJob)
 	citusScanState->tuplestorestate =
 		tuplestore_begin_heap(randomAccess, interTransactions, work_mem);
 
-	if (BinaryMasterCopyFormat)
-	{
-		DefElem *copyOption = makeDefElem("format", (Node *) makeString("binary"));
-		copyOptions = lappend(copyOptions, copyOption);
-	}
+	copyOptions = TaskResultCopyOptions();
 
 	foreach(workerTaskCell, workerTaskList)
 	{
@@ -331,6 +551,25 @@ LoadTuplesIntoTupleStore(CitusScanState *citusScanState, Job *workerJob)
 }
 
 
+/*
+ * TaskResultCopyOptions returns the options for reading task result files,
+ * which depend on the format in which the files were copied from workers.
+ */
+static List *
+TaskResultCopyOptions(void)
+{
+	List *copyOptions = NIL;
+
+	if (BinaryMasterCopyFormat)
+	{
+		DefElem *copyOption = makeDefElem("format", (Node *) makeString("binary"));
+		copyOptions = lappend(copyOptions, copyOption);
+	}
+
+	return copyOptions;
+}
+
+
 /*
  * StubRelation creates a stub Relation from the given tuple descriptor.
  * To be able to use copy.c, we need a Relation descriptor. As there is no
@@ -382,11 +621,482 @@ ReturnTupleFromTuplestore(CitusScanState *scanState)
 }
 
 
+/*
+ * BeginSortedMerge opens the result files of the given job's tasks for a k-way
+ * merge, and prepares the comparison of rows by the master query's sort clause.
+ * The merge then only keeps one row per task in memory, and returns the first
+ * rows without reading the remaining ones.
+ */
+static void
+BeginSortedMerge(CitusScanState *scanState, Job *workerJob)
+{
+	TupleDesc tupleDescriptor =
+		scanState->customScanState.ss.ps.ps_ResultTupleSlot->tts_tupleDescriptor;
+	Query *masterQuery = scanState->multiPlan->masterQuery;
+	List *sortClauseList = masterQuery->sortClause;
+	List *workerTaskList = workerJob->taskList;
+	List *copyOptions = TaskResultCopyOptions();
+	Relation stubRelation = StubRelation(tupleDescriptor);
+	SortedMerge *sortedMerge = palloc0(sizeof(SortedMerge));
+	MemoryContext oldContext = NULL;
+	ListCell *sortClauseCell = NULL;
+	ListCell *workerTaskCell = NULL;
+	int sortKeyIndex = 0;
+	int taskIndex = 0;
+
+	sortedMerge->mergeContext = AllocSetContextCreate(CurrentMemoryContext,
+													  "SortedMerge",
+													  ALLOCSET_DEFAULT_MINSIZE,
+													  ALLOCSET_DEFAULT_INITSIZE,
+													  ALLOCSET_DEFAULT_MAXSIZE);
+	oldContext = MemoryContextSwitchTo(sortedMerge->mergeContext);
+
+	sortedMerge->sortKeyCount = list_length(sortClauseList);
+	sortedMerge->sortKeyArray = palloc0(sortedMerge->sortKeyCount *
+										sizeof(SortSupportData));
+
+	foreach(sortClauseCell, sortClauseList)
+	{
+		SortGroupClause *sortClause = (SortGroupClause *) lfirst(sortClauseCell);
+		TargetEntry *targetEntry = get_sortgroupclause_tle(sortClause,
+														   masterQuery->targetList);
+		SortSupport sortKey = &sortedMerge->sortKeyArray[sortKeyIndex];
+
+		/*
+		 * Task result rows have the columns of the worker target list, which the
+		 * master target list references. Sorted merges are only planned for sort
+		 * keys that are plain columns, so the sort key is the referenced column.
+		 */
+		Var *sortColumn = (Var *) targetEntry->expr;
+		Assert(IsA(sortColumn, Var));
+
+		sortKey->ssup_cxt = sortedMerge->mergeContext;
+		sortKey->ssup_collation = exprCollation((Node *) sortColumn);
+		sortKey->ssup_nulls_first = sortClause->nulls_first;
+		sortKey->ssup_attno = sortColumn->varattno;
+
+		PrepareSortSupportFromOrderingOp(sortClause->sortop, sortKey);
+		sortKeyIndex++;
+	}
+
+	sortedMerge->taskCount = list_length(workerTaskList);
+	sortedMerge->copyStateArray = palloc0(sortedMerge->taskCount * sizeof(CopyState));
+	sortedMerge->slotArray = palloc0(sortedMerge->taskCount * sizeof(TupleTableSlot *));
+	sortedMerge->rowContextArray = palloc0(sortedMerge->taskCount *
+										   sizeof(MemoryContext));
+
+	foreach(workerTaskCell, workerTaskList)
+	{
+		Task *workerTask = (Task *) lfirst(workerTaskCell);
+		StringInfo jobDirectoryName = MasterJobDirectoryName(workerTask->jobId);
+		StringInfo taskFilename = TaskFilename(jobDirectoryName, workerTask->taskId);
+
+		sortedMerge->copyStateArray[taskIndex] =
+			BeginCopyFrom(stubRelation, taskFilename->data, false, NULL, copyOptions);
+		sortedMerge->slotArray[taskIndex] = MakeSingleTupleTableSlot(tupleDescriptor);
+		sortedMerge->rowContextArray[taskIndex] =
+			AllocSetContextCreate(sortedMerge->mergeContext, "SortedMergeRow",
+								  ALLOCSET_SMALL_MINSIZE,
+								  ALLOCSET_SMALL_INITSIZE,
+								  ALLOCSET_SMALL_MAXSIZE);
+		taskIndex++;
+	}
+
+	sortedMerge->taskHeap = binaryheap_allocate(sortedMerge->taskCount,
+												CompareMergeTuples, sortedMerge);
+
+	MemoryContextSwitchTo(oldContext);
+
+	scanState->sortedMerge = sortedMerge;
+}
+
+
+/*
+ * ReturnTupleFromSortedMerge returns the next tuple in sort order from the
+ * sorted merge of the given scan. The heap keeps the task whose current row
+ * comes first at the top; after returning that row, we read the task's next
+ * row and sift the task down the heap. The function returns an empty slot
+ * once all task results have been read.
+ */
+static TupleTableSlot *
+ReturnTupleFromSortedMerge(CitusScanState *scanState)
+{
+	SortedMerge *sortedMerge = scanState->sortedMerge;
+	binaryheap *taskHeap = sortedMerge->taskHeap;
+	int taskIndex = 0;
+
+	if (!sortedMerge->initialized)
+	{
+		for (taskIndex = 0; taskIndex < sortedMerge->taskCount; taskIndex++)
+		{
+			if (ReadNextMergeTuple(scanState, taskIndex))
+			{
+				binaryheap_add_unordered(taskHeap, Int32GetDatum(taskIndex));
+			}
+		}
+
+		binaryheap_build(taskHeap);
+		sortedMerge->initialized = true;
+	}
+	else if (!binaryheap_empty(taskHeap))
+	{
+		taskIndex = DatumGetInt32(binaryheap_first(taskHeap));
+
+		if (ReadNextMergeTuple(scanState, taskIndex))
+		{
+			binaryheap_replace_first(taskHeap, Int32GetDatum(taskIndex));
+		}
+		else
+		{
+			(void) binaryheap_remove_first(taskHeap);
+		}
+	}
+
+	if (binaryheap_empty(taskHeap))
+	{
+		TupleTableSlot *resultSlot = scanState->customScanState.ss.ps.ps_ResultTupleSlot;
+		return ExecClearTuple(resultSlot);
+	}
+
+	taskIndex = DatumGetInt32(binaryheap_first(taskHeap));
+
+	return sortedMerge->slotArray[taskIndex];
+}
+
+
+/*
+ * ReadNextMergeTuple reads the next row from the result file of the task with
+ * the given index into the task's slot. If the file has no rows left, the
+ * function closes the file and returns false.
+ */
+static bool
+ReadNextMergeTuple(CitusScanState *scanState, int taskIndex)
+{
+	SortedMerge *sortedMerge = scanState->sortedMerge;
+	EState *executorState = scanState->customScanState.ss.ps.state;
+	ExprContext *executorExpressionContext = GetPerTupleExprContext(executorState);
+	CopyState copyState = sortedMerge->copyStateArray[taskIndex];
+	TupleTableSlot *slot = sortedMerge->slotArray[taskIndex];
+	MemoryContext rowContext = sortedMerge->rowContextArray[taskIndex];
+	MemoryContext oldContext = NULL;
+	bool nextRowFound = false;
+
+	/* the previous row of this task has been returned already */
+	ExecClearTuple(slot);
+	MemoryContextReset(rowContext);
+
+	oldContext = MemoryContextSwitchTo(rowContext);
+	nextRowFound = NextCopyFrom(copyState, executorExpressionContext,
+								slot->tts_values, slot->tts_isnull, NULL);
+	MemoryContextSwitchTo(oldContext);
+
+	if (!nextRowFound)
+	{
+		EndCopyFrom(copyState);
+		sortedMerge->copyStateArray[taskIndex] = NULL;
+
+		return false;
+	}
+
+	ExecStoreVirtualTuple(slot);
+
+	return true;
+}
+
+
+/*
+ * CompareMergeTuples compares the current rows of the two given tasks by the
+ * sort keys of the sorted merge. As binaryheap is a max-heap, the function
+ * inverts the comparison, so that the task with the first row ends up on top.
+ */
+static int
+CompareMergeTuples(Datum leftTask, Datum rightTask, void *arg)
+{
+	SortedMerge *sortedMerge = (SortedMerge *) arg;
+	TupleTableSlot *leftSlot = sortedMerge->slotArray[DatumGetInt32(leftTask)];
+	TupleTableSlot *rightSlot = sortedMerge->slotArray[DatumGetInt32(rightTask)];
+	int sortKeyIndex = 0;
+
+	for (sortKeyIndex = 0; sortKeyIndex < sortedMerge->sortKeyCount; sortKeyIndex++)
+	{
+		SortSupport sortKey = &sortedMerge->sortKeyArray[sortKeyIndex];
+		AttrNumber attributeNumber = sortKey->ssup_attno;
+		bool leftIsNull = false;
+		bool rightIsNull = false;
+		Datum leftDatum = slot_getattr(leftSlot, attributeNumber, &leftIsNull);
+		Datum rightDatum = slot_getattr(rightSlot, attributeNumber, &rightIsNull);
+
+		int compare = ApplySortComparator(leftDatum, leftIsNull, rightDatum, rightIsNull,
+										  sortKey);
+		if (compare != 0)
+		{
+			return -compare;
+		}
+	}
+
+	return 0;
+}
+
+
+/*
+ * LoadMergedTuplesIntoTupleStore reads all tuples of the sorted merge of the
+ * given scan into the scan's tuple store, and then ends the merge. This is
+ * used for scans that may move backwards, which the merge can't do.
+ */
+static void
+LoadMergedTuplesIntoTupleStore(CitusScanState *scanState)
+{
+	bool randomAccess = true;
+	bool interTransactions = false;
+
+	Assert(scanState->tuplestorestate == NULL);
+	scanState->tuplestorestate =
+		tuplestore_begin_heap(randomAccess, interTransactions, work_mem);
+
+	while (true)
+	{
+		TupleTableSlot *slot = ReturnTupleFromSortedMerge(scanState);
+		if (TupIsNull(slot))
+		{
+			break;
+		}
+
+		tuplestore_puttupleslot(scanState->tuplestorestate, slot);
+	}
+
+	EndSortedMerge(scanState);
+}
+
+
+/*
+ * EndSortedMerge closes the task result files that the sorted merge of the
+ * given scan still reads from, and frees the merge's memory.
+ */
+static void
+EndSortedMerge(CitusScanState *scanState)
+{
+	SortedMerge *sortedMerge = scanState->sortedMerge;
+	int taskIndex = 0;
+
+	for (taskIndex = 0; taskIndex < sortedMerge->taskCount; taskIndex++)
+	{
+		CopyState copyState = sortedMerge->copyStateArray[taskIndex];
+		if (copyState != NULL)
+		{
+			EndCopyFrom(copyState);
+		}
+
+		ExecDropSingleTupleTableSlot(sortedMerge->slotArray[taskIndex]);
+	}
+
+	MemoryContextDelete(sortedMerge->mergeContext);
+	pfree(sortedMerge);
+
+	scanState->sortedMerge = NULL;
+}
+
+
+#if (PG_VERSION_NUM >= 90600)
+
+/*
+ * CitusEstimateDSMScan is the EstimateDSMCustomScan callback for scans that
+ * parallel workers share. It returns the size of the shared task result list.
+ */
+static Size
+CitusEstimateDSMScan(CustomScanState *node, ParallelContext *parallelContext)
+{
+	CitusScanState *scanState = (CitusScanState *) node;
+	List *taskList = scanState->multiPlan->workerJob->taskList;
+
+	return add_size(offsetof(ParallelTaskResults, taskIdArray),
+					mul_size(list_length(taskList), sizeof(uint32)));
+}
+
+
+/*
+ * CitusInitializeDSMScan is the InitializeDSMCustomScan callback for scans that
+ * parallel workers share. PostgreSQL calls it in the master backend before it
+ * starts the parallel workers, so we execute the distributed job here. Once all
+ * task results are in files, we list the files in shared memory, from where
+ * the master backend and the parallel workers take them one by one.
+ */
+static void
+CitusInitializeDSMScan(CustomScanState *node, ParallelContext *parallelContext,
+					   void *coordinate)
+{
+	CitusScanState *scanState = (CitusScanState *) node;
+	Job *workerJob = scanState->multiPlan->workerJob;
+	ParallelTaskResults *taskResults = (ParallelTaskResults *) coordinate;
+	ListCell *workerTaskCell = NULL;
+	uint32 taskIndex = 0;
+
+	PrepareMasterJobDirectory(workerJob);
+
+	if (scanState->executorType == MULTI_EXECUTOR_REAL_TIME)
+	{
+		MultiRealTimeExecute(workerJob);
+	}
+	else
+	{
+		MultiTaskTrackerExecute(workerJob);
+	}
+
+	scanState->finishedRemoteScan = true;
+
+	taskResults->jobId = workerJob->jobId;
+	taskResults->taskCount = list_length(workerJob->taskList);
+	pg_atomic_init_u32(&taskResults->nextTaskIndex, 0);
+
+	foreach(workerTaskCell, workerJob->taskList)
+	{
+		Task *workerTask = (Task *) lfirst(workerTaskCell);
+
+		taskResults->taskIdArray[taskIndex] = workerTask->taskId;
+		taskIndex++;
+	}
+
+	BeginParallelTaskScan(scanState, taskResults);
+}
+
+
+/*
+ * CitusInitializeWorkerScan is the InitializeWorkerCustomScan callback for
+ * scans that parallel workers share. The master backend has already executed
+ * the distributed job, so the parallel worker only reads task result files.
+ */
+static void
+CitusInitializeWorkerScan(CustomScanState *node, shm_toc *toc, void *coordinate)
+{
+	CitusScanState *scanState = (CitusScanState *) node;
+
+	scanState->finishedRemoteScan = true;
+
+	BeginParallelTaskScan(scanState, (ParallelTaskResults *) coordinate);
+}
+
+
+#endif
+
+
+/*
+ * BeginParallelTaskScan starts reading the task result files listed in the given
+ * shared memory for the given scan.
+ */
+static void
+BeginParallelTaskScan(CitusScanState *scanState, ParallelTaskResults *taskResults)
+{
+	EState *executorState = scanState->customScanState.ss.ps.state;
+	MemoryContext queryContext = executorState->es_query_cxt;
+	ParallelTaskScan *taskScan = MemoryContextAllocZero(queryContext,
+														sizeof(ParallelTaskScan));
+
+	taskScan->taskResults = taskResults;
+	taskScan->copyState = NULL;
+	taskScan->tupleContext = AllocSetContextCreate(queryContext,
+												   "ParallelTaskScan",
+												   ALLOCSET_DEFAULT_MINSIZE,
+												   ALLOCSET_DEFAULT_INITSIZE,
+												   ALLOCSET_DEFAULT_MAXSIZE);
+
+	scanState->parallelTaskScan = taskScan;
+}
+
+
+/*
+ * ReturnTupleFromParallelTaskScan returns the next tuple from the task result
+ * file that this process currently reads. Once the file has no rows left, the
+ * function takes the next unread file. It returns an empty slot once no unread
+ * files are left.
+ */
+static TupleTableSlot *
+ReturnTupleFromParallelTaskScan(CitusScanState *scanState)
+{
+	ParallelTaskScan *taskScan = scanState->parallelTaskScan;
+	ParallelTaskResults *taskResults = taskScan->taskResults;
+	TupleTableSlot *resultSlot = scanState->customScanState.ss.ps.ps_ResultTupleSlot;
+	TupleDesc tupleDescriptor = resultSlot->tts_tupleDescriptor;
+	EState *executorState = scanState->customScanState.ss.ps.state;
+	ExprContext *executorExpressionContext = GetPerTupleExprContext(executorState);
+
+	ExecClearTuple(resultSlot);
+	MemoryContextReset(taskScan->tupleContext);
+
+	while (true)
+	{
+		MemoryContext oldContext = NULL;
+		bool nextRowFound = false;
+
+		if (taskScan->copyState == NULL)
+		{
+			uint32 taskIndex = pg_atomic_fetch_add_u32(&taskResults->nextTaskIndex, 1);
+			StringInfo jobDirectoryName = NULL;
+			StringInfo taskFilename = NULL;
+
+			if (taskIndex >= taskResults->taskCount)
+			{
+				break;
+			}
+
+			jobDirectoryName = MasterJobDirectoryName(taskResults->jobId);
+			taskFilename = TaskFilename(jobDirectoryName,
+										taskResults->taskIdArray[taskIndex]);
+
+			oldContext = MemoryContextSwitchTo(executorState->es_query_cxt);
+			taskScan->copyState = BeginCopyFrom(StubRelation(tupleDescriptor),
+												taskFilename->data, false, NULL,
+												TaskResultCopyOptions());
+			MemoryContextSwitchTo(oldContext);
+		}
+
+		oldContext = MemoryContextSwitchTo(taskScan->tupleContext);
+		nextRowFound = NextCopyFrom(taskScan->copyState, executorExpressionContext,
+									resultSlot->tts_values, resultSlot->tts_isnull,
+									NULL);
+		MemoryContextSwitchTo(oldContext);
+
+		if (nextRowFound)
+		{
+			ExecStoreVirtualTuple(resultSlot);
+			break;
+		}
+
+		EndCopyFrom(taskScan->copyState);
+		taskScan->copyState = NULL;
+	}
+
+	return resultSlot;
+}
+
+
+/*
+ * RewindParallelTaskScan stops reading the current task result file, and marks
+ * all task result files as unread in shared memory. Only the master backend
+ * rewinds the scan, when no parallel workers are running.
+ */
+static void
+RewindParallelTaskScan(CitusScanState *scanState)
+{
+	ParallelTaskScan *taskScan = scanState->parallelTaskScan;
+
+	if (taskScan->copyState != NULL)
+	{
+		EndCopyFrom(taskScan->copyState);
+		taskScan->copyState = NULL;
+	}
+
+	MemoryContextReset(taskScan->tupleContext);
+
+	pg_atomic_write_u32(&taskScan->taskResults->nextTaskIndex, 0);
+}
+
+
 /*
  * TaskTrackerExecScan is a callback function which returns next tuple from a
  * task-tracker execution. In the first call, it executes distributed task-tracker
  * plan and loads results from temporary files into custom scan's tuple store.
- * Then, it returns tuples one by one from this tuple store.
+ * Then, it returns tuples one by one from this tuple store. As with the real-time
+ * executor, sorted task results are merged instead, and task results may be read
+ * together with parallel workers.
  */
 TupleTableSlot *
 TaskTrackerExecScan(CustomScanState *node)
@@ -394,6 +1104,11 @@ TaskTrackerExecScan(CustomScanState *node)
 	CitusScanState *scanState = (CitusScanState *) node;
 	TupleTableSlot *resultSlot = NULL;
 
+	if (scanState->parallelTaskScan != NULL)
+	{
+		return ReturnTupleFromParallelTaskScan(scanState);
+	}
+
 	if (!scanState->finishedRemoteScan)
 	{
 		MultiPlan *multiPlan = scanState->multiPlan;
@@ -402,12 +1117,12 @@ TaskTrackerExecScan(CustomScanState *node)
 		PrepareMasterJobDirectory(workerJob);
 		MultiTaskTrackerExecute(workerJob);
 
-		LoadTuplesIntoTupleStore(scanState, workerJob);
+		LoadTaskResults(scanState, workerJob);
 
 		scanState->finishedRemoteScan = true;
 	}
 
-	resultSlot = ReturnTupleFromTuplestore(scanState);
+	resultSlot = ReturnTaskResult(scanState);
 
 	return resultSlot;
 }
@@ -415,12 +1130,34 @@ TaskTrackerExecScan(CustomScanState *node)
 
 /*
  * CitusEndScan is used to clean up tuple store of the given custom scan state.
+ * If the scan stopped before a streaming execution finished, the function also
+ * stops the execution.
  */
 void
 CitusEndScan(CustomScanState *node)
 {
 	CitusScanState *scanState = (CitusScanState *) node;
 
+	if (scanState->realTimeExecution != NULL)
+	{
+		RealTimeExecution *realTimeExecution = scanState->realTimeExecution;
+
+		scanState->realTimeExecution = NULL;
+		MultiRealTimeExecuteEnd(realTimeExecution);
+	}
+
+	if (scanState->sortedMerge != NULL)
+	{
+		EndSortedMerge(scanState);
+	}
+
+	if (scanState->parallelTaskScan != NULL &&
+		scanState->parallelTaskScan->copyState != NULL)
+	{
+		EndCopyFrom(scanState->parallelTaskScan->copyState);
+		scanState->parallelTaskScan->copyState = NULL;
+	}
+
 	if (scanState->tuplestorestate)
 	{
 		tuplestore_end(scanState->tuplestorestate);
@@ -430,12 +1167,23 @@ CitusEndScan(CustomScanState *node)
 
 
 /*
- * CitusReScan is just a place holder for rescan callback. Currently, we don't
- * support rescan given that there is not any way to reach this code path.
+ * CitusReScan is the rescan callback. A Gather node rescans the scan that it
+ * runs in parallel workers after the workers have exited, and keeps the shared
+ * memory of the scan; we then start reading the task result files from the
+ * beginning. We don't support other rescans given that there is not any way to
+ * reach those code paths.
  */
 void
 CitusReScan(CustomScanState *node)
 {
+	CitusScanState *scanState = (CitusScanState *) node;
+
+	if (scanState->parallelTaskScan != NULL)
+	{
+		RewindParallelTaskScan(scanState);
+		return;
+	}
+
 	ereport(ERROR, (errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
 					errmsg("rescan is unsupported"),
 					errdetail("We don't expect this code path to be executed.")));
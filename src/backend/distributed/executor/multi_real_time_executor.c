@@ -24,18 +24,28 @@
 #include <poll.h>
 
 #include "commands/dbcommands.h"
+#include "funcapi.h"
 #include "distributed/connection_management.h"
 #include "distributed/multi_client_executor.h"
 #include "distributed/multi_physical_planner.h"
 #include "distributed/multi_server_executor.h"
+#include "distributed/shared_connection_stats.h"
 #include "distributed/worker_protocol.h"
 #include "storage/fd.h"
+#include "utils/memutils.h"
 #include "utils/timestamp.h"
 
 
 /* Local functions forward declarations */
-static ConnectAction ManageTaskExecution(Task *task, TaskExecution *taskExecution,
+static RealTimeExecution * CreateRealTimeExecution(Job *job);
+static bool RealTimeExecutionFinished(RealTimeExecution *execution);
+static void ExecuteRealTimeCycle(RealTimeExecution *execution);
+static void WaitForRealTimeTasks(RealTimeExecution *execution);
+static void FinishRealTimeExecution(RealTimeExecution *execution);
+static ConnectAction ManageTaskExecution(RealTimeExecution *execution, Task *task,
+										 TaskExecution *taskExecution,
 										 TaskExecutionStatus *executionStatus);
+static CopyStatus StoreTaskResults(RealTimeExecution *execution, int32 connectionId);
 static bool TaskExecutionReadyToStart(TaskExecution *taskExecution);
 static bool TaskExecutionCompleted(TaskExecution *taskExecution);
 static void CancelTaskExecutionIfActive(TaskExecution *taskExecution);
@@ -54,36 +64,175 @@ static WorkerNodeState * LookupWorkerForTask(HTAB *workerHash, Task *task,
 /* Throttling functions */
 static bool WorkerConnectionsExhausted(WorkerNodeState *workerNodeState);
 static bool MasterConnectionsExhausted(HTAB *workerHash);
+static bool ReserveWorkerConnection(WorkerNodeState *workerNodeState,
+									bool *connectionReserved);
 static uint32 TotalOpenConnectionCount(HTAB *workerHash);
 static void UpdateConnectionCounter(WorkerNodeState *workerNode,
 									ConnectAction connectAction);
+static bool ScaleUpConnectionLimits(HTAB *workerHash);
+
+/* Connection sharing functions */
+static bool StartTaskOnIdleConnection(TaskExecution *taskExecution,
+									  WorkerNodeState *workerNodeState);
+static bool ReleaseTaskConnection(TaskExecution *taskExecution,
+								  WorkerNodeState *workerNodeState);
+static void CloseIdleConnections(HTAB *workerHash);
+
+
+/*
+ * RealTimeExecution keeps the state of a real-time execution across execution
+ * cycles. If the execution streams its results, the rows received from workers
+ * are stored in the given tuple store as they arrive, instead of being copied
+ * into files in the master job directory.
+ */
+struct RealTimeExecution
+{
+	Job *job;
+	List *taskExecutionList;
+	HTAB *workerHash;
+	WaitInfo *waitInfo;
+	bool allTasksCompleted;
+	bool taskFailed;
+	uint32 failedTaskId;
+
+	/* fields below are only set if results are streamed */
+	Tuplestorestate *tupleStore;
+	AttInMetadata *attributeInputMetadata;
+	bool binaryResults;
+	AttributeReceiveMetadata *attributeReceiveMetadata;
+	char **columnArray;
+	int *lengthArray;
+	MemoryContext ioContext;
+	uint64 cycleTupleCount;
+};
 
 
 /*
  * MultiRealTimeExecute loops over the given tasks, and manages their execution
  * until either one task permanently fails or all tasks successfully complete.
  * The function opens up a connection for each task it needs to execute, and
- * manages these tasks' execution in real-time.
+ * manages these tasks' execution in real-time. If citus.max_connections_per_worker
+ * is set, the function instead opens at most that many connections per worker,
+ * and runs the tasks for a worker back-to-back on these connections.
  */
 void
 MultiRealTimeExecute(Job *job)
 {
+	RealTimeExecution *execution = CreateRealTimeExecution(job);
+
+	/* loop around until all tasks complete, one task fails, or user cancels */
+	while (!RealTimeExecutionFinished(execution))
+	{
+		ExecuteRealTimeCycle(execution);
+
+		if (!RealTimeExecutionFinished(execution))
+		{
+			WaitForRealTimeTasks(execution);
+		}
+	}
+
+	FinishRealTimeExecution(execution);
+}
+
+
+/*
+ * MultiRealTimeExecuteStart starts a real-time execution of the given job that
+ * streams its results. Instead of copying task results into files, the tasks
+ * fetch their results row by row, and the rows are stored in the given tuple
+ * store as they arrive. The caller then drives the execution by calling
+ * MultiRealTimeExecuteNext whenever it has consumed all tuples in the store.
+ */
+RealTimeExecution *
+MultiRealTimeExecuteStart(Job *job, Tuplestorestate *tupleStore,
+						  TupleDesc tupleDescriptor)
+{
+	RealTimeExecution *execution = CreateRealTimeExecution(job);
+
+	execution->tupleStore = tupleStore;
+	execution->attributeInputMetadata = TupleDescGetAttInMetadata(tupleDescriptor);
+	execution->columnArray = palloc0(tupleDescriptor->natts * sizeof(char *));
+	execution->lengthArray = palloc0(tupleDescriptor->natts * sizeof(int));
+
+	if (EnableBinaryProtocol && CanUseBinaryProtocol(tupleDescriptor))
+	{
+		execution->binaryResults = true;
+		execution->attributeReceiveMetadata =
+			TupleDescGetReceiveMetadata(tupleDescriptor);
+	}
+	execution->ioContext = AllocSetContextCreate(CurrentMemoryContext,
+												 "RealTimeExecution",
+												 ALLOCSET_DEFAULT_MINSIZE,
+												 ALLOCSET_DEFAULT_INITSIZE,
+												 ALLOCSET_DEFAULT_MAXSIZE);
+
+	return execution;
+}
+
+
+/*
+ * MultiRealTimeExecuteNext runs the given streaming execution until new rows
+ * have been stored in its tuple store, or until the execution is finished. The
+ * function returns false once the execution is finished; the execution is then
+ * cleaned up, and must not be used anymore. As in MultiRealTimeExecute, task
+ * failures and cancellations are reported as errors.
+ */
+bool
+MultiRealTimeExecuteNext(RealTimeExecution *execution)
+{
+	execution->cycleTupleCount = 0;
+
+	while (!RealTimeExecutionFinished(execution))
+	{
+		ExecuteRealTimeCycle(execution);
+
+		/* return to the caller without waiting, there may be more rows already */
+		if (execution->cycleTupleCount > 0)
+		{
+			return true;
+		}
+
+		if (!RealTimeExecutionFinished(execution))
+		{
+			WaitForRealTimeTasks(execution);
+		}
+	}
+
+	FinishRealTimeExecution(execution);
+
+	return false;
+}
+
+
+/*
+ * MultiRealTimeExecuteEnd stops a streaming execution whose remaining results
+ * are not needed anymore, for example because a limit has been reached. Tasks
+ * that are still running are cancelled, and their connections are closed.
+ */
+void
+MultiRealTimeExecuteEnd(RealTimeExecution *execution)
+{
+	FinishRealTimeExecution(execution);
+}
+
+
+/*
+ * CreateRealTimeExecution initializes the execution state for the given job,
+ * including one task execution per task.
+ */
+static RealTimeExecution *
+CreateRealTimeExecution(Job *job)
+{
+	RealTimeExecution *execution = palloc0(sizeof(RealTimeExecution));
 	List *taskList = job->taskList;
-	List *taskExecutionList = NIL;
-	ListCell *taskExecutionCell = NULL;
 	ListCell *taskCell = NULL;
-	uint32 failedTaskId = 0;
-	bool allTasksCompleted = false;
-	bool taskCompleted = false;
-	bool taskFailed = false;
-
 	List *workerNodeList = NIL;
-	HTAB *workerHash = NULL;
 	const char *workerHashName = "Worker node hash";
-	WaitInfo *waitInfo = MultiClientCreateWaitInfo(list_length(taskList));
 
 	workerNodeList = WorkerNodeList();
-	workerHash = WorkerHash(workerHashName, workerNodeList);
+
+	execution->job = job;
+	execution->workerHash = WorkerHash(workerHashName, workerNodeList);
+	execution->waitInfo = MultiClientCreateWaitInfo(list_length(taskList));
 
 	/* initialize task execution structures for remote execution */
 	foreach(taskCell, taskList)
@@ -91,105 +240,195 @@ MultiRealTimeExecute(Job *job)
 		Task *task = (Task *) lfirst(taskCell);
 
 		TaskExecution *taskExecution = InitTaskExecution(task, EXEC_TASK_CONNECT_START);
-		taskExecutionList = lappend(taskExecutionList, taskExecution);
+		execution->taskExecutionList = lappend(execution->taskExecutionList,
+											   taskExecution);
 	}
 
-	/* loop around until all tasks complete, one task fails, or user cancels */
-	while (!(allTasksCompleted || taskFailed || QueryCancelPending))
-	{
-		uint32 taskCount = list_length(taskList);
-		uint32 completedTaskCount = 0;
+	return execution;
+}
 
-		/* loop around all tasks and manage them */
-		ListCell *taskCell = NULL;
-		ListCell *taskExecutionCell = NULL;
 
-		MultiClientResetWaitInfo(waitInfo);
+/*
+ * RealTimeExecutionFinished returns true if all tasks of the given execution
+ * completed, one task failed, or the user cancelled the execution.
+ */
+static bool
+RealTimeExecutionFinished(RealTimeExecution *execution)
+{
+	return execution->allTasksCompleted || execution->taskFailed || QueryCancelPending;
+}
 
-		forboth(taskCell, taskList, taskExecutionCell, taskExecutionList)
-		{
-			Task *task = (Task *) lfirst(taskCell);
-			TaskExecution *taskExecution = (TaskExecution *) lfirst(taskExecutionCell);
-			ConnectAction connectAction = CONNECT_ACTION_NONE;
-			WorkerNodeState *workerNodeState = NULL;
-			TaskExecutionStatus executionStatus;
 
-			workerNodeState = LookupWorkerForTask(workerHash, task, taskExecution);
+/*
+ * ExecuteRealTimeCycle loops over all tasks of the given execution once, and
+ * moves each task's execution forward as far as it can go without blocking.
+ * Along the way, the function records what each task waits for, so that
+ * WaitForRealTimeTasks can block until one of them can make progress.
+ */
+static void
+ExecuteRealTimeCycle(RealTimeExecution *execution)
+{
+	List *taskList = execution->job->taskList;
+	List *taskExecutionList = execution->taskExecutionList;
+	HTAB *workerHash = execution->workerHash;
+	WaitInfo *waitInfo = execution->waitInfo;
+	uint32 taskCount = list_length(taskList);
+	uint32 completedTaskCount = 0;
+
+	/* loop around all tasks and manage them */
+	ListCell *taskCell = NULL;
+	ListCell *taskExecutionCell = NULL;
 
-			/* in case the task is about to start, throttle if necessary */
-			if (TaskExecutionReadyToStart(taskExecution) &&
-				(WorkerConnectionsExhausted(workerNodeState) ||
-				 MasterConnectionsExhausted(workerHash)))
-			{
-				continue;
-			}
+	MultiClientResetWaitInfo(waitInfo);
 
-			/* call the function that performs the core task execution logic */
-			connectAction = ManageTaskExecution(task, taskExecution, &executionStatus);
+	forboth(taskCell, taskList, taskExecutionCell, taskExecutionList)
+	{
+		Task *task = (Task *) lfirst(taskCell);
+		TaskExecution *taskExecution = (TaskExecution *) lfirst(taskExecutionCell);
+		ConnectAction connectAction = CONNECT_ACTION_NONE;
+		WorkerNodeState *workerNodeState = NULL;
+		TaskExecutionStatus executionStatus;
+		bool connectionReserved = false;
+		bool taskCompleted = false;
 
-			/* update the connection counter for throttling */
-			UpdateConnectionCounter(workerNodeState, connectAction);
+		workerNodeState = LookupWorkerForTask(workerHash, task, taskExecution);
 
-			/*
-			 * If this task failed, we need to iterate over task executions, and
-			 * manually clean out their client-side resources. Hence, we record
-			 * the failure here instead of immediately erroring out.
-			 */
-			taskFailed = TaskExecutionFailed(taskExecution);
-			if (taskFailed)
+		/*
+		 * In case the task is about to start, reuse an idle connection to its
+		 * worker if there is one, or throttle if necessary. Otherwise, the
+		 * connection the task is about to open is reserved from the budget
+		 * that is shared with other backends.
+		 */
+		if (TaskExecutionReadyToStart(taskExecution) &&
+			!StartTaskOnIdleConnection(taskExecution, workerNodeState))
+		{
+			if (WorkerConnectionsExhausted(workerNodeState) ||
+				MasterConnectionsExhausted(workerHash) ||
+				!ReserveWorkerConnection(workerNodeState, &connectionReserved))
 			{
-				failedTaskId = taskExecution->taskId;
-				break;
+				workerNodeState->waitingTaskCount++;
+				continue;
 			}
+		}
 
-			taskCompleted = TaskExecutionCompleted(taskExecution);
-			if (taskCompleted)
-			{
-				completedTaskCount++;
-			}
-			else
-			{
-				uint32 currentIndex = taskExecution->currentNodeIndex;
-				int32 *connectionIdArray = taskExecution->connectionIdArray;
-				int32 connectionId = connectionIdArray[currentIndex];
+		/* call the function that performs the core task execution logic */
+		connectAction = ManageTaskExecution(execution, task, taskExecution,
+											&executionStatus);
 
-				/*
-				 * If not done with the task yet, make note of what this task
-				 * and its associated connection is waiting for.
-				 */
-				MultiClientRegisterWait(waitInfo, executionStatus, connectionId);
+		/*
+		 * The reservation is passed on to the connection that was opened, and
+		 * returned when the connection is closed. If no connection was opened,
+		 * or a cached connection with its own reservation was reused, we don't
+		 * need the reservation anymore.
+		 */
+		if (connectionReserved)
+		{
+			uint32 currentIndex = taskExecution->currentNodeIndex;
+			int32 connectionId = taskExecution->connectionIdArray[currentIndex];
+
+			if (connectAction != CONNECT_ACTION_OPENED ||
+				!MultiClientHoldSharedConnection(connectionId))
+			{
+				ReleaseSharedConnection(workerNodeState->workerName,
+										workerNodeState->workerPort);
 			}
 		}
 
+		/* update the connection counter for throttling */
+		UpdateConnectionCounter(workerNodeState, connectAction);
+
 		/*
-		 * Check if all tasks completed; otherwise wait as appropriate to
-		 * avoid a tight loop. That means we immediately continue if tasks are
-		 * ready to be processed further, and block when we're waiting for
-		 * network IO.
+		 * If this task failed, we need to iterate over task executions, and
+		 * manually clean out their client-side resources. Hence, we record
+		 * the failure here instead of immediately erroring out.
 		 */
-		if (completedTaskCount == taskCount)
+		if (TaskExecutionFailed(taskExecution))
 		{
-			allTasksCompleted = true;
+			execution->taskFailed = true;
+			execution->failedTaskId = taskExecution->taskId;
+			break;
+		}
+
+		taskCompleted = TaskExecutionCompleted(taskExecution);
+		if (taskCompleted)
+		{
+			completedTaskCount++;
+
+			/*
+			 * Hand the connection over to the next task for this worker. That
+			 * task might have been skipped earlier in this loop, so make sure
+			 * we come back to it without waiting.
+			 */
+			if (ReleaseTaskConnection(taskExecution, workerNodeState))
+			{
+				MultiClientRegisterWait(waitInfo, TASK_STATUS_READY,
+										INVALID_CONNECTION_ID);
+			}
 		}
 		else
 		{
-			MultiClientWait(waitInfo);
+			uint32 currentIndex = taskExecution->currentNodeIndex;
+			int32 *connectionIdArray = taskExecution->connectionIdArray;
+			int32 connectionId = connectionIdArray[currentIndex];
+
+			/*
+			 * If not done with the task yet, make note of what this task
+			 * and its associated connection is waiting for.
+			 */
+			MultiClientRegisterWait(waitInfo, executionStatus, connectionId);
 		}
 	}
 
-	MultiClientFreeWaitInfo(waitInfo);
+	if (completedTaskCount == taskCount)
+	{
+		execution->allTasksCompleted = true;
+	}
+}
+
+
+/*
+ * WaitForRealTimeTasks waits as appropriate to avoid a tight loop. That means
+ * we immediately continue if tasks are ready to be processed further, and block
+ * when we're waiting for network IO.
+ */
+static void
+WaitForRealTimeTasks(RealTimeExecution *execution)
+{
+	WaitInfo *waitInfo = execution->waitInfo;
+
+	/* with slow start, allow more connections to workers with waiting tasks */
+	if (ScaleUpConnectionLimits(execution->workerHash))
+	{
+		MultiClientRegisterWait(waitInfo, TASK_STATUS_READY, INVALID_CONNECTION_ID);
+	}
+
+	MultiClientWait(waitInfo);
+}
+
+
+/*
+ * FinishRealTimeExecution cancels the tasks of the given execution that are
+ * still active, and closes the execution's connections and files. If the
+ * execution was stopped by a task failure or user cancellation, the function
+ * then errors out.
+ */
+static void
+FinishRealTimeExecution(RealTimeExecution *execution)
+{
+	ListCell *taskExecutionCell = NULL;
+
+	MultiClientFreeWaitInfo(execution->waitInfo);
 
 	/*
 	 * We prevent cancel/die interrupts until we clean up connections to worker
-	 * nodes. Note that for the above while loop, if the user Ctrl+C's a query
-	 * and we emit a warning before looping to the beginning of the while loop,
-	 * we will get canceled away before we can hold any interrupts.
+	 * nodes. Note that for the execution loop, if the user Ctrl+C's a query
+	 * and we emit a warning before looping to the beginning of the loop, we
+	 * will get canceled away before we can hold any interrupts.
 	 */
 	HOLD_INTERRUPTS();
 
 	/* cancel any active task executions */
-	taskExecutionCell = NULL;
-	foreach(taskExecutionCell, taskExecutionList)
+	foreach(taskExecutionCell, execution->taskExecutionList)
 	{
 		TaskExecution *taskExecution = (TaskExecution *) lfirst(taskExecutionCell);
 		CancelTaskExecutionIfActive(taskExecution);
@@ -198,24 +437,28 @@ MultiRealTimeExecute(Job *job)
 	/*
 	 * If cancel might have been sent, give remote backends some time to flush
 	 * their responses. This avoids some broken pipe logs on the backend-side.
-	 *
-	 * FIXME: This shouldn't be dependant on RemoteTaskCheckInterval; they're
-	 * unrelated type of delays.
+	 * We wait on the latch, as we do after task failures during execution.
 	 */
-	if (taskFailed || QueryCancelPending)
+	if (execution->taskFailed || QueryCancelPending)
 	{
-		long sleepInterval = RemoteTaskCheckInterval * 1000L;
-		pg_usleep(sleepInterval);
+		MultiClientWaitForFailureBackoff();
 	}
 
 	/* close connections and open files */
-	taskExecutionCell = NULL;
-	foreach(taskExecutionCell, taskExecutionList)
+	foreach(taskExecutionCell, execution->taskExecutionList)
 	{
 		TaskExecution *taskExecution = (TaskExecution *) lfirst(taskExecutionCell);
 		CleanupTaskExecution(taskExecution);
 	}
 
+	CloseIdleConnections(execution->workerHash);
+
+	if (execution->ioContext != NULL)
+	{
+		MemoryContextDelete(execution->ioContext);
+		execution->ioContext = NULL;
+	}
+
 	RESUME_INTERRUPTS();
 
 	/*
@@ -223,10 +466,12 @@ MultiRealTimeExecute(Job *job)
 	 * user cancellation request, we can now safely emit an error message (all
 	 * client-side resources have been cleared).
 	 */
-	if (taskFailed)
+	if (execution->taskFailed)
 	{
-		ereport(ERROR, (errmsg("failed to execute job " UINT64_FORMAT, job->jobId),
-						errdetail("Failure due to failed task %u", failedTaskId)));
+		ereport(ERROR, (errmsg("failed to execute job " UINT64_FORMAT,
+							   execution->job->jobId),
+						errdetail("Failure due to failed task %u",
+								  execution->failedTaskId)));
 	}
 	else if (QueryCancelPending)
 	{
@@ -246,8 +491,8 @@ MultiRealTimeExecute(Job *job)
  * what a Task is blocked on.
  */
 static ConnectAction
-ManageTaskExecution(Task *task, TaskExecution *taskExecution,
-					TaskExecutionStatus *executionStatus)
+ManageTaskExecution(RealTimeExecution *execution, Task *task,
+					TaskExecution *taskExecution, TaskExecutionStatus *executionStatus)
 {
 	TaskExecStatus *taskStatusArray = taskExecution->taskStatusArray;
 	int32 *connectionIdArray = taskExecution->connectionIdArray;
@@ -466,6 +711,31 @@ ManageTaskExecution(Task *task, TaskExecution *taskExecution,
 			/* construct new query to copy query results to stdout */
 			char *queryString = task->queryString;
 			StringInfo computeTaskQuery = makeStringInfo();
+
+			/* if results are streamed, run the query itself and read row by row */
+			if (execution->tupleStore != NULL)
+			{
+				if (execution->binaryResults)
+				{
+					querySent = MultiClientSendBinaryQuery(connectionId, queryString);
+				}
+				else
+				{
+					querySent = MultiClientSendQuery(connectionId, queryString);
+				}
+
+				if (querySent && MultiClientSetSingleRowMode(connectionId))
+				{
+					taskStatusArray[currentIndex] = EXEC_COMPUTE_TASK_STREAMING;
+				}
+				else
+				{
+					taskStatusArray[currentIndex] = EXEC_TASK_FAILED;
+				}
+
+				break;
+			}
+
 			if (BinaryMasterCopyFormat)
 			{
 				appendStringInfo(computeTaskQuery, COPY_QUERY_TO_STDOUT_BINARY,
@@ -577,10 +847,17 @@ ManageTaskExecution(Task *task, TaskExecution *taskExecution,
 				{
 					taskStatusArray[currentIndex] = EXEC_TASK_DONE;
 
-					/* we are done executing; we no longer need the connection */
-					MultiClientDisconnect(connectionId);
-					connectionIdArray[currentIndex] = INVALID_CONNECTION_ID;
-					connectAction = CONNECT_ACTION_CLOSED;
+					/*
+					 * We are done executing. If connections are shared between
+					 * tasks, our caller passes the connection on to the next task.
+					 * Otherwise, we no longer need the connection.
+					 */
+					if (MaxConnectionsPerWorker == 0)
+					{
+						MultiClientDisconnect(connectionId);
+						connectionIdArray[currentIndex] = INVALID_CONNECTION_ID;
+						connectAction = CONNECT_ACTION_CLOSED;
+					}
 				}
 				else
 				{
@@ -607,6 +884,69 @@ ManageTaskExecution(Task *task, TaskExecution *taskExecution,
 			break;
 		}
 
+		case EXEC_COMPUTE_TASK_STREAMING:
+		{
+			int32 connectionId = connectionIdArray[currentIndex];
+			ResultStatus resultStatus = MultiClientResultStatus(connectionId);
+			CopyStatus streamStatus = CLIENT_INVALID_COPY;
+
+			/* check if more rows are in progress or unavailable */
+			if (resultStatus == CLIENT_RESULT_BUSY)
+			{
+				taskStatusArray[currentIndex] = EXEC_COMPUTE_TASK_STREAMING;
+				*executionStatus = TASK_STATUS_SOCKET_READ;
+				break;
+			}
+			else if (resultStatus == CLIENT_RESULT_UNAVAILABLE)
+			{
+				streamStatus = CLIENT_COPY_FAILED;
+			}
+			else
+			{
+				uint64 storedTupleCount = execution->cycleTupleCount;
+
+				streamStatus = StoreTaskResults(execution, connectionId);
+
+				if (execution->cycleTupleCount > storedTupleCount)
+				{
+					taskExecution->resultsStreamed = true;
+				}
+			}
+
+			if (streamStatus == CLIENT_COPY_MORE)
+			{
+				taskStatusArray[currentIndex] = EXEC_COMPUTE_TASK_STREAMING;
+				*executionStatus = TASK_STATUS_SOCKET_READ;
+			}
+			else if (streamStatus == CLIENT_COPY_DONE)
+			{
+				taskStatusArray[currentIndex] = EXEC_TASK_DONE;
+
+				/* as above, keep the connection only if it is shared between tasks */
+				if (MaxConnectionsPerWorker == 0)
+				{
+					MultiClientDisconnect(connectionId);
+					connectionIdArray[currentIndex] = INVALID_CONNECTION_ID;
+					connectAction = CONNECT_ACTION_CLOSED;
+				}
+			}
+			else
+			{
+				taskStatusArray[currentIndex] = EXEC_TASK_FAILED;
+
+				/*
+				 * Rows that we already returned can't be taken back, so we can't
+				 * retry the task on another placement. Fail the job instead.
+				 */
+				if (taskExecution->resultsStreamed)
+				{
+					taskExecution->failureCount = MAX_TASK_EXECUTION_FAILURES;
+				}
+			}
+
+			break;
+		}
+
 		case EXEC_TASK_DONE:
 		{
 			/* we are done with this task's execution */
@@ -700,13 +1040,102 @@ CancelRequestIfActive(TaskExecStatus taskStatus, int connectionId)
 			MultiClientCancel(connectionId);
 		}
 	}
-	else if (taskStatus == EXEC_COMPUTE_TASK_COPYING)
+	else if (taskStatus == EXEC_COMPUTE_TASK_COPYING ||
+			 taskStatus == EXEC_COMPUTE_TASK_STREAMING)
 	{
 		MultiClientCancel(connectionId);
 	}
 }
 
 
+/*
+ * StoreTaskResults reads the rows that a task's query has returned so far over
+ * the given connection, and stores them in the tuple store of the execution.
+ * The function reads rows until it would need to wait for more data from the
+ * worker. It returns CLIENT_COPY_MORE in that case, and CLIENT_COPY_DONE or
+ * CLIENT_COPY_FAILED once the query finished.
+ */
+static CopyStatus
+StoreTaskResults(RealTimeExecution *execution, int32 connectionId)
+{
+	AttInMetadata *attributeInputMetadata = execution->attributeInputMetadata;
+	char **columnArray = execution->columnArray;
+	int *lengthArray = execution->lengthArray;
+
+	while (!MultiClientResultBusy(connectionId))
+	{
+		void *queryResult = NULL;
+		int rowCount = 0;
+		int columnCount = 0;
+		int rowIndex = 0;
+
+		BatchQueryStatus queryStatus = MultiClientBatchResult(connectionId, &queryResult,
+															  &rowCount, &columnCount);
+		if (queryStatus == CLIENT_BATCH_QUERY_DONE)
+		{
+			return CLIENT_COPY_DONE;
+		}
+		else if (queryStatus == CLIENT_BATCH_QUERY_FAILED)
+		{
+			return CLIENT_COPY_FAILED;
+		}
+
+		Assert(columnCount == attributeInputMetadata->tupdesc->natts);
+
+		for (rowIndex = 0; rowIndex < rowCount; rowIndex++)
+		{
+			HeapTuple heapTuple = NULL;
+			MemoryContext oldContext = NULL;
+			int columnIndex = 0;
+
+			for (columnIndex = 0; columnIndex < columnCount; columnIndex++)
+			{
+				if (MultiClientValueIsNull(queryResult, rowIndex, columnIndex))
+				{
+					columnArray[columnIndex] = NULL;
+				}
+				else
+				{
+					columnArray[columnIndex] = MultiClientGetValue(queryResult, rowIndex,
+																   columnIndex);
+					lengthArray[columnIndex] = MultiClientGetValueLength(queryResult,
+																		 rowIndex,
+																		 columnIndex);
+				}
+			}
+
+			/*
+			 * Switch to a temporary memory context that we reset after each tuple.
+			 * This protects us from any memory leaks that might be present in I/O
+			 * functions called by BuildTupleFromCStrings or BuildTupleFromBinaryValues.
+			 */
+			oldContext = MemoryContextSwitchTo(execution->ioContext);
+
+			if (execution->binaryResults)
+			{
+				heapTuple = BuildTupleFromBinaryValues(execution->attributeReceiveMetadata,
+													   columnArray, lengthArray);
+			}
+			else
+			{
+				heapTuple = BuildTupleFromCStrings(attributeInputMetadata, columnArray);
+			}
+
+			MemoryContextSwitchTo(oldContext);
+
+			tuplestore_puttuple(execution->tupleStore, heapTuple);
+			MemoryContextReset(execution->ioContext);
+
+			execution->cycleTupleCount++;
+		}
+
+		MultiClientClearResult(queryResult);
+	}
+
+	return CLIENT_COPY_MORE;
+}
+
+
 /*
  * WorkerHash creates a worker node hash with the given name. The function
  * then inserts one entry for each worker node in the given worker node
@@ -786,6 +1215,8 @@ WorkerHashEnter(HTAB *workerHash, char *nodeName, uint32 nodePort)
 
 	memcpy(workerNodeState, &workerNodeKey, sizeof(WorkerNodeState));
 	workerNodeState->openConnectionCount = 0;
+	workerNodeState->connectionLimit = 1;
+	workerNodeState->connectionLimitChangeTime = GetCurrentTimestamp();
 
 	return workerNodeState;
 }
@@ -858,6 +1289,20 @@ WorkerConnectionsExhausted(WorkerNodeState *workerNodeState)
 		reachedLimit = true;
 	}
 
+	/* the user may also have bounded the number of connections per worker */
+	if (MaxConnectionsPerWorker > 0 &&
+		workerNodeState->openConnectionCount >= MaxConnectionsPerWorker)
+	{
+		reachedLimit = true;
+	}
+
+	/* with slow start, we only open as many connections as currently allowed */
+	if (ExecutorSlowStartInterval > 0 &&
+		workerNodeState->openConnectionCount >= workerNodeState->connectionLimit)
+	{
+		reachedLimit = true;
+	}
+
 	return reachedLimit;
 }
 
@@ -882,6 +1327,30 @@ MasterConnectionsExhausted(HTAB *workerHash)
 }
 
 
+/*
+ * ReserveWorkerConnection reserves a connection to the given worker node from
+ * the budget shared by all backends, and sets connectionReserved if the
+ * connection counts against the budget. If the budget is used up, the function
+ * returns false, and the task stays queued until other connections to the
+ * worker are closed, in this or another backend. Cached connections keep their
+ * reservations, so no new reservation is needed if one of those is reused.
+ */
+static bool
+ReserveWorkerConnection(WorkerNodeState *workerNodeState, bool *connectionReserved)
+{
+	if (MultiClientReservedConnectionAvailable(workerNodeState->workerName,
+											   workerNodeState->workerPort))
+	{
+		*connectionReserved = false;
+		return true;
+	}
+
+	return TryReserveSharedConnection(workerNodeState->workerName,
+									  workerNodeState->workerPort,
+									  connectionReserved);
+}
+
+
 /*
  * TotalOpenConnectionCount counts the total number of open connections across all the
  * workers.
@@ -922,3 +1391,170 @@ UpdateConnectionCounter(WorkerNodeState *workerNode, ConnectAction connectAction
 		workerNode->openConnectionCount--;
 	}
 }
+
+
+/*
+ * ScaleUpConnectionLimits implements slow start for the connections to worker
+ * nodes. For each worker that had tasks waiting for a connection in the last
+ * execution cycle, and that has used up its current connection limit for at
+ * least citus.executor_slow_start_interval, the function doubles the limit; up
+ * to citus.max_connections_per_worker if set, or max_connections otherwise.
+ * Tasks that finish within the interval therefore never cause more connections
+ * to be opened. The function returns true if any limit was raised.
+ */
+static bool
+ScaleUpConnectionLimits(HTAB *workerHash)
+{
+	bool connectionLimitRaised = false;
+	uint32 maxConnectionLimit = MaxConnections;
+	TimestampTz currentTime = 0;
+	WorkerNodeState *workerNodeState = NULL;
+	HASH_SEQ_STATUS status;
+
+	if (ExecutorSlowStartInterval == 0)
+	{
+		return false;
+	}
+
+	if (MaxConnectionsPerWorker > 0)
+	{
+		maxConnectionLimit = Min(maxConnectionLimit, MaxConnectionsPerWorker);
+	}
+
+	currentTime = GetCurrentTimestamp();
+
+	hash_seq_init(&status, workerHash);
+
+	workerNodeState = (WorkerNodeState *) hash_seq_search(&status);
+	while (workerNodeState != NULL)
+	{
+		uint32 waitingTaskCount = workerNodeState->waitingTaskCount;
+		uint32 connectionLimit = workerNodeState->connectionLimit;
+
+		/* reset the backlog, it is recounted in each execution cycle */
+		workerNodeState->waitingTaskCount = 0;
+
+		if (waitingTaskCount > 0 && connectionLimit < maxConnectionLimit &&
+			workerNodeState->openConnectionCount >= connectionLimit &&
+			TimestampDifferenceExceeds(workerNodeState->connectionLimitChangeTime,
+									   currentTime, ExecutorSlowStartInterval))
+		{
+			workerNodeState->connectionLimit = Min(connectionLimit * 2,
+												   maxConnectionLimit);
+			workerNodeState->connectionLimitChangeTime = currentTime;
+			connectionLimitRaised = true;
+
+			ereport(DEBUG4, (errmsg("allowing %u connections to node \"%s:%u\"",
+									workerNodeState->connectionLimit,
+									workerNodeState->workerName,
+									workerNodeState->workerPort)));
+		}
+		else if (waitingTaskCount == 0 ||
+				 workerNodeState->openConnectionCount < connectionLimit)
+		{
+			/* the interval only counts while the worker is short on connections */
+			workerNodeState->connectionLimitChangeTime = currentTime;
+		}
+
+		workerNodeState = (WorkerNodeState *) hash_seq_search(&status);
+	}
+
+	return connectionLimitRaised;
+}
+
+
+/*
+ * StartTaskOnIdleConnection checks if there is an idle connection to the given
+ * worker node. If so, the function assigns this connection to the given task
+ * execution, moves the task directly past its connection phase, and returns
+ * true. Otherwise, the function returns false.
+ */
+static bool
+StartTaskOnIdleConnection(TaskExecution *taskExecution, WorkerNodeState *workerNodeState)
+{
+	uint32 currentIndex = taskExecution->currentNodeIndex;
+	int32 connectionId = INVALID_CONNECTION_ID;
+
+	if (workerNodeState->idleConnectionList == NIL)
+	{
+		return false;
+	}
+
+	connectionId = linitial_int(workerNodeState->idleConnectionList);
+	workerNodeState->idleConnectionList =
+		list_delete_first(workerNodeState->idleConnectionList);
+
+	taskExecution->connectionIdArray[currentIndex] = connectionId;
+	taskExecution->dataFetchTaskIndex = -1;
+	taskExecution->taskStatusArray[currentIndex] = EXEC_FETCH_TASK_LOOP;
+
+	return true;
+}
+
+
+/*
+ * ReleaseTaskConnection moves the connection of a completed task execution to
+ * the idle connection list of its worker node, so that the next task for that
+ * worker can reuse it. The function returns true if a connection was released.
+ * Connections are only kept open after completion when connections are shared
+ * between tasks; in other cases, this function does nothing.
+ */
+static bool
+ReleaseTaskConnection(TaskExecution *taskExecution, WorkerNodeState *workerNodeState)
+{
+	uint32 currentIndex = taskExecution->currentNodeIndex;
+	int32 connectionId = taskExecution->connectionIdArray[currentIndex];
+
+	if (connectionId == INVALID_CONNECTION_ID)
+	{
+		return false;
+	}
+
+	taskExecution->connectionIdArray[currentIndex] = INVALID_CONNECTION_ID;
+
+	/* a broken connection is of no use to anyone else */
+	if (!MultiClientConnectionUp(connectionId))
+	{
+		MultiClientDisconnect(connectionId);
+		UpdateConnectionCounter(workerNodeState, CONNECT_ACTION_CLOSED);
+
+		return true;
+	}
+
+	workerNodeState->idleConnectionList =
+		lappend_int(workerNodeState->idleConnectionList, connectionId);
+
+	return true;
+}
+
+
+/*
+ * CloseIdleConnections closes all connections that remain in the idle
+ * connection lists of the given worker node hash.
+ */
+static void
+CloseIdleConnections(HTAB *workerHash)
+{
+	WorkerNodeState *workerNodeState = NULL;
+
+	HASH_SEQ_STATUS status;
+	hash_seq_init(&status, workerHash);
+
+	workerNodeState = (WorkerNodeState *) hash_seq_search(&status);
+	while (workerNodeState != NULL)
+	{
+		ListCell *connectionIdCell = NULL;
+		foreach(connectionIdCell, workerNodeState->idleConnectionList)
+		{
+			int32 connectionId = lfirst_int(connectionIdCell);
+
+			MultiClientDisconnect(connectionId);
+			UpdateConnectionCounter(workerNodeState, CONNECT_ACTION_CLOSED);
+		}
+
+		list_free(workerNodeState->idleConnectionList);
+		workerNodeState->idleConnectionList = NIL;
+
+		workerNodeState = (WorkerNodeState *) hash_seq_search(&status);
+	}
+}
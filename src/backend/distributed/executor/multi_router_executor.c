@@ -38,6 +38,7 @@
 #include "distributed/multi_planner.h"
 #include "distributed/multi_router_executor.h"
 #include "distributed/multi_router_planner.h"
+#include "distributed/multi_server_executor.h"
 #include "distributed/multi_shard_transaction.h"
 #include "distributed/placement_connection.h"
 #include "distributed/relay_utility.h"
@@ -92,7 +93,7 @@ static void ExtractParametersFromParamListInfo(ParamListInfo paramListInfo,
 											   Oid **parameterTypes,
 											   const char ***parameterValues);
 static bool SendQueryInSingleRowMode(MultiConnection *connection, char *query,
-									 ParamListInfo paramListInfo);
+									 ParamListInfo paramListInfo, bool binaryResults);
 static bool StoreQueryResult(CitusScanState *scanState, MultiConnection *connection,
 							 bool failOnError, int64 *rows);
 static bool ConsumeQueryResult(MultiConnection *connection, bool failOnError,
@@ -558,6 +559,9 @@ ExecuteSingleSelectTask(CitusScanState *scanState, Task *task)
 	List *taskPlacementList = task->taskPlacementList;
 	ListCell *taskPlacementCell = NULL;
 	char *queryString = task->queryString;
+	TupleDesc tupleDescriptor =
+		scanState->customScanState.ss.ps.ps_ResultTupleSlot->tts_tupleDescriptor;
+	bool binaryResults = EnableBinaryProtocol && CanUseBinaryProtocol(tupleDescriptor);
 
 	if (XactModificationLevel == XACT_MODIFICATION_MULTI_SHARD)
 	{
@@ -580,7 +584,8 @@ ExecuteSingleSelectTask(CitusScanState *scanState, Task *task)
 		MultiConnection *connection =
 			GetPlacementConnection(connectionFlags, taskPlacement, NULL);
 
-		queryOK = SendQueryInSingleRowMode(connection, queryString, paramListInfo);
+		queryOK = SendQueryInSingleRowMode(connection, queryString, paramListInfo,
+										   binaryResults);
 		if (!queryOK)
 		{
 			continue;
@@ -690,7 +695,8 @@ ExecuteSingleModifyTask(CitusScanState *scanState, Task *task, bool expectResult
 			continue;
 		}
 
-		queryOK = SendQueryInSingleRowMode(connection, queryString, paramListInfo);
+		queryOK = SendQueryInSingleRowMode(connection, queryString, paramListInfo,
+										   false);
 		if (!queryOK)
 		{
 			continue;
@@ -965,7 +971,8 @@ ExecuteModifyTasks(List *taskList, bool expectResults, ParamListInfo paramListIn
 
 			connection = (MultiConnection *) list_nth(connectionList, placementIndex);
 
-			queryOK = SendQueryInSingleRowMode(connection, queryString, paramListInfo);
+			queryOK = SendQueryInSingleRowMode(connection, queryString, paramListInfo,
+											   false);
 			if (!queryOK)
 			{
 				ReportConnectionError(connection, ERROR);
@@ -1094,11 +1101,13 @@ TaskShardIntervalList(List *taskList)
 /*
  * SendQueryInSingleRowMode sends the given query on the connection in an
  * asynchronous way. The function also sets the single-row mode on the
- * connection so that we receive results a row at a time.
+ * connection so that we receive results a row at a time. If binaryResults is
+ * set, the rows are sent in binary format, which saves parsing them on the
+ * master.
  */
 static bool
 SendQueryInSingleRowMode(MultiConnection *connection, char *query,
-						 ParamListInfo paramListInfo)
+						 ParamListInfo paramListInfo, bool binaryResults)
 {
 	int querySent = 0;
 	int singleRowMode = 0;
@@ -1112,12 +1121,27 @@ SendQueryInSingleRowMode(MultiConnection *connection, char *query,
 		ExtractParametersFromParamListInfo(paramListInfo, &parameterTypes,
 										   &parameterValues);
 
-		querySent = SendRemoteCommandParams(connection, query, parameterCount,
-											parameterTypes, parameterValues);
+		/*
+		 * Parameterized commands are usually executed repeatedly with only the
+		 * parameter values changing, so prepare them on the worker if enabled.
+		 */
+		if (MaxPreparedStatementsPerConnection > 0)
+		{
+			querySent = SendRemotePreparedCommand(connection, query, parameterCount,
+												  parameterTypes, parameterValues,
+												  binaryResults);
+		}
+		else
+		{
+			querySent = SendRemoteCommandParams(connection, query, parameterCount,
+												parameterTypes, parameterValues,
+												binaryResults);
+		}
 	}
 	else
 	{
-		querySent = SendRemoteCommand(connection, query);
+		querySent = SendRemoteCommandParams(connection, query, 0, NULL, NULL,
+											binaryResults);
 	}
 
 	if (querySent == 0)
@@ -1213,7 +1237,7 @@ ExtractParametersFromParamListInfo(ParamListInfo paramListInfo, Oid **parameterT
  * tuples from the results, and stores them in the a newly created
  * tuple-store. If the function can't receive query results, it returns
  * false. Note that this function assumes the query has already been sent on
- * the connection.
+ * the connection. Results can be in text or binary format.
  */
 static bool
 StoreQueryResult(CitusScanState *scanState, MultiConnection *connection,
@@ -1225,6 +1249,8 @@ StoreQueryResult(CitusScanState *scanState, MultiConnection *connection,
 	List *targetList = scanState->customScanState.ss.ps.plan->targetlist;
 	uint32 expectedColumnCount = ExecCleanTargetListLength(targetList);
 	char **columnArray = (char **) palloc0(expectedColumnCount * sizeof(char *));
+	int *lengthArray = (int *) palloc0(expectedColumnCount * sizeof(int));
+	AttributeReceiveMetadata *attributeReceiveMetadata = NULL;
 	Tuplestorestate *tupleStore = NULL;
 	bool randomAccess = true;
 	bool interTransactions = false;
@@ -1257,6 +1283,7 @@ StoreQueryResult(CitusScanState *scanState, MultiConnection *connection,
 		uint32 columnCount = 0;
 		ExecStatusType resultStatus = 0;
 		bool doRaiseInterrupts = true;
+		bool binaryResults = false;
 
 		PGresult *result = GetRemoteCommandResult(connection, doRaiseInterrupts);
 		if (result == NULL)
@@ -1302,6 +1329,12 @@ StoreQueryResult(CitusScanState *scanState, MultiConnection *connection,
 		columnCount = PQnfields(result);
 		Assert(columnCount == expectedColumnCount);
 
+		binaryResults = PQbinaryTuples(result);
+		if (binaryResults && attributeReceiveMetadata == NULL)
+		{
+			attributeReceiveMetadata = TupleDescGetReceiveMetadata(tupleDescriptor);
+		}
+
 		for (rowIndex = 0; rowIndex < rowCount; rowIndex++)
 		{
 			HeapTuple heapTuple = NULL;
@@ -1317,17 +1350,26 @@ StoreQueryResult(CitusScanState *scanState, MultiConnection *connection,
 				else
 				{
 					columnArray[columnIndex] = PQgetvalue(result, rowIndex, columnIndex);
+					lengthArray[columnIndex] = PQgetlength(result, rowIndex, columnIndex);
 				}
 			}
 
 			/*
 			 * Switch to a temporary memory context that we reset after each tuple. This
 			 * protects us from any memory leaks that might be present in I/O functions
-			 * called by BuildTupleFromCStrings.
+			 * called by BuildTupleFromCStrings or BuildTupleFromBinaryValues.
 			 */
 			oldContext = MemoryContextSwitchTo(ioContext);
 
-			heapTuple = BuildTupleFromCStrings(attributeInputMetadata, columnArray);
+			if (binaryResults)
+			{
+				heapTuple = BuildTupleFromBinaryValues(attributeReceiveMetadata,
+													   columnArray, lengthArray);
+			}
+			else
+			{
+				heapTuple = BuildTupleFromCStrings(attributeInputMetadata, columnArray);
+			}
 
 			MemoryContextSwitchTo(oldContext);
 
@@ -1340,6 +1382,7 @@ StoreQueryResult(CitusScanState *scanState, MultiConnection *connection,
 	}
 
 	pfree(columnArray);
+	pfree(lengthArray);
 
 	return !commandFailed;
 }
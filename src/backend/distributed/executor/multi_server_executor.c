@@ -19,16 +19,26 @@
 
 #include <unistd.h>
 
+#include "access/htup_details.h"
+#include "access/transam.h"
+#include "catalog/pg_type.h"
 #include "distributed/multi_client_executor.h"
 #include "distributed/multi_physical_planner.h"
 #include "distributed/multi_resowner.h"
 #include "distributed/multi_server_executor.h"
 #include "distributed/worker_protocol.h"
+#include "lib/stringinfo.h"
+#include "utils/lsyscache.h"
+#include "utils/syscache.h"
 
 
 int RemoteTaskCheckInterval = 100; /* per cycle sleep interval in millisecs */
 int TaskExecutorType = MULTI_EXECUTOR_REAL_TIME; /* distributed executor type */
 bool BinaryMasterCopyFormat = false; /* copy data from workers in binary format */
+int MaxConnectionsPerWorker = 0; /* per query connection limit, 0 means one per task */
+int ExecutorSlowStartInterval = 0; /* connection scale-up interval, 0 disables */
+bool EnableResultStreaming = false; /* stream real-time results to the master plan */
+bool EnableBinaryProtocol = false; /* receive select results in binary format */
 
 
 /*
@@ -61,9 +71,19 @@ JobExecutorType(MultiPlan *multiPlan)
 	if (executorType == MULTI_EXECUTOR_REAL_TIME)
 	{
 		double reasonableConnectionCount = 0;
+		double connectionsPerNode = tasksPerNode;
+		double connectionCount = taskCount;
+
+		/* tasks share connections when the connections per worker are bounded */
+		if (MaxConnectionsPerWorker > 0)
+		{
+			connectionsPerNode = Min(tasksPerNode, MaxConnectionsPerWorker);
+			connectionCount = Min(taskCount,
+								  (double) MaxConnectionsPerWorker * workerNodeCount);
+		}
 
 		/* if we need to open too many connections per worker, warn the user */
-		if (tasksPerNode >= MaxConnections)
+		if (connectionsPerNode >= MaxConnections)
 		{
 			ereport(WARNING, (errmsg("this query uses more connections than the "
 									 "configured max_connections limit"),
@@ -78,7 +98,7 @@ JobExecutorType(MultiPlan *multiPlan)
 		 * but we still issue this warning because it degrades performance.
 		 */
 		reasonableConnectionCount = MaxMasterConnectionCount();
-		if (taskCount >= reasonableConnectionCount)
+		if (connectionCount >= reasonableConnectionCount)
 		{
 			ereport(WARNING, (errmsg("this query uses more file descriptors than the "
 									 "configured max_files_per_process limit"),
@@ -255,3 +275,148 @@ AdjustStateForFailure(TaskExecution *taskExecution)
 	taskExecution->dataFetchTaskIndex = -1; /* reset data fetch counter */
 	taskExecution->failureCount++;          /* record failure */
 }
+
+
+/*
+ * CanUseBinaryProtocol returns whether rows with the given tuple descriptor can
+ * be received from workers in binary format. This requires a binary receive
+ * function for each column type. Further, the binary format of some types, such
+ * as arrays, embeds type oids; so we only allow types that were created during
+ * initdb, whose oids are the same on all nodes. Composite types and pseudo-types
+ * such as record are not allowed either, as their binary format depends on the
+ * type oids of their columns.
+ */
+bool
+CanUseBinaryProtocol(TupleDesc tupleDescriptor)
+{
+	int attributeIndex = 0;
+
+	for (attributeIndex = 0; attributeIndex < tupleDescriptor->natts; attributeIndex++)
+	{
+		Form_pg_attribute attribute = tupleDescriptor->attrs[attributeIndex];
+		Oid typeId = attribute->atttypid;
+		HeapTuple typeTuple = NULL;
+		Form_pg_type typeForm = NULL;
+		bool canReceive = false;
+
+		if (attribute->attisdropped)
+		{
+			continue;
+		}
+
+		if (typeId >= FirstNormalObjectId)
+		{
+			return false;
+		}
+
+		typeTuple = SearchSysCache1(TYPEOID, ObjectIdGetDatum(typeId));
+		if (!HeapTupleIsValid(typeTuple))
+		{
+			elog(ERROR, "cache lookup failed for type %u", typeId);
+		}
+
+		typeForm = (Form_pg_type) GETSTRUCT(typeTuple);
+		canReceive = OidIsValid(typeForm->typreceive) &&
+					 typeForm->typtype != TYPTYPE_COMPOSITE &&
+					 typeForm->typtype != TYPTYPE_PSEUDO;
+
+		ReleaseSysCache(typeTuple);
+
+		if (!canReceive)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
+/*
+ * TupleDescGetReceiveMetadata looks up the binary receive functions for the
+ * columns of the given tuple descriptor, and returns them together with the
+ * arrays to build tuples with. The tuple descriptor must have passed the
+ * CanUseBinaryProtocol check.
+ */
+AttributeReceiveMetadata *
+TupleDescGetReceiveMetadata(TupleDesc tupleDescriptor)
+{
+	int columnCount = tupleDescriptor->natts;
+	int columnIndex = 0;
+	AttributeReceiveMetadata *receiveMetadata = palloc0(sizeof(AttributeReceiveMetadata));
+
+	receiveMetadata->tupleDescriptor = tupleDescriptor;
+	receiveMetadata->receiveFunctionArray = palloc0(columnCount * sizeof(FmgrInfo));
+	receiveMetadata->typeIOParamArray = palloc0(columnCount * sizeof(Oid));
+	receiveMetadata->columnValues = palloc0(columnCount * sizeof(Datum));
+	receiveMetadata->columnNulls = palloc0(columnCount * sizeof(bool));
+
+	for (columnIndex = 0; columnIndex < columnCount; columnIndex++)
+	{
+		Form_pg_attribute attribute = tupleDescriptor->attrs[columnIndex];
+		Oid receiveFunctionId = InvalidOid;
+
+		if (attribute->attisdropped)
+		{
+			continue;
+		}
+
+		getTypeBinaryInputInfo(attribute->atttypid, &receiveFunctionId,
+							   &receiveMetadata->typeIOParamArray[columnIndex]);
+		fmgr_info(receiveFunctionId, &receiveMetadata->receiveFunctionArray[columnIndex]);
+	}
+
+	return receiveMetadata;
+}
+
+
+/*
+ * BuildTupleFromBinaryValues builds a tuple from the given column values, which
+ * are in binary format. It is the binary counterpart to BuildTupleFromCStrings;
+ * null values are passed as NULL, and the lengths of other values are passed in
+ * lengthArray. Note that receive functions may temporarily modify the values.
+ */
+HeapTuple
+BuildTupleFromBinaryValues(AttributeReceiveMetadata *receiveMetadata, char **valueArray,
+						   int *lengthArray)
+{
+	TupleDesc tupleDescriptor = receiveMetadata->tupleDescriptor;
+	Datum *columnValues = receiveMetadata->columnValues;
+	bool *columnNulls = receiveMetadata->columnNulls;
+	int columnIndex = 0;
+
+	for (columnIndex = 0; columnIndex < tupleDescriptor->natts; columnIndex++)
+	{
+		Form_pg_attribute attribute = tupleDescriptor->attrs[columnIndex];
+		FmgrInfo *receiveFunction = &receiveMetadata->receiveFunctionArray[columnIndex];
+		Oid typeIOParam = receiveMetadata->typeIOParamArray[columnIndex];
+		StringInfoData valueBuffer;
+
+		if (valueArray[columnIndex] == NULL || attribute->attisdropped)
+		{
+			columnValues[columnIndex] = (Datum) 0;
+			columnNulls[columnIndex] = true;
+			continue;
+		}
+
+		valueBuffer.data = valueArray[columnIndex];
+		valueBuffer.len = lengthArray[columnIndex];
+		valueBuffer.maxlen = lengthArray[columnIndex] + 1;
+		valueBuffer.cursor = 0;
+
+		columnValues[columnIndex] = ReceiveFunctionCall(receiveFunction, &valueBuffer,
+														typeIOParam,
+														attribute->atttypmod);
+		columnNulls[columnIndex] = false;
+
+		/* the receive function must have consumed the whole value */
+		if (valueBuffer.cursor != valueBuffer.len)
+		{
+			ereport(ERROR, (errcode(ERRCODE_INVALID_BINARY_REPRESENTATION),
+							errmsg("incorrect binary data format in column %d",
+								   columnIndex + 1)));
+		}
+	}
+
+	return heap_form_tuple(tupleDescriptor, columnValues, columnNulls);
+}
@@ -18,6 +18,7 @@
 #include "access/heapam.h"
 #include "access/htup_details.h"
 #include "catalog/pg_am.h"
+#include "distributed/colocation_utils.h"
 #include "distributed/metadata_cache.h"
 #include "distributed/multi_join_order.h"
 #include "distributed/multi_physical_planner.h"
@@ -36,6 +37,8 @@
 /* Config variables managed via guc.c */
 int LargeTableShardCount = 4;   /* shard counts for a large table */
 bool LogMultiJoinOrder = false; /* print join order as a debugging aid */
+bool EnableCostBasedJoinOrder = false; /* pick join orders by data transfer costs */
+int BroadcastJoinSizeThreshold = 0; /* size threshold in kB for broadcasting tables */
 
 /* Function pointer type definition for join rule evaluation functions */
 typedef JoinOrderNode *(*RuleEvalFunction) (JoinOrderNode *currentJoinNode,
@@ -47,6 +50,17 @@ typedef JoinOrderNode *(*RuleEvalFunction) (JoinOrderNode *currentJoinNode,
 static char *RuleNameArray[JOIN_RULE_LAST] = { 0 }; /* ordered join rule names */
 static RuleEvalFunction RuleEvalFunctionArray[JOIN_RULE_LAST] = { 0 }; /* join rules */
 
+/*
+ * TableDataSize keeps the shard count and the estimated size of a table in the
+ * join, so that we read shard metadata only once when costing join orders.
+ */
+typedef struct TableDataSize
+{
+	uint32 rangeTableId;
+	int shardCount;
+	uint64 dataSize;
+} TableDataSize;
+
 
 /* Local functions forward declarations */
 static JoinOrderNode * CreateFirstJoinOrderNode(FromExpr *fromExpr,
@@ -59,10 +73,15 @@ static bool ShardIntervalsMatch(List *leftShardIntervalList,
 								List *rightShardIntervalList);
 static List * JoinOrderForTable(TableEntry *firstTable, List *tableEntryList,
 								List *joinClauseList);
-static List * BestJoinOrder(List *candidateJoinOrders);
+static List * BestJoinOrder(List *candidateJoinOrders, List *tableDataSizeList);
 static List * FewestOfJoinRuleType(List *candidateJoinOrders, JoinRuleType ruleType);
 static uint32 JoinRuleTypeCount(List *joinOrder, JoinRuleType ruleTypeToCount);
 static List * LatestLargeDataTransfer(List *candidateJoinOrders);
+static List * TableDataSizeList(List *tableEntryList);
+static TableDataSize * FindTableDataSize(List *tableDataSizeList, uint32 tableId);
+static List * LeastDataTransfer(List *candidateJoinOrders, List *tableDataSizeList);
+static uint64 JoinOrderDataTransfer(List *joinOrder, List *tableDataSizeList);
+static uint64 ShardIntervalListDataSize(List *shardIntervalList);
 static void PrintJoinOrderList(List *joinOrder);
 static uint32 LargeDataTransferLocation(List *joinOrder);
 static List * TableEntryListDifference(List *lhsTableList, List *rhsTableList);
@@ -77,6 +96,12 @@ static JoinOrderNode * EvaluateJoinRules(List *joinedTableList,
 static List * RangeTableIdList(List *tableList);
 static RuleEvalFunction JoinRuleEvalFunction(JoinRuleType ruleType);
 static char * JoinRuleName(JoinRuleType ruleType);
+static JoinOrderNode * ColocatedJoin(List *joinedTableList,
+									 JoinOrderNode *currentJoinNode,
+									 TableEntry *candidateTable,
+									 List *candidateShardList,
+									 List *applicableJoinClauses,
+									 JoinType joinType);
 static JoinOrderNode * BroadcastJoin(JoinOrderNode *joinNode, TableEntry *candidateTable,
 									 List *candidateShardList,
 									 List *applicableJoinClauses,
@@ -619,8 +644,15 @@ JoinOrderList(List *tableEntryList, List *joinClauseList)
 {
 	List *bestJoinOrder = NIL;
 	List *candidateJoinOrderList = NIL;
+	List *tableDataSizeList = NIL;
 	ListCell *tableEntryCell = NULL;
 
+	/* look up table sizes once, rather than for each candidate join order */
+	if (EnableCostBasedJoinOrder)
+	{
+		tableDataSizeList = TableDataSizeList(tableEntryList);
+	}
+
 	foreach(tableEntryCell, tableEntryList)
 	{
 		TableEntry *startingTable = (TableEntry *) lfirst(tableEntryCell);
@@ -633,7 +665,7 @@ JoinOrderList(List *tableEntryList, List *joinClauseList)
 		candidateJoinOrderList = lappend(candidateJoinOrderList, candidateJoinOrder);
 	}
 
-	bestJoinOrder = BestJoinOrder(candidateJoinOrderList);
+	bestJoinOrder = BestJoinOrder(candidateJoinOrderList, tableDataSizeList);
 
 	/* if logging is enabled, print join order */
 	if (LogMultiJoinOrder)
@@ -739,13 +771,27 @@ JoinOrderForTable(TableEntry *firstTable, List *tableEntryList, List *joinClause
  * join orders where large data transfers occur later in the execution.
  */
 static List *
-BestJoinOrder(List *candidateJoinOrders)
+BestJoinOrder(List *candidateJoinOrders, List *tableDataSizeList)
 {
 	List *bestJoinOrder = NULL;
 	uint32 ruleTypeIndex = 0;
 	uint32 highestValidIndex = JOIN_RULE_LAST - 1;
 	uint32 candidateCount PG_USED_FOR_ASSERTS_ONLY = 0;
 
+	/*
+	 * If enabled, we first keep the join orders that have the fewest cartesian
+	 * products, and among those the join orders that are estimated to transfer
+	 * the fewest bytes over the network. The rule based heuristics below then
+	 * only break ties, for example if no shard statistics are available.
+	 */
+	if (EnableCostBasedJoinOrder)
+	{
+		candidateJoinOrders = FewestOfJoinRuleType(candidateJoinOrders,
+												   CARTESIAN_PRODUCT);
+		candidateJoinOrders = LeastDataTransfer(candidateJoinOrders,
+												tableDataSizeList);
+	}
+
 	/*
 	 * We start with the highest ranking rule type (cartesian product), and walk
 	 * over these rules in reverse order. For each rule type, we then keep join
@@ -908,6 +954,215 @@ LargeDataTransferLocation(List *joinOrder)
 }
 
 
+/*
+ * TableDataSizeList returns a list with the shard count and the estimated data
+ * size of each table in the given table entry list.
+ */
+static List *
+TableDataSizeList(List *tableEntryList)
+{
+	List *tableDataSizeList = NIL;
+	ListCell *tableEntryCell = NULL;
+
+	foreach(tableEntryCell, tableEntryList)
+	{
+		TableEntry *tableEntry = (TableEntry *) lfirst(tableEntryCell);
+		List *shardIntervalList = LoadShardIntervalList(tableEntry->relationId);
+		TableDataSize *tableDataSize = NULL;
+
+		tableDataSize = (TableDataSize *) palloc0(sizeof(TableDataSize));
+		tableDataSize->rangeTableId = tableEntry->rangeTableId;
+		tableDataSize->shardCount = list_length(shardIntervalList);
+		tableDataSize->dataSize = ShardIntervalListDataSize(shardIntervalList);
+
+		tableDataSizeList = lappend(tableDataSizeList, tableDataSize);
+	}
+
+	return tableDataSizeList;
+}
+
+
+/*
+ * FindTableDataSize finds the table data size with the given range table id in
+ * the given list, and returns null if there is no such entry.
+ */
+static TableDataSize *
+FindTableDataSize(List *tableDataSizeList, uint32 tableId)
+{
+	ListCell *tableDataSizeCell = NULL;
+
+	foreach(tableDataSizeCell, tableDataSizeList)
+	{
+		TableDataSize *tableDataSize = (TableDataSize *) lfirst(tableDataSizeCell);
+		if (tableDataSize->rangeTableId == tableId)
+		{
+			return tableDataSize;
+		}
+	}
+
+	return NULL;
+}
+
+
+/*
+ * LeastDataTransfer finds and returns join orders that are estimated to transfer
+ * the fewest bytes across the network, and filters all other join orders.
+ */
+static List *
+LeastDataTransfer(List *candidateJoinOrders, List *tableDataSizeList)
+{
+	List *leastJoinOrders = NIL;
+	uint64 leastDataTransfer = 0;
+	ListCell *joinOrderCell = NULL;
+
+	foreach(joinOrderCell, candidateJoinOrders)
+	{
+		List *joinOrder = (List *) lfirst(joinOrderCell);
+		uint64 dataTransfer = JoinOrderDataTransfer(joinOrder, tableDataSizeList);
+
+		if (leastJoinOrders != NIL && dataTransfer == leastDataTransfer)
+		{
+			leastJoinOrders = lappend(leastJoinOrders, joinOrder);
+		}
+		else if (leastJoinOrders == NIL || dataTransfer < leastDataTransfer)
+		{
+			leastJoinOrders = list_make1(joinOrder);
+			leastDataTransfer = dataTransfer;
+		}
+	}
+
+	return leastJoinOrders;
+}
+
+
+/*
+ * JoinOrderDataTransfer estimates the number of bytes the given join order
+ * transfers across the network. The estimate uses shard lengths from the
+ * metadata, which master_update_shard_statistics() refreshes from the workers.
+ * Since we don't know join selectivities, we assume that the result of a join
+ * is as large as its larger input, which holds for joins between a fact table
+ * and its dimension tables. Table sizes come from the given table data size
+ * list, which the caller computes once for all candidate join orders.
+ */
+static uint64
+JoinOrderDataTransfer(List *joinOrder, List *tableDataSizeList)
+{
+	uint64 dataTransfer = 0;
+	uint64 joinedDataSize = 0;
+	int joinedShardCount = 0;
+	ListCell *joinOrderNodeCell = NULL;
+
+	foreach(joinOrderNodeCell, joinOrder)
+	{
+		JoinOrderNode *joinOrderNode = (JoinOrderNode *) lfirst(joinOrderNodeCell);
+		TableEntry *tableEntry = joinOrderNode->tableEntry;
+		JoinRuleType joinRuleType = joinOrderNode->joinRuleType;
+		TableDataSize *tableDataSize = FindTableDataSize(tableDataSizeList,
+														 tableEntry->rangeTableId);
+		int shardCount = 0;
+		uint64 dataSize = 0;
+
+		Assert(tableDataSize != NULL);
+		shardCount = tableDataSize->shardCount;
+		dataSize = tableDataSize->dataSize;
+
+		switch (joinRuleType)
+		{
+			case JOIN_RULE_INVALID_FIRST:
+			{
+				/* first table in the join order */
+				joinedShardCount = shardCount;
+				break;
+			}
+
+			case BROADCAST_JOIN:
+			case CARTESIAN_PRODUCT:
+			{
+				/* tasks fetch the whole table, except if it is a reference table */
+				if (PartitionMethod(tableEntry->relationId) != DISTRIBUTE_BY_NONE)
+				{
+					dataTransfer += dataSize * joinedShardCount;
+				}
+
+				break;
+			}
+
+			case LOCAL_PARTITION_JOIN:
+			{
+				break;
+			}
+
+			case SINGLE_PARTITION_JOIN:
+			{
+				Var *partitionColumn = joinOrderNode->partitionColumn;
+
+				/*
+				 * If the join keeps partitioning on the candidate table's column,
+				 * the tables joined so far are re-partitioned. Otherwise, the
+				 * candidate table is re-partitioned.
+				 */
+				if (partitionColumn->varno == tableEntry->rangeTableId)
+				{
+					dataTransfer += joinedDataSize;
+					joinedShardCount = shardCount;
+				}
+				else
+				{
+					dataTransfer += dataSize;
+				}
+
+				break;
+			}
+
+			case DUAL_PARTITION_JOIN:
+			{
+				dataTransfer += joinedDataSize + dataSize;
+				joinedShardCount = Max(joinedShardCount, shardCount);
+				break;
+			}
+
+			default:
+			{
+				ereport(ERROR, (errmsg("unrecognized join rule type: %d",
+									   joinRuleType)));
+			}
+		}
+
+		joinedDataSize = Max(joinedDataSize, dataSize);
+	}
+
+	return dataTransfer;
+}
+
+
+/*
+ * ShardIntervalListDataSize returns the sum of the lengths of the given shards.
+ * Shards that have no finalized placements are assumed to be empty.
+ */
+static uint64
+ShardIntervalListDataSize(List *shardIntervalList)
+{
+	uint64 dataSize = 0;
+	ListCell *shardIntervalCell = NULL;
+
+	foreach(shardIntervalCell, shardIntervalList)
+	{
+		ShardInterval *shardInterval = (ShardInterval *) lfirst(shardIntervalCell);
+		List *shardPlacementList = FinalizedShardPlacementList(shardInterval->shardId);
+
+		if (shardPlacementList != NIL)
+		{
+			ShardPlacement *shardPlacement =
+				(ShardPlacement *) linitial(shardPlacementList);
+
+			dataSize += shardPlacement->shardLength;
+		}
+	}
+
+	return dataSize;
+}
+
+
 /* Prints the join order list and join rules for debugging purposes. */
 static void
 PrintJoinOrderList(List *joinOrder)
@@ -1027,8 +1282,17 @@ EvaluateJoinRules(List *joinedTableList, JoinOrderNode *currentJoinNode,
 	applicableJoinClauses = ApplicableJoinClauses(joinedTableIdList, candidateTableId,
 												  joinClauseList);
 
+	/*
+	 * Co-located tables that are joined on their partition columns are always
+	 * joined locally, even if the candidate table could be broadcast, since a
+	 * local join never moves data between nodes.
+	 */
+	nextJoinNode = ColocatedJoin(joinedTableList, currentJoinNode, candidateTable,
+								 candidateShardList, applicableJoinClauses, joinType);
+
 	/* we then evaluate all join rules in order */
-	for (ruleIndex = lowestValidIndex; ruleIndex <= highestValidIndex; ruleIndex++)
+	for (ruleIndex = lowestValidIndex;
+		 nextJoinNode == NULL && ruleIndex <= highestValidIndex; ruleIndex++)
 	{
 		JoinRuleType ruleType = (JoinRuleType) ruleIndex;
 		RuleEvalFunction ruleEvalFunction = JoinRuleEvalFunction(ruleType);
@@ -1128,6 +1392,41 @@ JoinRuleName(JoinRuleType ruleType)
 }
 
 
+/*
+ * ColocatedJoin evaluates if the candidate table is a hash distributed table
+ * that is co-located with the table whose partition column the tables in the
+ * join order are currently partitioned on. If so, and the tables are joined on
+ * their partition columns, the function returns a join order node for a local
+ * join. Otherwise, the function returns null and the join rules are evaluated
+ * in their usual order.
+ */
+static JoinOrderNode *
+ColocatedJoin(List *joinedTableList, JoinOrderNode *currentJoinNode,
+			  TableEntry *candidateTable, List *candidateShardList,
+			  List *applicableJoinClauses, JoinType joinType)
+{
+	Var *currentPartitionColumn = currentJoinNode->partitionColumn;
+	TableEntry *currentTable = NULL;
+	Oid candidateRelationId = candidateTable->relationId;
+
+	if (currentJoinNode->partitionMethod != DISTRIBUTE_BY_HASH ||
+		PartitionMethod(candidateRelationId) != DISTRIBUTE_BY_HASH)
+	{
+		return NULL;
+	}
+
+	currentTable = FindTableEntry(joinedTableList, currentPartitionColumn->varno);
+	if (currentTable == NULL ||
+		!TablesColocated(currentTable->relationId, candidateRelationId))
+	{
+		return NULL;
+	}
+
+	return LocalJoin(currentJoinNode, candidateTable, candidateShardList,
+					 applicableJoinClauses, joinType);
+}
+
+
 /*
  * BroadcastJoin evaluates if the candidate table is small enough to be
  * broadcasted to all nodes in the system. If the table can be broadcasted,
@@ -1153,7 +1452,11 @@ BroadcastJoin(JoinOrderNode *currentJoinNode, TableEntry *candidateTable,
 	/*
 	 * If the table's shard count doesn't exceed the value specified in the
 	 * configuration or the table is a reference table, then we assume table
-	 * broadcasting is feasible. This assumption is valid only for inner joins.
+	 * broadcasting is feasible. If a broadcast size threshold is configured,
+	 * we instead compare the table's size, as recorded in the shard lengths,
+	 * to the threshold. Shard lengths of zero usually mean that statistics
+	 * were never collected, so we then fall back to the shard count. This
+	 * assumption is valid only for inner joins.
 	 *
 	 * Left join requires candidate table to have single shard, right join requires
 	 * existing (left) table to have single shard, full outer join requires both tables
@@ -1163,6 +1466,7 @@ BroadcastJoin(JoinOrderNode *currentJoinNode, TableEntry *candidateTable,
 	{
 		ShardInterval *initialCandidateShardInterval = NULL;
 		char candidatePartitionMethod = '\0';
+		uint64 candidateDataSize = 0;
 
 		if (candidateShardCount > 0)
 		{
@@ -1172,8 +1476,26 @@ BroadcastJoin(JoinOrderNode *currentJoinNode, TableEntry *candidateTable,
 				PartitionMethod(initialCandidateShardInterval->relationId);
 		}
 
-		if (candidatePartitionMethod == DISTRIBUTE_BY_NONE ||
-			candidateShardCount < LargeTableShardCount)
+		if (BroadcastJoinSizeThreshold > 0 &&
+			candidatePartitionMethod != DISTRIBUTE_BY_NONE)
+		{
+			candidateDataSize = ShardIntervalListDataSize(candidateShardList);
+		}
+
+		if (candidatePartitionMethod == DISTRIBUTE_BY_NONE)
+		{
+			performBroadcastJoin = true;
+		}
+		else if (candidateDataSize > 0)
+		{
+			uint64 broadcastSizeThreshold = (uint64) BroadcastJoinSizeThreshold * 1024L;
+
+			if (candidateDataSize <= broadcastSizeThreshold)
+			{
+				performBroadcastJoin = true;
+			}
+		}
+		else if (candidateShardCount < LargeTableShardCount)
 		{
 			performBroadcastJoin = true;
 		}
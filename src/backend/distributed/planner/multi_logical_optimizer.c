@@ -53,7 +53,11 @@
 
 /* Config variable managed via guc.c */
 int LimitClauseRowFetchCount = -1; /* number of rows to fetch from each task */
+int LimitClauseOverfetchFactor = 0; /* multiple of the limit to fetch from each task */
 double CountDistinctErrorRate = 0.0; /* precision of count(distinct) approximate */
+int PercentileApproximationCompression = 0; /* compression of percentile sketches */
+bool EnableSortedMerge = false; /* merge sorted task results on the master */
+bool EnableGroupByPushdown = false; /* compute groups on partition column on workers */
 
 
 typedef struct MasterAggregateWalkerContext
@@ -111,7 +115,9 @@ static void ApplyExtendedOpNodes(MultiExtendedOp *originalNode,
 								 MultiExtendedOp *masterNode,
 								 MultiExtendedOp *workerNode);
 static void TransformSubqueryNode(MultiTable *subqueryNode);
-static MultiExtendedOp * MasterExtendedOpNode(MultiExtendedOp *originalOpNode);
+static bool CanPushDownGrouping(MultiNode *logicalPlanNode, MultiExtendedOp *opNode);
+static MultiExtendedOp * MasterExtendedOpNode(MultiExtendedOp *originalOpNode,
+											  bool pushDownGrouping);
 static Node * MasterAggregateMutator(Node *originalNode,
 									 MasterAggregateWalkerContext *walkerContext);
 static Expr * MasterAggregateExpression(Aggref *originalAggregate,
@@ -119,13 +125,17 @@ static Expr * MasterAggregateExpression(Aggref *originalAggregate,
 static Expr * MasterAverageExpression(Oid sumAggregateType, Oid countAggregateType,
 									  AttrNumber *columnId);
 static Expr * AddTypeConversion(Node *originalAggregate, Node *newExpression);
-static MultiExtendedOp * WorkerExtendedOpNode(MultiExtendedOp *originalOpNode);
+static MultiExtendedOp * WorkerExtendedOpNode(MultiExtendedOp *originalOpNode,
+											  bool pushDownGrouping);
 static bool WorkerAggregateWalker(Node *node,
 								  WorkerAggregateWalkerContext *walkerContext);
 static List * WorkerAggregateExpressionList(Aggref *originalAggregate,
 											WorkerAggregateWalkerContext *walkerContextry);
 static AggregateType GetAggregateType(Oid aggFunctionId);
 static Oid AggregateArgumentType(Aggref *aggregate);
+#if (PG_VERSION_NUM >= 90600)
+static bool AggregateHasCombineFunction(Oid aggFunctionId);
+#endif
 static Oid AggregateFunctionOid(const char *functionName, Oid inputType);
 static Oid TypeOid(Oid schemaId, const char *typeName);
 
@@ -138,6 +148,8 @@ static Const * MakeIntegerConstInt64(int64 integerValue);
 /* Local functions forward declarations for aggregate expression checks */
 static void ErrorIfContainsUnsupportedAggregate(MultiNode *logicalPlanNode);
 static void ErrorIfUnsupportedArrayAggregate(Aggref *arrayAggregateExpression);
+static void ErrorIfUnsupportedCombineAggregate(Aggref *aggregateExpression);
+static void ErrorIfUnsupportedPercentileAggregate(Aggref *aggregateExpression);
 static void ErrorIfUnsupportedAggregateDistinct(Aggref *aggregateExpression,
 												MultiNode *logicalPlanNode);
 static Var * AggregateDistinctColumn(Aggref *aggregateExpression);
@@ -168,8 +180,13 @@ static bool EqualOpExpressionLists(List *firstOpExpressionList,
 								   List *secondOpExpressionList);
 
 /* Local functions forward declarations for limit clauses */
-static Node * WorkerLimitCount(MultiExtendedOp *originalOpNode);
-static List * WorkerSortClauseList(MultiExtendedOp *originalOpNode);
+static Node * WorkerLimitCount(MultiExtendedOp *originalOpNode, bool pushDownGrouping);
+static Node * WorkerApproximateLimitCount(MultiExtendedOp *originalOpNode);
+static int64 AddLimitOffset(int64 limitCount, Node *limitOffset);
+static List * WorkerSortClauseList(MultiExtendedOp *originalOpNode,
+								   bool pushDownGrouping);
+static bool CanMergeSortedTaskResults(MultiExtendedOp *originalOpNode,
+									  bool pushDownGrouping);
 static bool CanPushDownLimitApproximate(List *sortClauseList, List *targetList);
 static bool HasOrderByAggregate(List *sortClauseList, List *targetList);
 static bool HasOrderByAverage(List *sortClauseList, List *targetList);
@@ -188,7 +205,9 @@ static bool HasOrderByHllType(List *sortClauseList, List *targetList);
  * to return to the user, or aggregate expressions used by the aggregate node.
  * Third, the function pulls up the collect operators in the tree. Fourth, the
  * function finds the extended operator node, and splits this node into master
- * and worker extended operator nodes.
+ * and worker extended operator nodes. If each group of the extended operator
+ * node lives in a single task, the worker node computes these groups fully and
+ * the master node only concatenates task results.
  */
 void
 MultiLogicalPlanOptimize(MultiTreeRoot *multiLogicalPlan)
@@ -206,9 +225,44 @@ MultiLogicalPlanOptimize(MultiTreeRoot *multiLogicalPlan)
 	MultiExtendedOp *masterExtendedOpNode = NULL;
 	MultiExtendedOp *workerExtendedOpNode = NULL;
 	MultiNode *logicalPlanNode = (MultiNode *) multiLogicalPlan;
+	bool pushDownGrouping = false;
+
+	extendedOpNodeList = FindNodesOfType(logicalPlanNode, T_MultiExtendedOp);
+	extendedOpNode = (MultiExtendedOp *) linitial(extendedOpNodeList);
+
+	/*
+	 * We only support distinct clauses and window functions when worker nodes can
+	 * compute them fully. In that case, worker nodes also compute aggregates as
+	 * they are, so we don't need to check whether we can split them.
+	 */
+	pushDownGrouping = CanPushDownGrouping(logicalPlanNode, extendedOpNode);
+	if (extendedOpNode->distinctClause != NIL && !pushDownGrouping)
+	{
+		ereport(ERROR, (errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+						errmsg("could not run distributed query with DISTINCT clause"),
+						errdetail("Distinct clauses need to include the partition "
+								  "column of each distributed table in the query, "
+								  "and each column that the query groups by."),
+						errhint("Consider using an equality filter on the "
+								"distributed table's partition column.")));
+	}
+
+	if (extendedOpNode->windowClause != NIL && !pushDownGrouping)
+	{
+		ereport(ERROR, (errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+						errmsg("could not run distributed query with window functions"),
+						errdetail("Window functions need to be partitioned by the "
+								  "partition column of each distributed table in "
+								  "the query."),
+						errhint("Consider using an equality filter on the "
+								"distributed table's partition column.")));
+	}
 
 	/* check that we can optimize aggregates in the plan */
-	ErrorIfContainsUnsupportedAggregate(logicalPlanNode);
+	if (!pushDownGrouping)
+	{
+		ErrorIfContainsUnsupportedAggregate(logicalPlanNode);
+	}
 
 	/* check that we can pushdown subquery in the plan */
 	ErrorIfContainsUnsupportedSubquery(logicalPlanNode);
@@ -268,11 +322,8 @@ MultiLogicalPlanOptimize(MultiTreeRoot *multiLogicalPlan)
 	 * clause list to the worker operator node. We then push the worker operator
 	 * node below the collect node.
 	 */
-	extendedOpNodeList = FindNodesOfType(logicalPlanNode, T_MultiExtendedOp);
-	extendedOpNode = (MultiExtendedOp *) linitial(extendedOpNodeList);
-
-	masterExtendedOpNode = MasterExtendedOpNode(extendedOpNode);
-	workerExtendedOpNode = WorkerExtendedOpNode(extendedOpNode);
+	masterExtendedOpNode = MasterExtendedOpNode(extendedOpNode, pushDownGrouping);
+	workerExtendedOpNode = WorkerExtendedOpNode(extendedOpNode, pushDownGrouping);
 
 	ApplyExtendedOpNodes(extendedOpNode, masterExtendedOpNode, workerExtendedOpNode);
 
@@ -1176,8 +1227,8 @@ TransformSubqueryNode(MultiTable *subqueryNode)
 		(MultiExtendedOp *) ChildNode((MultiUnaryNode *) subqueryNode);
 	MultiNode *collectNode = ChildNode((MultiUnaryNode *) extendedOpNode);
 	MultiNode *collectChildNode = ChildNode((MultiUnaryNode *) collectNode);
-	MultiExtendedOp *masterExtendedOpNode = MasterExtendedOpNode(extendedOpNode);
-	MultiExtendedOp *workerExtendedOpNode = WorkerExtendedOpNode(extendedOpNode);
+	MultiExtendedOp *masterExtendedOpNode = MasterExtendedOpNode(extendedOpNode, false);
+	MultiExtendedOp *workerExtendedOpNode = WorkerExtendedOpNode(extendedOpNode, false);
 	MultiPartition *partitionNode = CitusMakeNode(MultiPartition);
 	List *groupClauseList = extendedOpNode->groupClauseList;
 	List *targetEntryList = extendedOpNode->targetList;
@@ -1227,6 +1278,136 @@ TransformSubqueryNode(MultiTable *subqueryNode)
 }
 
 
+/*
+ * CanPushDownGrouping checks if worker nodes can fully compute the groups, the
+ * distinct rows and the window functions of the given extended operator node, so
+ * that the master node only needs to concatenate task results. This is the case
+ * when the node groups by, has its distinct clause on, and partitions its windows
+ * by the partition column of each range or hash partitioned table in the plan,
+ * as each group and window partition then lives in a single task.
+ * Tables with a single shard can't split groups across tasks, so they don't need
+ * to be grouped by their partition column. Repartition jobs create tasks that
+ * don't follow the shards of the tables, so we don't push down grouping if the
+ * plan repartitions any table.
+ *
+ * Worker nodes return all target entries, including the ones that the query
+ * only groups or sorts by. For a distinct clause that isn't a distinct on, these
+ * entries would then also become part of the distinct rows on worker nodes, so
+ * we don't push down such distinct clauses.
+ *
+ * We only push down group by clauses if citus.enable_group_by_pushdown is set,
+ * but always push down distinct clauses and window functions as we don't support
+ * them otherwise.
+ */
+static bool
+CanPushDownGrouping(MultiNode *logicalPlanNode, MultiExtendedOp *opNode)
+{
+	List *groupClauseList = opNode->groupClauseList;
+	List *distinctClauseList = opNode->distinctClause;
+	List *windowClauseList = opNode->windowClause;
+	List *targetList = opNode->targetList;
+	MultiNode *parentNode = ParentNode((MultiNode *) opNode);
+	List *tableNodeList = NIL;
+	ListCell *tableNodeCell = NULL;
+	ListCell *targetEntryCell = NULL;
+
+	if (!EnableGroupByPushdown && distinctClauseList == NIL && windowClauseList == NIL)
+	{
+		return false;
+	}
+
+	/* distinct rows on workers would also cover columns we only group by */
+	if (distinctClauseList != NIL && !opNode->hasDistinctOn)
+	{
+		foreach(targetEntryCell, targetList)
+		{
+			TargetEntry *targetEntry = (TargetEntry *) lfirst(targetEntryCell);
+			if (targetEntry->resjunk)
+			{
+				return false;
+			}
+		}
+	}
+
+	/* repartitioned subqueries are grouped by the repartition job */
+	if (!CitusIsA(parentNode, MultiTreeRoot))
+	{
+		return false;
+	}
+
+	/* without group by clauses, aggregates combine the rows of all tasks */
+	if (groupClauseList == NIL)
+	{
+		if ((distinctClauseList == NIL && windowClauseList == NIL) ||
+			contain_agg_clause((Node *) targetList) ||
+			contain_agg_clause(opNode->havingQual))
+		{
+			return false;
+		}
+	}
+
+	if (FindNodesOfType(logicalPlanNode, T_MultiPartition) != NIL)
+	{
+		return false;
+	}
+
+	tableNodeList = FindNodesOfType(logicalPlanNode, T_MultiTable);
+	foreach(tableNodeCell, tableNodeList)
+	{
+		MultiTable *tableNode = (MultiTable *) lfirst(tableNodeCell);
+		Oid relationId = tableNode->relationId;
+		Var *partitionColumn = tableNode->partitionColumn;
+		char partitionMethod = 0;
+		List *shardList = NIL;
+		ListCell *windowClauseCell = NULL;
+
+		if (relationId == SUBQUERY_RELATION_ID)
+		{
+			return false;
+		}
+
+		/* if table has one shard, its rows are in a single task */
+		shardList = LoadShardList(relationId);
+		if (list_length(shardList) == 1)
+		{
+			continue;
+		}
+
+		partitionMethod = PartitionMethod(relationId);
+		if (partitionMethod != DISTRIBUTE_BY_RANGE &&
+			partitionMethod != DISTRIBUTE_BY_HASH)
+		{
+			return false;
+		}
+
+		if (groupClauseList != NIL &&
+			!GroupedByColumn(groupClauseList, targetList, partitionColumn))
+		{
+			return false;
+		}
+
+		if (distinctClauseList != NIL &&
+			!GroupedByColumn(distinctClauseList, targetList, partitionColumn))
+		{
+			return false;
+		}
+
+		foreach(windowClauseCell, windowClauseList)
+		{
+			WindowClause *windowClause = (WindowClause *) lfirst(windowClauseCell);
+			List *partitionClauseList = windowClause->partitionClause;
+
+			if (!GroupedByColumn(partitionClauseList, targetList, partitionColumn))
+			{
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+
 /*
  * MasterExtendedOpNode creates the master extended operator node from the given
  * target entries. The function walks over these target entries; and for entries
@@ -1236,10 +1417,11 @@ TransformSubqueryNode(MultiTable *subqueryNode)
  * Note that the function logically depends on the worker extended operator node
  * function. If the target entry does not contain aggregate functions, we assume
  * all work is done on the worker side, and create a column that references the
- * worker nodes' results.
+ * worker nodes' results. If we push down grouping, worker nodes do all the work
+ * for every target entry, and the master node doesn't group again.
  */
 static MultiExtendedOp *
-MasterExtendedOpNode(MultiExtendedOp *originalOpNode)
+MasterExtendedOpNode(MultiExtendedOp *originalOpNode, bool pushDownGrouping)
 {
 	MultiExtendedOp *masterExtendedOpNode = NULL;
 	List *targetEntryList = originalOpNode->targetList;
@@ -1269,7 +1451,7 @@ MasterExtendedOpNode(MultiExtendedOp *originalOpNode)
 		Expr *newExpression = NULL;
 
 		bool hasAggregates = contain_agg_clause((Node *) originalExpression);
-		if (hasAggregates)
+		if (hasAggregates && !pushDownGrouping)
 		{
 			Node *newNode = MasterAggregateMutator((Node *) originalExpression,
 												   walkerContext);
@@ -1296,14 +1478,18 @@ MasterExtendedOpNode(MultiExtendedOp *originalOpNode)
 		newTargetEntryList = lappend(newTargetEntryList, newTargetEntry);
 	}
 
-	if (originalHavingQual != NULL)
+	if (originalHavingQual != NULL && !pushDownGrouping)
 	{
 		newHavingQual = MasterAggregateMutator(originalHavingQual, walkerContext);
 	}
 
 	masterExtendedOpNode = CitusMakeNode(MultiExtendedOp);
 	masterExtendedOpNode->targetList = newTargetEntryList;
-	masterExtendedOpNode->groupClauseList = originalOpNode->groupClauseList;
+	if (!pushDownGrouping)
+	{
+		masterExtendedOpNode->groupClauseList = originalOpNode->groupClauseList;
+	}
+
 	masterExtendedOpNode->sortClauseList = originalOpNode->sortClauseList;
 	masterExtendedOpNode->limitCount = originalOpNode->limitCount;
 	masterExtendedOpNode->limitOffset = originalOpNode->limitOffset;
@@ -1613,6 +1799,118 @@ MasterAggregateExpression(Aggref *originalAggregate,
 
 		newMasterExpression = (Expr *) newMasterAggregate;
 	}
+	else if (aggregateType == AGGREGATE_PERCENTILE_CONT)
+	{
+		/*
+		 * If enabled, we approximate percentile_cont() with percentile sketches.
+		 * For this, we first compute percentile_sketch_add_agg(column, compression)
+		 * on worker nodes, and get a sketch for each shard. We then merge these
+		 * sketches on the master node, and compute the percentile with
+		 * percentile_sketch_value(percentile_sketch_union_agg(sketch), fraction).
+		 */
+		const int unionArgumentCount = 1;
+		const int valueArgumentCount = 2;
+		const int defaultTypeMod = -1;
+
+		Node *fractionExpression = (Node *) linitial(originalAggregate->aggdirectargs);
+		TargetEntry *sketchTargetEntry = NULL;
+		Aggref *unionAggregate = NULL;
+		FuncExpr *valueExpression = NULL;
+
+		Oid unionFunctionId = FunctionOid(CITUS_AGGREGATE_SCHEMA_NAME,
+										  PERCENTILE_SKETCH_UNION_AGGREGATE_NAME,
+										  unionArgumentCount);
+		Oid valueFunctionId = FunctionOid(CITUS_AGGREGATE_SCHEMA_NAME,
+										  PERCENTILE_SKETCH_VALUE_FUNC_NAME,
+										  valueArgumentCount);
+		Oid sketchType = get_func_rettype(unionFunctionId);
+		Oid valueReturnType = get_func_rettype(valueFunctionId);
+
+		Var *sketchColumn = makeVar(masterTableId, walkerContext->columnId, sketchType,
+									defaultTypeMod, InvalidOid, columnLevelsUp);
+		walkerContext->columnId++;
+
+		sketchTargetEntry = makeTargetEntry((Expr *) sketchColumn, argumentId, NULL,
+											false);
+
+		unionAggregate = makeNode(Aggref);
+		unionAggregate->aggfnoid = unionFunctionId;
+		unionAggregate->aggtype = sketchType;
+		unionAggregate->args = list_make1(sketchTargetEntry);
+		unionAggregate->aggkind = AGGKIND_NORMAL;
+		unionAggregate->aggfilter = NULL;
+#if (PG_VERSION_NUM >= 90600)
+		unionAggregate->aggtranstype = InvalidOid;
+		unionAggregate->aggargtypes = list_make1_oid(sketchType);
+		unionAggregate->aggsplit = AGGSPLIT_SIMPLE;
+#endif
+
+		valueExpression = makeNode(FuncExpr);
+		valueExpression->funcid = valueFunctionId;
+		valueExpression->funcresulttype = valueReturnType;
+		valueExpression->args = list_make2(unionAggregate,
+										   copyObject(fractionExpression));
+
+		newMasterExpression = (Expr *) valueExpression;
+	}
+	else if (aggregateType == AGGREGATE_CUSTOM_COMBINE)
+	{
+		/*
+		 * Other aggregates with combine functions are handled in two steps. First,
+		 * worker nodes compute the aggregate's transition state and serialize it
+		 * with worker_partial_agg(). Then, the master node combines these states
+		 * and finalizes the result with master_combine_agg(aggregate, state,
+		 * null::result_type), where the last argument only determines the result
+		 * type of the polymorphic master_combine_agg().
+		 */
+		const int combineArgumentCount = 3;
+		const int defaultTypeMod = -1;
+
+		Var *stateColumn = NULL;
+		Const *aggregateIdConst = NULL;
+		Const *resultTypeConst = NULL;
+		List *combineArgumentList = NIL;
+		Aggref *combineAggregate = NULL;
+
+		Oid combineFunctionId = FunctionOid(CITUS_AGGREGATE_SCHEMA_NAME,
+											MASTER_COMBINE_AGGREGATE_NAME,
+											combineArgumentCount);
+		Oid resultType = exprType((Node *) originalAggregate);
+		int32 resultTypeMod = exprTypmod((Node *) originalAggregate);
+		Oid resultCollationId = exprCollation((Node *) originalAggregate);
+
+		aggregateIdConst = makeConst(OIDOID, defaultTypeMod, InvalidOid, sizeof(Oid),
+									 ObjectIdGetDatum(originalAggregate->aggfnoid),
+									 false, true);
+		resultTypeConst = makeNullConst(resultType, resultTypeMod, resultCollationId);
+
+		stateColumn = makeVar(masterTableId, walkerContext->columnId, BYTEAOID,
+							  defaultTypeMod, InvalidOid, columnLevelsUp);
+		walkerContext->columnId++;
+
+		combineArgumentList = list_make3(makeTargetEntry((Expr *) aggregateIdConst,
+														 1, NULL, false),
+										 makeTargetEntry((Expr *) stateColumn,
+														 2, NULL, false),
+										 makeTargetEntry((Expr *) resultTypeConst,
+														 3, NULL, false));
+
+		combineAggregate = makeNode(Aggref);
+		combineAggregate->aggfnoid = combineFunctionId;
+		combineAggregate->aggtype = resultType;
+		combineAggregate->aggcollid = originalAggregate->aggcollid;
+		combineAggregate->inputcollid = originalAggregate->inputcollid;
+		combineAggregate->args = combineArgumentList;
+		combineAggregate->aggkind = AGGKIND_NORMAL;
+		combineAggregate->aggfilter = NULL;
+#if (PG_VERSION_NUM >= 90600)
+		combineAggregate->aggtranstype = InvalidOid;
+		combineAggregate->aggargtypes = list_make3_oid(OIDOID, BYTEAOID, resultType);
+		combineAggregate->aggsplit = AGGSPLIT_SIMPLE;
+#endif
+
+		newMasterExpression = (Expr *) combineAggregate;
+	}
 	else
 	{
 		/*
@@ -1785,10 +2083,12 @@ AddTypeConversion(Node *originalAggregate, Node *newExpression)
  * count and sort clause list fields in the new operator node. It provides special
  * treatment for count distinct operator if it is used in repartition subqueries.
  * Each column in count distinct aggregate is added to target list, and group by
- * list of worker extended operator.
+ * list of worker extended operator. If we push down grouping, the worker node
+ * computes the original target entries, having and distinct clauses, and window
+ * functions as they are.
  */
 static MultiExtendedOp *
-WorkerExtendedOpNode(MultiExtendedOp *originalOpNode)
+WorkerExtendedOpNode(MultiExtendedOp *originalOpNode, bool pushDownGrouping)
 {
 	MultiExtendedOp *workerExtendedOpNode = NULL;
 	MultiNode *parentNode = ParentNode((MultiNode *) originalOpNode);
@@ -1836,7 +2136,7 @@ WorkerExtendedOpNode(MultiExtendedOp *originalOpNode)
 		walkerContext->expressionList = NIL;
 		walkerContext->createGroupByClause = false;
 
-		if (hasAggregates)
+		if (hasAggregates && !pushDownGrouping)
 		{
 			WorkerAggregateWalker((Node *) originalExpression, walkerContext);
 
@@ -1903,7 +2203,7 @@ WorkerExtendedOpNode(MultiExtendedOp *originalOpNode)
 	}
 
 	/* we also need to add having expressions to worker target list */
-	if (havingQual != NULL)
+	if (havingQual != NULL && !pushDownGrouping)
 	{
 		List *newExpressionList = NIL;
 		ListCell *newExpressionCell = NULL;
@@ -1941,9 +2241,19 @@ WorkerExtendedOpNode(MultiExtendedOp *originalOpNode)
 	workerExtendedOpNode->targetList = newTargetEntryList;
 	workerExtendedOpNode->groupClauseList = groupClauseList;
 
+	if (pushDownGrouping)
+	{
+		workerExtendedOpNode->havingQual = copyObject(havingQual);
+		workerExtendedOpNode->distinctClause = copyObject(originalOpNode->distinctClause);
+		workerExtendedOpNode->hasDistinctOn = originalOpNode->hasDistinctOn;
+		workerExtendedOpNode->windowClause = copyObject(originalOpNode->windowClause);
+	}
+
 	/* if we can push down the limit, also set related fields */
-	workerExtendedOpNode->limitCount = WorkerLimitCount(originalOpNode);
-	workerExtendedOpNode->sortClauseList = WorkerSortClauseList(originalOpNode);
+	workerExtendedOpNode->limitCount = WorkerLimitCount(originalOpNode,
+														pushDownGrouping);
+	workerExtendedOpNode->sortClauseList = WorkerSortClauseList(originalOpNode,
+																pushDownGrouping);
 
 	return workerExtendedOpNode;
 }
@@ -2123,6 +2433,95 @@ WorkerAggregateExpressionList(Aggref *originalAggregate,
 		workerAggregateList = lappend(workerAggregateList, sumAggregate);
 		workerAggregateList = lappend(workerAggregateList, countAggregate);
 	}
+	else if (aggregateType == AGGREGATE_PERCENTILE_CONT)
+	{
+		/*
+		 * If the original aggregate is a percentile_cont() approximation, we want
+		 * to compute percentile_sketch_add_agg(var, compression) on worker nodes.
+		 */
+		const AttrNumber firstArgumentId = 1;
+		const AttrNumber secondArgumentId = 2;
+		const int addArgumentCount = 2;
+
+		TargetEntry *valueArgument = NULL;
+		TargetEntry *compressionArgument = NULL;
+		Aggref *addAggregateFunction = NULL;
+
+		TargetEntry *argument = (TargetEntry *) linitial(originalAggregate->args);
+		Expr *argumentExpression = copyObject(argument->expr);
+		Const *compressionConst = MakeIntegerConst(PercentileApproximationCompression);
+
+		Oid addFunctionId = FunctionOid(CITUS_AGGREGATE_SCHEMA_NAME,
+										PERCENTILE_SKETCH_ADD_AGGREGATE_NAME,
+										addArgumentCount);
+
+		valueArgument = makeTargetEntry(argumentExpression, firstArgumentId, NULL,
+										false);
+		compressionArgument = makeTargetEntry((Expr *) compressionConst,
+											  secondArgumentId, NULL, false);
+
+		addAggregateFunction = makeNode(Aggref);
+		addAggregateFunction->aggfnoid = addFunctionId;
+		addAggregateFunction->aggtype = get_func_rettype(addFunctionId);
+		addAggregateFunction->args = list_make2(valueArgument, compressionArgument);
+		addAggregateFunction->aggkind = AGGKIND_NORMAL;
+		addAggregateFunction->aggfilter = (Expr *) copyObject(
+			originalAggregate->aggfilter);
+#if (PG_VERSION_NUM >= 90600)
+		addAggregateFunction->aggtranstype = InvalidOid;
+		addAggregateFunction->aggargtypes = list_make2_oid(FLOAT8OID, INT4OID);
+		addAggregateFunction->aggsplit = AGGSPLIT_SIMPLE;
+#endif
+
+		workerAggregateList = lappend(workerAggregateList, addAggregateFunction);
+	}
+	else if (aggregateType == AGGREGATE_CUSTOM_COMBINE)
+	{
+		/*
+		 * If the original aggregate has a combine function, we compute its
+		 * serialized transition state with worker_partial_agg(aggregate, var) on
+		 * worker nodes. We pass the aggregate as a regprocedure, since its oid
+		 * may differ on worker nodes.
+		 */
+		const int partialArgumentCount = 2;
+		const int defaultTypeMod = -1;
+
+		TargetEntry *argument = (TargetEntry *) linitial(originalAggregate->args);
+		Expr *argumentExpression = copyObject(argument->expr);
+		Const *aggregateIdConst = NULL;
+		List *partialArgumentList = NIL;
+		Aggref *partialAggregate = NULL;
+
+		Oid partialFunctionId = FunctionOid(CITUS_AGGREGATE_SCHEMA_NAME,
+											WORKER_PARTIAL_AGGREGATE_NAME,
+											partialArgumentCount);
+
+		aggregateIdConst = makeConst(REGPROCEDUREOID, defaultTypeMod, InvalidOid,
+									 sizeof(Oid),
+									 ObjectIdGetDatum(originalAggregate->aggfnoid),
+									 false, true);
+
+		partialArgumentList = list_make2(makeTargetEntry((Expr *) aggregateIdConst,
+														 1, NULL, false),
+										 makeTargetEntry(argumentExpression,
+														 2, NULL, false));
+
+		partialAggregate = makeNode(Aggref);
+		partialAggregate->aggfnoid = partialFunctionId;
+		partialAggregate->aggtype = BYTEAOID;
+		partialAggregate->inputcollid = originalAggregate->inputcollid;
+		partialAggregate->args = partialArgumentList;
+		partialAggregate->aggkind = AGGKIND_NORMAL;
+		partialAggregate->aggfilter = (Expr *) copyObject(originalAggregate->aggfilter);
+#if (PG_VERSION_NUM >= 90600)
+		partialAggregate->aggtranstype = InvalidOid;
+		partialAggregate->aggargtypes =
+			list_make2_oid(OIDOID, AggregateArgumentType(originalAggregate));
+		partialAggregate->aggsplit = AGGSPLIT_SIMPLE;
+#endif
+
+		workerAggregateList = lappend(workerAggregateList, partialAggregate);
+	}
 	else
 	{
 		/*
@@ -2179,15 +2578,58 @@ GetAggregateType(Oid aggFunctionId)
 		}
 	}
 
-	if (!found)
+	if (found)
+	{
+		return aggregateIndex;
+	}
+
+#if (PG_VERSION_NUM >= 90600)
+
+	/* other aggregates with combine functions are computed in two phases */
+	if (AggregateHasCombineFunction(aggFunctionId))
+	{
+		return AGGREGATE_CUSTOM_COMBINE;
+	}
+#endif
+
+	ereport(ERROR, (errmsg("unsupported aggregate function %s", aggregateProcName)));
+
+	return AGGREGATE_INVALID_FIRST;
+}
+
+
+#if (PG_VERSION_NUM >= 90600)
+
+/*
+ * AggregateHasCombineFunction checks pg_aggregate for whether the given
+ * aggregate has a combine function, which lets us combine the aggregate's
+ * transition states computed on different shards.
+ */
+static bool
+AggregateHasCombineFunction(Oid aggFunctionId)
+{
+	HeapTuple aggregateTuple = NULL;
+	Form_pg_aggregate aggregateForm = NULL;
+	bool hasCombineFunction = false;
+
+	aggregateTuple = SearchSysCache1(AGGFNOID, ObjectIdGetDatum(aggFunctionId));
+	if (!HeapTupleIsValid(aggregateTuple))
 	{
-		ereport(ERROR, (errmsg("unsupported aggregate function %s", aggregateProcName)));
+		ereport(ERROR, (errmsg("cache lookup failed for aggregate %u", aggFunctionId)));
 	}
 
-	return aggregateIndex;
+	aggregateForm = (Form_pg_aggregate) GETSTRUCT(aggregateTuple);
+	hasCombineFunction = OidIsValid(aggregateForm->aggcombinefn);
+
+	ReleaseSysCache(aggregateTuple);
+
+	return hasCombineFunction;
 }
 
 
+#endif
+
+
 /* Extracts the type of the argument over which the aggregate is operating. */
 static Oid
 AggregateArgumentType(Aggref *aggregate)
@@ -2472,6 +2914,14 @@ ErrorIfContainsUnsupportedAggregate(MultiNode *logicalPlanNode)
 		{
 			ErrorIfUnsupportedArrayAggregate(aggregateExpression);
 		}
+		else if (aggregateType == AGGREGATE_CUSTOM_COMBINE)
+		{
+			ErrorIfUnsupportedCombineAggregate(aggregateExpression);
+		}
+		else if (aggregateType == AGGREGATE_PERCENTILE_CONT)
+		{
+			ErrorIfUnsupportedPercentileAggregate(aggregateExpression);
+		}
 		else if (aggregateExpression->aggdistinct)
 		{
 			ErrorIfUnsupportedAggregateDistinct(aggregateExpression, logicalPlanNode);
@@ -2504,6 +2954,127 @@ ErrorIfUnsupportedArrayAggregate(Aggref *arrayAggregateExpression)
 }
 
 
+/*
+ * ErrorIfUnsupportedCombineAggregate checks if we can compute the aggregate that
+ * has a combine function in two phases, with worker_partial_agg() on worker
+ * nodes and master_combine_agg() on the master node. If we cannot, this function
+ * errors.
+ */
+static void
+ErrorIfUnsupportedCombineAggregate(Aggref *aggregateExpression)
+{
+	Oid aggregateId = aggregateExpression->aggfnoid;
+	char *aggregateName = get_func_name(aggregateId);
+#if (PG_VERSION_NUM >= 90600)
+	HeapTuple aggregateTuple = NULL;
+	Form_pg_aggregate aggregateForm = NULL;
+	Oid transitionTypeId = InvalidOid;
+	bool hasSerialFunctions = false;
+#endif
+
+	if (list_length(aggregateExpression->args) != 1)
+	{
+		ereport(ERROR, (errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+						errmsg("%s with %d arguments is unsupported", aggregateName,
+							   list_length(aggregateExpression->args)),
+						errdetail("Only aggregates with a single argument can be "
+								  "computed from partial results.")));
+	}
+
+	if (aggregateExpression->aggdistinct)
+	{
+		ereport(ERROR, (errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+						errmsg("%s (distinct) is unsupported", aggregateName)));
+	}
+
+	if (aggregateExpression->aggorder)
+	{
+		ereport(ERROR, (errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+						errmsg("%s with order by is unsupported", aggregateName)));
+	}
+
+#if (PG_VERSION_NUM >= 90600)
+	aggregateTuple = SearchSysCache1(AGGFNOID, ObjectIdGetDatum(aggregateId));
+	if (!HeapTupleIsValid(aggregateTuple))
+	{
+		ereport(ERROR, (errmsg("cache lookup failed for aggregate %u", aggregateId)));
+	}
+
+	aggregateForm = (Form_pg_aggregate) GETSTRUCT(aggregateTuple);
+	transitionTypeId = aggregateForm->aggtranstype;
+	hasSerialFunctions = OidIsValid(aggregateForm->aggserialfn) &&
+						 OidIsValid(aggregateForm->aggdeserialfn);
+
+	ReleaseSysCache(aggregateTuple);
+
+	if (IsPolymorphicType(transitionTypeId))
+	{
+		ereport(ERROR, (errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+						errmsg("%s is unsupported", aggregateName),
+						errdetail("Aggregates with polymorphic transition types "
+								  "cannot be computed from partial results.")));
+	}
+
+	if (transitionTypeId == INTERNALOID && !hasSerialFunctions)
+	{
+		ereport(ERROR, (errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+						errmsg("%s is unsupported", aggregateName),
+						errdetail("Aggregates with transition type internal need "
+								  "serialization functions to be computed from "
+								  "partial results.")));
+	}
+#endif
+}
+
+
+/*
+ * ErrorIfUnsupportedPercentileAggregate checks if we can approximate the given
+ * percentile_cont() expression with percentile sketches. We only approximate
+ * percentiles when citus.percentile_approximation_compression is set, and only
+ * for a single fraction over double precision values. If we cannot approximate
+ * the aggregate, this function errors.
+ */
+static void
+ErrorIfUnsupportedPercentileAggregate(Aggref *aggregateExpression)
+{
+	Node *fractionExpression = NULL;
+	Oid argumentType = InvalidOid;
+
+	if (PercentileApproximationCompression == DISABLE_PERCENTILE_APPROXIMATION)
+	{
+		ereport(ERROR, (errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+						errmsg("cannot compute percentile_cont on distributed tables"),
+						errdetail("Exact percentiles require all rows on the master "
+								  "node."),
+						errhint("You can enable percentile approximations by setting "
+								"citus.percentile_approximation_compression.")));
+	}
+
+	argumentType = AggregateArgumentType(aggregateExpression);
+	if (list_length(aggregateExpression->aggdirectargs) == 1)
+	{
+		fractionExpression = (Node *) linitial(aggregateExpression->aggdirectargs);
+	}
+
+	if (argumentType != FLOAT8OID || fractionExpression == NULL ||
+		exprType(fractionExpression) != FLOAT8OID)
+	{
+		ereport(ERROR, (errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+						errmsg("cannot approximate percentile_cont"),
+						errdetail("Only percentiles of double precision values "
+								  "with a single fraction can be approximated.")));
+	}
+
+	if (contain_var_clause(fractionExpression))
+	{
+		ereport(ERROR, (errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+						errmsg("cannot approximate percentile_cont"),
+						errdetail("Percentile fractions that reference columns "
+								  "cannot be approximated.")));
+	}
+}
+
+
 /*
  * ErrorIfUnsupportedAggregateDistinct checks if we can transform the aggregate
  * (distinct expression) and push it down to the worker node. It handles count
@@ -4375,10 +4946,10 @@ EqualOpExpressionLists(List *firstOpExpressionList, List *secondOpExpressionList
  * with LIMIT x OFFSET y, (x+y) records should be pulled from the workers.
  *
  * If no limit is present or can be pushed down, then WorkerLimitCount
- * returns null.
+ * returns null. The same holds for limit all, which asks for all records.
  */
 static Node *
-WorkerLimitCount(MultiExtendedOp *originalOpNode)
+WorkerLimitCount(MultiExtendedOp *originalOpNode, bool pushDownGrouping)
 {
 	Node *workerLimitNode = NULL;
 	List *groupClauseList = originalOpNode->groupClauseList;
@@ -4389,17 +4960,19 @@ WorkerLimitCount(MultiExtendedOp *originalOpNode)
 	bool canApproximate = false;
 
 	/* no limit node to push down */
-	if (originalOpNode->limitCount == NULL)
+	if (originalOpNode->limitCount == NULL ||
+		((Const *) originalOpNode->limitCount)->constisnull)
 	{
 		return NULL;
 	}
 
 	/*
-	 * If we don't have group by clauses, or if we have order by clauses without
-	 * aggregates, we can push down the original limit. Else if we have order by
-	 * clauses with commutative aggregates, we can push down approximate limits.
+	 * If we don't have group by clauses, if worker nodes compute the groups fully,
+	 * or if we have order by clauses without aggregates, we can push down the
+	 * original limit. Else if we have order by clauses with commutative
+	 * aggregates, we can push down approximate limits.
 	 */
-	if (groupClauseList == NIL)
+	if (groupClauseList == NIL || pushDownGrouping)
 	{
 		canPushDownLimit = true;
 	}
@@ -4416,34 +4989,23 @@ WorkerLimitCount(MultiExtendedOp *originalOpNode)
 		canApproximate = CanPushDownLimitApproximate(sortClauseList, targetList);
 	}
 
-	/* create the workerLimitNode according to the decisions above */
-	if (canPushDownLimit)
-	{
-		workerLimitNode = (Node *) copyObject(originalOpNode->limitCount);
-	}
-	else if (canApproximate)
-	{
-		Const *workerLimitConst = (Const *) copyObject(originalOpNode->limitCount);
-		int64 workerLimitCount = (int64) LimitClauseRowFetchCount;
-		workerLimitConst->constvalue = Int64GetDatum(workerLimitCount);
-
-		workerLimitNode = (Node *) workerLimitConst;
-	}
-
 	/*
-	 * If offset clause is present and limit can be pushed down (whether exactly or
-	 * approximately), add the offset value to limit on workers
+	 * Create the workerLimitNode according to the decisions above. If an offset
+	 * clause is present, the limit on workers also covers the offset rows.
 	 */
-	if (workerLimitNode != NULL && originalOpNode->limitOffset != NULL)
+	if (canPushDownLimit)
 	{
-		Const *workerLimitConst = (Const *) workerLimitNode;
-		Const *workerOffsetConst = (Const *) originalOpNode->limitOffset;
-		int64 workerLimitCount = DatumGetInt64(workerLimitConst->constvalue);
-		int64 workerOffsetCount = DatumGetInt64(workerOffsetConst->constvalue);
+		Const *originalLimitConst = (Const *) originalOpNode->limitCount;
+		int64 originalLimitCount = DatumGetInt64(originalLimitConst->constvalue);
+		int64 workerLimitCount = AddLimitOffset(originalLimitCount,
+												originalOpNode->limitOffset);
 
-		workerLimitCount = workerLimitCount + workerOffsetCount;
 		workerLimitNode = (Node *) MakeIntegerConstInt64(workerLimitCount);
 	}
+	else if (canApproximate)
+	{
+		workerLimitNode = WorkerApproximateLimitCount(originalOpNode);
+	}
 
 	/* display debug message on limit push down */
 	if (workerLimitNode != NULL)
@@ -4459,25 +5021,116 @@ WorkerLimitCount(MultiExtendedOp *originalOpNode)
 }
 
 
+/*
+ * WorkerApproximateLimitCount returns the limit to push down to worker nodes when
+ * we approximate the original limit. Each task returns its top groups according
+ * to the order by aggregates, and the master node merges these partial results.
+ * Groups that rank high overall but are cut off in some tasks then get smaller
+ * aggregate values than they should, so we fetch more rows from each task than
+ * the original limit asks for. citus.limit_clause_row_fetch_count sets a fixed
+ * number of rows to fetch, and citus.limit_clause_overfetch_factor sets a number
+ * that grows with the limit. If both are set, we fetch the larger number of rows.
+ * Both numbers also cover the rows skipped by an offset clause; the factor thus
+ * multiplies the sum of the limit and the offset.
+ *
+ * Fetching k rows from each task is the same as merging per-task frequent item
+ * summaries of size k: for counts, the aggregate of each returned group is off by
+ * at most the sum of the smallest counts that each task returned.
+ */
+static Node *
+WorkerApproximateLimitCount(MultiExtendedOp *originalOpNode)
+{
+	Const *originalLimitConst = (Const *) originalOpNode->limitCount;
+	Node *limitOffset = originalOpNode->limitOffset;
+	int64 workerLimitCount = 0;
+
+	if (LimitClauseRowFetchCount != DISABLE_LIMIT_APPROXIMATION)
+	{
+		workerLimitCount = AddLimitOffset((int64) LimitClauseRowFetchCount,
+										  limitOffset);
+	}
+
+	if (LimitClauseOverfetchFactor != DISABLE_LIMIT_OVERFETCH)
+	{
+		int64 originalLimitCount = DatumGetInt64(originalLimitConst->constvalue);
+		int64 limitOffsetCount = AddLimitOffset(originalLimitCount, limitOffset);
+		int64 overfetchLimitCount = 0;
+
+		if (limitOffsetCount > PG_INT64_MAX / LimitClauseOverfetchFactor)
+		{
+			overfetchLimitCount = PG_INT64_MAX;
+		}
+		else
+		{
+			overfetchLimitCount = limitOffsetCount * LimitClauseOverfetchFactor;
+		}
+
+		workerLimitCount = Max(workerLimitCount, overfetchLimitCount);
+	}
+
+	return (Node *) MakeIntegerConstInt64(workerLimitCount);
+}
+
+
+/*
+ * AddLimitOffset adds the value of the given offset clause, if any, to the given
+ * limit count. If the sum doesn't fit into an int64, the function returns the
+ * largest int64 value instead, which still asks for all remaining rows.
+ */
+static int64
+AddLimitOffset(int64 limitCount, Node *limitOffset)
+{
+	Const *limitOffsetConst = (Const *) limitOffset;
+	int64 offsetCount = 0;
+
+	if (limitOffsetConst == NULL || limitOffsetConst->constisnull)
+	{
+		return limitCount;
+	}
+
+	offsetCount = DatumGetInt64(limitOffsetConst->constvalue);
+	if (offsetCount > 0 && limitCount > PG_INT64_MAX - offsetCount)
+	{
+		return PG_INT64_MAX;
+	}
+
+	return limitCount + offsetCount;
+}
+
+
 /*
  * WorkerSortClauseList first checks if the given extended node contains a limit
  * that can be pushed down. If it does, the function then checks if we need to
  * add any sorting and grouping clauses to the sort list we push down for the
  * limit. If we do, the function adds these clauses and returns them. Otherwise,
- * the function returns null.
+ * the function returns null. Worker nodes that compute distinct on clauses also
+ * need the original sort clauses, as these pick the first row of each group.
  */
 static List *
-WorkerSortClauseList(MultiExtendedOp *originalOpNode)
+WorkerSortClauseList(MultiExtendedOp *originalOpNode, bool pushDownGrouping)
 {
 	List *workerSortClauseList = NIL;
 	List *groupClauseList = originalOpNode->groupClauseList;
 	List *sortClauseList = originalOpNode->sortClauseList;
 	List *targetList = originalOpNode->targetList;
 
-	/* if no limit node, no need to push down sort clauses */
+	if (pushDownGrouping && originalOpNode->hasDistinctOn)
+	{
+		return originalOpNode->sortClauseList;
+	}
+
+	/*
+	 * If no limit node, we only push down sort clauses if the master node can
+	 * then merge the sorted task results, instead of sorting all of them.
+	 */
 	if (originalOpNode->limitCount == NULL)
 	{
-		return NIL;
+		if (CanMergeSortedTaskResults(originalOpNode, pushDownGrouping))
+		{
+			workerSortClauseList = originalOpNode->sortClauseList;
+		}
+
+		return workerSortClauseList;
 	}
 
 	/*
@@ -4486,9 +5139,10 @@ WorkerSortClauseList(MultiExtendedOp *originalOpNode)
 	 * aggregates, add group by clauses to the order by list. We do this because
 	 * rows that belong to the same grouping may appear in different "offsets"
 	 * in different task results. By ordering on the group by clause, we ensure
-	 * that query results are consistent.
+	 * that query results are consistent. If worker nodes compute the groups
+	 * fully, the original order by clauses are enough.
 	 */
-	if (groupClauseList == NIL)
+	if (groupClauseList == NIL || pushDownGrouping)
 	{
 		workerSortClauseList = originalOpNode->sortClauseList;
 	}
@@ -4512,11 +5166,60 @@ WorkerSortClauseList(MultiExtendedOp *originalOpNode)
 }
 
 
+/*
+ * CanMergeSortedTaskResults checks if the master node can produce the results of
+ * the given extended node by merging sorted task results. This is the case when
+ * the user enabled sorted merges, and the query orders plain rows; that is, it
+ * has order by clauses, but neither aggregates nor group by clauses, or worker
+ * nodes compute its groups fully. We also don't sort results of subqueries that
+ * are repartitioned, as those results are fed into another job instead of the
+ * master node.
+ */
+static bool
+CanMergeSortedTaskResults(MultiExtendedOp *originalOpNode, bool pushDownGrouping)
+{
+	MultiNode *parentNode = ParentNode((MultiNode *) originalOpNode);
+
+	if (!EnableSortedMerge)
+	{
+		return false;
+	}
+
+	if (!CitusIsA(parentNode, MultiTreeRoot))
+	{
+		return false;
+	}
+
+	if (originalOpNode->sortClauseList == NIL)
+	{
+		return false;
+	}
+
+	if (pushDownGrouping)
+	{
+		return true;
+	}
+
+	if (originalOpNode->groupClauseList != NIL || originalOpNode->havingQual != NULL)
+	{
+		return false;
+	}
+
+	if (contain_agg_clause((Node *) originalOpNode->targetList))
+	{
+		return false;
+	}
+
+	return true;
+}
+
+
 /*
  * CanPushDownLimitApproximate checks if we can push down the limit clause to
  * the worker nodes, and get approximate and meaningful results. We can do this
- * only when: (1) the user has enabled the limit approximation and (2) the query
- * has order by clauses that are commutative.
+ * only when: (1) the user has enabled the limit approximation, either with a
+ * fixed row count or with an overfetch factor, and (2) the query has order by
+ * clauses that are commutative.
  */
 static bool
 CanPushDownLimitApproximate(List *sortClauseList, List *targetList)
@@ -4524,7 +5227,8 @@ CanPushDownLimitApproximate(List *sortClauseList, List *targetList)
 	bool canApproximate = false;
 
 	/* user hasn't enabled the limit approximation */
-	if (LimitClauseRowFetchCount == DISABLE_LIMIT_APPROXIMATION)
+	if (LimitClauseRowFetchCount == DISABLE_LIMIT_APPROXIMATION &&
+		LimitClauseOverfetchFactor == DISABLE_LIMIT_OVERFETCH)
 	{
 		return false;
 	}
@@ -4577,7 +5281,8 @@ HasOrderByAggregate(List *sortClauseList, List *targetList)
 
 /*
  * HasOrderByAverage walks over the given order by clauses, and checks if we
- * have an order by an average. If we do, the function returns true.
+ * have an order by an average, or by another aggregate that worker nodes only
+ * compute partially. If we do, the function returns true.
  */
 static bool
 HasOrderByAverage(List *sortClauseList, List *targetList)
@@ -4596,7 +5301,9 @@ HasOrderByAverage(List *sortClauseList, List *targetList)
 			Aggref *aggregate = (Aggref *) sortExpression;
 
 			AggregateType aggregateType = GetAggregateType(aggregate->aggfnoid);
-			if (aggregateType == AGGREGATE_AVERAGE)
+			if (aggregateType == AGGREGATE_AVERAGE ||
+				aggregateType == AGGREGATE_PERCENTILE_CONT ||
+				aggregateType == AGGREGATE_CUSTOM_COMBINE)
 			{
 				hasOrderByAverage = true;
 				break;
@@ -385,13 +385,6 @@ ErrorIfQueryNotSupported(Query *queryTree)
 		errorHint = filterHint;
 	}
 
-	if (queryTree->hasWindowFuncs)
-	{
-		preconditionsSatisfied = false;
-		errorMessage = "could not run distributed query with window functions";
-		errorHint = filterHint;
-	}
-
 	if (queryTree->setOperations)
 	{
 		preconditionsSatisfied = false;
@@ -421,13 +414,6 @@ ErrorIfQueryNotSupported(Query *queryTree)
 		errorHint = filterHint;
 	}
 
-	if (queryTree->distinctClause)
-	{
-		preconditionsSatisfied = false;
-		errorMessage = "could not run distributed query with DISTINCT clause";
-		errorHint = filterHint;
-	}
-
 	if (queryTree->groupingSets)
 	{
 		preconditionsSatisfied = false;
@@ -630,6 +616,18 @@ ErrorIfSubqueryNotSupported(Query *subqueryTree)
 		errorDetail = "Subqueries with offset are not supported yet";
 	}
 
+	if (subqueryTree->distinctClause != NIL)
+	{
+		preconditionsSatisfied = false;
+		errorDetail = "Subqueries with distinct clause are not supported yet";
+	}
+
+	if (subqueryTree->hasWindowFuncs)
+	{
+		preconditionsSatisfied = false;
+		errorDetail = "Subqueries with window functions are not supported yet";
+	}
+
 	/* finally check and error out if not satisfied */
 	if (!preconditionsSatisfied)
 	{
@@ -1392,6 +1390,9 @@ MultiExtendedOpNode(Query *queryTree)
 	extendedOpNode->limitCount = queryTree->limitCount;
 	extendedOpNode->limitOffset = queryTree->limitOffset;
 	extendedOpNode->havingQual = queryTree->havingQual;
+	extendedOpNode->distinctClause = queryTree->distinctClause;
+	extendedOpNode->hasDistinctOn = queryTree->hasDistinctOn;
+	extendedOpNode->windowClause = queryTree->windowClause;
 
 	return extendedOpNode;
 }
@@ -1684,7 +1685,8 @@ pull_var_clause_default(Node *node)
 	 * PVC_REJECT_PLACEHOLDERS is now implicit if PVC_INCLUDE_PLACEHOLDERS
 	 * isn't specified.
 	 */
-	List *columnList = pull_var_clause(node, PVC_RECURSE_AGGREGATES);
+	List *columnList = pull_var_clause(node, PVC_RECURSE_AGGREGATES |
+									   PVC_RECURSE_WINDOWFUNCS);
 #else
 	List *columnList = pull_var_clause(node, PVC_RECURSE_AGGREGATES,
 									   PVC_REJECT_PLACEHOLDERS);
@@ -13,6 +13,10 @@
 
 #include "postgres.h"
 
+#include "access/htup_details.h"
+#include "catalog/pg_aggregate.h"
+#include "catalog/pg_proc.h"
+#include "catalog/pg_type.h"
 #include "distributed/multi_master_planner.h"
 #include "distributed/multi_physical_planner.h"
 #include "distributed/multi_planner.h"
@@ -21,15 +25,51 @@
 #include "nodes/makefuncs.h"
 #include "nodes/nodeFuncs.h"
 #include "optimizer/clauses.h"
+#include "optimizer/cost.h"
 #include "optimizer/planmain.h"
 #include "optimizer/tlist.h"
 #include "optimizer/var.h"
 #include "utils/builtins.h"
+#include "utils/lsyscache.h"
 #include "utils/memutils.h"
 #include "utils/rel.h"
 #include "utils/syscache.h"
 
 
+/* Config variable managed via guc.c */
+int MaxMasterParallelWorkers = 0; /* parallel workers for master aggregation */
+
+
+#if (PG_VERSION_NUM >= 90600)
+
+/*
+ * ParallelAggregateContext keeps the expressions that the partial aggregation
+ * computes for a parallel master aggregation, and how the final aggregation
+ * refers to them.
+ */
+typedef struct ParallelAggregateContext
+{
+	List *scanTargetList;
+	List *partialTargetList;
+	AttrNumber *partialColumnIdArray;   /* partial column for each scan column */
+	List *aggregateList;
+	List *finalAggregateList;
+} ParallelAggregateContext;
+
+
+/* local function forward declarations */
+static Plan * BuildParallelAggregatePlan(Query *masterQuery, CustomScan *remoteScan);
+static bool AddPartialColumn(ParallelAggregateContext *context, Var *column);
+static bool AddPartialAggregate(ParallelAggregateContext *context, Aggref *aggregate);
+static bool AggregateSupportsPartialMode(Aggref *aggregate, Oid *transitionTypeId);
+static Node * FinalAggregateExpressionMutator(Node *node,
+											  ParallelAggregateContext *context);
+static Gather * BuildGatherPlan(Plan *subPlan, int workerCount);
+static void AssignPlanNodeIds(Plan *plan, int *lastPlanNodeId);
+
+#endif
+
+
 /*
  * MasterTargetList uses the given worker target list's expressions, and creates
  * a target target list for the master node. This master target list keeps the
@@ -163,14 +203,438 @@ BuildAggregatePlan(Query *masterQuery, Plan *subPlan)
 }
 
 
+#if (PG_VERSION_NUM >= 90600)
+
+/*
+ * BuildParallelAggregatePlan tries to build an aggregate plan that runs the
+ * master aggregation with PostgreSQL's parallel workers. Each worker computes
+ * partial aggregates over part of the task results, a Gather node collects the
+ * partial aggregates, and a final aggregate plan combines them:
+ *
+ *   Agg (final) -> Gather -> Agg (partial) -> Custom Scan (parallel aware)
+ *
+ * The function returns NULL if parallel master aggregation is disabled, or if
+ * the master query's aggregates can't be computed in partial mode; the caller
+ * then builds a regular aggregate plan. Unlike BuildAggregatePlan, the function
+ * doesn't modify the master query.
+ */
+static Plan *
+BuildParallelAggregatePlan(Query *masterQuery, CustomScan *remoteScan)
+{
+	Plan *scanPlan = &remoteScan->scan.plan;
+	List *targetList = copyObject(masterQuery->targetList);
+	Node *havingQual = copyObject(masterQuery->havingQual);
+	List *groupClauseList = masterQuery->groupClause;
+	int groupColumnCount = list_length(groupClauseList);
+	int scanColumnCount = list_length(scanPlan->targetlist);
+	int workerCount = Min(MaxMasterParallelWorkers, max_parallel_workers_per_gather);
+	AggStrategy aggregateStrategy = AGG_PLAIN;
+	AttrNumber *partialGroupColumnIdArray = NULL;
+	AttrNumber *finalGroupColumnIdArray = NULL;
+	Oid *groupColumnOpArray = NULL;
+	ParallelAggregateContext context;
+	List *nodeList = NIL;
+	ListCell *nodeCell = NULL;
+	ListCell *groupClauseCell = NULL;
+	List *finalTargetList = NIL;
+	Node *finalHavingQual = NULL;
+	Agg *partialAggregatePlan = NULL;
+	Gather *gatherPlan = NULL;
+	Agg *finalAggregatePlan = NULL;
+	const long rowEstimate = 10;
+
+	if (workerCount <= 0)
+	{
+		return NULL;
+	}
+
+	/*
+	 * The master query's expressions are evaluated in parallel mode, so they
+	 * must not use parallel unsafe functions. Below, we also check that the
+	 * partial aggregation can run in parallel workers.
+	 */
+	if (has_parallel_hazard((Node *) targetList, true) ||
+		has_parallel_hazard(havingQual, true))
+	{
+		return NULL;
+	}
+
+	if (groupColumnCount > 0)
+	{
+		if (!grouping_is_hashable(groupClauseList))
+		{
+			return NULL;
+		}
+
+		aggregateStrategy = AGG_HASHED;
+	}
+
+	memset(&context, 0, sizeof(ParallelAggregateContext));
+	context.scanTargetList = scanPlan->targetlist;
+	context.partialColumnIdArray = palloc0((scanColumnCount + 1) * sizeof(AttrNumber));
+
+	/* the partial aggregation outputs the group columns first */
+	foreach(groupClauseCell, groupClauseList)
+	{
+		SortGroupClause *groupClause = (SortGroupClause *) lfirst(groupClauseCell);
+		TargetEntry *scanTargetEntry = get_sortgroupclause_tle(groupClause,
+															   scanPlan->targetlist);
+		Var *groupColumn = makeVarFromTargetEntry(OUTER_VAR, scanTargetEntry);
+
+		AddPartialColumn(&context, groupColumn);
+	}
+
+	/* then, the other columns and the aggregates that the master query uses */
+	nodeList = list_concat(pull_var_clause((Node *) targetList,
+										   PVC_INCLUDE_AGGREGATES),
+						   pull_var_clause(havingQual, PVC_INCLUDE_AGGREGATES));
+
+	foreach(nodeCell, nodeList)
+	{
+		Node *node = (Node *) lfirst(nodeCell);
+		bool added = false;
+
+		if (IsA(node, Var))
+		{
+			added = AddPartialColumn(&context, (Var *) node);
+		}
+		else if (IsA(node, Aggref))
+		{
+			added = AddPartialAggregate(&context, (Aggref *) node);
+		}
+
+		if (!added)
+		{
+			return NULL;
+		}
+	}
+
+	if (has_parallel_hazard((Node *) context.partialTargetList, false))
+	{
+		return NULL;
+	}
+
+	finalTargetList = (List *) FinalAggregateExpressionMutator((Node *) targetList,
+															   &context);
+	finalHavingQual = FinalAggregateExpressionMutator(havingQual, &context);
+
+	if (groupColumnCount > 0)
+	{
+		partialGroupColumnIdArray = extract_grouping_cols(groupClauseList,
+														  scanPlan->targetlist);
+		groupColumnOpArray = extract_grouping_ops(groupClauseList);
+	}
+
+	partialAggregatePlan = make_agg(context.partialTargetList, NIL, aggregateStrategy,
+									AGGSPLIT_INITIAL_SERIAL, groupColumnCount,
+									partialGroupColumnIdArray, groupColumnOpArray,
+									NIL, NIL, rowEstimate, scanPlan);
+
+	gatherPlan = BuildGatherPlan((Plan *) partialAggregatePlan, workerCount);
+
+	if (groupColumnCount > 0)
+	{
+		finalGroupColumnIdArray = extract_grouping_cols(groupClauseList,
+														gatherPlan->plan.targetlist);
+	}
+
+	finalAggregatePlan = make_agg(finalTargetList, (List *) finalHavingQual,
+								  aggregateStrategy, AGGSPLIT_FINAL_DESERIAL,
+								  groupColumnCount, finalGroupColumnIdArray,
+								  groupColumnOpArray, NIL, NIL, rowEstimate,
+								  (Plan *) gatherPlan);
+
+	/* parallel workers split the task results between them */
+	scanPlan->parallel_aware = true;
+
+	/* just for reproducible costs between different PostgreSQL versions */
+	partialAggregatePlan->plan.startup_cost = 0;
+	partialAggregatePlan->plan.total_cost = 0;
+	partialAggregatePlan->plan.plan_rows = 0;
+	finalAggregatePlan->plan.startup_cost = 0;
+	finalAggregatePlan->plan.total_cost = 0;
+	finalAggregatePlan->plan.plan_rows = 0;
+
+	return (Plan *) finalAggregatePlan;
+}
+
+
+/*
+ * AddPartialColumn adds the scan column that the given column refers to to
+ * the output of the partial aggregation, unless the column is already there.
+ * The partial aggregation passes these columns through to the final one.
+ */
+static bool
+AddPartialColumn(ParallelAggregateContext *context, Var *column)
+{
+	AttrNumber scanColumnId = column->varattno;
+	TargetEntry *scanTargetEntry = NULL;
+	TargetEntry *partialTargetEntry = NULL;
+	Var *partialColumn = NULL;
+	AttrNumber partialColumnId = 0;
+
+	if (scanColumnId <= 0 || scanColumnId > list_length(context->scanTargetList))
+	{
+		return false;
+	}
+
+	if (context->partialColumnIdArray[scanColumnId] != 0)
+	{
+		return true;
+	}
+
+	scanTargetEntry = (TargetEntry *) list_nth(context->scanTargetList, scanColumnId - 1);
+	partialColumnId = list_length(context->partialTargetList) + 1;
+
+	partialColumn = copyObject(column);
+	partialColumn->varno = OUTER_VAR;
+
+	partialTargetEntry = makeTargetEntry((Expr *) partialColumn, partialColumnId,
+										 scanTargetEntry->resname, false);
+	partialTargetEntry->ressortgroupref = scanTargetEntry->ressortgroupref;
+
+	context->partialTargetList = lappend(context->partialTargetList, partialTargetEntry);
+	context->partialColumnIdArray[scanColumnId] = partialColumnId;
+
+	return true;
+}
+
+
+/*
+ * AddPartialAggregate adds the partial form of the given aggregate to the
+ * output of the partial aggregation, and builds the final form that combines
+ * the partial aggregates. If the aggregate can't be computed in partial mode,
+ * the function returns false.
+ */
+static bool
+AddPartialAggregate(ParallelAggregateContext *context, Aggref *aggregate)
+{
+	Aggref *partialAggregate = NULL;
+	Aggref *finalAggregate = NULL;
+	Var *partialColumn = NULL;
+	TargetEntry *partialTargetEntry = NULL;
+	AttrNumber partialColumnId = 0;
+	Oid transitionTypeId = InvalidOid;
+	List *partialColumnList = NIL;
+	ListCell *partialColumnCell = NULL;
+
+	if (list_member(context->aggregateList, aggregate))
+	{
+		return true;
+	}
+
+	if (!AggregateSupportsPartialMode(aggregate, &transitionTypeId))
+	{
+		return false;
+	}
+
+	/* the partial aggregate reads its arguments from the custom scan */
+	partialAggregate = copyObject(aggregate);
+	partialAggregate->aggsplit = AGGSPLIT_INITIAL_SERIAL;
+	partialAggregate->aggtranstype = transitionTypeId;
+	partialAggregate->aggtype = transitionTypeId;
+
+	/* internal transition values are serialized to pass them between processes */
+	if (transitionTypeId == INTERNALOID)
+	{
+		partialAggregate->aggtype = BYTEAOID;
+	}
+
+	partialColumnList = pull_var_clause((Node *) partialAggregate,
+										PVC_RECURSE_AGGREGATES);
+	foreach(partialColumnCell, partialColumnList)
+	{
+		Var *column = (Var *) lfirst(partialColumnCell);
+		column->varno = OUTER_VAR;
+	}
+
+	partialColumnId = list_length(context->partialTargetList) + 1;
+	partialTargetEntry = makeTargetEntry((Expr *) partialAggregate, partialColumnId,
+										 NULL, false);
+	context->partialTargetList = lappend(context->partialTargetList, partialTargetEntry);
+
+	/* the final aggregate combines the partial aggregates passed up by Gather */
+	partialColumn = makeVar(OUTER_VAR, partialColumnId, partialAggregate->aggtype, -1,
+							InvalidOid, 0);
+
+	finalAggregate = copyObject(aggregate);
+	finalAggregate->args = list_make1(makeTargetEntry((Expr *) partialColumn, 1, NULL,
+													  false));
+	finalAggregate->aggfilter = NULL;
+	finalAggregate->aggsplit = AGGSPLIT_FINAL_DESERIAL;
+	finalAggregate->aggtranstype = transitionTypeId;
+
+	context->aggregateList = lappend(context->aggregateList, aggregate);
+	context->finalAggregateList = lappend(context->finalAggregateList, finalAggregate);
+
+	return true;
+}
+
+
+/*
+ * AggregateSupportsPartialMode returns whether the given aggregate can be
+ * computed in partial mode, and combined afterwards. This requires a parallel
+ * safe aggregate with a combine function, and, if its transition type is
+ * internal, with serialization functions. We don't handle ordered aggregates
+ * and polymorphic transition types. The function also returns the aggregate's
+ * transition type.
+ */
+static bool
+AggregateSupportsPartialMode(Aggref *aggregate, Oid *transitionTypeId)
+{
+	HeapTuple aggregateTuple = NULL;
+	Form_pg_aggregate aggregateForm = NULL;
+	bool supportsPartialMode = true;
+
+	if (aggregate->aggorder != NIL || aggregate->aggdistinct != NIL ||
+		aggregate->aggdirectargs != NIL || aggregate->aggkind != AGGKIND_NORMAL)
+	{
+		return false;
+	}
+
+	if (func_parallel(aggregate->aggfnoid) != PROPARALLEL_SAFE)
+	{
+		return false;
+	}
+
+	aggregateTuple = SearchSysCache1(AGGFNOID, ObjectIdGetDatum(aggregate->aggfnoid));
+	if (!HeapTupleIsValid(aggregateTuple))
+	{
+		elog(ERROR, "cache lookup failed for aggregate %u", aggregate->aggfnoid);
+	}
+
+	aggregateForm = (Form_pg_aggregate) GETSTRUCT(aggregateTuple);
+	*transitionTypeId = aggregateForm->aggtranstype;
+
+	if (!OidIsValid(aggregateForm->aggcombinefn) ||
+		IsPolymorphicType(aggregateForm->aggtranstype))
+	{
+		supportsPartialMode = false;
+	}
+	else if (aggregateForm->aggtranstype == INTERNALOID &&
+			 (!OidIsValid(aggregateForm->aggserialfn) ||
+			  !OidIsValid(aggregateForm->aggdeserialfn)))
+	{
+		supportsPartialMode = false;
+	}
+
+	ReleaseSysCache(aggregateTuple);
+
+	return supportsPartialMode;
+}
+
+
+/*
+ * FinalAggregateExpressionMutator rewrites the given master query expression
+ * for the final aggregation. It replaces aggregates with their final forms, and
+ * columns with references to the corresponding partial aggregation columns.
+ */
+static Node *
+FinalAggregateExpressionMutator(Node *node, ParallelAggregateContext *context)
+{
+	if (node == NULL)
+	{
+		return NULL;
+	}
+
+	if (IsA(node, Aggref))
+	{
+		ListCell *aggregateCell = NULL;
+		ListCell *finalAggregateCell = NULL;
+
+		forboth(aggregateCell, context->aggregateList,
+				finalAggregateCell, context->finalAggregateList)
+		{
+			if (equal(node, lfirst(aggregateCell)))
+			{
+				return copyObject(lfirst(finalAggregateCell));
+			}
+		}
+
+		elog(ERROR, "aggregate not found in partial aggregation");
+	}
+
+	if (IsA(node, Var))
+	{
+		Var *column = (Var *) copyObject(node);
+
+		column->varno = OUTER_VAR;
+		column->varattno = context->partialColumnIdArray[column->varattno];
+
+		return (Node *) column;
+	}
+
+	return expression_tree_mutator(node, FinalAggregateExpressionMutator,
+								   (void *) context);
+}
+
+
+/*
+ * BuildGatherPlan creates a Gather plan that runs the given plan in the given
+ * number of parallel workers, and passes up the plan's output as is.
+ */
+static Gather *
+BuildGatherPlan(Plan *subPlan, int workerCount)
+{
+	Gather *gatherPlan = makeNode(Gather);
+	List *gatherTargetList = NIL;
+	ListCell *targetEntryCell = NULL;
+
+	foreach(targetEntryCell, subPlan->targetlist)
+	{
+		TargetEntry *targetEntry = (TargetEntry *) lfirst(targetEntryCell);
+		TargetEntry *gatherTargetEntry = flatCopyTargetEntry(targetEntry);
+		Var *gatherColumn = makeVarFromTargetEntry(OUTER_VAR, targetEntry);
+
+		gatherTargetEntry->expr = (Expr *) gatherColumn;
+		gatherTargetList = lappend(gatherTargetList, gatherTargetEntry);
+	}
+
+	gatherPlan->plan.targetlist = gatherTargetList;
+	gatherPlan->plan.lefttree = subPlan;
+	gatherPlan->num_workers = workerCount;
+	gatherPlan->single_copy = false;
+	gatherPlan->invisible = false;
+
+	return gatherPlan;
+}
+
+
+/*
+ * AssignPlanNodeIds gives each node in the given plan tree a unique id, the way
+ * set_plan_references() does for plans that PostgreSQL builds. Parallel query
+ * identifies the nodes below a Gather node by these ids, so we assign them once
+ * the master plan is complete.
+ */
+static void
+AssignPlanNodeIds(Plan *plan, int *lastPlanNodeId)
+{
+	if (plan == NULL)
+	{
+		return;
+	}
+
+	plan->plan_node_id = (*lastPlanNodeId)++;
+
+	AssignPlanNodeIds(plan->lefttree, lastPlanNodeId);
+	AssignPlanNodeIds(plan->righttree, lastPlanNodeId);
+}
+
+
+#endif
+
+
 /*
  * BuildSelectStatement builds the final select statement to run on the master
  * node, before returning results to the user. The function first gets the custom
  * scan node for all results fetched to the master, and layers aggregation, sort
- * and limit plans on top of the scan statement if necessary.
+ * and limit plans on top of the scan statement if necessary. If the custom scan
+ * merges sorted task results, the results are already in order, and we don't
+ * add a sort plan.
  */
 static PlannedStmt *
-BuildSelectStatement(Query *masterQuery, List *masterTargetList, CustomScan *remoteScan)
+BuildSelectStatement(Query *masterQuery, List *masterTargetList, CustomScan *remoteScan,
+					 bool sortedMerge)
 {
 	PlannedStmt *selectStatement = NULL;
 	RangeTblEntry *customScanRangeTableEntry = NULL;
@@ -205,8 +669,16 @@ BuildSelectStatement(Query *masterQuery, List *masterTargetList, CustomScan *rem
 	{
 		remoteScan->scan.plan.targetlist = masterTargetList;
 
-		aggregationPlan = BuildAggregatePlan(masterQuery, &remoteScan->scan.plan);
-		topLevelPlan = (Plan *) aggregationPlan;
+#if (PG_VERSION_NUM >= 90600)
+		topLevelPlan = BuildParallelAggregatePlan(masterQuery, remoteScan);
+		selectStatement->parallelModeNeeded = (topLevelPlan != NULL);
+#endif
+
+		if (topLevelPlan == NULL)
+		{
+			aggregationPlan = BuildAggregatePlan(masterQuery, &remoteScan->scan.plan);
+			topLevelPlan = (Plan *) aggregationPlan;
+		}
 	}
 	else
 	{
@@ -216,7 +688,7 @@ BuildSelectStatement(Query *masterQuery, List *masterTargetList, CustomScan *rem
 	}
 
 	/* (3) add a sorting plan if needed */
-	if (masterQuery->sortClause)
+	if (masterQuery->sortClause && !sortedMerge)
 	{
 		List *sortClauseList = masterQuery->sortClause;
 #if (PG_VERSION_NUM >= 90600)
@@ -253,6 +725,15 @@ BuildSelectStatement(Query *masterQuery, List *masterTargetList, CustomScan *rem
 	/* (5) finally set our top level plan in the plan tree */
 	selectStatement->planTree = topLevelPlan;
 
+#if (PG_VERSION_NUM >= 90600)
+	if (selectStatement->parallelModeNeeded)
+	{
+		int lastPlanNodeId = 0;
+
+		AssignPlanNodeIds(topLevelPlan, &lastPlanNodeId);
+	}
+#endif
+
 	return selectStatement;
 }
 
@@ -275,7 +756,8 @@ MasterNodeSelectPlan(MultiPlan *multiPlan, CustomScan *remoteScan)
 	List *workerTargetList = workerJob->jobQuery->targetList;
 	List *masterTargetList = MasterTargetList(workerTargetList);
 
-	masterSelectPlan = BuildSelectStatement(masterQuery, masterTargetList, remoteScan);
+	masterSelectPlan = BuildSelectStatement(masterQuery, masterTargetList, remoteScan,
+											multiPlan->sortedMerge);
 
 	return masterSelectPlan;
 }
@@ -23,6 +23,7 @@
 #include "access/nbtree.h"
 #include "access/skey.h"
 #include "catalog/pg_am.h"
+#include "catalog/pg_collation.h"
 #include "catalog/pg_operator.h"
 #include "catalog/pg_type.h"
 #include "commands/defrem.h"
@@ -48,9 +49,11 @@
 #include "optimizer/clauses.h"
 #include "optimizer/predtest.h"
 #include "optimizer/restrictinfo.h"
+#include "optimizer/tlist.h"
 #include "optimizer/var.h"
 #include "parser/parse_relation.h"
 #include "parser/parsetree.h"
+#include "utils/array.h"
 #include "utils/builtins.h"
 #include "utils/catcache.h"
 #include "utils/fmgroids.h"
@@ -73,6 +76,37 @@ int TaskAssignmentPolicy = TASK_ASSIGNMENT_GREEDY;
 static List *OperatorCache = NIL;
 
 
+/*
+ * TaskQueryTemplate holds the query string of a job, deparsed once with a
+ * placeholder in place of the name of each table fragment and split around
+ * these placeholders. The query string of a task is then built by putting the
+ * names of the task's fragments in between the parts, which is much cheaper
+ * than deparsing the query once per task.
+ */
+typedef struct TaskQueryTemplate
+{
+	List *stringPartList;   /* query string parts around the fragment names */
+	List *rangeTableIdList; /* range table ids of fragment names, in order */
+	List *schemaNameList;   /* schema names of fragment names, NULL for public */
+	List *relationNameList; /* relation names of fragment names, in order */
+} TaskQueryTemplate;
+
+
+/*
+ * PartitionColumnBounds holds the range of partition column values allowed by
+ * restriction clauses that compare the partition column with a constant.
+ */
+typedef struct PartitionColumnBounds
+{
+	bool hasLowerBound;
+	bool lowerBoundInclusive;
+	Datum lowerBound;
+	bool hasUpperBound;
+	bool upperBoundInclusive;
+	Datum upperBound;
+} PartitionColumnBounds;
+
+
 /* Local functions forward declarations for job creation */
 static Job * BuildJobTree(MultiTreeRoot *multiTree);
 static MultiNode * LeftMostNode(MultiTreeRoot *multiTree);
@@ -118,6 +152,7 @@ static ArrayType * SplitPointObject(ShardInterval **shardIntervalArray,
 
 /* Local functions forward declarations for task list creation and helper functions */
 static bool MultiPlanRouterExecutable(MultiPlan *multiPlan);
+static bool MultiPlanSortedMerge(MultiPlan *multiPlan);
 static Job * BuildJobTreeTaskList(Job *jobTree);
 static List * SubquerySqlTaskList(Job *job);
 static List * SqlTaskList(Job *job);
@@ -128,10 +163,40 @@ static List * AnchorRangeTableIdList(List *rangeTableList, List *baseRangeTableI
 static void AdjustColumnOldAttributes(List *expressionList);
 static List * RangeTableFragmentsList(List *rangeTableList, List *whereClauseList,
 									  List *dependedJobList);
+static List * PruneRangeShardList(Oid relationId, Var *partitionColumn,
+								  List *whereClauseList, List *restrictInfoList,
+								  List *shardIntervalList, List **removedShardList);
+static List * ExtractPartitionColumnBounds(List *whereClauseList, Var *partitionColumn,
+										   FmgrInfo *compareFunction,
+										   PartitionColumnBounds *bounds);
+static void UpdateLowerBound(PartitionColumnBounds *bounds, Datum value,
+							 bool inclusive, FmgrInfo *compareFunction);
+static void UpdateUpperBound(PartitionColumnBounds *bounds, Datum value,
+							 bool inclusive, FmgrInfo *compareFunction);
+static bool SatisfiesLowerBound(Datum value, PartitionColumnBounds *bounds,
+								FmgrInfo *compareFunction);
+static bool SatisfiesUpperBound(Datum value, PartitionColumnBounds *bounds,
+								FmgrInfo *compareFunction);
+static List * PruneSortedShardIntervalArray(DistTableCacheEntry *cacheEntry,
+											PartitionColumnBounds *bounds,
+											Var *partitionColumn,
+											List *restrictInfoList,
+											bool checkResidualClauses,
+											List **removedShardList);
+static void AppendRemovedShardInterval(List **removedShardList,
+									   ShardInterval *shardInterval);
+static int LowerBoundShardIndex(ShardInterval **sortedShardIntervalArray,
+								int shardCount, PartitionColumnBounds *bounds,
+								FmgrInfo *compareFunction);
+static int UpperBoundShardIndex(ShardInterval **sortedShardIntervalArray,
+								int shardCount, PartitionColumnBounds *bounds,
+								FmgrInfo *compareFunction);
+static bool NeedsPredicateRefutation(List *clauseList, Var *partitionColumn);
 static OperatorCacheEntry * LookupOperatorByType(Oid typeId, Oid accessMethodId,
 												 int16 strategyNumber);
 static Oid GetOperatorByType(Oid typeId, Oid accessMethodId, int16 strategyNumber);
 static Node * HashableClauseMutator(Node *originalNode, Var *partitionColumn);
+static Node * HashedArrayOperatorExpression(ScalarArrayOpExpr *arrayOperatorExpression);
 static OpExpr * MakeHashedOperatorExpression(OpExpr *operatorExpression);
 static List * BuildRestrictInfoList(List *qualList);
 static List * FragmentCombinationList(List *rangeTableFragmentsList, Query *jobQuery,
@@ -153,6 +218,10 @@ static StringInfo DatumArrayString(Datum *datumArray, uint32 datumCount, Oid dat
 static void UpdateRangeTableAlias(List *rangeTableList, List *fragmentList);
 static Alias * FragmentAlias(RangeTblEntry *rangeTableEntry,
 							 RangeTableFragment *fragment);
+static TaskQueryTemplate * BuildTaskQueryTemplate(Query *templateQuery,
+												  List *templateRangeTableList,
+												  List *fragmentList);
+static char * TaskQueryString(TaskQueryTemplate *queryTemplate, List *fragmentList);
 static uint64 AnchorShardId(List *fragmentList, uint32 anchorRangeTableId);
 static List * PruneSqlTaskDependencies(List *sqlTaskList);
 static List * AssignTaskList(List *sqlTaskList);
@@ -214,6 +283,7 @@ MultiPhysicalPlanCreate(MultiTreeRoot *multiTree)
 	multiPlan->workerJob = workerJob;
 	multiPlan->masterQuery = masterQuery;
 	multiPlan->routerExecutable = MultiPlanRouterExecutable(multiPlan);
+	multiPlan->sortedMerge = MultiPlanSortedMerge(multiPlan);
 	multiPlan->operation = CMD_SELECT;
 
 	return multiPlan;
@@ -280,6 +350,81 @@ MultiPlanRouterExecutable(MultiPlan *multiPlan)
 }
 
 
+/*
+ * MultiPlanSortedMerge returns true if the tasks of the input multiPlan return
+ * their results sorted the same way as the master query, and the master query
+ * doesn't aggregate them. In that case, the master node only needs to merge
+ * the sorted task results, which is cheaper than sorting them all over again.
+ */
+static bool
+MultiPlanSortedMerge(MultiPlan *multiPlan)
+{
+	Query *masterQuery = multiPlan->masterQuery;
+	Query *workerQuery = multiPlan->workerJob->jobQuery;
+	List *masterSortClauseList = masterQuery->sortClause;
+	List *workerSortClauseList = workerQuery->sortClause;
+	ListCell *masterSortClauseCell = NULL;
+	ListCell *workerSortClauseCell = NULL;
+
+	if (!EnableSortedMerge)
+	{
+		return false;
+	}
+
+	if (masterSortClauseList == NIL || masterQuery->hasAggs ||
+		masterQuery->groupClause != NIL)
+	{
+		return false;
+	}
+
+	if (list_length(workerSortClauseList) < list_length(masterSortClauseList))
+	{
+		return false;
+	}
+
+	/* merging keeps a file open for each task, so sort on the master above this */
+	if (list_length(multiPlan->workerJob->taskList) > MAX_SORTED_MERGE_TASK_COUNT)
+	{
+		return false;
+	}
+
+	/* each master sort key needs to be the same sort key on the same worker column */
+	forboth(masterSortClauseCell, masterSortClauseList,
+			workerSortClauseCell, workerSortClauseList)
+	{
+		SortGroupClause *masterSortClause = lfirst(masterSortClauseCell);
+		SortGroupClause *workerSortClause = lfirst(workerSortClauseCell);
+		TargetEntry *masterTargetEntry = NULL;
+		TargetEntry *workerTargetEntry = NULL;
+		Var *masterColumn = NULL;
+
+		if (masterSortClause->sortop != workerSortClause->sortop ||
+			masterSortClause->nulls_first != workerSortClause->nulls_first)
+		{
+			return false;
+		}
+
+		masterTargetEntry = get_sortgroupclause_tle(masterSortClause,
+													masterQuery->targetList);
+		workerTargetEntry = get_sortgroupclause_tle(workerSortClause,
+													workerQuery->targetList);
+
+		if (!IsA(masterTargetEntry->expr, Var))
+		{
+			return false;
+		}
+
+		masterColumn = (Var *) masterTargetEntry->expr;
+		if (masterColumn->varattno != workerTargetEntry->resno)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
 /*
  * BuildJobTree builds the physical job tree from the given logical plan tree.
  * The function walks over the logical plan from the bottom up, finds boundaries
@@ -567,6 +712,9 @@ BuildJobQuery(MultiNode *multiNode, List *dependedJobList)
 	FromExpr *joinTree = NULL;
 	Node *joinRoot = NULL;
 	Node *havingQual = NULL;
+	List *distinctClause = NIL;
+	bool hasDistinctOn = false;
+	List *windowClause = NIL;
 
 	/* we start building jobs from below the collect node */
 	Assert(!CitusIsA(multiNode, MultiCollect));
@@ -644,7 +792,22 @@ BuildJobQuery(MultiNode *multiNode, List *dependedJobList)
 		limitCount = extendedOp->limitCount;
 		limitOffset = extendedOp->limitOffset;
 		sortClauseList = extendedOp->sortClauseList;
-		havingQual = extendedOp->havingQual;
+		havingQual = copyObject(extendedOp->havingQual);
+		distinctClause = extendedOp->distinctClause;
+		hasDistinctOn = extendedOp->hasDistinctOn;
+		windowClause = extendedOp->windowClause;
+	}
+
+	/* set correct column attributes for having columns pushed down to workers */
+	if (updateColumnAttributes && havingQual != NULL)
+	{
+		ListCell *columnCell = NULL;
+		List *columnList = pull_var_clause_default(havingQual);
+		foreach(columnCell, columnList)
+		{
+			Var *column = (Var *) lfirst(columnCell);
+			UpdateColumnAttributes(column, rangeTableList, dependedJobList);
+		}
 	}
 
 	/* build group clauses */
@@ -687,7 +850,12 @@ BuildJobQuery(MultiNode *multiNode, List *dependedJobList)
 	jobQuery->limitOffset = limitOffset;
 	jobQuery->limitCount = limitCount;
 	jobQuery->havingQual = havingQual;
-	jobQuery->hasAggs = contain_agg_clause((Node *) targetList);
+	jobQuery->hasAggs = contain_agg_clause((Node *) targetList) ||
+					   contain_agg_clause((Node *) havingQual);
+	jobQuery->distinctClause = distinctClause;
+	jobQuery->hasDistinctOn = hasDistinctOn;
+	jobQuery->windowClause = windowClause;
+	jobQuery->hasWindowFuncs = contain_window_function((Node *) targetList);
 
 	return jobQuery;
 }
@@ -1999,6 +2167,7 @@ SubquerySqlTaskList(Job *job)
 	ListCell *rangeTableCell = NULL;
 	ListCell *queryCell = NULL;
 	Node *whereClauseTree = NULL;
+	TaskQueryTemplate *queryTemplate = NULL;
 	uint32 taskIdIndex = 1; /* 0 is reserved for invalid taskId */
 	uint32 anchorRangeTableId = 0;
 	uint32 rangeTableIndex = 0;
@@ -2117,14 +2286,24 @@ SubquerySqlTaskList(Job *job)
 	whereClauseTree = (Node *) make_ands_explicit((List *) subquery->jointree->quals);
 	subquery->jointree->quals = whereClauseTree;
 
+	/* deparse the query only once if there are several tasks */
+	if (list_length(fragmentCombinationList) > 1)
+	{
+		List *fragmentCombination = (List *) linitial(fragmentCombinationList);
+		List *templateRangeTableList = NIL;
+		Query *templateQuery = copyObject(subquery);
+
+		ExtractRangeTableRelationWalker((Node *) templateQuery, &templateRangeTableList);
+		queryTemplate = BuildTaskQueryTemplate(templateQuery, templateRangeTableList,
+											   fragmentCombination);
+	}
+
 	/* create tasks from every fragment combination */
 	foreach(fragmentCombinationCell, fragmentCombinationList)
 	{
 		List *fragmentCombination = (List *) lfirst(fragmentCombinationCell);
-		List *taskRangeTableList = NIL;
-		Query *taskQuery = copyObject(subquery);
 		Task *sqlTask = NULL;
-		StringInfo sqlQueryString = NULL;
+		char *sqlQueryString = NULL;
 
 		/* create tasks to fetch fragments required for the sql task */
 		List *uniqueFragmentList = UniqueFragmentList(fragmentCombination);
@@ -2133,20 +2312,31 @@ SubquerySqlTaskList(Job *job)
 		int32 dataFetchTaskCount = list_length(dataFetchTaskList);
 		taskIdIndex += dataFetchTaskCount;
 
-		ExtractRangeTableRelationWalker((Node *) taskQuery, &taskRangeTableList);
-		UpdateRangeTableAlias(taskRangeTableList, fragmentCombination);
+		if (queryTemplate != NULL)
+		{
+			sqlQueryString = TaskQueryString(queryTemplate, fragmentCombination);
+		}
+		else
+		{
+			List *taskRangeTableList = NIL;
+			Query *taskQuery = copyObject(subquery);
+			StringInfo taskQueryString = makeStringInfo();
 
-		/* transform the updated task query to a SQL query string */
-		sqlQueryString = makeStringInfo();
-		pg_get_query_def(taskQuery, sqlQueryString);
+			ExtractRangeTableRelationWalker((Node *) taskQuery, &taskRangeTableList);
+			UpdateRangeTableAlias(taskRangeTableList, fragmentCombination);
+
+			/* transform the updated task query to a SQL query string */
+			pg_get_query_def(taskQuery, taskQueryString);
+			sqlQueryString = taskQueryString->data;
+		}
 
-		sqlTask = CreateBasicTask(jobId, taskIdIndex, SQL_TASK, sqlQueryString->data);
+		sqlTask = CreateBasicTask(jobId, taskIdIndex, SQL_TASK, sqlQueryString);
 		sqlTask->dependedTaskList = dataFetchTaskList;
 
 		/* log the query string we generated */
 		ereport(DEBUG4, (errmsg("generated sql query for job " UINT64_FORMAT
 								" and task %d", sqlTask->jobId, sqlTask->taskId),
-						 errdetail("query string: \"%s\"", sqlQueryString->data)));
+						 errdetail("query string: \"%s\"", sqlQueryString)));
 
 		sqlTask->anchorShardId = AnchorShardId(fragmentCombination, anchorRangeTableId);
 
@@ -2178,6 +2368,7 @@ SqlTaskList(Job *job)
 	List *rangeTableFragmentsList = NIL;
 	List *fragmentCombinationList = NIL;
 	ListCell *fragmentCombinationCell = NULL;
+	TaskQueryTemplate *queryTemplate = NULL;
 
 	Query *jobQuery = job->jobQuery;
 	List *rangeTableList = jobQuery->rtable;
@@ -2231,38 +2422,57 @@ SqlTaskList(Job *job)
 	fragmentCombinationList = FragmentCombinationList(rangeTableFragmentsList,
 													  jobQuery, dependedJobList);
 
+	/* deparse the query only once if there are several tasks */
+	if (list_length(fragmentCombinationList) > 1)
+	{
+		List *fragmentCombination = (List *) linitial(fragmentCombinationList);
+		Query *templateQuery = copyObject(jobQuery);
+
+		queryTemplate = BuildTaskQueryTemplate(templateQuery, templateQuery->rtable,
+											   fragmentCombination);
+	}
+
 	fragmentCombinationCell = NULL;
 	foreach(fragmentCombinationCell, fragmentCombinationList)
 	{
 		List *fragmentCombination = (List *) lfirst(fragmentCombinationCell);
 		List *dataFetchTaskList = NIL;
 		int32 dataFetchTaskCount = 0;
-		StringInfo sqlQueryString = NULL;
+		char *sqlQueryString = NULL;
 		Task *sqlTask = NULL;
-		Query *taskQuery = NULL;
-		List *fragmentRangeTableList = NIL;
 
 		/* create tasks to fetch fragments required for the sql task */
 		dataFetchTaskList = DataFetchTaskList(jobId, taskIdIndex, fragmentCombination);
 		dataFetchTaskCount = list_length(dataFetchTaskList);
 		taskIdIndex += dataFetchTaskCount;
 
-		/* update range table entries with fragment aliases (in place) */
-		taskQuery = copyObject(jobQuery);
-		fragmentRangeTableList = taskQuery->rtable;
-		UpdateRangeTableAlias(fragmentRangeTableList, fragmentCombination);
-
-		/* transform the updated task query to a SQL query string */
-		sqlQueryString = makeStringInfo();
-		pg_get_query_def(taskQuery, sqlQueryString);
+		if (queryTemplate != NULL)
+		{
+			sqlQueryString = TaskQueryString(queryTemplate, fragmentCombination);
+		}
+		else
+		{
+			Query *taskQuery = NULL;
+			List *fragmentRangeTableList = NIL;
+			StringInfo taskQueryString = makeStringInfo();
+
+			/* update range table entries with fragment aliases (in place) */
+			taskQuery = copyObject(jobQuery);
+			fragmentRangeTableList = taskQuery->rtable;
+			UpdateRangeTableAlias(fragmentRangeTableList, fragmentCombination);
+
+			/* transform the updated task query to a SQL query string */
+			pg_get_query_def(taskQuery, taskQueryString);
+			sqlQueryString = taskQueryString->data;
+		}
 
-		sqlTask = CreateBasicTask(jobId, taskIdIndex, SQL_TASK, sqlQueryString->data);
+		sqlTask = CreateBasicTask(jobId, taskIdIndex, SQL_TASK, sqlQueryString);
 		sqlTask->dependedTaskList = dataFetchTaskList;
 
 		/* log the query string we generated */
 		ereport(DEBUG4, (errmsg("generated sql query for job " UINT64_FORMAT
 								" and task %d", sqlTask->jobId, sqlTask->taskId),
-						 errdetail("query string: \"%s\"", sqlQueryString->data)));
+						 errdetail("query string: \"%s\"", sqlQueryString)));
 
 		sqlTask->anchorShardId = INVALID_SHARD_ID;
 		if (anchorRangeTableBasedAssignment)
@@ -2568,13 +2778,36 @@ RangeTableFragmentsList(List *rangeTableList, List *whereClauseList,
 
 /*
  * PruneShardList prunes shard intervals from given list based on the selection criteria,
- * and returns remaining shard intervals in another list.
+ * and returns remaining shard intervals in another list. The given list is expected to
+ * hold the shard intervals of the relation in the order of the metadata cache.
  *
  * For reference tables, the function simply returns the single shard that the table has.
  */
 List *
 PruneShardList(Oid relationId, Index tableId, List *whereClauseList,
 			   List *shardIntervalList)
+{
+	List *removedShardList = NIL;
+	List *remainingShardList = PruneShardIntervalList(relationId, tableId,
+													  whereClauseList,
+													  shardIntervalList,
+													  &removedShardList);
+
+	LogRemovedShardIntervals(removedShardList);
+
+	return remainingShardList;
+}
+
+
+/*
+ * PruneShardIntervalList prunes shard intervals like PruneShardList() does, but
+ * instead of logging the pruned shard intervals, the function appends them to
+ * the given list if DEBUG2 messages are logged. This way, callers that may plan
+ * the query again only report each pruned shard once.
+ */
+List *
+PruneShardIntervalList(Oid relationId, Index tableId, List *whereClauseList,
+					   List *shardIntervalList, List **removedShardList)
 {
 	List *remainingShardList = NIL;
 	ListCell *shardIntervalCell = NULL;
@@ -2603,6 +2836,13 @@ PruneShardList(Oid relationId, Index tableId, List *whereClauseList,
 												 partitionColumn);
 
 		List *hashedClauseList = (List *) hashedNode;
+
+		/* ANY on an array without non-null elements makes the clause false */
+		if (ContainsFalseClause(hashedClauseList))
+		{
+			return NIL;
+		}
+
 		restrictInfoList = BuildRestrictInfoList(hashedClauseList);
 	}
 	else
@@ -2610,6 +2850,14 @@ PruneShardList(Oid relationId, Index tableId, List *whereClauseList,
 		restrictInfoList = BuildRestrictInfoList(whereClauseList);
 	}
 
+	/* range and append partitioned tables are pruned on partition column bounds */
+	if (partitionMethod == DISTRIBUTE_BY_RANGE || partitionMethod == DISTRIBUTE_BY_APPEND)
+	{
+		return PruneRangeShardList(relationId, partitionColumn, whereClauseList,
+								   restrictInfoList, shardIntervalList,
+								   removedShardList);
+	}
+
 	/* override the partition column for hash partitioning */
 	if (partitionMethod == DISTRIBUTE_BY_HASH)
 	{
@@ -2637,8 +2885,129 @@ PruneShardList(Oid relationId, Index tableId, List *whereClauseList,
 
 		if (shardPruned)
 		{
-			ereport(DEBUG2, (errmsg("predicate pruning for shardId "
-									UINT64_FORMAT, shardInterval->shardId)));
+			AppendRemovedShardInterval(removedShardList, shardInterval);
+		}
+		else
+		{
+			remainingShardList = lappend(remainingShardList, shardInterval);
+		}
+	}
+
+	return remainingShardList;
+}
+
+
+/*
+ * LogRemovedShardIntervals logs the shard intervals that PruneShardIntervalList()
+ * pruned away.
+ */
+void
+LogRemovedShardIntervals(List *removedShardList)
+{
+	ListCell *shardIntervalCell = NULL;
+
+	foreach(shardIntervalCell, removedShardList)
+	{
+		ShardInterval *shardInterval = (ShardInterval *) lfirst(shardIntervalCell);
+
+		ereport(DEBUG2, (errmsg("predicate pruning for shardId "
+								UINT64_FORMAT, shardInterval->shardId)));
+	}
+}
+
+
+/*
+ * AppendRemovedShardInterval appends the given pruned shard interval to the list
+ * of pruned shard intervals if DEBUG2 messages are logged.
+ */
+static void
+AppendRemovedShardInterval(List **removedShardList, ShardInterval *shardInterval)
+{
+	if (log_min_messages <= DEBUG2 || client_min_messages <= DEBUG2)
+	{
+		*removedShardList = lappend(*removedShardList, shardInterval);
+	}
+}
+
+
+/*
+ * PruneRangeShardList prunes the shard intervals of a range or append partitioned
+ * table. The function first derives bounds on the partition column from clauses
+ * comparing it with constants, and prunes shard intervals outside these bounds.
+ * If the shard intervals don't overlap, they are sorted on their max values as
+ * well, and the function prunes the cached sorted shard interval array instead
+ * of the given list, which holds the same shards in the same order. Otherwise,
+ * the function checks each shard interval's bounds. Only if other clauses could
+ * refute a remaining shard, the function checks that shard with
+ * predicate_refuted_by().
+ */
+static List *
+PruneRangeShardList(Oid relationId, Var *partitionColumn, List *whereClauseList,
+					List *restrictInfoList, List *shardIntervalList,
+					List **removedShardList)
+{
+	DistTableCacheEntry *cacheEntry = DistributedTableCacheEntry(relationId);
+	FmgrInfo *compareFunction = cacheEntry->shardIntervalCompareFunction;
+	int shardCount = list_length(shardIntervalList);
+	PartitionColumnBounds bounds;
+	List *remainingShardList = NIL;
+	List *residualClauseList = NIL;
+	Node *baseConstraint = NULL;
+	bool checkResidualClauses = false;
+	ListCell *shardIntervalCell = NULL;
+
+	if (shardCount == 0)
+	{
+		return NIL;
+	}
+
+	Assert(compareFunction != NULL);
+
+	memset(&bounds, 0, sizeof(PartitionColumnBounds));
+	residualClauseList = ExtractPartitionColumnBounds(whereClauseList, partitionColumn,
+													  compareFunction, &bounds);
+	checkResidualClauses = NeedsPredicateRefutation(residualClauseList,
+													partitionColumn);
+
+	/* binary search the cached array if its shard intervals don't overlap */
+	if (!cacheEntry->hasOverlappingShardInterval &&
+		cacheEntry->shardIntervalArrayLength == shardCount)
+	{
+		return PruneSortedShardIntervalArray(cacheEntry, &bounds, partitionColumn,
+											 restrictInfoList, checkResidualClauses,
+											 removedShardList);
+	}
+
+	baseConstraint = BuildBaseConstraint(partitionColumn);
+
+	foreach(shardIntervalCell, shardIntervalList)
+	{
+		ShardInterval *shardInterval = (ShardInterval *) lfirst(shardIntervalCell);
+		bool shardPruned = false;
+
+		if (shardInterval->minValueExists && shardInterval->maxValueExists)
+		{
+			shardPruned =
+				!SatisfiesLowerBound(shardInterval->maxValue, &bounds,
+									 compareFunction) ||
+				!SatisfiesUpperBound(shardInterval->minValue, &bounds,
+									 compareFunction);
+
+			if (!shardPruned && checkResidualClauses)
+			{
+				List *constraintList = NIL;
+
+				/* set the min/max values in the base constraint */
+				UpdateConstraint(baseConstraint, shardInterval);
+				constraintList = list_make1(baseConstraint);
+
+				shardPruned = predicate_refuted_by(constraintList, restrictInfoList);
+			}
+		}
+
+		if (shardPruned)
+		{
+			AppendRemovedShardInterval(removedShardList, shardInterval);
 		}
 		else
 		{
@@ -2650,6 +3019,393 @@ PruneShardList(Oid relationId, Index tableId, List *whereClauseList,
 }
 
 
+/*
+ * PruneSortedShardIntervalArray binary searches the sorted shard interval array
+ * of the given cache entry for the first and last shards within the bounds, and
+ * returns copies of the shards in between that other clauses don't refute. Only
+ * these shards are visited, unless pruned shards are logged for debugging.
+ */
+static List *
+PruneSortedShardIntervalArray(DistTableCacheEntry *cacheEntry,
+							  PartitionColumnBounds *bounds, Var *partitionColumn,
+							  List *restrictInfoList, bool checkResidualClauses,
+							  List **removedShardList)
+{
+	ShardInterval **sortedShardIntervalArray = cacheEntry->sortedShardIntervalArray;
+	int shardCount = cacheEntry->shardIntervalArrayLength;
+	FmgrInfo *compareFunction = cacheEntry->shardIntervalCompareFunction;
+	List *remainingShardList = NIL;
+	Node *baseConstraint = BuildBaseConstraint(partitionColumn);
+	int lowerShardIndex = LowerBoundShardIndex(sortedShardIntervalArray, shardCount,
+											   bounds, compareFunction);
+	int upperShardIndex = UpperBoundShardIndex(sortedShardIntervalArray, shardCount,
+											   bounds, compareFunction);
+	int firstShardIndex = lowerShardIndex;
+	int lastShardIndex = upperShardIndex;
+	int shardIndex = 0;
+
+	/* visit all shards to log the pruned ones in order */
+	if (log_min_messages <= DEBUG2 || client_min_messages <= DEBUG2)
+	{
+		firstShardIndex = 0;
+		lastShardIndex = shardCount - 1;
+	}
+
+	for (shardIndex = firstShardIndex; shardIndex <= lastShardIndex; shardIndex++)
+	{
+		ShardInterval *shardInterval = sortedShardIntervalArray[shardIndex];
+		bool shardPruned = false;
+
+		if (shardIndex < lowerShardIndex || shardIndex > upperShardIndex)
+		{
+			shardPruned = true;
+		}
+		else if (checkResidualClauses && shardInterval->minValueExists &&
+				 shardInterval->maxValueExists)
+		{
+			List *constraintList = NIL;
+
+			/* set the min/max values in the base constraint */
+			UpdateConstraint(baseConstraint, shardInterval);
+			constraintList = list_make1(baseConstraint);
+
+			shardPruned = predicate_refuted_by(constraintList, restrictInfoList);
+		}
+
+		if (shardPruned)
+		{
+			AppendRemovedShardInterval(removedShardList, shardInterval);
+		}
+		else
+		{
+			ShardInterval *remainingShardInterval =
+				(ShardInterval *) palloc0(sizeof(ShardInterval));
+
+			CopyShardInterval(shardInterval, remainingShardInterval);
+			remainingShardList = lappend(remainingShardList, remainingShardInterval);
+		}
+	}
+
+	return remainingShardList;
+}
+
+
+/*
+ * ExtractPartitionColumnBounds narrows the given bounds using the clauses that
+ * compare the partition column with a constant of the same type, using an
+ * operator of the type's default btree operator family. The function returns
+ * the clauses it could not use.
+ */
+static List *
+ExtractPartitionColumnBounds(List *whereClauseList, Var *partitionColumn,
+							 FmgrInfo *compareFunction, PartitionColumnBounds *bounds)
+{
+	List *residualClauseList = NIL;
+	Oid columnType = partitionColumn->vartype;
+	Oid operatorClassId = GetDefaultOpClass(columnType, BTREE_AM_OID);
+	Oid operatorFamilyId = InvalidOid;
+	ListCell *clauseCell = NULL;
+
+	if (OidIsValid(operatorClassId))
+	{
+		operatorFamilyId = get_opclass_family(operatorClassId);
+	}
+
+	foreach(clauseCell, whereClauseList)
+	{
+		Node *clause = (Node *) lfirst(clauseCell);
+		OpExpr *operatorExpression = NULL;
+		Node *leftOperand = NULL;
+		Node *rightOperand = NULL;
+		Const *constantClause = NULL;
+		int strategyNumber = 0;
+
+		if (!OidIsValid(operatorFamilyId) || !IsA(clause, OpExpr) ||
+			list_length(((OpExpr *) clause)->args) != 2)
+		{
+			residualClauseList = lappend(residualClauseList, clause);
+			continue;
+		}
+
+		operatorExpression = (OpExpr *) clause;
+		leftOperand = (Node *) linitial(operatorExpression->args);
+		rightOperand = (Node *) lsecond(operatorExpression->args);
+
+		/* shard intervals are sorted using the default collation */
+		if (OidIsValid(operatorExpression->inputcollid) &&
+			operatorExpression->inputcollid != DEFAULT_COLLATION_OID)
+		{
+			residualClauseList = lappend(residualClauseList, clause);
+			continue;
+		}
+
+		strategyNumber = get_op_opfamily_strategy(operatorExpression->opno,
+												  operatorFamilyId);
+
+		if (IsA(rightOperand, Const) && equal(leftOperand, partitionColumn))
+		{
+			constantClause = (Const *) rightOperand;
+		}
+		else if (IsA(leftOperand, Const) && equal(rightOperand, partitionColumn))
+		{
+			constantClause = (Const *) leftOperand;
+
+			/* commute the operator, so that the partition column is on the left */
+			if (strategyNumber == BTLessStrategyNumber)
+			{
+				strategyNumber = BTGreaterStrategyNumber;
+			}
+			else if (strategyNumber == BTLessEqualStrategyNumber)
+			{
+				strategyNumber = BTGreaterEqualStrategyNumber;
+			}
+			else if (strategyNumber == BTGreaterEqualStrategyNumber)
+			{
+				strategyNumber = BTLessEqualStrategyNumber;
+			}
+			else if (strategyNumber == BTGreaterStrategyNumber)
+			{
+				strategyNumber = BTLessStrategyNumber;
+			}
+		}
+
+		if (constantClause == NULL || constantClause->constisnull ||
+			constantClause->consttype != columnType || strategyNumber == 0)
+		{
+			residualClauseList = lappend(residualClauseList, clause);
+			continue;
+		}
+
+		switch (strategyNumber)
+		{
+			case BTLessStrategyNumber:
+			case BTLessEqualStrategyNumber:
+			{
+				bool inclusive = (strategyNumber == BTLessEqualStrategyNumber);
+				UpdateUpperBound(bounds, constantClause->constvalue, inclusive,
+								 compareFunction);
+				break;
+			}
+
+			case BTEqualStrategyNumber:
+			{
+				UpdateLowerBound(bounds, constantClause->constvalue, true,
+								 compareFunction);
+				UpdateUpperBound(bounds, constantClause->constvalue, true,
+								 compareFunction);
+				break;
+			}
+
+			case BTGreaterEqualStrategyNumber:
+			case BTGreaterStrategyNumber:
+			{
+				bool inclusive = (strategyNumber == BTGreaterEqualStrategyNumber);
+				UpdateLowerBound(bounds, constantClause->constvalue, inclusive,
+								 compareFunction);
+				break;
+			}
+
+			default:
+			{
+				residualClauseList = lappend(residualClauseList, clause);
+				break;
+			}
+		}
+	}
+
+	return residualClauseList;
+}
+
+
+/*
+ * UpdateLowerBound raises the lower bound to the given value, unless the current
+ * lower bound is already higher.
+ */
+static void
+UpdateLowerBound(PartitionColumnBounds *bounds, Datum value, bool inclusive,
+				 FmgrInfo *compareFunction)
+{
+	if (bounds->hasLowerBound)
+	{
+		Datum comparisonDatum = CompareCall2(compareFunction, value,
+											 bounds->lowerBound);
+		int comparisonResult = DatumGetInt32(comparisonDatum);
+
+		if (comparisonResult < 0 || (comparisonResult == 0 && inclusive))
+		{
+			return;
+		}
+	}
+
+	bounds->hasLowerBound = true;
+	bounds->lowerBound = value;
+	bounds->lowerBoundInclusive = inclusive;
+}
+
+
+/*
+ * UpdateUpperBound lowers the upper bound to the given value, unless the current
+ * upper bound is already lower.
+ */
+static void
+UpdateUpperBound(PartitionColumnBounds *bounds, Datum value, bool inclusive,
+				 FmgrInfo *compareFunction)
+{
+	if (bounds->hasUpperBound)
+	{
+		Datum comparisonDatum = CompareCall2(compareFunction, value,
+											 bounds->upperBound);
+		int comparisonResult = DatumGetInt32(comparisonDatum);
+
+		if (comparisonResult > 0 || (comparisonResult == 0 && inclusive))
+		{
+			return;
+		}
+	}
+
+	bounds->hasUpperBound = true;
+	bounds->upperBound = value;
+	bounds->upperBoundInclusive = inclusive;
+}
+
+
+/* SatisfiesLowerBound returns whether the given value is within the lower bound. */
+static bool
+SatisfiesLowerBound(Datum value, PartitionColumnBounds *bounds,
+					FmgrInfo *compareFunction)
+{
+	Datum comparisonDatum = 0;
+	int comparisonResult = 0;
+
+	if (!bounds->hasLowerBound)
+	{
+		return true;
+	}
+
+	comparisonDatum = CompareCall2(compareFunction, value, bounds->lowerBound);
+	comparisonResult = DatumGetInt32(comparisonDatum);
+
+	return comparisonResult > 0 || (comparisonResult == 0 && bounds->lowerBoundInclusive);
+}
+
+
+/* SatisfiesUpperBound returns whether the given value is within the upper bound. */
+static bool
+SatisfiesUpperBound(Datum value, PartitionColumnBounds *bounds,
+					FmgrInfo *compareFunction)
+{
+	Datum comparisonDatum = 0;
+	int comparisonResult = 0;
+
+	if (!bounds->hasUpperBound)
+	{
+		return true;
+	}
+
+	comparisonDatum = CompareCall2(compareFunction, value, bounds->upperBound);
+	comparisonResult = DatumGetInt32(comparisonDatum);
+
+	return comparisonResult < 0 || (comparisonResult == 0 && bounds->upperBoundInclusive);
+}
+
+
+/*
+ * LowerBoundShardIndex returns the index of the first shard interval whose max
+ * value is within the lower bound. The shard intervals must not overlap, so that
+ * the array is sorted on max values as well.
+ */
+static int
+LowerBoundShardIndex(ShardInterval **sortedShardIntervalArray, int shardCount,
+					 PartitionColumnBounds *bounds, FmgrInfo *compareFunction)
+{
+	int lowerIndex = 0;
+	int upperIndex = shardCount;
+
+	while (lowerIndex < upperIndex)
+	{
+		int middleIndex = (lowerIndex + upperIndex) / 2;
+		Datum maxValue = sortedShardIntervalArray[middleIndex]->maxValue;
+
+		if (SatisfiesLowerBound(maxValue, bounds, compareFunction))
+		{
+			upperIndex = middleIndex;
+		}
+		else
+		{
+			lowerIndex = middleIndex + 1;
+		}
+	}
+
+	return lowerIndex;
+}
+
+
+/*
+ * UpperBoundShardIndex returns the index of the last shard interval whose min
+ * value is within the upper bound, or -1 if there is no such shard interval.
+ */
+static int
+UpperBoundShardIndex(ShardInterval **sortedShardIntervalArray, int shardCount,
+					 PartitionColumnBounds *bounds, FmgrInfo *compareFunction)
+{
+	int lowerIndex = 0;
+	int upperIndex = shardCount;
+
+	while (lowerIndex < upperIndex)
+	{
+		int middleIndex = (lowerIndex + upperIndex) / 2;
+		Datum minValue = sortedShardIntervalArray[middleIndex]->minValue;
+
+		if (SatisfiesUpperBound(minValue, bounds, compareFunction))
+		{
+			lowerIndex = middleIndex + 1;
+		}
+		else
+		{
+			upperIndex = middleIndex;
+		}
+	}
+
+	return lowerIndex - 1;
+}
+
+
+/*
+ * NeedsPredicateRefutation returns whether any of the given clauses could refute
+ * a shard's constraint. These are the clauses on the partition column, and the
+ * clauses without any columns, such as a constant null.
+ */
+static bool
+NeedsPredicateRefutation(List *clauseList, Var *partitionColumn)
+{
+	ListCell *clauseCell = NULL;
+
+	foreach(clauseCell, clauseList)
+	{
+		Node *clause = (Node *) lfirst(clauseCell);
+		List *columnList = pull_var_clause_default(clause);
+		ListCell *columnCell = NULL;
+
+		if (columnList == NIL)
+		{
+			return true;
+		}
+
+		foreach(columnCell, columnList)
+		{
+			Var *column = (Var *) lfirst(columnCell);
+			if (column->varno == partitionColumn->varno &&
+				column->varattno == partitionColumn->varattno)
+			{
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+
 /*
  * ContainsFalseClause returns whether the flattened where clause list
  * contains false as a clause.
@@ -2954,17 +3710,23 @@ HashableClauseMutator(Node *originalNode, Var *partitionColumn)
 		bool usingEqualityOperator = OperatorImplementsEquality(
 			arrayOperatorExpression->opno);
 
-		/*
-		 * Citus cannot prune hash-distributed shards with ANY/ALL. We show a NOTICE
-		 * if the expression is ANY/ALL performed on the partition column with equality.
-		 */
 		if (usingEqualityOperator && strippedLeftOpExpression != NULL &&
 			equal(strippedLeftOpExpression, partitionColumn))
 		{
-			ereport(NOTICE, (errmsg("cannot use shard pruning with "
-									"ANY/ALL (array expression)"),
-							 errhint("Consider rewriting the expression with "
-									 "OR/AND clauses.")));
+			newNode = HashedArrayOperatorExpression(arrayOperatorExpression);
+
+			/*
+			 * Citus can only prune hash-distributed shards with ANY on a constant
+			 * array. We show a NOTICE if the expression is another ANY/ALL
+			 * performed on the partition column with equality.
+			 */
+			if (newNode == NULL)
+			{
+				ereport(NOTICE, (errmsg("cannot use shard pruning with "
+										"ANY/ALL (array expression)"),
+								 errhint("Consider rewriting the expression with "
+										 "OR/AND clauses.")));
+			}
 		}
 	}
 
@@ -2982,6 +3744,91 @@ HashableClauseMutator(Node *originalNode, Var *partitionColumn)
 }
 
 
+/*
+ * HashedArrayOperatorExpression turns an expression of the form partitionColumn =
+ * ANY (constant array) into an OR of hashed equality expressions, one for each
+ * non-null array element, so that all shards not containing any of the elements
+ * are pruned. If the array has no non-null elements, no row can match, and the
+ * function returns a constant false. The function returns NULL if the
+ * expression is not of this form.
+ */
+static Node *
+HashedArrayOperatorExpression(ScalarArrayOpExpr *arrayOperatorExpression)
+{
+	Node *leftOperand = (Node *) linitial(arrayOperatorExpression->args);
+	Node *rightOperand = (Node *) lsecond(arrayOperatorExpression->args);
+	Const *arrayConstant = NULL;
+	ArrayType *array = NULL;
+	Oid elementType = InvalidOid;
+	int16 elementLength = 0;
+	bool elementByValue = false;
+	char elementAlignment = 0;
+	Datum *elementArray = NULL;
+	bool *elementNullArray = NULL;
+	int elementCount = 0;
+	int elementIndex = 0;
+	List *hashedExpressionList = NIL;
+	Oid leftHashFunction = InvalidOid;
+	Oid rightHashFunction = InvalidOid;
+
+	bool hasHashFunction = get_op_hash_functions(arrayOperatorExpression->opno,
+												 &leftHashFunction,
+												 &rightHashFunction);
+
+	rightOperand = strip_implicit_coercions(rightOperand);
+	if (!arrayOperatorExpression->useOr || !hasHashFunction ||
+		!IsA(rightOperand, Const) || ((Const *) rightOperand)->constisnull)
+	{
+		return NULL;
+	}
+
+	arrayConstant = (Const *) rightOperand;
+	array = DatumGetArrayTypeP(arrayConstant->constvalue);
+	elementType = ARR_ELEMTYPE(array);
+
+	get_typlenbyvalalign(elementType, &elementLength, &elementByValue,
+						 &elementAlignment);
+	deconstruct_array(array, elementType, elementLength, elementByValue,
+					  elementAlignment, &elementArray, &elementNullArray,
+					  &elementCount);
+
+	for (elementIndex = 0; elementIndex < elementCount; elementIndex++)
+	{
+		Const *elementConstant = NULL;
+		OpExpr *operatorExpression = NULL;
+		OpExpr *hashedOperatorExpression = NULL;
+
+		/* null elements never compare equal */
+		if (elementNullArray[elementIndex])
+		{
+			continue;
+		}
+
+		elementConstant = makeConst(elementType, -1, arrayConstant->constcollid,
+									elementLength, elementArray[elementIndex], false,
+									elementByValue);
+
+		operatorExpression = (OpExpr *) make_opclause(
+			arrayOperatorExpression->opno, BOOLOID, false, (Expr *) leftOperand,
+			(Expr *) elementConstant, InvalidOid, arrayOperatorExpression->inputcollid);
+
+		hashedOperatorExpression = MakeHashedOperatorExpression(operatorExpression);
+		hashedExpressionList = lappend(hashedExpressionList, hashedOperatorExpression);
+	}
+
+	if (hashedExpressionList == NIL)
+	{
+		return makeBoolConst(false, false);
+	}
+	else if (list_length(hashedExpressionList) == 1)
+	{
+		return (Node *) linitial(hashedExpressionList);
+	}
+
+	return (Node *) make_orclause(hashedExpressionList);
+}
+
+
 /*
  * OpExpressionContainsColumn checks if the operator expression contains the
  * given partition column. We assume that given operator expression is a simple
@@ -4133,6 +4980,190 @@ FragmentAlias(RangeTblEntry *rangeTableEntry, RangeTableFragment *fragment)
 }
 
 
+/*
+ * BuildTaskQueryTemplate deparses the given query with a placeholder in place
+ * of the name of each shard in the given fragment list, and splits the query
+ * string around these placeholders. The function modifies the given query, so
+ * callers should pass a copy of the job query.
+ *
+ * The function returns NULL if the query can't be turned into a template. This
+ * is the case if a fragment is not a shard, as the names of merge task tables
+ * are also used as aliases, or if a placeholder does not occur exactly once in
+ * the query string, for example because a constant in the query contains it.
+ */
+static TaskQueryTemplate *
+BuildTaskQueryTemplate(Query *templateQuery, List *templateRangeTableList,
+					   List *fragmentList)
+{
+	TaskQueryTemplate *queryTemplate = NULL;
+	StringInfo templateString = makeStringInfo();
+	int fragmentCount = list_length(fragmentList);
+	char **placeholderArray = palloc0(fragmentCount * sizeof(char *));
+	char **locationArray = palloc0(fragmentCount * sizeof(char *));
+	char **schemaNameArray = palloc0(fragmentCount * sizeof(char *));
+	char **relationNameArray = palloc0(fragmentCount * sizeof(char *));
+	List *rangeTableIdList = NIL;
+	char *stringPartStart = NULL;
+	ListCell *fragmentCell = NULL;
+	int fragmentIndex = 0;
+	int partIndex = 0;
+
+	foreach(fragmentCell, fragmentList)
+	{
+		RangeTableFragment *fragment = (RangeTableFragment *) lfirst(fragmentCell);
+		uint32 rangeTableId = fragment->rangeTableId;
+		RangeTblEntry *rangeTableEntry = rt_fetch(rangeTableId, templateRangeTableList);
+		StringInfo placeholder = makeStringInfo();
+		CitusRTEKind fragmentKind = CITUS_RTE_RELATION;
+		char *fragmentSchemaName = NULL;
+		char *fragmentTableName = NULL;
+		List *tableIdList = NIL;
+
+		if (fragment->fragmentType != CITUS_RTE_RELATION ||
+			list_member_int(rangeTableIdList, (int) rangeTableId))
+		{
+			return NULL;
+		}
+
+		rangeTableIdList = lappend_int(rangeTableIdList, (int) rangeTableId);
+		relationNameArray[fragmentIndex] = get_rel_name(rangeTableEntry->relid);
+
+		appendStringInfo(placeholder, FRAGMENT_NAME_PLACEHOLDER, rangeTableId);
+		placeholderArray[fragmentIndex] = placeholder->data;
+
+		/*
+		 * Set up the range table entry as for a task, but with the placeholder
+		 * in place of the schema qualified shard name. The shard's schema is
+		 * added back when the task's query string is built.
+		 */
+		rangeTableEntry->alias = FragmentAlias(rangeTableEntry, fragment);
+		ExtractRangeTblExtraData(rangeTableEntry, &fragmentKind, &fragmentSchemaName,
+								 &fragmentTableName, &tableIdList);
+		schemaNameArray[fragmentIndex] = fragmentSchemaName;
+
+		ModifyRangeTblExtraData(rangeTableEntry, CITUS_RTE_SHARD, NULL,
+								placeholder->data, NIL);
+
+		fragmentIndex++;
+	}
+
+	pg_get_query_def(templateQuery, templateString);
+
+	for (fragmentIndex = 0; fragmentIndex < fragmentCount; fragmentIndex++)
+	{
+		char *placeholder = placeholderArray[fragmentIndex];
+		char *location = strstr(templateString->data, placeholder);
+
+		if (location == NULL || strstr(location + 1, placeholder) != NULL)
+		{
+			return NULL;
+		}
+
+		locationArray[fragmentIndex] = location;
+	}
+
+	queryTemplate = palloc0(sizeof(TaskQueryTemplate));
+	stringPartStart = templateString->data;
+
+	/* split the query string at the placeholders, in the order they occur */
+	for (partIndex = 0; partIndex < fragmentCount; partIndex++)
+	{
+		int nextIndex = -1;
+		char *location = NULL;
+		char *stringPart = NULL;
+
+		for (fragmentIndex = 0; fragmentIndex < fragmentCount; fragmentIndex++)
+		{
+			char *fragmentLocation = locationArray[fragmentIndex];
+			if (fragmentLocation != NULL &&
+				(nextIndex < 0 || fragmentLocation < locationArray[nextIndex]))
+			{
+				nextIndex = fragmentIndex;
+			}
+		}
+
+		location = locationArray[nextIndex];
+		stringPart = pnstrdup(stringPartStart, location - stringPartStart);
+
+		queryTemplate->stringPartList = lappend(queryTemplate->stringPartList,
+												stringPart);
+		queryTemplate->rangeTableIdList =
+			lappend_int(queryTemplate->rangeTableIdList,
+						list_nth_int(rangeTableIdList, nextIndex));
+		queryTemplate->schemaNameList =
+			lappend(queryTemplate->schemaNameList, schemaNameArray[nextIndex]);
+		queryTemplate->relationNameList =
+			lappend(queryTemplate->relationNameList, relationNameArray[nextIndex]);
+
+		stringPartStart = location + strlen(placeholderArray[nextIndex]);
+		locationArray[nextIndex] = NULL;
+	}
+
+	queryTemplate->stringPartList = lappend(queryTemplate->stringPartList,
+											pstrdup(stringPartStart));
+
+	return queryTemplate;
+}
+
+
+/*
+ * TaskQueryString builds the query string of a task from the given template by
+ * putting the names of the shards in the given fragment list in between the
+ * parts of the template's query string. Shard names are schema qualified
+ * unless the shard is in the public schema, as when deparsing the query.
+ */
+static char *
+TaskQueryString(TaskQueryTemplate *queryTemplate, List *fragmentList)
+{
+	StringInfo queryString = makeStringInfo();
+	ListCell *stringPartCell = list_head(queryTemplate->stringPartList);
+	ListCell *rangeTableIdCell = NULL;
+	ListCell *schemaNameCell = list_head(queryTemplate->schemaNameList);
+	ListCell *relationNameCell = NULL;
+
+	appendStringInfoString(queryString, (char *) lfirst(stringPartCell));
+
+	forboth(rangeTableIdCell, queryTemplate->rangeTableIdList,
+			relationNameCell, queryTemplate->relationNameList)
+	{
+		uint32 rangeTableId = (uint32) lfirst_int(rangeTableIdCell);
+		char *shardName = pstrdup((char *) lfirst(relationNameCell));
+		char *schemaName = NULL;
+		ShardInterval *shardInterval = NULL;
+		ListCell *fragmentCell = NULL;
+
+		foreach(fragmentCell, fragmentList)
+		{
+			RangeTableFragment *fragment = (RangeTableFragment *) lfirst(fragmentCell);
+			if (fragment->rangeTableId == rangeTableId)
+			{
+				Assert(fragment->fragmentType == CITUS_RTE_RELATION);
+				shardInterval = (ShardInterval *) fragment->fragmentReference;
+				break;
+			}
+		}
+
+		Assert(shardInterval != NULL);
+
+		AppendShardIdToName(&shardName, shardInterval->shardId);
+
+		schemaName = (char *) lfirst(schemaNameCell);
+		if (schemaName != NULL)
+		{
+			appendStringInfo(queryString, "%s.", quote_identifier(schemaName));
+		}
+
+		appendStringInfoString(queryString, quote_identifier(shardName));
+
+		schemaNameCell = lnext(schemaNameCell);
+		stringPartCell = lnext(stringPartCell);
+		appendStringInfoString(queryString, (char *) lfirst(stringPartCell));
+	}
+
+	return queryString->data;
+}
+
+
 /*
  * AnchorShardId walks over each fragment in the given fragment list, finds the
  * fragment that corresponds to the given anchor range tableId, and returns this
@@ -24,6 +24,9 @@
 #include "distributed/multi_master_planner.h"
 #include "distributed/multi_router_planner.h"
 #include "executor/executor.h"
+#if (PG_VERSION_NUM >= 90600)
+#include "nodes/extensible.h"
+#endif
 #include "nodes/makefuncs.h"
 #include "nodes/nodeFuncs.h"
 #include "optimizer/planner.h"
@@ -60,6 +63,9 @@ static PlannedStmt * CreateDistributedPlan(PlannedStmt *localPlan, Query *origin
 										   RelationRestrictionContext *restrictionContext);
 static Node * SerializeMultiPlan(struct MultiPlan *multiPlan);
 static MultiPlan * DeserializeMultiPlan(Node *node);
+static PlannedStmt * CreateFastPathDistributedPlan(Query *parse,
+												   ParamListInfo boundParams);
+static PlannedStmt * FastPathLocalPlan(Query *parse);
 static PlannedStmt * FinalizePlan(PlannedStmt *localPlan, MultiPlan *multiPlan);
 static PlannedStmt * FinalizeNonRouterPlan(PlannedStmt *localPlan, MultiPlan *multiPlan,
 										   CustomScan *customScan);
@@ -80,6 +86,20 @@ multi_planner(Query *parse, int cursorOptions, ParamListInfo boundParams)
 	Query *originalQuery = NULL;
 	RelationRestrictionContext *restrictionContext = NULL;
 
+	/*
+	 * Simple single shard lookups can be planned directly from the parse
+	 * tree, which avoids the cost of the postgres planner for them.
+	 */
+	if (needsDistributedPlanning && EnableFastPathRouterPlanner &&
+		EnableRouterExecution)
+	{
+		result = CreateFastPathDistributedPlan(parse, boundParams);
+		if (result != NULL)
+		{
+			return result;
+		}
+	}
+
 	/*
 	 * standard_planner scribbles on it's input, but for deparsing we need the
 	 * unmodified form. So copy once we're sure it's a distributed query.
@@ -142,6 +162,78 @@ multi_planner(Query *parse, int cursorOptions, ParamListInfo boundParams)
 }
 
 
+/*
+ * CreateFastPathDistributedPlan returns the final plan for a query that can be
+ * planned by the fast path router planner, or NULL if the query doesn't
+ * qualify for it.
+ */
+static PlannedStmt *
+CreateFastPathDistributedPlan(Query *parse, ParamListInfo boundParams)
+{
+	PlannedStmt *localPlan = NULL;
+	PlannedStmt *finalPlan = NULL;
+	MultiPlan *distributedPlan = NULL;
+
+	/* take the range table before the router planner points it to the shard */
+	localPlan = FastPathLocalPlan(parse);
+
+	distributedPlan = CreateFastPathRouterPlan(parse, boundParams);
+	if (distributedPlan == NULL)
+	{
+		return NULL;
+	}
+
+	finalPlan = FinalizePlan(localPlan, distributedPlan);
+
+	/*
+	 * Generic plans with deferred shard pruning embed the table's shards, so
+	 * let postgres drop cached plans when the table's metadata changes, which
+	 * invalidates the table's relcache entry.
+	 */
+	finalPlan->relationOids = localPlan->relationOids;
+
+	return finalPlan;
+}
+
+
+/*
+ * FastPathLocalPlan builds a stand-in for the plan standard_planner() would
+ * have produced for the given query, containing just the fields FinalizePlan()
+ * uses: the output columns, the range table for permission checks, the
+ * referenced relations and the statement properties.
+ */
+static PlannedStmt *
+FastPathLocalPlan(Query *parse)
+{
+	PlannedStmt *localPlan = makeNode(PlannedStmt);
+	Result *resultPlan = makeNode(Result);
+	List *relationOidList = NIL;
+	ListCell *rangeTableCell = NULL;
+
+	foreach(rangeTableCell, parse->rtable)
+	{
+		RangeTblEntry *rangeTableEntry = (RangeTblEntry *) lfirst(rangeTableCell);
+
+		if (rangeTableEntry->rtekind == RTE_RELATION)
+		{
+			relationOidList = lappend_oid(relationOidList, rangeTableEntry->relid);
+		}
+	}
+
+	resultPlan->plan.targetlist = parse->targetList;
+
+	localPlan->planTree = (Plan *) resultPlan;
+	localPlan->rtable = copyObject(parse->rtable);
+	localPlan->queryId = parse->queryId;
+	localPlan->utilityStmt = parse->utilityStmt;
+	localPlan->commandType = parse->commandType;
+	localPlan->hasReturning = false;
+	localPlan->relationOids = relationOidList;
+
+	return localPlan;
+}
+
+
 /*
  * IsModifyCommand returns true if the query performs modifications, false
  * otherwise.
@@ -311,6 +403,26 @@ CreateDistributedPlan(PlannedStmt *localPlan, Query *originalQuery, Query *query
 }
 
 
+#if (PG_VERSION_NUM >= 90600)
+
+/*
+ * RegisterCitusCustomScanMethods makes the custom scan methods of Citus known
+ * by name, so that plans with Citus custom scans can be read back from their
+ * string form. Parallel workers need this to read their part of the plan.
+ */
+void
+RegisterCitusCustomScanMethods(void)
+{
+	RegisterCustomScanMethods(&RealTimeCustomScanMethods);
+	RegisterCustomScanMethods(&TaskTrackerCustomScanMethods);
+	RegisterCustomScanMethods(&RouterCustomScanMethods);
+	RegisterCustomScanMethods(&DelayedErrorCustomScanMethods);
+}
+
+
+#endif
+
+
 /*
  * GetMultiPlan returns the associated MultiPlan for a CustomScan.
  */
@@ -328,16 +440,18 @@ GetMultiPlan(CustomScan *customScan)
 
 
 /*
- * SerializeMultiPlan returns the string representing the distributed plan in a
- * Const node.
- *
- * Note that this should be improved for 9.6+, we we can copy trees efficiently.
- * I.e. we should introduce copy support for relevant node types, and just
- * return the MultiPlan as-is for 9.6.
+ * SerializeMultiPlan returns the node to store the distributed plan in the
+ * custom scan. On 9.6+ Citus nodes can be copied, so the plan is stored as-is
+ * and postgres copies it along with the rest of the plan tree, e.g. when the
+ * plan is cached. Before 9.6 the plan is stored as its string representation
+ * in a Const node.
  */
 static Node *
 SerializeMultiPlan(MultiPlan *multiPlan)
 {
+#if (PG_VERSION_NUM >= 90600)
+	return (Node *) multiPlan;
+#else
 	char *serializedMultiPlan = NULL;
 	Const *multiPlanData = NULL;
 
@@ -351,25 +465,34 @@ SerializeMultiPlan(MultiPlan *multiPlan)
 	multiPlanData->location = -1;
 
 	return (Node *) multiPlanData;
+#endif
 }
 
 
 /*
- * DeserializeMultiPlan returns the deserialized distributed plan from the string
- * representation in a Const node.
+ * DeserializeMultiPlan returns a fresh copy of the distributed plan stored by
+ * SerializeMultiPlan. The executor modifies the plan it runs, e.g. to prune
+ * tasks or to rebuild their query strings, so it must never see the plan
+ * stored in the (possibly cached) plan tree.
  */
 static MultiPlan *
 DeserializeMultiPlan(Node *node)
 {
+	MultiPlan *multiPlan = NULL;
+
+#if (PG_VERSION_NUM >= 90600)
+	multiPlan = (MultiPlan *) copyObject(node);
+#else
 	Const *multiPlanData = NULL;
 	char *serializedMultiPlan = NULL;
-	MultiPlan *multiPlan = NULL;
 
 	Assert(IsA(node, Const));
 	multiPlanData = (Const *) node;
 	serializedMultiPlan = DatumGetCString(multiPlanData->constvalue);
 
 	multiPlan = (MultiPlan *) CitusStringToNode(serializedMultiPlan);
+#endif
+
 	Assert(CitusIsA(multiPlan, MultiPlan));
 
 	return multiPlan;
@@ -74,6 +74,7 @@ typedef struct WalkerState
 } WalkerState;
 
 bool EnableRouterExecution = true;
+bool EnableFastPathRouterPlanner = false;
 
 /* planner functions forward declarations */
 static MultiPlan * CreateSingleTaskRouterPlan(Query *originalQuery,
@@ -131,6 +132,17 @@ static DeferredErrorMessage * InsertPartitionColumnMatchesSelect(Query *query,
 																 selectPartitionColumnTableId);
 static void AddUninstantiatedEqualityQual(Query *query, Var *targetPartitionColumnVar);
 static DeferredErrorMessage * ErrorIfQueryHasModifyingCTE(Query *queryTree);
+static MultiPlan * CreateDeferredPruningRouterPlan(Query *query, Param *partitionParam);
+static char * DeferredPruningQueryString(char *templateString,
+										 RelationShard *relationShard);
+static Task * FastPathRouterTask(char *queryString, RelationShard *relationShard);
+static MultiPlan * FastPathRouterMultiPlan(Job *job);
+static bool FastPathRouterQuery(Query *query, ParamListInfo boundParams,
+								Node **partitionValue);
+static Node * FastPathPartitionValue(Node *clause, Var *partitionColumn,
+									 ParamListInfo boundParams);
+static ShardInterval * FastPathShardInterval(Oid relationId, Oid valueType,
+											 Datum partitionValue);
 
 
 /*
@@ -158,6 +170,307 @@ CreateRouterPlan(Query *originalQuery, Query *query,
 }
 
 
+/*
+ * CreateFastPathRouterPlan creates a router plan for a SELECT on a single hash
+ * distributed table whose WHERE clause has an equality filter on the partition
+ * column, such as SELECT ... FROM table WHERE key = $1. Such queries are
+ * recognized on the parse tree, and the target shard is found through the
+ * cached shard interval array, so neither the postgres planner nor the
+ * restriction based shard pruning has to run for them.
+ *
+ * If the partition column is compared to a parameter whose value isn't known
+ * yet, the choice of the shard is deferred to execution time.
+ *
+ * The function returns NULL if the query doesn't qualify for the fast path,
+ * in which case the caller should plan it the regular way. Note that the
+ * given query is modified to refer to the target shard.
+ */
+MultiPlan *
+CreateFastPathRouterPlan(Query *query, ParamListInfo boundParams)
+{
+	Node *partitionValue = NULL;
+	Const *partitionConstant = NULL;
+	RangeTblEntry *rangeTableEntry = NULL;
+	ShardInterval *shardInterval = NULL;
+	RelationShard *relationShard = NULL;
+	List *placementList = NIL;
+	StringInfo queryString = NULL;
+	Task *task = NULL;
+	Job *job = NULL;
+
+	if (!FastPathRouterQuery(query, boundParams, &partitionValue))
+	{
+		return NULL;
+	}
+
+	if (IsA(partitionValue, Param))
+	{
+		return CreateDeferredPruningRouterPlan(query, (Param *) partitionValue);
+	}
+
+	rangeTableEntry = (RangeTblEntry *) linitial(query->rtable);
+	partitionConstant = (Const *) partitionValue;
+
+	shardInterval = FastPathShardInterval(rangeTableEntry->relid,
+										  partitionConstant->consttype,
+										  partitionConstant->constvalue);
+	if (shardInterval == NULL)
+	{
+		return NULL;
+	}
+
+	placementList = FinalizedShardPlacementList(shardInterval->shardId);
+	if (placementList == NIL)
+	{
+		return NULL;
+	}
+
+	relationShard = CitusMakeNode(RelationShard);
+	relationShard->relationId = shardInterval->relationId;
+	relationShard->shardId = shardInterval->shardId;
+
+	UpdateRelationToShardNames((Node *) query, list_make1(relationShard));
+
+	queryString = makeStringInfo();
+	pg_get_query_def(query, queryString);
+
+	task = FastPathRouterTask(queryString->data, relationShard);
+
+	ereport(DEBUG2, (errmsg("Creating fast path router plan")));
+
+	job = RouterQueryJob(query, task, placementList);
+
+	return FastPathRouterMultiPlan(job);
+}
+
+
+/*
+ * CreateDeferredPruningRouterPlan creates a router plan for a fast path query
+ * whose partition column is compared to a parameter without a known value, as
+ * in the generic plan of a prepared statement. The plan has a single task whose
+ * query is deparsed once, with a placeholder in place of the shard name. Once
+ * the parameter value is known, PruneDeferredTaskList() picks the shard and puts
+ * its name into the query string. Since postgres caches generic plans, executing
+ * such a prepared statement then only requires hashing the parameter value,
+ * however many shards the table has.
+ *
+ * The function returns NULL if the placeholder doesn't occur exactly once in the
+ * query string, for example because a constant in the query contains it.
+ */
+static MultiPlan *
+CreateDeferredPruningRouterPlan(Query *query, Param *partitionParam)
+{
+	RangeTblEntry *rangeTableEntry = (RangeTblEntry *) linitial(query->rtable);
+	RangeTblEntry relationRangeTableEntry = *rangeTableEntry;
+	Oid relationId = rangeTableEntry->relid;
+	DistTableCacheEntry *cacheEntry = DistributedTableCacheEntry(relationId);
+	int shardCount = cacheEntry->shardIntervalArrayLength;
+	TypeCacheEntry *typeEntry = lookup_type_cache(partitionParam->paramtype,
+												  TYPECACHE_HASH_PROC);
+	char *schemaName = NULL;
+	StringInfo placeholder = makeStringInfo();
+	StringInfo queryString = makeStringInfo();
+	char *placeholderLocation = NULL;
+	RelationShard *relationShard = NULL;
+	Task *task = NULL;
+	Job *job = NULL;
+
+	if (shardCount == 0 || cacheEntry->hasUninitializedShardInterval ||
+		!OidIsValid(typeEntry->hash_proc))
+	{
+		return NULL;
+	}
+
+	/* deparse the query with the placeholder, then restore the relation's entry */
+	schemaName = get_namespace_name(get_rel_namespace(relationId));
+	appendStringInfo(placeholder, FRAGMENT_NAME_PLACEHOLDER, 1);
+
+	ModifyRangeTblExtraData(rangeTableEntry, CITUS_RTE_SHARD, schemaName,
+							placeholder->data, NIL);
+	pg_get_query_def(query, queryString);
+	*rangeTableEntry = relationRangeTableEntry;
+
+	placeholderLocation = strstr(queryString->data, placeholder->data);
+	if (placeholderLocation == NULL ||
+		strstr(placeholderLocation + 1, placeholder->data) != NULL)
+	{
+		return NULL;
+	}
+
+	/* the shard is only known at execution time */
+	relationShard = CitusMakeNode(RelationShard);
+	relationShard->relationId = relationId;
+	relationShard->shardId = INVALID_SHARD_ID;
+
+	task = FastPathRouterTask(queryString->data, relationShard);
+
+	ereport(DEBUG2, (errmsg("Creating fast path router plan with deferred shard "
+							"pruning")));
+
+	job = CitusMakeNode(Job);
+	job->jobId = INVALID_JOB_ID;
+	job->jobQuery = query;
+	job->taskList = list_make1(task);
+	job->dependedJobList = NIL;
+	job->subqueryPushdown = false;
+	job->requiresMasterEvaluation = false;
+	job->deferredPruningParam = partitionParam;
+
+	return FastPathRouterMultiPlan(job);
+}
+
+
+/*
+ * FastPathRouterTask creates the router task that runs the given query string
+ * on the given shard.
+ */
+static Task *
+FastPathRouterTask(char *queryString, RelationShard *relationShard)
+{
+	Task *task = CitusMakeNode(Task);
+
+	task->jobId = INVALID_JOB_ID;
+	task->taskId = INVALID_TASK_ID;
+	task->taskType = ROUTER_TASK;
+	task->queryString = queryString;
+	task->anchorShardId = relationShard->shardId;
+	task->replicationModel = REPLICATION_MODEL_INVALID;
+	task->dependedTaskList = NIL;
+	task->upsertQuery = false;
+	task->relationShardList = list_make1(relationShard);
+
+	return task;
+}
+
+
+/* FastPathRouterMultiPlan wraps the given job of a fast path query into a plan */
+static MultiPlan *
+FastPathRouterMultiPlan(Job *job)
+{
+	MultiPlan *multiPlan = CitusMakeNode(MultiPlan);
+
+	multiPlan->operation = CMD_SELECT;
+	multiPlan->workerJob = job;
+	multiPlan->masterQuery = NULL;
+	multiPlan->routerExecutable = true;
+	multiPlan->hasReturning = false;
+
+	return multiPlan;
+}
+
+
+/*
+ * PruneDeferredTaskList picks the shard that the partition column parameter of
+ * a router plan with deferred shard pruning falls into. The function then puts
+ * the shard's name into the query string of the plan's task, and assigns the
+ * shard's placements to the task.
+ */
+void
+PruneDeferredTaskList(Job *job, ParamListInfo paramListInfo)
+{
+	Param *partitionParam = job->deferredPruningParam;
+	int parameterId = partitionParam->paramid;
+	Task *task = (Task *) linitial(job->taskList);
+	RelationShard *relationShard =
+		(RelationShard *) linitial(task->relationShardList);
+	ParamExternData *parameterData = NULL;
+	ShardInterval *shardInterval = NULL;
+	uint64 shardId = INVALID_SHARD_ID;
+
+	if (paramListInfo == NULL || parameterId <= 0 ||
+		parameterId > paramListInfo->numParams)
+	{
+		ereport(ERROR, (errcode(ERRCODE_UNDEFINED_OBJECT),
+						errmsg("no value found for parameter %d", parameterId)));
+	}
+
+	parameterData = &paramListInfo->params[parameterId - 1];
+
+	/* give hook a chance in case parameter is dynamic */
+	if (!OidIsValid(parameterData->ptype) && paramListInfo->paramFetch != NULL)
+	{
+		(*paramListInfo->paramFetch)(paramListInfo, parameterId);
+	}
+
+	if (parameterData->ptype != partitionParam->paramtype)
+	{
+		ereport(ERROR, (errcode(ERRCODE_DATATYPE_MISMATCH),
+						errmsg("type of parameter %d (%s) does not match that "
+							   "when preparing the plan (%s)", parameterId,
+							   format_type_be(parameterData->ptype),
+							   format_type_be(partitionParam->paramtype))));
+	}
+
+	if (parameterData->isnull)
+	{
+		/* no row has a NULL partition value, so any shard gives the result */
+		DistTableCacheEntry *cacheEntry =
+			DistributedTableCacheEntry(relationShard->relationId);
+
+		if (cacheEntry->shardIntervalArrayLength > 0)
+		{
+			shardInterval = cacheEntry->sortedShardIntervalArray[0];
+		}
+	}
+	else
+	{
+		shardInterval = FastPathShardInterval(relationShard->relationId,
+											  partitionParam->paramtype,
+											  parameterData->value);
+	}
+
+	if (shardInterval == NULL)
+	{
+		ereport(ERROR, (errmsg("could not find the shard for the partition column "
+							   "value of parameter %d", parameterId)));
+	}
+
+	shardId = shardInterval->shardId;
+	relationShard->shardId = shardId;
+	task->anchorShardId = shardId;
+	task->queryString = DeferredPruningQueryString(task->queryString,
+												   relationShard);
+
+	task->taskPlacementList = FinalizedShardPlacementList(shardId);
+	if (task->taskPlacementList == NIL)
+	{
+		ereport(ERROR, (errmsg("could not find any healthy placement for shard "
+							   UINT64_FORMAT, shardId)));
+	}
+
+	ereport(DEBUG2, (errmsg("deferred pruning picked shardId " UINT64_FORMAT
+							" for parameter %d", shardId, parameterId)));
+}
+
+
+/*
+ * DeferredPruningQueryString returns the given query string of a router plan
+ * with deferred shard pruning, with the name of the given relation shard in
+ * place of the shard name placeholder.
+ */
+static char *
+DeferredPruningQueryString(char *templateString, RelationShard *relationShard)
+{
+	StringInfo queryString = makeStringInfo();
+	StringInfo placeholder = makeStringInfo();
+	char *shardName = get_rel_name(relationShard->relationId);
+	char *placeholderLocation = NULL;
+
+	appendStringInfo(placeholder, FRAGMENT_NAME_PLACEHOLDER, 1);
+	placeholderLocation = strstr(templateString, placeholder->data);
+	Assert(placeholderLocation != NULL);
+
+	AppendShardIdToName(&shardName, relationShard->shardId);
+
+	appendBinaryStringInfo(queryString, templateString,
+						   placeholderLocation - templateString);
+	appendStringInfoString(queryString, quote_identifier(shardName));
+	appendStringInfoString(queryString, placeholderLocation + placeholder->len);
+
+	return queryString->data;
+}
+
+
 /*
  * CreateModifyPlan attempts to create a plan the given modification
  * statement.  If planning fails ->planningError is set to a description of
@@ -2218,6 +2531,226 @@ FastShardPruning(Oid distributedTableId, Datum partitionValue)
 }
 
 
+/*
+ * FastPathRouterQuery returns true if the given query is a simple SELECT on a
+ * single hash distributed table, with an equality filter on the partition
+ * column at the top level of its WHERE clause. In that case partitionValue is
+ * set to the constant the partition column is compared to, or to the
+ * parameter if its value is not known at planning time.
+ */
+static bool
+FastPathRouterQuery(Query *query, ParamListInfo boundParams, Node **partitionValue)
+{
+	FromExpr *joinTree = query->jointree;
+	RangeTblEntry *rangeTableEntry = NULL;
+	Oid distributedTableId = InvalidOid;
+	Var *partitionColumn = NULL;
+	List *qualList = NIL;
+	ListCell *qualCell = NULL;
+
+	if (query->commandType != CMD_SELECT || query->utilityStmt != NULL)
+	{
+		return false;
+	}
+
+	if (query->hasSubLinks || query->hasForUpdate || query->hasRecursive ||
+		query->hasModifyingCTE || query->cteList != NIL ||
+		query->setOperations != NULL)
+	{
+		return false;
+	}
+
+	if (list_length(query->rtable) != 1 || joinTree == NULL ||
+		joinTree->quals == NULL || list_length(joinTree->fromlist) != 1 ||
+		!IsA(linitial(joinTree->fromlist), RangeTblRef))
+	{
+		return false;
+	}
+
+	rangeTableEntry = (RangeTblEntry *) linitial(query->rtable);
+	if (rangeTableEntry->rtekind != RTE_RELATION ||
+		rangeTableEntry->tablesample != NULL)
+	{
+		return false;
+	}
+
+	distributedTableId = rangeTableEntry->relid;
+	if (!IsDistributedTable(distributedTableId) ||
+		PartitionMethod(distributedTableId) != DISTRIBUTE_BY_HASH)
+	{
+		return false;
+	}
+
+	partitionColumn = PartitionColumn(distributedTableId, 1);
+	qualList = make_ands_implicit((Expr *) joinTree->quals);
+
+	foreach(qualCell, qualList)
+	{
+		Node *qual = (Node *) lfirst(qualCell);
+		Node *qualPartitionValue = FastPathPartitionValue(qual, partitionColumn,
+														  boundParams);
+
+		if (qualPartitionValue != NULL)
+		{
+			*partitionValue = qualPartitionValue;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+/*
+ * FastPathPartitionValue returns the value the partition column is compared
+ * to if the given clause is a hashable equality between the partition column
+ * and a constant or a parameter. Parameters with a value that postgres treats
+ * as constant are returned as a constant, other parameters are returned as
+ * is. If the clause is of another form, the function returns NULL.
+ *
+ * The partition column may only be wrapped in a binary compatible relabeling,
+ * so that hashing the value gives the same result as hashing the column.
+ */
+static Node *
+FastPathPartitionValue(Node *clause, Var *partitionColumn, ParamListInfo boundParams)
+{
+	OpExpr *operatorExpression = NULL;
+	Node *leftOperand = NULL;
+	Node *rightOperand = NULL;
+	Node *columnOperand = NULL;
+	Node *valueOperand = NULL;
+	Var *column = NULL;
+	Oid leftHashFunction = InvalidOid;
+	Oid rightHashFunction = InvalidOid;
+
+	if (!IsA(clause, OpExpr) || list_length(((OpExpr *) clause)->args) != 2)
+	{
+		return NULL;
+	}
+
+	operatorExpression = (OpExpr *) clause;
+	if (!get_op_hash_functions(operatorExpression->opno, &leftHashFunction,
+							   &rightHashFunction))
+	{
+		return NULL;
+	}
+
+	leftOperand = get_leftop((Expr *) operatorExpression);
+	rightOperand = get_rightop((Expr *) operatorExpression);
+
+	if (IsA(leftOperand, RelabelType))
+	{
+		leftOperand = (Node *) ((RelabelType *) leftOperand)->arg;
+	}
+
+	if (IsA(rightOperand, RelabelType))
+	{
+		rightOperand = (Node *) ((RelabelType *) rightOperand)->arg;
+	}
+
+	if (IsA(leftOperand, Var))
+	{
+		columnOperand = leftOperand;
+		valueOperand = rightOperand;
+	}
+	else if (IsA(rightOperand, Var))
+	{
+		columnOperand = rightOperand;
+		valueOperand = leftOperand;
+	}
+	else
+	{
+		return NULL;
+	}
+
+	column = (Var *) columnOperand;
+	if (column->varno != partitionColumn->varno || column->varlevelsup != 0 ||
+		column->varattno != partitionColumn->varattno)
+	{
+		return NULL;
+	}
+
+	if (IsA(valueOperand, Const))
+	{
+		Const *constant = (Const *) valueOperand;
+
+		if (constant->constisnull)
+		{
+			return NULL;
+		}
+
+		return (Node *) constant;
+	}
+	else if (IsA(valueOperand, Param))
+	{
+		Param *parameter = (Param *) valueOperand;
+		ParamExternData *parameterData = NULL;
+		int16 typeLength = 0;
+		bool typeByValue = false;
+
+		if (parameter->paramkind != PARAM_EXTERN)
+		{
+			return NULL;
+		}
+
+		/* leave the parameter to execution time unless its value is fixed */
+		if (boundParams == NULL || boundParams->paramFetch != NULL ||
+			parameter->paramid <= 0 || parameter->paramid > boundParams->numParams)
+		{
+			return (Node *) parameter;
+		}
+
+		parameterData = &boundParams->params[parameter->paramid - 1];
+		if (parameterData->ptype != parameter->paramtype || parameterData->isnull ||
+			!(parameterData->pflags & PARAM_FLAG_CONST))
+		{
+			return (Node *) parameter;
+		}
+
+		get_typlenbyval(parameter->paramtype, &typeLength, &typeByValue);
+
+		return (Node *) makeConst(parameter->paramtype, parameter->paramtypmod,
+								  parameter->paramcollid, typeLength,
+								  parameterData->value, false, typeByValue);
+	}
+
+	return NULL;
+}
+
+
+/*
+ * FastPathShardInterval returns the shard of the given hash distributed table
+ * that the given partition column value falls into, or NULL if the shard
+ * cannot be determined from the metadata cache. The value is hashed with the
+ * hash function of its own type, which the hash operator family guarantees to
+ * agree with the hash function of the partition column's type.
+ */
+static ShardInterval *
+FastPathShardInterval(Oid relationId, Oid valueType, Datum partitionValue)
+{
+	DistTableCacheEntry *cacheEntry = DistributedTableCacheEntry(relationId);
+	int shardCount = cacheEntry->shardIntervalArrayLength;
+	bool useBinarySearch = !cacheEntry->hasUniformHashDistribution;
+	TypeCacheEntry *typeEntry = NULL;
+
+	if (shardCount == 0 || cacheEntry->hasUninitializedShardInterval)
+	{
+		return NULL;
+	}
+
+	typeEntry = lookup_type_cache(valueType, TYPECACHE_HASH_PROC_FINFO);
+	if (!OidIsValid(typeEntry->hash_proc_finfo.fn_oid))
+	{
+		return NULL;
+	}
+
+	return FindShardInterval(partitionValue, cacheEntry->sortedShardIntervalArray,
+							 shardCount, DISTRIBUTE_BY_HASH,
+							 cacheEntry->shardIntervalCompareFunction,
+							 &typeEntry->hash_proc_finfo, useBinarySearch);
+}
+
+
 /*
  * QueryRestrictList returns the restriction clauses for the query. For a SELECT
  * statement these are the where-clause expressions. For INSERT statements we
@@ -2533,6 +3066,7 @@ TargetShardIntervalsForSelect(Query *query,
 		List *baseRestrictionList = relationRestriction->relOptInfo->baserestrictinfo;
 		List *restrictClauseList = get_all_actual_clauses(baseRestrictionList);
 		List *prunedShardList = NIL;
+		List *removedShardList = NIL;
 		int shardIndex = 0;
 		List *joinInfoList = relationRestriction->relOptInfo->joininfo;
 		List *pseudoRestrictionList = extract_actual_clauses(joinInfoList, true);
@@ -2558,20 +3092,24 @@ TargetShardIntervalsForSelect(Query *query,
 				shardIntervalList = lappend(shardIntervalList, shardInterval);
 			}
 
-			prunedShardList = PruneShardList(relationId, tableId,
-											 restrictClauseList,
-											 shardIntervalList);
+			prunedShardList = PruneShardIntervalList(relationId, tableId,
+													 restrictClauseList,
+													 shardIntervalList,
+													 &removedShardList);
 
 			/*
 			 * Quick bail out. The query can not be router plannable if one
 			 * relation has more than one shard left after pruning. Having no
 			 * shard left is okay at this point. It will be handled at a later
-			 * stage.
+			 * stage. The pruned shards of the relation are not logged here,
+			 * since the multi-shard planner prunes and logs them again.
 			 */
 			if (list_length(prunedShardList) > 1)
 			{
 				return NULL;
 			}
+
+			LogRemovedShardIntervals(removedShardList);
 		}
 
 		relationRestriction->prunedShardIntervalList = prunedShardList;
@@ -27,6 +27,7 @@
 #include "distributed/multi_explain.h"
 #include "distributed/multi_join_order.h"
 #include "distributed/multi_logical_optimizer.h"
+#include "distributed/multi_master_planner.h"
 #include "distributed/multi_planner.h"
 #include "distributed/multi_router_executor.h"
 #include "distributed/multi_router_planner.h"
@@ -35,6 +36,7 @@
 #include "distributed/pg_dist_partition.h"
 #include "distributed/placement_connection.h"
 #include "distributed/remote_commands.h"
+#include "distributed/shared_connection_stats.h"
 #include "distributed/task_tracker.h"
 #include "distributed/transaction_management.h"
 #include "distributed/worker_manager.h"
@@ -137,6 +139,12 @@ _PG_init(void)
 	/* make our additional node types known */
 	RegisterNodes();
 
+#if (PG_VERSION_NUM >= 90600)
+
+	/* make our custom scans known to parallel workers */
+	RegisterCitusCustomScanMethods();
+#endif
+
 	/* intercept planner */
 	planner_hook = multi_planner;
 
@@ -149,6 +157,9 @@ _PG_init(void)
 	/* organize that task tracker is started once server is up */
 	TaskTrackerRegister();
 
+	/* organize that the shared connection budget is allocated */
+	InitializeSharedConnectionStats();
+
 	/* initialize coordinated transaction management */
 	InitializeTransactionManagement();
 	InitializeConnectionManagement();
@@ -207,6 +218,54 @@ RegisterCitusConfigVariables(void)
 		GUC_UNIT_MS,
 		NULL, NULL, NULL);
 
+	DefineCustomIntVariable(
+		"citus.max_cached_conns_per_worker",
+		gettext_noop("Sets the maximum number of idle connections to keep open "
+					 "per worker."),
+		gettext_noop("By default, the real-time and task-tracker executors "
+					 "close their connections to worker nodes at the end of "
+					 "each query. When this value is set, up to this many "
+					 "idle connections per worker are kept open across "
+					 "transactions, and reused by later queries of the same "
+					 "session. This avoids the cost of connection establishment "
+					 "for repeated queries. 0 disables connection caching."),
+		&MaxCachedConnectionsPerWorker,
+		0, 0, INT_MAX,
+		PGC_USERSET,
+		0,
+		NULL, NULL, NULL);
+
+	DefineCustomIntVariable(
+		"citus.max_cached_connection_lifetime",
+		gettext_noop("Sets the maximum age of connections kept open across "
+					 "transactions."),
+		gettext_noop("Connections to worker nodes that are kept open across "
+					 "transactions are closed at transaction end once they "
+					 "have been open for longer than this. -1 disables the "
+					 "limit."),
+		&MaxCachedConnectionLifetime,
+		10 * 60 * 1000, -1, INT_MAX,
+		PGC_USERSET,
+		GUC_UNIT_MS,
+		NULL, NULL, NULL);
+
+	DefineCustomIntVariable(
+		"citus.max_prepared_statements_per_connection",
+		gettext_noop("Sets the maximum number of router statements to prepare "
+					 "on each worker connection."),
+		gettext_noop("When this value is set, parameterized router queries and "
+					 "modifications are prepared on the worker the first time "
+					 "they are sent over a connection, and later executions "
+					 "reuse the prepared statement instead of having the worker "
+					 "parse and plan the command again. This is most useful "
+					 "together with citus.max_cached_conns_per_worker. 0 "
+					 "disables preparing statements on workers."),
+		&MaxPreparedStatementsPerConnection,
+		0, 0, INT_MAX,
+		PGC_USERSET,
+		0,
+		NULL, NULL, NULL);
+
 	/* keeping temporarily for updates from pre-6.0 versions */
 	DefineCustomStringVariable(
 		"citus.worker_list_file",
@@ -230,6 +289,37 @@ RegisterCitusConfigVariables(void)
 		0,
 		NULL, NULL, NULL);
 
+	DefineCustomBoolVariable(
+		"citus.enable_result_streaming",
+		gettext_noop("Streams the results of real-time queries as they arrive."),
+		gettext_noop("By default, the real-time executor copies the results "
+					 "of all tasks into files on the master node, and only "
+					 "then returns them. When enabled, rows are instead "
+					 "fetched from workers one by one, and returned as soon "
+					 "as they arrive. This reduces the time until the first "
+					 "row is returned, and avoids writing intermediate results "
+					 "to disk. Rows of different tasks may then be returned "
+					 "in any order."),
+		&EnableResultStreaming,
+		false,
+		PGC_USERSET,
+		0,
+		NULL, NULL, NULL);
+
+	DefineCustomBoolVariable(
+		"citus.enable_binary_protocol",
+		gettext_noop("Receives select query results from workers in binary format."),
+		gettext_noop("When enabled, router queries and streamed real-time queries "
+					 "ask workers to send their results in binary format, which "
+					 "saves parsing text values on the master. This is only used "
+					 "when all result columns have built-in types with binary "
+					 "receive functions."),
+		&EnableBinaryProtocol,
+		false,
+		PGC_USERSET,
+		0,
+		NULL, NULL, NULL);
+
 	DefineCustomBoolVariable(
 		"citus.binary_worker_copy_format",
 		gettext_noop("Use the binary worker copy format."),
@@ -265,6 +355,21 @@ RegisterCitusConfigVariables(void)
 		0,
 		NULL, NULL, NULL);
 
+	DefineCustomBoolVariable(
+		"citus.enable_cost_based_join_order",
+		gettext_noop("Picks distributed join orders by estimated network traffic."),
+		gettext_noop("When enabled, the planner estimates the bytes each candidate "
+					 "join order broadcasts or re-partitions using the shard "
+					 "lengths in the metadata, and picks the join order with the "
+					 "lowest estimate. Shard lengths can be refreshed using "
+					 "master_update_shard_statistics(). The rule based join order "
+					 "heuristics are used to break ties."),
+		&EnableCostBasedJoinOrder,
+		false,
+		PGC_USERSET,
+		0,
+		NULL, NULL, NULL);
+
 	DefineCustomBoolVariable(
 		"citus.log_multi_join_order",
 		gettext_noop("Logs the distributed join order to the server log."),
@@ -354,6 +459,20 @@ RegisterCitusConfigVariables(void)
 		GUC_NO_SHOW_ALL,
 		NULL, NULL, NULL);
 
+	DefineCustomBoolVariable(
+		"citus.enable_fast_path_router_planner",
+		gettext_noop("Plans single shard lookups without the postgres planner."),
+		gettext_noop("When enabled, SELECT queries on a single hash distributed "
+					 "table that filter on the partition column with an "
+					 "equality, such as lookups by key, are planned directly "
+					 "from the parse tree. This skips the postgres planner and "
+					 "restriction based shard pruning for such queries."),
+		&EnableFastPathRouterPlanner,
+		false,
+		PGC_USERSET,
+		0,
+		NULL, NULL, NULL);
+
 	DefineCustomIntVariable(
 		"citus.shard_count",
 		gettext_noop("Sets the number of shards for a new hash-partitioned table"
@@ -420,6 +539,58 @@ RegisterCitusConfigVariables(void)
 		GUC_UNIT_MS,
 		NULL, NULL, NULL);
 
+	DefineCustomIntVariable(
+		"citus.max_connections_per_worker",
+		gettext_noop("Sets the maximum number of connections a query opens per worker."),
+		gettext_noop("By default, the real-time executor opens a separate "
+					 "connection for each task. When this value is set, each "
+					 "query opens at most this many connections to a worker "
+					 "node, and runs the remaining tasks for that worker "
+					 "back-to-back on these connections. 0 disables the limit."),
+		&MaxConnectionsPerWorker,
+		0, 0, INT_MAX,
+		PGC_USERSET,
+		0,
+		NULL, NULL, NULL);
+
+	DefineCustomIntVariable(
+		"citus.max_shared_connections_per_worker",
+		gettext_noop("Sets the maximum number of connections all backends open "
+					 "to a worker."),
+		gettext_noop("Connection throttling in the real-time executor is per "
+					 "query, so many concurrent sessions can together exceed "
+					 "max_connections on a worker node. When set, all backends "
+					 "on this node share a budget of this many connections per "
+					 "worker, and tasks wait for a connection to become "
+					 "available once the budget is used up. Only connections "
+					 "opened by the real-time executor are counted; router and "
+					 "task-tracker executor connections are not limited. Idle "
+					 "connections kept open by citus.max_cached_conns_per_worker "
+					 "keep counting against the budget until they are closed. "
+					 "0 disables the shared budget."),
+		&MaxSharedConnectionsPerWorker,
+		0, 0, INT_MAX,
+		PGC_SIGHUP,
+		0,
+		NULL, NULL, NULL);
+
+	DefineCustomIntVariable(
+		"citus.executor_slow_start_interval",
+		gettext_noop("Sets the interval at which the real-time executor opens "
+					 "additional connections to a worker."),
+		gettext_noop("When set, the real-time executor starts a query with one "
+					 "connection per worker node. For every interval in which "
+					 "tasks for a worker had to wait for a connection, the "
+					 "number of allowed connections to that worker doubles, up "
+					 "to citus.max_connections_per_worker. Short queries thus "
+					 "avoid opening many connections, while long running "
+					 "queries still get full parallelism. 0 disables slow start."),
+		&ExecutorSlowStartInterval,
+		0, 0, INT_MAX,
+		PGC_USERSET,
+		GUC_UNIT_MS,
+		NULL, NULL, NULL);
+
 	DefineCustomIntVariable(
 		"citus.task_tracker_delay",
 		gettext_noop("Task tracker sleep time between task management rounds."),
@@ -502,6 +673,37 @@ RegisterCitusConfigVariables(void)
 		0,
 		NULL, NULL, NULL);
 
+	DefineCustomIntVariable(
+		"citus.broadcast_join_size_threshold",
+		gettext_noop("Sets the size threshold under which tables are broadcast in joins."),
+		gettext_noop("When set, distributed tables whose total shard length does "
+					 "not exceed this size are broadcast to the workers in joins, "
+					 "and larger tables are re-partitioned, regardless of their "
+					 "shard count. Shard lengths can be refreshed using "
+					 "master_update_shard_statistics(). Tables without shard "
+					 "lengths, and all tables when set to 0, use "
+					 "citus.large_table_shard_count instead."),
+		&BroadcastJoinSizeThreshold,
+		0, 0, INT_MAX,
+		PGC_USERSET,
+		GUC_UNIT_KB,
+		NULL, NULL, NULL);
+
+	DefineCustomIntVariable(
+		"citus.max_master_parallel_workers",
+		gettext_noop("Sets the number of parallel workers for master aggregation."),
+		gettext_noop("When set, the master node computes the aggregates of "
+					 "select queries with PostgreSQL's parallel workers, each "
+					 "of which reads part of the task results. The number of "
+					 "workers is also limited by max_parallel_workers_per_gather. "
+					 "This requires PostgreSQL 9.6, and aggregates that support "
+					 "partial aggregation. 0 disables parallel master aggregation."),
+		&MaxMasterParallelWorkers,
+		0, 0, MAX_BACKENDS,
+		PGC_USERSET,
+		0,
+		NULL, NULL, NULL);
+
 	DefineCustomIntVariable(
 		"citus.limit_clause_row_fetch_count",
 		gettext_noop("Number of rows to fetch per task for limit clause optimization."),
@@ -517,6 +719,51 @@ RegisterCitusConfigVariables(void)
 		0,
 		NULL, NULL, NULL);
 
+	DefineCustomIntVariable(
+		"citus.limit_clause_overfetch_factor",
+		gettext_noop("Multiplier of the limit that sets the number of rows to fetch "
+					 "per task for limit clause optimization."),
+		gettext_noop("Where an approximation would produce meaningful results, "
+					 "select queries that order by aggregates fetch this many "
+					 "times the rows requested by their limit clause from each "
+					 "task. Unlike citus.limit_clause_row_fetch_count, this scales "
+					 "with the limit, so top-N queries stay accurate as N grows. "
+					 "0 disables this optimization."),
+		&LimitClauseOverfetchFactor,
+		0, 0, INT_MAX,
+		PGC_USERSET,
+		0,
+		NULL, NULL, NULL);
+
+	DefineCustomBoolVariable(
+		"citus.enable_sorted_merge",
+		gettext_noop("Merges sorted task results instead of sorting them again."),
+		gettext_noop("When enabled, select queries that only sort their results "
+					 "push the sort down to the tasks, and the master merges "
+					 "the sorted task results while reading them. This avoids "
+					 "a full sort on the master and returns the first rows "
+					 "sooner."),
+		&EnableSortedMerge,
+		false,
+		PGC_USERSET,
+		0,
+		NULL, NULL, NULL);
+
+	DefineCustomBoolVariable(
+		"citus.enable_group_by_pushdown",
+		gettext_noop("Computes groups on the distribution column fully on workers."),
+		gettext_noop("When a query groups by the distribution column of its "
+					 "distributed tables, each group is computed by a single "
+					 "task. When enabled, these queries run their aggregates, "
+					 "group by and having clauses on the workers, and the master "
+					 "only concatenates the task results instead of grouping "
+					 "them again."),
+		&EnableGroupByPushdown,
+		false,
+		PGC_USERSET,
+		0,
+		NULL, NULL, NULL);
+
 	DefineCustomRealVariable(
 		"citus.count_distinct_error_rate",
 		gettext_noop("Desired error rate when calculating count(distinct) "
@@ -530,6 +777,20 @@ RegisterCitusConfigVariables(void)
 		0,
 		NULL, NULL, NULL);
 
+	DefineCustomIntVariable(
+		"citus.percentile_approximation_compression",
+		gettext_noop("Sets the compression of the sketches used when calculating "
+					 "percentile_cont() approximates."),
+		gettext_noop("Sketches keep a number of centroids proportional to this "
+					 "value; higher values give more accurate percentiles at the "
+					 "cost of larger sketches. 0 disables approximations for "
+					 "percentile_cont()."),
+		&PercentileApproximationCompression,
+		0, 0, 10000,
+		PGC_USERSET,
+		0,
+		NULL, NULL, NULL);
+
 	DefineCustomEnumVariable(
 		"citus.multi_shard_commit_protocol",
 		gettext_noop("Sets the commit protocol for commands modifying multiple shards."),
@@ -0,0 +1,84 @@
+/*-------------------------------------------------------------------------
+ *
+ * test/src/find_shard_interval.c
+ *
+ * This file contains functions to benchmark finding the shard interval of
+ * a partition column value within Citus.
+ *
+ * Copyright (c) 2014-2016, Citus Data, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+#include "fmgr.h"
+
+#include "distributed/metadata_cache.h"
+#include "distributed/pg_dist_partition.h"
+#include "distributed/shardinterval_utils.h"
+#include "distributed/test_helper_functions.h" /* IWYU pragma: keep */
+#include "portability/instr_time.h"
+#include "utils/fmgroids.h"
+
+
+/* declarations for dynamic loading */
+PG_FUNCTION_INFO_V1(find_shard_interval_benchmark);
+
+
+/*
+ * find_shard_interval_benchmark finds the shard intervals of the given number
+ * of integer values for the given hash distributed table, and returns the time
+ * spent in milliseconds. If useBinarySearch is false, shard intervals are found
+ * arithmetically, which requires the table to have a uniform hash distribution.
+ * Comparing the two gives the throughput of the lookups done for every row of a
+ * COPY and for every router query.
+ */
+Datum
+find_shard_interval_benchmark(PG_FUNCTION_ARGS)
+{
+	Oid distributedTableId = PG_GETARG_OID(0);
+	int32 lookupCount = PG_GETARG_INT32(1);
+	bool useBinarySearch = PG_GETARG_BOOL(2);
+	DistTableCacheEntry *cacheEntry = DistributedTableCacheEntry(distributedTableId);
+	ShardInterval **shardIntervalArray = cacheEntry->sortedShardIntervalArray;
+	int shardCount = cacheEntry->shardIntervalArrayLength;
+	FmgrInfo *compareFunction = cacheEntry->shardIntervalCompareFunction;
+	FmgrInfo *hashFunction = (FmgrInfo *) palloc0(sizeof(FmgrInfo));
+	int32 lookupIndex = 0;
+	instr_time startTime;
+	instr_time duration;
+
+	if (cacheEntry->partitionMethod != DISTRIBUTE_BY_HASH || shardCount == 0 ||
+		cacheEntry->hasUninitializedShardInterval ||
+		(!useBinarySearch && !cacheEntry->hasUniformHashDistribution))
+	{
+		ereport(ERROR, (errmsg("cannot benchmark shard interval lookups"),
+						errdetail("Table must be hash distributed with %s shards.",
+								  useBinarySearch ? "initialized" :
+								  "uniformly distributed")));
+	}
+
+	/* look up integer values independent of the type of the partition column */
+	fmgr_info(F_HASHINT4, hashFunction);
+
+	INSTR_TIME_SET_CURRENT(startTime);
+
+	for (lookupIndex = 0; lookupIndex < lookupCount; lookupIndex++)
+	{
+		ShardInterval *shardInterval = FindShardInterval(Int32GetDatum(lookupIndex),
+														 shardIntervalArray, shardCount,
+														 DISTRIBUTE_BY_HASH,
+														 compareFunction, hashFunction,
+														 useBinarySearch);
+		if (shardInterval == NULL)
+		{
+			ereport(ERROR, (errmsg("could not find shard interval for value %d",
+								   lookupIndex)));
+		}
+	}
+
+	INSTR_TIME_SET_CURRENT(duration);
+	INSTR_TIME_SUBTRACT(duration, startTime);
+
+	PG_RETURN_FLOAT8(INSTR_TIME_GET_MILLISEC(duration));
+}
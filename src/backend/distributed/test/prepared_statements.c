@@ -0,0 +1,62 @@
+/*-------------------------------------------------------------------------
+ *
+ * test/src/prepared_statements.c
+ *
+ * This file contains functions to inspect the statements that this backend
+ * has prepared on its worker connections.
+ *
+ * Copyright (c) 2017, Citus Data, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+#include "fmgr.h"
+
+#include "distributed/connection_management.h"
+#include "distributed/test_helper_functions.h" /* IWYU pragma: keep */
+#include "lib/ilist.h"
+#include "utils/builtins.h"
+#include "utils/hsearch.h"
+
+
+/* declarations for dynamic loading */
+PG_FUNCTION_INFO_V1(remote_prepared_statement_count);
+
+
+/*
+ * remote_prepared_statement_count returns the number of statements that this
+ * backend has prepared on its open connections to the given worker node.
+ */
+Datum
+remote_prepared_statement_count(PG_FUNCTION_ARGS)
+{
+	text *workerNameText = PG_GETARG_TEXT_P(0);
+	int32 workerPort = PG_GETARG_INT32(1);
+	char *workerName = text_to_cstring(workerNameText);
+	int32 preparedStatementCount = 0;
+	HASH_SEQ_STATUS status;
+	ConnectionHashEntry *entry = NULL;
+
+	hash_seq_init(&status, ConnectionHash);
+	while ((entry = (ConnectionHashEntry *) hash_seq_search(&status)) != NULL)
+	{
+		dlist_iter iter;
+
+		if (strcmp(entry->key.hostname, workerName) != 0 ||
+			entry->key.port != workerPort)
+		{
+			continue;
+		}
+
+		dlist_foreach(iter, entry->connections)
+		{
+			MultiConnection *connection =
+				dlist_container(MultiConnection, connectionNode, iter.cur);
+
+			preparedStatementCount += list_length(connection->preparedStatementList);
+		}
+	}
+
+	PG_RETURN_INT32(preparedStatementCount);
+}
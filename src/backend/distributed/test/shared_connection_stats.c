@@ -0,0 +1,39 @@
+/*-------------------------------------------------------------------------
+ *
+ * test/src/shared_connection_stats.c
+ *
+ * This file contains functions to inspect the connection budget that all
+ * backends share per worker node.
+ *
+ * Copyright (c) 2017, Citus Data, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+#include "fmgr.h"
+
+#include "distributed/shared_connection_stats.h"
+#include "distributed/test_helper_functions.h" /* IWYU pragma: keep */
+#include "utils/builtins.h"
+
+
+/* declarations for dynamic loading */
+PG_FUNCTION_INFO_V1(shared_connection_count);
+
+
+/*
+ * shared_connection_count returns the number of connections that all backends
+ * currently have reserved to the given worker node.
+ */
+Datum
+shared_connection_count(PG_FUNCTION_ARGS)
+{
+	text *workerNameText = PG_GETARG_TEXT_P(0);
+	int32 workerPort = PG_GETARG_INT32(1);
+	char *workerName = text_to_cstring(workerNameText);
+
+	uint32 connectionCount = SharedConnectionCount(workerName, workerPort);
+
+	PG_RETURN_INT32(connectionCount);
+}
@@ -21,9 +21,11 @@
 #include "access/xact.h"
 #include "distributed/connection_management.h"
 #include "distributed/hash_helpers.h"
+#include "distributed/multi_client_executor.h"
 #include "distributed/multi_shard_transaction.h"
 #include "distributed/transaction_management.h"
 #include "distributed/placement_connection.h"
+#include "distributed/shared_connection_stats.h"
 #include "utils/hsearch.h"
 #include "utils/guc.h"
 
@@ -163,6 +165,9 @@ CoordinatedTransactionCallback(XactEvent event, void *arg)
 				AfterXactConnectionHandling(true);
 			}
 
+			/* cached connections keep their reservations until closed */
+			ReleaseUnheldSharedConnections();
+
 			Assert(!subXactAbortAttempted);
 			CurrentCoordinatedTransactionState = COORD_TRANS_NONE;
 			XactModificationLevel = XACT_MODIFICATION_NONE;
@@ -186,6 +191,10 @@ CoordinatedTransactionCallback(XactEvent event, void *arg)
 			 */
 			ResetShardPlacementTransactionState();
 
+			/* close connections of executions that were interrupted by the error */
+			MultiClientDisconnectAll();
+			MultiClientFreeAllWaitEventSets();
+
 			/* handles both already prepared and open transactions */
 			if (CurrentCoordinatedTransactionState > COORD_TRANS_IDLE)
 			{
@@ -199,6 +208,9 @@ CoordinatedTransactionCallback(XactEvent event, void *arg)
 				AfterXactConnectionHandling(false);
 			}
 
+			/* return reservations an aborted execution could not pass on */
+			ReleaseUnheldSharedConnections();
+
 			CurrentCoordinatedTransactionState = COORD_TRANS_NONE;
 			XactModificationLevel = XACT_MODIFICATION_NONE;
 			dlist_init(&InProgressTransactions);
@@ -0,0 +1,649 @@
+/*-------------------------------------------------------------------------
+ *
+ * aggregate_utils.c
+ *
+ * Implementation of the worker_partial_agg() and master_combine_agg()
+ * aggregates. Together, they compute any aggregate that has a combine function
+ * in two phases: worker_partial_agg() computes the aggregate's transition state
+ * over a shard and serializes it, and master_combine_agg() deserializes the
+ * states of all shards on the master node, combines them with the aggregate's
+ * combine function, and applies the aggregate's final function.
+ *
+ * Copyright (c) 2017, Citus Data, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+#include "fmgr.h"
+
+#include "access/htup_details.h"
+#include "catalog/pg_aggregate.h"
+#include "catalog/pg_type.h"
+#include "lib/stringinfo.h"
+#include "parser/parse_agg.h"
+#include "utils/builtins.h"
+#include "utils/datum.h"
+#include "utils/lsyscache.h"
+#include "utils/syscache.h"
+
+
+/* declarations for dynamic loading */
+PG_FUNCTION_INFO_V1(worker_partial_agg_sfunc);
+PG_FUNCTION_INFO_V1(worker_partial_agg_ffunc);
+PG_FUNCTION_INFO_V1(master_combine_agg_sfunc);
+PG_FUNCTION_INFO_V1(master_combine_agg_ffunc);
+
+
+#if (PG_VERSION_NUM >= 90600)
+
+/*
+ * AggregateStateBox keeps the transition state of the aggregate computed by
+ * worker_partial_agg() or master_combine_agg(), together with the functions
+ * that advance, (de)serialize and finalize this state. On worker nodes, the
+ * state is advanced with the aggregate's transition function; on the master
+ * node, it is advanced with the aggregate's combine function.
+ */
+typedef struct AggregateStateBox
+{
+	Oid aggregateId;
+	Oid transitionTypeId;
+	int16 transitionTypeLength;
+	bool transitionTypeByValue;
+	Oid transitionTypeIOParam;
+
+	Datum value;
+	bool valueNull;
+
+	FmgrInfo transitionFunction;
+	FmgrInfo serialFunction;
+	FmgrInfo finalFunction;
+	int finalArgumentCount;
+} AggregateStateBox;
+
+
+/* local function forward declarations */
+static AggregateStateBox * CreateAggregateStateBox(FunctionCallInfo fcinfo,
+												   Oid aggregateId, Oid argumentTypeId,
+												   bool combineStates);
+static MemoryContext AggregateContext(FunctionCallInfo fcinfo);
+static void AdvanceAggregateState(AggregateStateBox *box, FunctionCallInfo fcinfo,
+								  Datum argument, bool argumentNull);
+static bytea * SerializeAggregateState(AggregateStateBox *box,
+									   FunctionCallInfo fcinfo);
+static Datum DeserializeAggregateState(AggregateStateBox *box, FunctionCallInfo fcinfo,
+									   bytea *serializedState);
+
+
+/*
+ * worker_partial_agg_sfunc advances the transition state of the given aggregate
+ * with the given argument, using the aggregate's transition function. The
+ * function creates the state on its first call.
+ */
+Datum
+worker_partial_agg_sfunc(PG_FUNCTION_ARGS)
+{
+	AggregateStateBox *box = NULL;
+	Datum argument = PG_GETARG_DATUM(2);
+	bool argumentNull = PG_ARGISNULL(2);
+
+	if (PG_ARGISNULL(0))
+	{
+		Oid aggregateId = InvalidOid;
+		Oid argumentTypeId = get_fn_expr_argtype(fcinfo->flinfo, 2);
+
+		if (PG_ARGISNULL(1))
+		{
+			ereport(ERROR, (errmsg("aggregate oid cannot be null")));
+		}
+
+		aggregateId = PG_GETARG_OID(1);
+		box = CreateAggregateStateBox(fcinfo, aggregateId, argumentTypeId, false);
+	}
+	else
+	{
+		box = (AggregateStateBox *) PG_GETARG_POINTER(0);
+	}
+
+	/*
+	 * Like the executor, we skip null inputs for strict transition functions,
+	 * and use the first non-null input as the state if there's no initial one.
+	 */
+	if (box->transitionFunction.fn_strict)
+	{
+		if (argumentNull)
+		{
+			PG_RETURN_POINTER(box);
+		}
+
+		if (box->valueNull)
+		{
+			MemoryContext oldContext = MemoryContextSwitchTo(AggregateContext(fcinfo));
+
+			box->value = datumCopy(argument, box->transitionTypeByValue,
+								   box->transitionTypeLength);
+			box->valueNull = false;
+
+			MemoryContextSwitchTo(oldContext);
+
+			PG_RETURN_POINTER(box);
+		}
+	}
+
+	AdvanceAggregateState(box, fcinfo, argument, argumentNull);
+
+	PG_RETURN_POINTER(box);
+}
+
+
+/*
+ * worker_partial_agg_ffunc serializes the transition state computed by
+ * worker_partial_agg_sfunc, so that it can be sent to the master node. The
+ * function returns null if the state is null.
+ */
+Datum
+worker_partial_agg_ffunc(PG_FUNCTION_ARGS)
+{
+	AggregateStateBox *box = NULL;
+	bytea *serializedState = NULL;
+
+	if (PG_ARGISNULL(0))
+	{
+		PG_RETURN_NULL();
+	}
+
+	box = (AggregateStateBox *) PG_GETARG_POINTER(0);
+	if (box->valueNull)
+	{
+		PG_RETURN_NULL();
+	}
+
+	serializedState = SerializeAggregateState(box, fcinfo);
+	if (serializedState == NULL)
+	{
+		PG_RETURN_NULL();
+	}
+
+	PG_RETURN_BYTEA_P(serializedState);
+}
+
+
+/*
+ * master_combine_agg_sfunc deserializes a transition state computed by
+ * worker_partial_agg() and combines it into the aggregate's state using the
+ * aggregate's combine function. The function creates the state on its first
+ * call, and skips null states which come from shards without any rows.
+ */
+Datum
+master_combine_agg_sfunc(PG_FUNCTION_ARGS)
+{
+	AggregateStateBox *box = NULL;
+	Datum partialState = 0;
+
+	if (PG_ARGISNULL(0))
+	{
+		Oid aggregateId = InvalidOid;
+		Oid resultTypeId = get_fn_expr_argtype(fcinfo->flinfo, 3);
+
+		if (PG_ARGISNULL(1))
+		{
+			ereport(ERROR, (errmsg("aggregate oid cannot be null")));
+		}
+
+		aggregateId = PG_GETARG_OID(1);
+		box = CreateAggregateStateBox(fcinfo, aggregateId, resultTypeId, true);
+	}
+	else
+	{
+		box = (AggregateStateBox *) PG_GETARG_POINTER(0);
+	}
+
+	if (PG_ARGISNULL(2))
+	{
+		PG_RETURN_POINTER(box);
+	}
+
+	partialState = DeserializeAggregateState(box, fcinfo, PG_GETARG_BYTEA_PP(2));
+
+	/* a strict combine function takes the first state as is */
+	if (box->transitionFunction.fn_strict && box->valueNull)
+	{
+		MemoryContext oldContext = MemoryContextSwitchTo(AggregateContext(fcinfo));
+
+		box->value = datumCopy(partialState, box->transitionTypeByValue,
+							   box->transitionTypeLength);
+		box->valueNull = false;
+
+		MemoryContextSwitchTo(oldContext);
+
+		PG_RETURN_POINTER(box);
+	}
+
+	AdvanceAggregateState(box, fcinfo, partialState, false);
+
+	PG_RETURN_POINTER(box);
+}
+
+
+/*
+ * master_combine_agg_ffunc applies the aggregate's final function to the
+ * combined transition state, and returns the aggregate's result. If the
+ * aggregate has no final function, the function returns the state itself.
+ */
+Datum
+master_combine_agg_ffunc(PG_FUNCTION_ARGS)
+{
+	AggregateStateBox *box = NULL;
+	FunctionCallInfoData finalFunctionCallInfo;
+	Datum result = 0;
+	int argumentIndex = 0;
+
+	if (PG_ARGISNULL(0))
+	{
+		PG_RETURN_NULL();
+	}
+
+	box = (AggregateStateBox *) PG_GETARG_POINTER(0);
+	if (!OidIsValid(box->finalFunction.fn_oid))
+	{
+		if (box->valueNull)
+		{
+			PG_RETURN_NULL();
+		}
+
+		PG_RETURN_DATUM(box->value);
+	}
+
+	if (box->finalFunction.fn_strict && box->valueNull)
+	{
+		PG_RETURN_NULL();
+	}
+
+	InitFunctionCallInfoData(finalFunctionCallInfo, &box->finalFunction,
+							 box->finalArgumentCount, fcinfo->fncollation,
+							 fcinfo->context, NULL);
+
+	finalFunctionCallInfo.arg[0] = box->value;
+	finalFunctionCallInfo.argnull[0] = box->valueNull;
+
+	/* aggregates with extra final function arguments get nulls for them */
+	for (argumentIndex = 1; argumentIndex < box->finalArgumentCount; argumentIndex++)
+	{
+		finalFunctionCallInfo.arg[argumentIndex] = (Datum) 0;
+		finalFunctionCallInfo.argnull[argumentIndex] = true;
+	}
+
+	result = FunctionCallInvoke(&finalFunctionCallInfo);
+	if (finalFunctionCallInfo.isnull)
+	{
+		PG_RETURN_NULL();
+	}
+
+	PG_RETURN_DATUM(result);
+}
+
+
+/*
+ * CreateAggregateStateBox looks up the given aggregate, and creates a state box
+ * for it in the aggregate memory context. On worker nodes, the box advances
+ * the state with the aggregate's transition function and serializes it. On the
+ * master node, where combineStates is true, the box deserializes states and
+ * combines them with the aggregate's combine function, and finalizes the
+ * result. argumentTypeId is the type of the aggregate's argument on worker
+ * nodes and the aggregate's result type on the master node.
+ */
+static AggregateStateBox *
+CreateAggregateStateBox(FunctionCallInfo fcinfo, Oid aggregateId, Oid argumentTypeId,
+						bool combineStates)
+{
+	MemoryContext aggregateContext = AggregateContext(fcinfo);
+	MemoryContext oldContext = MemoryContextSwitchTo(aggregateContext);
+	AggregateStateBox *box = palloc0(sizeof(AggregateStateBox));
+	Oid collationId = fcinfo->fncollation;
+	HeapTuple aggregateTuple = NULL;
+	Form_pg_aggregate aggregateForm = NULL;
+	Datum initialValueDatum = 0;
+	bool initialValueNull = true;
+	Oid *declaredArgumentTypes = NULL;
+	int declaredArgumentCount = 0;
+	Oid transitionTypeId = InvalidOid;
+	Oid transitionFunctionId = InvalidOid;
+	Oid serialFunctionId = InvalidOid;
+	Oid finalFunctionId = InvalidOid;
+	Expr *transitionExpression = NULL;
+	Expr *inverseTransitionExpression = NULL;
+	Expr *serialExpression = NULL;
+	Expr *finalExpression = NULL;
+
+	aggregateTuple = SearchSysCache1(AGGFNOID, ObjectIdGetDatum(aggregateId));
+	if (!HeapTupleIsValid(aggregateTuple))
+	{
+		ereport(ERROR, (errmsg("cache lookup failed for aggregate %u", aggregateId)));
+	}
+
+	aggregateForm = (Form_pg_aggregate) GETSTRUCT(aggregateTuple);
+	transitionTypeId = aggregateForm->aggtranstype;
+
+	if (!OidIsValid(aggregateForm->aggcombinefn))
+	{
+		ereport(ERROR, (errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+						errmsg("aggregate %s does not have a combine function",
+							   format_procedure(aggregateId))));
+	}
+
+	if (IsPolymorphicType(transitionTypeId))
+	{
+		ereport(ERROR, (errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+						errmsg("aggregate %s has a polymorphic transition type",
+							   format_procedure(aggregateId))));
+	}
+
+	get_func_signature(aggregateId, &declaredArgumentTypes, &declaredArgumentCount);
+
+	box->aggregateId = aggregateId;
+	box->transitionTypeId = transitionTypeId;
+	get_typlenbyval(transitionTypeId, &box->transitionTypeLength,
+					&box->transitionTypeByValue);
+
+	/* the state starts out with the aggregate's initial value, if any */
+	initialValueDatum = SysCacheGetAttr(AGGFNOID, aggregateTuple,
+										Anum_pg_aggregate_agginitval,
+										&initialValueNull);
+	box->valueNull = initialValueNull;
+	if (!initialValueNull)
+	{
+		char *initialValueString = TextDatumGetCString(initialValueDatum);
+		Oid inputFunctionId = InvalidOid;
+		Oid inputTypeIOParam = InvalidOid;
+
+		getTypeInputInfo(transitionTypeId, &inputFunctionId, &inputTypeIOParam);
+		box->value = OidInputFunctionCall(inputFunctionId, initialValueString,
+										  inputTypeIOParam, -1);
+	}
+
+	if (!combineStates)
+	{
+		transitionFunctionId = aggregateForm->aggtransfn;
+		build_aggregate_transfn_expr(&argumentTypeId, 1, 0, false, transitionTypeId,
+									 collationId, transitionFunctionId, InvalidOid,
+									 &transitionExpression,
+									 &inverseTransitionExpression);
+
+		if (transitionTypeId == INTERNALOID)
+		{
+			serialFunctionId = aggregateForm->aggserialfn;
+			build_aggregate_serialfn_expr(serialFunctionId, &serialExpression);
+		}
+		else
+		{
+			bool typeVarLength = false;
+
+			getTypeBinaryOutputInfo(transitionTypeId, &serialFunctionId,
+									&typeVarLength);
+		}
+	}
+	else
+	{
+		transitionFunctionId = aggregateForm->aggcombinefn;
+		build_aggregate_combinefn_expr(transitionTypeId, collationId,
+									   transitionFunctionId, &transitionExpression);
+
+		if (transitionTypeId == INTERNALOID)
+		{
+			serialFunctionId = aggregateForm->aggdeserialfn;
+			build_aggregate_deserialfn_expr(serialFunctionId, &serialExpression);
+		}
+		else
+		{
+			getTypeBinaryInputInfo(transitionTypeId, &serialFunctionId,
+								   &box->transitionTypeIOParam);
+		}
+
+		finalFunctionId = aggregateForm->aggfinalfn;
+		if (OidIsValid(finalFunctionId))
+		{
+			box->finalArgumentCount = 1;
+			if (aggregateForm->aggfinalextra)
+			{
+				box->finalArgumentCount += declaredArgumentCount;
+			}
+
+			build_aggregate_finalfn_expr(declaredArgumentTypes,
+										 box->finalArgumentCount, transitionTypeId,
+										 argumentTypeId, collationId, finalFunctionId,
+										 &finalExpression);
+
+			fmgr_info_cxt(finalFunctionId, &box->finalFunction, aggregateContext);
+			fmgr_info_set_expr((Node *) finalExpression, &box->finalFunction);
+		}
+	}
+
+	if (!OidIsValid(serialFunctionId))
+	{
+		ereport(ERROR, (errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+						errmsg("transition state of aggregate %s cannot be serialized",
+							   format_procedure(aggregateId))));
+	}
+
+	fmgr_info_cxt(transitionFunctionId, &box->transitionFunction, aggregateContext);
+	fmgr_info_set_expr((Node *) transitionExpression, &box->transitionFunction);
+
+	fmgr_info_cxt(serialFunctionId, &box->serialFunction, aggregateContext);
+	if (serialExpression != NULL)
+	{
+		fmgr_info_set_expr((Node *) serialExpression, &box->serialFunction);
+	}
+
+	ReleaseSysCache(aggregateTuple);
+
+	MemoryContextSwitchTo(oldContext);
+
+	return box;
+}
+
+
+/*
+ * AggregateContext returns the memory context of the aggregate that the given
+ * function is called for, and errors out if the function isn't called as part
+ * of an aggregate.
+ */
+static MemoryContext
+AggregateContext(FunctionCallInfo fcinfo)
+{
+	MemoryContext aggregateContext = NULL;
+
+	if (!AggCheckCallContext(fcinfo, &aggregateContext))
+	{
+		ereport(ERROR, (errmsg("aggregate function called in non-aggregate "
+							   "context")));
+	}
+
+	return aggregateContext;
+}
+
+
+/*
+ * AdvanceAggregateState calls the box's transition function with the current
+ * state and the given argument, and keeps the result as the new state. As in
+ * the executor, pass-by-reference results are copied into the aggregate memory
+ * context, and the previous state is freed.
+ */
+static void
+AdvanceAggregateState(AggregateStateBox *box, FunctionCallInfo fcinfo,
+					  Datum argument, bool argumentNull)
+{
+	FunctionCallInfoData transitionCallInfo;
+	Datum newValue = 0;
+	bool newValueNull = false;
+
+	InitFunctionCallInfoData(transitionCallInfo, &box->transitionFunction, 2,
+							 fcinfo->fncollation, fcinfo->context, NULL);
+
+	transitionCallInfo.arg[0] = box->value;
+	transitionCallInfo.argnull[0] = box->valueNull;
+	transitionCallInfo.arg[1] = argument;
+	transitionCallInfo.argnull[1] = argumentNull;
+
+	newValue = FunctionCallInvoke(&transitionCallInfo);
+	newValueNull = transitionCallInfo.isnull;
+
+	if (!box->transitionTypeByValue &&
+		DatumGetPointer(newValue) != DatumGetPointer(box->value))
+	{
+		if (!newValueNull)
+		{
+			MemoryContext oldContext = MemoryContextSwitchTo(AggregateContext(fcinfo));
+
+			newValue = datumCopy(newValue, box->transitionTypeByValue,
+								 box->transitionTypeLength);
+
+			MemoryContextSwitchTo(oldContext);
+		}
+
+		if (!box->valueNull)
+		{
+			pfree(DatumGetPointer(box->value));
+		}
+	}
+
+	box->value = newValue;
+	box->valueNull = newValueNull;
+}
+
+
+/*
+ * SerializeAggregateState serializes the box's state into a bytea, either with
+ * the aggregate's serialization function for internal states, or with the
+ * binary send function of the transition type.
+ */
+static bytea *
+SerializeAggregateState(AggregateStateBox *box, FunctionCallInfo fcinfo)
+{
+	FunctionCallInfoData serialCallInfo;
+	Datum serializedState = 0;
+
+	if (box->transitionTypeId != INTERNALOID)
+	{
+		return SendFunctionCall(&box->serialFunction, box->value);
+	}
+
+	InitFunctionCallInfoData(serialCallInfo, &box->serialFunction, 1,
+							 InvalidOid, fcinfo->context, NULL);
+
+	serialCallInfo.arg[0] = box->value;
+	serialCallInfo.argnull[0] = false;
+
+	serializedState = FunctionCallInvoke(&serialCallInfo);
+	if (serialCallInfo.isnull)
+	{
+		return NULL;
+	}
+
+	return DatumGetByteaP(serializedState);
+}
+
+
+/*
+ * DeserializeAggregateState reads a state serialized by SerializeAggregateState
+ * back, either with the aggregate's deserialization function for internal
+ * states, or with the binary receive function of the transition type. The
+ * state is allocated in the current memory context.
+ */
+static Datum
+DeserializeAggregateState(AggregateStateBox *box, FunctionCallInfo fcinfo,
+						  bytea *serializedState)
+{
+	FunctionCallInfoData deserialCallInfo;
+	Datum state = 0;
+
+	if (box->transitionTypeId != INTERNALOID)
+	{
+		StringInfoData stateBuffer;
+
+		initStringInfo(&stateBuffer);
+		appendBinaryStringInfo(&stateBuffer, VARDATA_ANY(serializedState),
+							   VARSIZE_ANY_EXHDR(serializedState));
+
+		return ReceiveFunctionCall(&box->serialFunction, &stateBuffer,
+								   box->transitionTypeIOParam, -1);
+	}
+
+	InitFunctionCallInfoData(deserialCallInfo, &box->serialFunction, 2,
+							 InvalidOid, fcinfo->context, NULL);
+
+	deserialCallInfo.arg[0] = PointerGetDatum(serializedState);
+	deserialCallInfo.argnull[0] = false;
+
+	/* dummy second argument, as in the executor */
+	deserialCallInfo.arg[1] = PointerGetDatum(NULL);
+	deserialCallInfo.argnull[1] = false;
+
+	state = FunctionCallInvoke(&deserialCallInfo);
+	if (deserialCallInfo.isnull)
+	{
+		ereport(ERROR, (errmsg("could not deserialize transition state of "
+							   "aggregate %s", format_procedure(box->aggregateId))));
+	}
+
+	return state;
+}
+
+
+#else
+
+
+/* local function forward declarations */
+static void ErrorIfPartialAggregatesUnsupported(void);
+
+
+/* worker_partial_agg_sfunc requires combine functions, added in 9.6 */
+Datum
+worker_partial_agg_sfunc(PG_FUNCTION_ARGS)
+{
+	ErrorIfPartialAggregatesUnsupported();
+
+	PG_RETURN_NULL();
+}
+
+
+/* worker_partial_agg_ffunc requires combine functions, added in 9.6 */
+Datum
+worker_partial_agg_ffunc(PG_FUNCTION_ARGS)
+{
+	ErrorIfPartialAggregatesUnsupported();
+
+	PG_RETURN_NULL();
+}
+
+
+/* master_combine_agg_sfunc requires combine functions, added in 9.6 */
+Datum
+master_combine_agg_sfunc(PG_FUNCTION_ARGS)
+{
+	ErrorIfPartialAggregatesUnsupported();
+
+	PG_RETURN_NULL();
+}
+
+
+/* master_combine_agg_ffunc requires combine functions, added in 9.6 */
+Datum
+master_combine_agg_ffunc(PG_FUNCTION_ARGS)
+{
+	ErrorIfPartialAggregatesUnsupported();
+
+	PG_RETURN_NULL();
+}
+
+
+/* ErrorIfPartialAggregatesUnsupported errors out on PostgreSQL 9.5. */
+static void
+ErrorIfPartialAggregatesUnsupported(void)
+{
+	ereport(ERROR, (errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+					errmsg("partial aggregates are only supported on PostgreSQL "
+						   "9.6 and later")));
+}
+
+
+#endif
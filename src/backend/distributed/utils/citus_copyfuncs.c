@@ -0,0 +1,257 @@
+/*-------------------------------------------------------------------------
+ *
+ * citus_copyfuncs.c
+ *    Citus specific node copy functions
+ *
+ * Portions Copyright (c) 1996-2016, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ * Portions Copyright (c) 2012-2016, Citus Data, Inc.
+ *
+ * NOTES
+ *	  Copy support for the Citus node types used in distributed plans, so
+ *	  that postgres' copyObject() can copy plans containing them. Only
+ *	  available on 9.6+, where Citus nodes are extensible nodes.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include "distributed/citus_nodefuncs.h"
+#include "distributed/citus_nodes.h"
+#include "distributed/errormessage.h"
+#include "distributed/master_metadata_utility.h"
+#include "distributed/multi_physical_planner.h"
+#include "distributed/multi_planner.h"
+#include "utils/datum.h"
+
+
+#if (PG_VERSION_NUM >= 90600)
+
+/*
+ * Macros to simplify copying of different kinds of fields.  Use these
+ * wherever possible to reduce the chance for silly typos.  Note that these
+ * hard-wire the convention that the local variables in a Copy routine are
+ * named 'newnode' and 'from'.
+ */
+
+/* Declare the typed locals for the target and source node */
+#define DECLARE_FROM_AND_NEW_NODE(nodeTypeName) \
+	nodeTypeName *newnode = (nodeTypeName *) target_node; \
+	const nodeTypeName *from = (const nodeTypeName *) source_node
+
+/* Copy a simple scalar field (int, float, bool, enum, etc) */
+#define COPY_SCALAR_FIELD(fldname) \
+	(newnode->fldname = from->fldname)
+
+/* Copy a field that is a pointer to some kind of Node or Node tree */
+#define COPY_NODE_FIELD(fldname) \
+	(newnode->fldname = copyObject(from->fldname))
+
+/* Copy a field that is a pointer to a C string, or perhaps NULL */
+#define COPY_STRING_FIELD(fldname) \
+	(newnode->fldname = from->fldname ? pstrdup(from->fldname) : (char *) NULL)
+
+
+/*
+ * CopyCitusNodeTag copies the Citus tag of the source node. postgres sets up
+ * the type and the name of the extensible node before calling the copy
+ * function of the node.
+ */
+static void
+CopyCitusNodeTag(struct ExtensibleNode *target_node,
+				 const struct ExtensibleNode *source_node)
+{
+	((CitusNode *) target_node)->citus_tag = ((const CitusNode *) source_node)->citus_tag;
+}
+
+
+static void
+CopyJobFields(const Job *from, Job *newnode)
+{
+	COPY_SCALAR_FIELD(jobId);
+	COPY_NODE_FIELD(jobQuery);
+	COPY_NODE_FIELD(taskList);
+	COPY_NODE_FIELD(dependedJobList);
+	COPY_SCALAR_FIELD(subqueryPushdown);
+	COPY_SCALAR_FIELD(requiresMasterEvaluation);
+	COPY_NODE_FIELD(deferredPruningParam);
+}
+
+
+void
+CopyNodeMultiPlan(COPYFUNC_ARGS)
+{
+	DECLARE_FROM_AND_NEW_NODE(MultiPlan);
+
+	CopyCitusNodeTag(target_node, source_node);
+
+	COPY_SCALAR_FIELD(operation);
+	COPY_SCALAR_FIELD(hasReturning);
+
+	COPY_NODE_FIELD(workerJob);
+	COPY_NODE_FIELD(masterQuery);
+	COPY_SCALAR_FIELD(routerExecutable);
+	COPY_SCALAR_FIELD(sortedMerge);
+	COPY_NODE_FIELD(planningError);
+}
+
+
+void
+CopyNodeJob(COPYFUNC_ARGS)
+{
+	DECLARE_FROM_AND_NEW_NODE(Job);
+
+	CopyCitusNodeTag(target_node, source_node);
+
+	CopyJobFields(from, newnode);
+}
+
+
+void
+CopyNodeMapMergeJob(COPYFUNC_ARGS)
+{
+	DECLARE_FROM_AND_NEW_NODE(MapMergeJob);
+	int arrayLength = from->sortedShardIntervalArrayLength;
+	int arrayIndex = 0;
+
+	CopyCitusNodeTag(target_node, source_node);
+
+	CopyJobFields(&from->job, &newnode->job);
+
+	COPY_NODE_FIELD(reduceQuery);
+	COPY_SCALAR_FIELD(partitionType);
+	COPY_NODE_FIELD(partitionColumn);
+	COPY_SCALAR_FIELD(partitionCount);
+	COPY_SCALAR_FIELD(sortedShardIntervalArrayLength);
+
+	newnode->sortedShardIntervalArray = NULL;
+	if (arrayLength > 0)
+	{
+		newnode->sortedShardIntervalArray = palloc(arrayLength *
+												   sizeof(ShardInterval *));
+
+		for (arrayIndex = 0; arrayIndex < arrayLength; arrayIndex++)
+		{
+			newnode->sortedShardIntervalArray[arrayIndex] =
+				copyObject(from->sortedShardIntervalArray[arrayIndex]);
+		}
+	}
+
+	COPY_NODE_FIELD(mapTaskList);
+	COPY_NODE_FIELD(mergeTaskList);
+}
+
+
+void
+CopyNodeShardInterval(COPYFUNC_ARGS)
+{
+	DECLARE_FROM_AND_NEW_NODE(ShardInterval);
+
+	CopyCitusNodeTag(target_node, source_node);
+
+	COPY_SCALAR_FIELD(relationId);
+	COPY_SCALAR_FIELD(storageType);
+	COPY_SCALAR_FIELD(valueTypeId);
+	COPY_SCALAR_FIELD(valueTypeLen);
+	COPY_SCALAR_FIELD(valueByVal);
+	COPY_SCALAR_FIELD(minValueExists);
+	COPY_SCALAR_FIELD(maxValueExists);
+
+	newnode->minValue = 0;
+	if (from->minValueExists)
+	{
+		newnode->minValue = datumCopy(from->minValue, from->valueByVal,
+									  from->valueTypeLen);
+	}
+
+	newnode->maxValue = 0;
+	if (from->maxValueExists)
+	{
+		newnode->maxValue = datumCopy(from->maxValue, from->valueByVal,
+									  from->valueTypeLen);
+	}
+
+	COPY_SCALAR_FIELD(shardId);
+}
+
+
+void
+CopyNodeShardPlacement(COPYFUNC_ARGS)
+{
+	DECLARE_FROM_AND_NEW_NODE(ShardPlacement);
+
+	CopyCitusNodeTag(target_node, source_node);
+
+	COPY_SCALAR_FIELD(placementId);
+	COPY_SCALAR_FIELD(shardId);
+	COPY_SCALAR_FIELD(shardLength);
+	COPY_SCALAR_FIELD(shardState);
+	COPY_STRING_FIELD(nodeName);
+	COPY_SCALAR_FIELD(nodePort);
+	COPY_SCALAR_FIELD(partitionMethod);
+	COPY_SCALAR_FIELD(colocationGroupId);
+	COPY_SCALAR_FIELD(representativeValue);
+}
+
+
+void
+CopyNodeRelationShard(COPYFUNC_ARGS)
+{
+	DECLARE_FROM_AND_NEW_NODE(RelationShard);
+
+	CopyCitusNodeTag(target_node, source_node);
+
+	COPY_SCALAR_FIELD(relationId);
+	COPY_SCALAR_FIELD(shardId);
+}
+
+
+void
+CopyNodeTask(COPYFUNC_ARGS)
+{
+	DECLARE_FROM_AND_NEW_NODE(Task);
+
+	CopyCitusNodeTag(target_node, source_node);
+
+	COPY_SCALAR_FIELD(taskType);
+	COPY_SCALAR_FIELD(jobId);
+	COPY_SCALAR_FIELD(taskId);
+	COPY_STRING_FIELD(queryString);
+	COPY_SCALAR_FIELD(anchorShardId);
+	COPY_NODE_FIELD(taskPlacementList);
+	COPY_NODE_FIELD(dependedTaskList);
+	COPY_SCALAR_FIELD(partitionId);
+	COPY_SCALAR_FIELD(upstreamTaskId);
+	COPY_NODE_FIELD(shardInterval);
+	COPY_SCALAR_FIELD(assignmentConstrained);
+	COPY_SCALAR_FIELD(shardId);
+
+	/* task executions belong to a single execution, and are not part of plans */
+	newnode->taskExecution = NULL;
+
+	COPY_SCALAR_FIELD(upsertQuery);
+	COPY_SCALAR_FIELD(replicationModel);
+	COPY_SCALAR_FIELD(insertSelectQuery);
+	COPY_NODE_FIELD(relationShardList);
+}
+
+
+void
+CopyNodeDeferredErrorMessage(COPYFUNC_ARGS)
+{
+	DECLARE_FROM_AND_NEW_NODE(DeferredErrorMessage);
+
+	CopyCitusNodeTag(target_node, source_node);
+
+	COPY_SCALAR_FIELD(code);
+	COPY_STRING_FIELD(message);
+	COPY_STRING_FIELD(detail);
+	COPY_STRING_FIELD(hint);
+	COPY_STRING_FIELD(filename);
+	COPY_SCALAR_FIELD(linenumber);
+	COPY_STRING_FIELD(functionname);
+}
+
+
+#endif
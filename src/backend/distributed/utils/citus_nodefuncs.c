@@ -358,7 +358,7 @@ EqualUnsupportedCitusNode(const struct ExtensibleNode *a,
 	{ \
 		#type, \
 		sizeof(type), \
-		CopyUnsupportedCitusNode, \
+		CopyNode##type, \
 		EqualUnsupportedCitusNode, \
 		Out##type, \
 		Read##type \
@@ -387,7 +387,7 @@ const ExtensibleNodeMethods nodeMethods[] =
 	DEFINE_NODE_METHODS(Task),
 	DEFINE_NODE_METHODS(DeferredErrorMessage),
 
-	/* nodes with only output support */
+	/* nodes with only output support, which are never copied */
 	DEFINE_NODE_METHODS_NO_READ(MultiNode),
 	DEFINE_NODE_METHODS_NO_READ(MultiTreeRoot),
 	DEFINE_NODE_METHODS_NO_READ(MultiProject),
@@ -164,6 +164,7 @@ readJobInfo(Job *local_node)
 	READ_NODE_FIELD(dependedJobList);
 	READ_BOOL_FIELD(subqueryPushdown);
 	READ_BOOL_FIELD(requiresMasterEvaluation);
+	READ_NODE_FIELD(deferredPruningParam);
 }
 
 
@@ -189,6 +190,7 @@ ReadMultiPlan(READFUNC_ARGS)
 	READ_NODE_FIELD(workerJob);
 	READ_NODE_FIELD(masterQuery);
 	READ_BOOL_FIELD(routerExecutable);
+	READ_BOOL_FIELD(sortedMerge);
 	READ_NODE_FIELD(planningError);
 
 	READ_DONE();
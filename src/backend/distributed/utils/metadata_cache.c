@@ -133,6 +133,9 @@ static bool HasUniformHashDistribution(ShardInterval **shardIntervalArray,
 									   int shardIntervalArrayLength);
 static bool HasUninitializedShardInterval(ShardInterval **sortedShardIntervalArray,
 										  int shardCount);
+static bool HasOverlappingShardInterval(ShardInterval **sortedShardIntervalArray,
+										int shardCount,
+										FmgrInfo *shardIntervalCompareFunction);
 static void InitializeDistTableCache(void);
 static void InitializeWorkerNodeCache(void);
 static uint32 WorkerNodeHashCode(const void *key, Size keySize);
@@ -713,6 +716,19 @@ BuildCachedShardList(DistTableCacheEntry *cacheEntry)
 		cacheEntry->hasUninitializedShardInterval =
 			HasUninitializedShardInterval(sortedShardIntervalArray,
 										  shardIntervalArrayLength);
+
+		/* shard intervals without min/max values may cover any value */
+		if (cacheEntry->hasUninitializedShardInterval)
+		{
+			cacheEntry->hasOverlappingShardInterval = true;
+		}
+		else
+		{
+			cacheEntry->hasOverlappingShardInterval =
+				HasOverlappingShardInterval(sortedShardIntervalArray,
+											shardIntervalArrayLength,
+											shardIntervalCompareFunction);
+		}
 	}
 
 
@@ -918,6 +934,40 @@ HasUninitializedShardInterval(ShardInterval **sortedShardIntervalArray, int shar
 }
 
 
+/*
+ * HasOverlappingShardInterval returns true if any two shard intervals in the
+ * given array overlap. The array must be sorted on shardminvalue and all shard
+ * intervals in it must have min/max values. If no intervals overlap, the array
+ * is also sorted on shardmaxvalue.
+ */
+static bool
+HasOverlappingShardInterval(ShardInterval **sortedShardIntervalArray, int shardCount,
+							FmgrInfo *shardIntervalCompareFunction)
+{
+	int shardIndex = 0;
+
+	for (shardIndex = 1; shardIndex < shardCount; shardIndex++)
+	{
+		ShardInterval *lastShardInterval = sortedShardIntervalArray[shardIndex - 1];
+		ShardInterval *curShardInterval = sortedShardIntervalArray[shardIndex];
+		Datum comparisonDatum = 0;
+
+		Assert(lastShardInterval->minValueExists && lastShardInterval->maxValueExists);
+		Assert(curShardInterval->minValueExists && curShardInterval->maxValueExists);
+
+		comparisonDatum = CompareCall2(shardIntervalCompareFunction,
+									   curShardInterval->minValue,
+									   lastShardInterval->maxValue);
+		if (DatumGetInt32(comparisonDatum) <= 0)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
 /*
  * CitusHasBeenLoaded returns true if the citus extension has been created
  * in the current database and the extension script has been executed. Otherwise,
@@ -1847,6 +1897,7 @@ ResetDistTableCacheEntry(DistTableCacheEntry *cacheEntry)
 	cacheEntry->shardIntervalArrayLength = 0;
 	cacheEntry->hasUninitializedShardInterval = false;
 	cacheEntry->hasUniformHashDistribution = false;
+	cacheEntry->hasOverlappingShardInterval = false;
 }
 
 
@@ -0,0 +1,545 @@
+/*-------------------------------------------------------------------------
+ *
+ * percentile_sketch.c
+ *
+ * Implementation of mergeable percentile sketches, which we use to approximate
+ * percentile_cont() over distributed tables. A sketch summarizes a set of
+ * values as a sorted list of weighted centroids, in the spirit of the merging
+ * t-digest. Centroids near the minimum and maximum are kept small, so that
+ * extreme percentiles remain accurate, and the number of centroids is bounded
+ * by the sketch's compression.
+ *
+ * percentile_sketch_add_agg() builds a sketch over the values of a shard, and
+ * percentile_sketch_union_agg() merges the sketches of all shards on the master
+ * node. percentile_sketch_value() then computes a percentile from the merged
+ * sketch. Sketches are sent between nodes as double precision arrays of the
+ * form {compression, min, max, mean1, weight1, mean2, weight2, ...}.
+ *
+ * Copyright (c) 2017, Citus Data, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+#include "fmgr.h"
+
+#include <math.h>
+
+#include "catalog/pg_type.h"
+#include "utils/array.h"
+#include "utils/builtins.h"
+
+
+/* number of array elements before the sketch's centroids */
+#define SKETCH_HEADER_LENGTH 3
+
+/* sketches buffer this many centroids per unit of compression before merging */
+#define SKETCH_BUFFER_FACTOR 10
+#define SKETCH_MIN_BUFFER_SIZE 32
+
+
+/* Centroid summarizes a number of values by their mean and count */
+typedef struct Centroid
+{
+	double mean;
+	double weight;
+} Centroid;
+
+
+/*
+ * PercentileSketch keeps the centroids of a sketch while it is being built. New
+ * centroids are appended to the end of the centroid array, and are merged into
+ * the sorted centroids once the array is full.
+ */
+typedef struct PercentileSketch
+{
+	double compression;
+	double minValue;
+	double maxValue;
+	double totalWeight;
+	int centroidCount;
+	int maxCentroidCount;
+	Centroid *centroidArray;
+} PercentileSketch;
+
+
+/* local function forward declarations */
+static PercentileSketch * CreatePercentileSketch(FunctionCallInfo fcinfo,
+												 double compression);
+static void AddCentroid(PercentileSketch *sketch, double mean, double weight);
+static void CompressPercentileSketch(PercentileSketch *sketch);
+static int CompareCentroids(const void *leftElement, const void *rightElement);
+static double SketchPercentile(PercentileSketch *sketch, double fraction);
+static ArrayType * SerializePercentileSketch(PercentileSketch *sketch);
+static Datum * SketchArrayElements(ArrayType *sketchArray, int *elementCount);
+
+
+/* declarations for dynamic loading */
+PG_FUNCTION_INFO_V1(percentile_sketch_add_sfunc);
+PG_FUNCTION_INFO_V1(percentile_sketch_union_sfunc);
+PG_FUNCTION_INFO_V1(percentile_sketch_ffunc);
+PG_FUNCTION_INFO_V1(percentile_sketch_value);
+
+
+/*
+ * percentile_sketch_add_sfunc adds the given value to the sketch, and creates
+ * the sketch with the given compression on its first call. Like percentile_cont,
+ * the function skips null values.
+ */
+Datum
+percentile_sketch_add_sfunc(PG_FUNCTION_ARGS)
+{
+	PercentileSketch *sketch = NULL;
+	double value = 0.0;
+
+	if (PG_ARGISNULL(0))
+	{
+		if (PG_ARGISNULL(2))
+		{
+			ereport(ERROR, (errmsg("sketch compression cannot be null")));
+		}
+
+		sketch = CreatePercentileSketch(fcinfo, (double) PG_GETARG_INT32(2));
+	}
+	else
+	{
+		sketch = (PercentileSketch *) PG_GETARG_POINTER(0);
+	}
+
+	if (PG_ARGISNULL(1))
+	{
+		PG_RETURN_POINTER(sketch);
+	}
+
+	value = PG_GETARG_FLOAT8(1);
+	sketch->minValue = Min(sketch->minValue, value);
+	sketch->maxValue = Max(sketch->maxValue, value);
+
+	AddCentroid(sketch, value, 1.0);
+
+	PG_RETURN_POINTER(sketch);
+}
+
+
+/*
+ * percentile_sketch_union_sfunc merges the given serialized sketch into the
+ * current sketch. The merged sketch takes its compression from the first sketch
+ * it sees. The function skips null sketches, which come from shards without any
+ * rows.
+ */
+Datum
+percentile_sketch_union_sfunc(PG_FUNCTION_ARGS)
+{
+	PercentileSketch *sketch = NULL;
+	ArrayType *sketchArray = NULL;
+	Datum *elementArray = NULL;
+	int elementCount = 0;
+	int elementIndex = 0;
+
+	if (!PG_ARGISNULL(0))
+	{
+		sketch = (PercentileSketch *) PG_GETARG_POINTER(0);
+	}
+
+	if (PG_ARGISNULL(1))
+	{
+		if (sketch == NULL)
+		{
+			PG_RETURN_NULL();
+		}
+
+		PG_RETURN_POINTER(sketch);
+	}
+
+	sketchArray = PG_GETARG_ARRAYTYPE_P(1);
+	elementArray = SketchArrayElements(sketchArray, &elementCount);
+
+	if (sketch == NULL)
+	{
+		sketch = CreatePercentileSketch(fcinfo, DatumGetFloat8(elementArray[0]));
+	}
+
+	sketch->minValue = Min(sketch->minValue, DatumGetFloat8(elementArray[1]));
+	sketch->maxValue = Max(sketch->maxValue, DatumGetFloat8(elementArray[2]));
+
+	for (elementIndex = SKETCH_HEADER_LENGTH; elementIndex < elementCount;
+		 elementIndex += 2)
+	{
+		double mean = DatumGetFloat8(elementArray[elementIndex]);
+		double weight = DatumGetFloat8(elementArray[elementIndex + 1]);
+
+		AddCentroid(sketch, mean, weight);
+	}
+
+	PG_RETURN_POINTER(sketch);
+}
+
+
+/*
+ * percentile_sketch_ffunc compresses the sketch, and serializes it into a double
+ * precision array. The function returns null if the sketch is null.
+ */
+Datum
+percentile_sketch_ffunc(PG_FUNCTION_ARGS)
+{
+	PercentileSketch *sketch = NULL;
+
+	if (PG_ARGISNULL(0))
+	{
+		PG_RETURN_NULL();
+	}
+
+	sketch = (PercentileSketch *) PG_GETARG_POINTER(0);
+
+	PG_RETURN_ARRAYTYPE_P(SerializePercentileSketch(sketch));
+}
+
+
+/*
+ * percentile_sketch_value computes the given percentile from a serialized
+ * sketch. The function returns null for sketches without any values.
+ */
+Datum
+percentile_sketch_value(PG_FUNCTION_ARGS)
+{
+	ArrayType *sketchArray = PG_GETARG_ARRAYTYPE_P(0);
+	double fraction = PG_GETARG_FLOAT8(1);
+	PercentileSketch sketch;
+	Datum *elementArray = NULL;
+	int elementCount = 0;
+	int elementIndex = 0;
+	int centroidIndex = 0;
+
+	if (fraction < 0.0 || fraction > 1.0 || isnan(fraction))
+	{
+		ereport(ERROR, (errcode(ERRCODE_NUMERIC_VALUE_OUT_OF_RANGE),
+						errmsg("percentile value %g is not between 0 and 1",
+							   fraction)));
+	}
+
+	elementArray = SketchArrayElements(sketchArray, &elementCount);
+	if (elementCount == SKETCH_HEADER_LENGTH)
+	{
+		PG_RETURN_NULL();
+	}
+
+	/* serialized sketches are already compressed, so we use their centroids as is */
+	memset(&sketch, 0, sizeof(PercentileSketch));
+	sketch.compression = DatumGetFloat8(elementArray[0]);
+	sketch.minValue = DatumGetFloat8(elementArray[1]);
+	sketch.maxValue = DatumGetFloat8(elementArray[2]);
+	sketch.centroidCount = (elementCount - SKETCH_HEADER_LENGTH) / 2;
+	sketch.maxCentroidCount = sketch.centroidCount;
+	sketch.centroidArray = palloc0(sketch.centroidCount * sizeof(Centroid));
+
+	for (elementIndex = SKETCH_HEADER_LENGTH; elementIndex < elementCount;
+		 elementIndex += 2)
+	{
+		Centroid *centroid = &sketch.centroidArray[centroidIndex++];
+
+		centroid->mean = DatumGetFloat8(elementArray[elementIndex]);
+		centroid->weight = DatumGetFloat8(elementArray[elementIndex + 1]);
+		sketch.totalWeight += centroid->weight;
+	}
+
+	/* sketches we serialize are sorted, but we don't rely on that for any input */
+	qsort(sketch.centroidArray, sketch.centroidCount, sizeof(Centroid),
+		  CompareCentroids);
+
+	PG_RETURN_FLOAT8(SketchPercentile(&sketch, fraction));
+}
+
+
+/*
+ * CreatePercentileSketch creates an empty sketch with the given compression in
+ * the memory context of the aggregate that the given function is called for.
+ */
+static PercentileSketch *
+CreatePercentileSketch(FunctionCallInfo fcinfo, double compression)
+{
+	MemoryContext aggregateContext = NULL;
+	MemoryContext oldContext = NULL;
+	PercentileSketch *sketch = NULL;
+
+	if (!AggCheckCallContext(fcinfo, &aggregateContext))
+	{
+		ereport(ERROR, (errmsg("aggregate function called in non-aggregate "
+							   "context")));
+	}
+
+	if (!(compression >= 1.0 && compression <= INT_MAX / SKETCH_BUFFER_FACTOR))
+	{
+		ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+						errmsg("invalid percentile sketch compression: %g",
+							   compression),
+						errdetail("Compression must be between 1 and %d.",
+								  INT_MAX / SKETCH_BUFFER_FACTOR)));
+	}
+
+	oldContext = MemoryContextSwitchTo(aggregateContext);
+
+	sketch = palloc0(sizeof(PercentileSketch));
+	sketch->compression = compression;
+	sketch->minValue = get_float8_infinity();
+	sketch->maxValue = -get_float8_infinity();
+	sketch->maxCentroidCount = (int) (compression * SKETCH_BUFFER_FACTOR) +
+							   SKETCH_MIN_BUFFER_SIZE;
+	sketch->centroidArray = palloc0(sketch->maxCentroidCount * sizeof(Centroid));
+
+	MemoryContextSwitchTo(oldContext);
+
+	return sketch;
+}
+
+
+/*
+ * AddCentroid appends a centroid with the given mean and weight to the sketch.
+ * If the sketch's centroid array is full, the function first compresses the
+ * sketch, and grows the array if compression didn't free up enough space.
+ */
+static void
+AddCentroid(PercentileSketch *sketch, double mean, double weight)
+{
+	Centroid *centroid = NULL;
+
+	if (sketch->centroidCount == sketch->maxCentroidCount)
+	{
+		CompressPercentileSketch(sketch);
+
+		if (sketch->centroidCount * 2 > sketch->maxCentroidCount)
+		{
+			/* repalloc keeps the array in the aggregate's memory context */
+			sketch->maxCentroidCount *= 2;
+			sketch->centroidArray = repalloc(sketch->centroidArray,
+											 sketch->maxCentroidCount *
+											 sizeof(Centroid));
+		}
+	}
+
+	centroid = &sketch->centroidArray[sketch->centroidCount];
+	centroid->mean = mean;
+	centroid->weight = weight;
+
+	sketch->centroidCount++;
+	sketch->totalWeight += weight;
+}
+
+
+/*
+ * CompressPercentileSketch sorts the sketch's centroids by their means, and then
+ * merges neighbouring centroids as long as the merged centroid stays within its
+ * size limit. The limit of a centroid at quantile q is proportional to q(1-q),
+ * which keeps centroids small near the edges of the distribution.
+ */
+static void
+CompressPercentileSketch(PercentileSketch *sketch)
+{
+	Centroid *centroidArray = sketch->centroidArray;
+	int mergedCount = 0;
+	int centroidIndex = 0;
+	double weightSoFar = 0.0;
+
+	if (sketch->centroidCount <= 1)
+	{
+		return;
+	}
+
+	qsort(centroidArray, sketch->centroidCount, sizeof(Centroid), CompareCentroids);
+
+	for (centroidIndex = 1; centroidIndex < sketch->centroidCount; centroidIndex++)
+	{
+		Centroid *mergedCentroid = &centroidArray[mergedCount];
+		Centroid *nextCentroid = &centroidArray[centroidIndex];
+		double proposedWeight = mergedCentroid->weight + nextCentroid->weight;
+		double quantile = (weightSoFar + proposedWeight / 2.0) / sketch->totalWeight;
+		double weightLimit = 4.0 * sketch->totalWeight * quantile * (1.0 - quantile) /
+							 sketch->compression;
+
+		if (proposedWeight <= weightLimit)
+		{
+			mergedCentroid->mean += (nextCentroid->mean - mergedCentroid->mean) *
+									nextCentroid->weight / proposedWeight;
+			mergedCentroid->weight = proposedWeight;
+		}
+		else
+		{
+			weightSoFar += mergedCentroid->weight;
+			mergedCount++;
+			centroidArray[mergedCount] = *nextCentroid;
+		}
+	}
+
+	sketch->centroidCount = mergedCount + 1;
+}
+
+
+/* CompareCentroids compares two centroids by their means for sorting */
+static int
+CompareCentroids(const void *leftElement, const void *rightElement)
+{
+	const Centroid *leftCentroid = (const Centroid *) leftElement;
+	const Centroid *rightCentroid = (const Centroid *) rightElement;
+
+	if (leftCentroid->mean < rightCentroid->mean)
+	{
+		return -1;
+	}
+	else if (leftCentroid->mean > rightCentroid->mean)
+	{
+		return 1;
+	}
+
+	return 0;
+}
+
+
+/*
+ * SketchPercentile estimates the given percentile of the sketch's values. Like
+ * percentile_cont, we look for the value at position fraction * (count - 1),
+ * and interpolate linearly between the centers of the two centroids around that
+ * position. The minimum and maximum values bound the first and last centroids.
+ * As a result, sketches whose centroids each hold a single value give the same
+ * results as percentile_cont. The sketch must have at least one centroid, and
+ * its centroids must be sorted by their means.
+ */
+static double
+SketchPercentile(PercentileSketch *sketch, double fraction)
+{
+	Centroid *centroidArray = NULL;
+	int centroidCount = 0;
+	int centroidIndex = 0;
+	double totalWeight = 0.0;
+	double targetPosition = 0.0;
+	double firstCenter = 0.0;
+	double lastCenter = 0.0;
+	double lastPosition = 0.0;
+	double weightSoFar = 0.0;
+	Centroid *lastCentroid = NULL;
+
+	centroidArray = sketch->centroidArray;
+	centroidCount = sketch->centroidCount;
+	totalWeight = sketch->totalWeight;
+	Assert(centroidCount > 0);
+
+	/* positions are measured in weights, with the first value centered at 0.5 */
+	targetPosition = fraction * (totalWeight - 1.0) + 0.5;
+
+	firstCenter = centroidArray[0].weight / 2.0;
+	if (targetPosition <= firstCenter)
+	{
+		if (firstCenter <= 0.5)
+		{
+			return centroidArray[0].mean;
+		}
+
+		return sketch->minValue + (centroidArray[0].mean - sketch->minValue) *
+			   (targetPosition - 0.5) / (firstCenter - 0.5);
+	}
+
+	for (centroidIndex = 0; centroidIndex < centroidCount - 1; centroidIndex++)
+	{
+		Centroid *currentCentroid = &centroidArray[centroidIndex];
+		Centroid *nextCentroid = &centroidArray[centroidIndex + 1];
+		double currentCenter = weightSoFar + currentCentroid->weight / 2.0;
+		double nextCenter = weightSoFar + currentCentroid->weight +
+							nextCentroid->weight / 2.0;
+
+		if (targetPosition <= nextCenter)
+		{
+			return currentCentroid->mean +
+				   (nextCentroid->mean - currentCentroid->mean) *
+				   (targetPosition - currentCenter) / (nextCenter - currentCenter);
+		}
+
+		weightSoFar += currentCentroid->weight;
+	}
+
+	lastCentroid = &centroidArray[centroidCount - 1];
+	lastCenter = totalWeight - lastCentroid->weight / 2.0;
+	lastPosition = totalWeight - 0.5;
+	if (lastPosition <= lastCenter)
+	{
+		return lastCentroid->mean;
+	}
+
+	return lastCentroid->mean + (sketch->maxValue - lastCentroid->mean) *
+		   (targetPosition - lastCenter) / (lastPosition - lastCenter);
+}
+
+
+/*
+ * SerializePercentileSketch compresses the sketch, and returns it as a double
+ * precision array that holds the sketch's compression, minimum and maximum
+ * values, followed by the mean and weight of each centroid.
+ */
+static ArrayType *
+SerializePercentileSketch(PercentileSketch *sketch)
+{
+	int elementCount = 0;
+	Datum *elementArray = NULL;
+	int elementIndex = 0;
+	int centroidIndex = 0;
+
+	CompressPercentileSketch(sketch);
+
+	elementCount = SKETCH_HEADER_LENGTH + 2 * sketch->centroidCount;
+	elementArray = palloc0(elementCount * sizeof(Datum));
+
+	elementArray[elementIndex++] = Float8GetDatum(sketch->compression);
+	elementArray[elementIndex++] = Float8GetDatum(sketch->minValue);
+	elementArray[elementIndex++] = Float8GetDatum(sketch->maxValue);
+
+	for (centroidIndex = 0; centroidIndex < sketch->centroidCount; centroidIndex++)
+	{
+		Centroid *centroid = &sketch->centroidArray[centroidIndex];
+
+		elementArray[elementIndex++] = Float8GetDatum(centroid->mean);
+		elementArray[elementIndex++] = Float8GetDatum(centroid->weight);
+	}
+
+	return construct_array(elementArray, elementCount, FLOAT8OID, sizeof(float8),
+						   FLOAT8PASSBYVAL, 'd');
+}
+
+
+/*
+ * SketchArrayElements deconstructs the given serialized sketch into its elements,
+ * and returns them after checking that they form a valid sketch.
+ */
+static Datum *
+SketchArrayElements(ArrayType *sketchArray, int *elementCount)
+{
+	Datum *elementArray = NULL;
+	bool *nullArray = NULL;
+	int elementIndex = 0;
+
+	if (ARR_NDIM(sketchArray) > 1 || ARR_ELEMTYPE(sketchArray) != FLOAT8OID ||
+		array_contains_nulls(sketchArray))
+	{
+		ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+						errmsg("invalid percentile sketch")));
+	}
+
+	deconstruct_array(sketchArray, FLOAT8OID, sizeof(float8), FLOAT8PASSBYVAL, 'd',
+					  &elementArray, &nullArray, elementCount);
+	if (*elementCount < SKETCH_HEADER_LENGTH ||
+		(*elementCount - SKETCH_HEADER_LENGTH) % 2 != 0)
+	{
+		ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+						errmsg("invalid percentile sketch")));
+	}
+
+	for (elementIndex = SKETCH_HEADER_LENGTH + 1; elementIndex < *elementCount;
+		 elementIndex += 2)
+	{
+		double weight = DatumGetFloat8(elementArray[elementIndex]);
+		if (!(weight > 0.0))
+		{
+			ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+							errmsg("invalid percentile sketch"),
+							errdetail("Centroid weights must be positive.")));
+		}
+	}
+
+	return elementArray;
+}
@@ -300,20 +300,8 @@ FindShardIntervalIndex(Datum searchedValue, ShardInterval **shardIntervalCache,
 		else
 		{
 			int hashedValue = DatumGetInt32(searchedValue);
-			uint64 hashTokenIncrement = HASH_TOKEN_COUNT / shardCount;
 
-			shardIndex = (uint32) (hashedValue - INT32_MIN) / hashTokenIncrement;
-			Assert(shardIndex <= shardCount);
-
-			/*
-			 * If the shard count is not power of 2, the range of the last
-			 * shard becomes larger than others. For that extra piece of range,
-			 * we still need to use the last shard.
-			 */
-			if (shardIndex == shardCount)
-			{
-				shardIndex = shardCount - 1;
-			}
+			shardIndex = CalculateUniformHashRangeIndex(hashedValue, shardCount);
 		}
 	}
 	else if (partitionMethod == DISTRIBUTE_BY_NONE)
@@ -335,6 +323,36 @@ FindShardIntervalIndex(Datum searchedValue, ShardInterval **shardIntervalCache,
 }
 
 
+/*
+ * CalculateUniformHashRangeIndex returns the index of the hash range into which
+ * the given hashed value falls, for tables whose shards divide the hash space
+ * into shardCount ranges of equal size. The index is computed arithmetically,
+ * which avoids the binary search over the sorted shard interval array.
+ */
+int
+CalculateUniformHashRangeIndex(int hashedValue, int shardCount)
+{
+	/* normalize the hashed value to the [0, UINT32_MAX] range */
+	uint32 normalizedHashValue = (uint32) hashedValue - (uint32) INT32_MIN;
+	uint64 hashTokenIncrement = HASH_TOKEN_COUNT / shardCount;
+	int shardIndex = (int) (normalizedHashValue / hashTokenIncrement);
+
+	Assert(shardIndex <= shardCount);
+
+	/*
+	 * If the shard count is not power of 2, the range of the last
+	 * shard becomes larger than others. For that extra piece of range,
+	 * we still need to use the last shard.
+	 */
+	if (shardIndex == shardCount)
+	{
+		shardIndex = shardCount - 1;
+	}
+
+	return shardIndex;
+}
+
+
 /*
  * SearchCachedShardInterval performs a binary search for a shard interval
  * matching a given partition column value and returns it's index in the cached
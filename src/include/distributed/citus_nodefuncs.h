@@ -1,7 +1,7 @@
 /*-------------------------------------------------------------------------
  *
  * citus_nodefuncs.h
- *	  Node (de-)serialization support for Citus.
+ *	  Node (de-)serialization and copy support for Citus.
  *
  * Copyright (c) 2012-2016, Citus Data, Inc.
  *
@@ -61,6 +61,11 @@ extern void RegisterNodes(void);
 #define OUTFUNC_ARGS StringInfo str, const Node *raw_node
 #endif
 
+#if (PG_VERSION_NUM >= 90600)
+#define COPYFUNC_ARGS struct ExtensibleNode *target_node, \
+	const struct ExtensibleNode *source_node
+#endif
+
 extern READFUNC_RET ReadJob(READFUNC_ARGS);
 extern READFUNC_RET ReadMultiPlan(READFUNC_ARGS);
 extern READFUNC_RET ReadShardInterval(READFUNC_ARGS);
@@ -81,6 +86,17 @@ extern void OutRelationShard(OUTFUNC_ARGS);
 extern void OutTask(OUTFUNC_ARGS);
 extern void OutDeferredErrorMessage(OUTFUNC_ARGS);
 
+#if (PG_VERSION_NUM >= 90600)
+extern void CopyNodeJob(COPYFUNC_ARGS);
+extern void CopyNodeMultiPlan(COPYFUNC_ARGS);
+extern void CopyNodeShardInterval(COPYFUNC_ARGS);
+extern void CopyNodeMapMergeJob(COPYFUNC_ARGS);
+extern void CopyNodeShardPlacement(COPYFUNC_ARGS);
+extern void CopyNodeRelationShard(COPYFUNC_ARGS);
+extern void CopyNodeTask(COPYFUNC_ARGS);
+extern void CopyNodeDeferredErrorMessage(COPYFUNC_ARGS);
+#endif
+
 extern void OutMultiNode(OUTFUNC_ARGS);
 extern void OutMultiTreeRoot(OUTFUNC_ARGS);
 extern void OutMultiProject(OUTFUNC_ARGS);
@@ -20,6 +20,10 @@
  *     the macros defined within that file. This function will handle
  *     converting strings into instances of the node
  *
+ *   * Implement a 'copyfunc' for the node in citus_copyfuncs.c, using
+ *     the macros defined within that file. This function will handle
+ *     copying the node, e.g. when the plan containing it is cached
+ *
  *   * Use DEFINE_NODE_METHODS within the nodeMethods array (near the
  *     bottom of citus_nodefuncs.c) to register the node in PostgreSQL
  *
@@ -14,6 +14,7 @@
 #include "distributed/transaction_management.h"
 #include "distributed/remote_transaction.h"
 #include "lib/ilist.h"
+#include "nodes/pg_list.h"
 #include "utils/hsearch.h"
 #include "utils/timestamp.h"
 
@@ -37,13 +38,34 @@ enum MultiConnectionMode
 
 	FOR_DDL = 1 << 2,
 
-	FOR_DML = 1 << 3
+	FOR_DML = 1 << 3,
+
+	/* only reuse connections that are not part of the coordinated transaction */
+	OUTSIDE_TRANSACTION = 1 << 4
 };
 
 
 /* declaring this directly above makes uncrustify go crazy */
 typedef enum MultiConnectionMode MultiConnectionMode;
 
+/*
+ * PreparedStatement describes a command that has been prepared on a remote
+ * node, so later executions of the same command over the same connection can
+ * skip parsing and planning on that node.
+ */
+typedef struct PreparedStatement
+{
+	/* name of the statement on the remote node */
+	char statementName[NAMEDATALEN];
+
+	/* command text and parameter types the statement was prepared for */
+	char *commandString;
+	uint32 commandHash;
+	int parameterCount;
+	Oid *parameterTypes;
+} PreparedStatement;
+
+
 typedef struct MultiConnection
 {
 	/* connection details, useful for error messages and such. */
@@ -75,6 +97,12 @@ typedef struct MultiConnection
 
 	/* list of all placements referenced by this connection */
 	dlist_head referencedPlacements;
+
+	/* statements prepared on this connection, allocated in ConnectionContext */
+	List *preparedStatementList;
+
+	/* does the connection hold a reservation from the shared connection budget */
+	bool sharedConnectionReserved;
 } MultiConnection;
 
 
@@ -106,6 +134,12 @@ typedef struct ConnectionHashEntry
 /* maximum duration to wait for connection */
 extern int NodeConnectionTimeout;
 
+/* maximum number of idle connections per worker kept across transactions */
+extern int MaxCachedConnectionsPerWorker;
+
+/* maximum age of connections kept across transactions */
+extern int MaxCachedConnectionLifetime;
+
 /* the hash table */
 extern HTAB *ConnectionHash;
 
@@ -133,7 +167,11 @@ extern MultiConnection * StartNodeUserDatabaseConnection(uint32 flags,
 extern MultiConnection * GetConnectionFromPGconn(struct pg_conn *pqConn);
 extern void CloseNodeConnectionsAfterTransaction(char *nodeName, int nodePort);
 extern void CloseConnection(MultiConnection *connection);
+extern void ReleaseConnection(MultiConnection *connection);
 extern void CloseConnectionByPGconn(struct pg_conn *pqConn);
+extern bool ReservedConnectionAvailable(uint32 flags, const char *hostname,
+										int32 port);
+extern uint32 ReservedConnectionCount(const char *hostname, int32 port);
 
 /* dealing with a connection */
 extern void FinishConnectionListEstablishment(List *multiConnectionList);
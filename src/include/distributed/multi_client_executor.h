@@ -83,7 +83,17 @@ typedef enum TaskExecutionStatus
 
 
 struct pollfd; /* forward declared, to avoid having to include poll.h */
-
+struct WaitEventSet; /* forward declared, to avoid having to include latch.h */
+
+/*
+ * WaitInfo tracks what a set of connections is waiting for in one cycle of an
+ * executor loop. The registrations of the current cycle are kept in pollfds.
+ * On PostgreSQL 9.6 and later, these registrations are mirrored into a wait
+ * event set that persists across cycles, and which is only rebuilt when the
+ * set of sockets changes. Each WaitInfo owns its wait event set, so that
+ * executions that are interleaved, e.g. through cursors, don't wait on each
+ * other's sockets.
+ */
 typedef struct WaitInfo
 {
 	int maxWaiters;
@@ -91,6 +101,13 @@ typedef struct WaitInfo
 	int registeredWaiters;
 	bool haveReadyWaiter;
 	bool haveFailedWaiter;
+
+#if (PG_VERSION_NUM >= 90600)
+	struct WaitEventSet *waitEventSet;
+	struct pollfd *waitEventPollfds; /* sockets currently in the wait event set */
+	int waitEventSocketCount;
+	uint64 waitEventSocketGeneration;
+#endif
 } WaitInfo;
 
 
@@ -101,12 +118,19 @@ extern int32 MultiClientConnectStart(const char *nodeName, uint32 nodePort,
 									 const char *nodeDatabase);
 extern ConnectStatus MultiClientConnectPoll(int32 connectionId);
 extern void MultiClientDisconnect(int32 connectionId);
+extern void MultiClientDisconnectAll(void);
 extern bool MultiClientConnectionUp(int32 connectionId);
+extern bool MultiClientReservedConnectionAvailable(const char *nodeName,
+												  uint32 nodePort);
+extern bool MultiClientHoldSharedConnection(int32 connectionId);
 extern bool MultiClientExecute(int32 connectionId, const char *query, void **queryResult,
 							   int *rowCount, int *columnCount);
 extern bool MultiClientSendQuery(int32 connectionId, const char *query);
+extern bool MultiClientSendBinaryQuery(int32 connectionId, const char *query);
+extern bool MultiClientSetSingleRowMode(int32 connectionId);
 extern bool MultiClientCancel(int32 connectionId);
 extern ResultStatus MultiClientResultStatus(int32 connectionId);
+extern bool MultiClientResultBusy(int32 connectionId);
 extern QueryStatus MultiClientQueryStatus(int32 connectionId);
 extern CopyStatus MultiClientCopyData(int32 connectionId, int32 fileDescriptor);
 extern bool MultiClientQueryResult(int32 connectionId, void **queryResult,
@@ -114,15 +138,18 @@ extern bool MultiClientQueryResult(int32 connectionId, void **queryResult,
 extern BatchQueryStatus MultiClientBatchResult(int32 connectionId, void **queryResult,
 											   int *rowCount, int *columnCount);
 extern char * MultiClientGetValue(void *queryResult, int rowIndex, int columnIndex);
+extern int MultiClientGetValueLength(void *queryResult, int rowIndex, int columnIndex);
 extern bool MultiClientValueIsNull(void *queryResult, int rowIndex, int columnIndex);
 extern void MultiClientClearResult(void *queryResult);
 extern WaitInfo * MultiClientCreateWaitInfo(int maxConnections);
 
 extern void MultiClientResetWaitInfo(WaitInfo *waitInfo);
 extern void MultiClientFreeWaitInfo(WaitInfo *waitInfo);
+extern void MultiClientFreeAllWaitEventSets(void);
 extern void MultiClientRegisterWait(WaitInfo *waitInfo, TaskExecutionStatus waitStatus,
 									int32 connectionId);
 extern void MultiClientWait(WaitInfo *waitInfo);
+extern void MultiClientWaitForFailureBackoff(void);
 
 
 #endif /* MULTI_CLIENT_EXECUTOR_H */
@@ -25,6 +25,9 @@
 #endif
 
 
+struct SortedMerge; /* private to multi_executor.c */
+struct ParallelTaskScan; /* private to multi_executor.c */
+
 typedef struct CitusScanState
 {
 	CustomScanState customScanState;  /* underlying custom scan node */
@@ -32,6 +35,11 @@ typedef struct CitusScanState
 	MultiExecutorType executorType;   /* distributed executor type */
 	bool finishedRemoteScan;          /* flag to check if remote scan is finished */
 	Tuplestorestate *tuplestorestate; /* tuple store to store distributed results */
+	bool streamResults;               /* whether results are returned as they arrive */
+	RealTimeExecution *realTimeExecution; /* ongoing execution, if streaming */
+	bool randomAccess;                /* whether the scan may move backwards */
+	struct SortedMerge *sortedMerge;  /* merge of sorted task results, if any */
+	struct ParallelTaskScan *parallelTaskScan; /* shared reading of task results */
 } CitusScanState;
 
 
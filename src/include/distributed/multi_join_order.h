@@ -76,6 +76,8 @@ typedef struct JoinOrderNode
 /* Config variables managed via guc.c */
 extern int LargeTableShardCount;
 extern bool LogMultiJoinOrder;
+extern bool EnableCostBasedJoinOrder;
+extern int BroadcastJoinSizeThreshold;
 
 
 /* Function declaration for determining table join orders */
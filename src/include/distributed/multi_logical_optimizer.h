@@ -21,8 +21,16 @@
 /* Definitions local to logical plan optimizer */
 #define DIVISION_OPER_NAME "/"
 #define DISABLE_LIMIT_APPROXIMATION -1
+#define DISABLE_LIMIT_OVERFETCH 0
 #define DISABLE_DISTINCT_APPROXIMATION 0.0
+#define DISABLE_PERCENTILE_APPROXIMATION 0
 #define ARRAY_CAT_AGGREGATE_NAME "array_cat_agg"
+#define CITUS_AGGREGATE_SCHEMA_NAME "pg_catalog"
+#define WORKER_PARTIAL_AGGREGATE_NAME "worker_partial_agg"
+#define MASTER_COMBINE_AGGREGATE_NAME "master_combine_agg"
+#define PERCENTILE_SKETCH_ADD_AGGREGATE_NAME "percentile_sketch_add_agg"
+#define PERCENTILE_SKETCH_UNION_AGGREGATE_NAME "percentile_sketch_union_agg"
+#define PERCENTILE_SKETCH_VALUE_FUNC_NAME "percentile_sketch_value"
 #define WORKER_COLUMN_FORMAT "worker_column_%d"
 
 /* Definitions related to count(distinct) approximations */
@@ -44,7 +52,8 @@
  *
  * Please note that the order of values in this enumeration is tied to the order
  * of elements in the following AggregateNames array. This order needs to be
- * preserved.
+ * preserved. AGGREGATE_CUSTOM_COMBINE is the exception; it stands for all other
+ * aggregates that have a combine function, and has no name in the array.
  */
 typedef enum
 {
@@ -54,7 +63,9 @@ typedef enum
 	AGGREGATE_MAX = 3,
 	AGGREGATE_SUM = 4,
 	AGGREGATE_COUNT = 5,
-	AGGREGATE_ARRAY_AGG = 6
+	AGGREGATE_ARRAY_AGG = 6,
+	AGGREGATE_PERCENTILE_CONT = 7,
+	AGGREGATE_CUSTOM_COMBINE = 8
 } AggregateType;
 
 
@@ -96,13 +107,17 @@ typedef enum
  */
 static const char *const AggregateNames[] = {
 	"invalid", "avg", "min", "max", "sum",
-	"count", "array_agg"
+	"count", "array_agg", "percentile_cont"
 };
 
 
 /* Config variable managed via guc.c */
 extern int LimitClauseRowFetchCount;
+extern int LimitClauseOverfetchFactor;
 extern double CountDistinctErrorRate;
+extern int PercentileApproximationCompression;
+extern bool EnableSortedMerge;
+extern bool EnableGroupByPushdown;
 
 
 /* Function declaration for optimizing logical plans */
@@ -172,6 +172,9 @@ typedef struct MultiExtendedOp
 	Node *limitCount;
 	Node *limitOffset;
 	Node *havingQual;
+	List *distinctClause;
+	bool hasDistinctOn;
+	List *windowClause;
 } MultiExtendedOp;
 
 
@@ -19,6 +19,10 @@
 #include "nodes/plannodes.h"
 
 
+/* Config variable managed via guc.c */
+extern int MaxMasterParallelWorkers;
+
+
 /* Function declarations for building local plans on the master node */
 struct MultiPlan;
 struct CustomScan;
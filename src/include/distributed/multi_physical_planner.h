@@ -47,6 +47,8 @@
  (" UINT64_FORMAT ", %d, '%s', '%s')"
 #define MERGE_FILES_AND_RUN_QUERY_COMMAND \
 	"SELECT worker_merge_files_and_run_query(" UINT64_FORMAT ", %d, %s, %s)"
+#define FRAGMENT_NAME_PLACEHOLDER "citus_fragment_placeholder_%u_"
+#define MAX_SORTED_MERGE_TASK_COUNT 128
 
 
 typedef enum CitusRTEKind
@@ -123,6 +125,7 @@ typedef struct Job
 	List *dependedJobList;
 	bool subqueryPushdown;
 	bool requiresMasterEvaluation; /* only applies to modify jobs */
+	Param *deferredPruningParam; /* set if the task is picked at execution time */
 } Job;
 
 
@@ -220,6 +223,12 @@ typedef struct MultiPlan
 	Query *masterQuery;
 	bool routerExecutable;
 
+	/*
+	 * True if task results are sorted by the master query's sort clause, so
+	 * that the master node merges them instead of sorting them again.
+	 */
+	bool sortedMerge;
+
 	/*
 	 * NULL if this a valid plan, an error description otherwise. This will
 	 * e.g. be set if SQL features are present that a planner doesn't support,
@@ -254,6 +263,10 @@ extern Task * CreateBasicTask(uint64 jobId, uint32 taskId, TaskType taskType,
 /* Function declarations for shard pruning */
 extern List * PruneShardList(Oid relationId, Index tableId, List *whereClauseList,
 							 List *shardList);
+extern List * PruneShardIntervalList(Oid relationId, Index tableId,
+									 List *whereClauseList, List *shardIntervalList,
+									 List **removedShardList);
+extern void LogRemovedShardIntervals(List *removedShardList);
 extern bool ContainsFalseClause(List *whereClauseList);
 extern OpExpr * MakeOpExpression(Var *variable, int16 strategyNumber);
 
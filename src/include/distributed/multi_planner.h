@@ -53,6 +53,9 @@ extern PlannedStmt * multi_planner(Query *parse, int cursorOptions,
 
 struct MultiPlan;
 extern struct MultiPlan * GetMultiPlan(CustomScan *node);
+#if (PG_VERSION_NUM >= 90600)
+extern void RegisterCitusCustomScanMethods(void);
+#endif
 extern void multi_relation_restriction_hook(PlannerInfo *root, RelOptInfo *relOptInfo,
 											Index index, RangeTblEntry *rte);
 extern bool IsModifyCommand(Query *query);
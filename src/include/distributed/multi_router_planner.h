@@ -28,9 +28,12 @@
 #define CITUS_TABLE_ALIAS "citus_table_alias"
 
 extern bool EnableRouterExecution;
+extern bool EnableFastPathRouterPlanner;
 
 extern MultiPlan * CreateRouterPlan(Query *originalQuery, Query *query,
 									RelationRestrictionContext *restrictionContext);
+extern MultiPlan * CreateFastPathRouterPlan(Query *query, ParamListInfo boundParams);
+extern void PruneDeferredTaskList(Job *job, ParamListInfo paramListInfo);
 extern MultiPlan * CreateModifyPlan(Query *originalQuery, Query *query,
 									RelationRestrictionContext *restrictionContext);
 
@@ -17,6 +17,7 @@
 #include "distributed/multi_physical_planner.h"
 #include "distributed/task_tracker.h"
 #include "distributed/worker_manager.h"
+#include "utils/tuplestore.h"
 
 
 #define MAX_TASK_EXECUTION_FAILURES 3 /* allowed failure count for one task */
@@ -58,7 +59,10 @@ typedef enum
 	EXEC_TASK_TRACKER_RETRY = 13,
 	EXEC_TASK_TRACKER_FAILED = 14,
 	EXEC_SOURCE_TASK_TRACKER_RETRY = 15,
-	EXEC_SOURCE_TASK_TRACKER_FAILED = 16
+	EXEC_SOURCE_TASK_TRACKER_FAILED = 16,
+
+	/* used for real-time executions that stream their results */
+	EXEC_COMPUTE_TASK_STREAMING = 17
 } TaskExecStatus;
 
 
@@ -126,6 +130,7 @@ struct TaskExecution
 	uint32 querySourceNodeIndex; /* only applies to map fetch tasks */
 	int32 dataFetchTaskIndex;
 	uint32 failureCount;
+	bool resultsStreamed; /* only applies to streaming real-time executions */
 };
 
 
@@ -168,25 +173,67 @@ typedef struct TaskTracker
 
 /*
  * WorkerNodeState keeps state for a worker node. The real-time executor uses this to
- * keep track of the number of open connections to a worker node.
+ * keep track of the number of open connections to a worker node. When the number
+ * of connections per worker is bounded, connections of completed tasks are kept
+ * in the idle connection list, and handed to the next task for that worker.
+ *
+ * With slow start enabled, the executor initially allows only one connection to
+ * each worker. connectionLimit then doubles for every slow start interval in which
+ * tasks for the worker had to wait for a connection.
  */
 typedef struct WorkerNodeState
 {
 	uint32 workerPort;
 	char workerName[WORKER_LENGTH];
 	uint32 openConnectionCount;
+	List *idleConnectionList;
+
+	uint32 connectionLimit;
+	uint32 waitingTaskCount;
+	TimestampTz connectionLimitChangeTime;
 } WorkerNodeState;
 
 
+/*
+ * RealTimeExecution keeps the state of a real-time execution that streams its
+ * results. Its fields are private to the real-time executor.
+ */
+typedef struct RealTimeExecution RealTimeExecution;
+
+
+/*
+ * AttributeReceiveMetadata keeps the binary receive functions for the columns
+ * of a tuple descriptor, to build tuples from rows that workers send in binary
+ * format.
+ */
+typedef struct AttributeReceiveMetadata
+{
+	TupleDesc tupleDescriptor;
+	FmgrInfo *receiveFunctionArray;
+	Oid *typeIOParamArray;
+	Datum *columnValues;
+	bool *columnNulls;
+} AttributeReceiveMetadata;
+
+
 /* Config variable managed via guc.c */
 extern int RemoteTaskCheckInterval;
 extern int MaxAssignTaskBatchSize;
 extern int TaskExecutorType;
 extern bool BinaryMasterCopyFormat;
+extern int MaxConnectionsPerWorker;
+extern int ExecutorSlowStartInterval;
+extern bool EnableResultStreaming;
+extern bool EnableBinaryProtocol;
 
 
 /* Function declarations for distributed execution */
 extern void MultiRealTimeExecute(Job *job);
+extern RealTimeExecution * MultiRealTimeExecuteStart(Job *job,
+													 Tuplestorestate *tupleStore,
+													 TupleDesc tupleDescriptor);
+extern bool MultiRealTimeExecuteNext(RealTimeExecution *execution);
+extern void MultiRealTimeExecuteEnd(RealTimeExecution *execution);
 extern void MultiTaskTrackerExecute(Job *job);
 
 /* Function declarations common to more than one executor */
@@ -197,6 +244,10 @@ extern void CleanupTaskExecution(TaskExecution *taskExecution);
 extern bool TaskExecutionFailed(TaskExecution *taskExecution);
 extern void AdjustStateForFailure(TaskExecution *taskExecution);
 extern int MaxMasterConnectionCount(void);
+extern bool CanUseBinaryProtocol(TupleDesc tupleDescriptor);
+extern AttributeReceiveMetadata * TupleDescGetReceiveMetadata(TupleDesc tupleDescriptor);
+extern HeapTuple BuildTupleFromBinaryValues(AttributeReceiveMetadata *receiveMetadata,
+											char **valueArray, int *lengthArray);
 
 
 #endif /* MULTI_SERVER_EXECUTOR_H */
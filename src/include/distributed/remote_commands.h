@@ -21,6 +21,7 @@ struct pg_result; /* target of the PGresult typedef */
 
 /* GUC, determining whether statements sent to remote nodes are logged */
 extern bool LogRemoteCommands;
+extern int MaxPreparedStatementsPerConnection;
 
 
 /* simple helpers */
@@ -43,7 +44,12 @@ extern int ExecuteOptionalRemoteCommand(MultiConnection *connection,
 extern int SendRemoteCommand(MultiConnection *connection, const char *command);
 extern int SendRemoteCommandParams(MultiConnection *connection, const char *command,
 								   int parameterCount, const Oid *parameterTypes,
-								   const char *const *parameterValues);
+								   const char *const *parameterValues,
+								   bool binaryResults);
+extern int SendRemotePreparedCommand(MultiConnection *connection, const char *command,
+									 int parameterCount, const Oid *parameterTypes,
+									 const char *const *parameterValues,
+									 bool binaryResults);
 extern struct pg_result * GetRemoteCommandResult(MultiConnection *connection,
 												 bool raiseInterrupts);
 
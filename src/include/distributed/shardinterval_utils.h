@@ -37,6 +37,7 @@ extern ShardInterval * FindShardInterval(Datum partitionColumnValue,
 										 int shardCount, char partitionMethod,
 										 FmgrInfo *compareFunction,
 										 FmgrInfo *hashFunction, bool useBinarySearch);
+extern int CalculateUniformHashRangeIndex(int hashedValue, int shardCount);
 extern bool SingleReplicatedTable(Oid relationId);
 
 #endif /* SHARDINTERVAL_UTILS_H_ */
@@ -0,0 +1,66 @@
+/*-------------------------------------------------------------------------
+ *
+ * shared_connection_stats.h
+ *	  Type and function declarations for tracking the number of connections
+ *	  all backends on this node have open to each worker node.
+ *
+ * Copyright (c) 2017, Citus Data, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef SHARED_CONNECTION_STATS_H
+#define SHARED_CONNECTION_STATS_H
+
+#include "distributed/worker_manager.h"
+#include "storage/lwlock.h"
+#include "utils/hsearch.h"
+
+
+/*
+ * SharedConnectionStatsEntry keeps the number of connections that backends on
+ * this node currently have reserved to one worker node. The entries are kept
+ * in a shared hash, keyed by worker node name and port.
+ */
+typedef struct SharedConnectionStatsEntry
+{
+	uint32 workerPort;              /* node's port; part of hash table key */
+	char workerName[WORKER_LENGTH]; /* node's name; part of hash table key */
+	uint32 connectionCount;
+} SharedConnectionStatsEntry;
+
+
+/*
+ * SharedConnectionStatsData contains the connection counts shared between
+ * all backends, and the lock protecting them. Backends whose reservations
+ * failed mark themselves in waitingBackendArray, indexed by pgprocno, so that
+ * backends returning connections can wake them up.
+ */
+typedef struct SharedConnectionStatsData
+{
+	HTAB *connectionStatsHash;
+
+	int connectionStatsTrancheId;
+	LWLockTranche connectionStatsLockTranche;
+	LWLock connectionStatsLock;
+
+	int waitingBackendCount;
+	int backendSlotCount;
+	bool waitingBackendArray[FLEXIBLE_ARRAY_MEMBER];
+} SharedConnectionStatsData;
+
+
+/* Config variable managed via guc.c */
+extern int MaxSharedConnectionsPerWorker;
+
+
+/* Function declarations for the shared connection budget */
+extern void InitializeSharedConnectionStats(void);
+extern bool TryReserveSharedConnection(const char *workerName, uint32 workerPort,
+									   bool *connectionReserved);
+extern void ReleaseSharedConnection(const char *workerName, uint32 workerPort);
+extern void ReleaseUnheldSharedConnections(void);
+extern uint32 SharedConnectionCount(const char *workerName, uint32 workerPort);
+
+
+#endif /* SHARED_CONNECTION_STATS_H */
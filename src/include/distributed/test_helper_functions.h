@@ -72,5 +72,14 @@ extern Datum prune_using_either_value(PG_FUNCTION_ARGS);
 extern Datum prune_using_both_values(PG_FUNCTION_ARGS);
 extern Datum debug_equality_expression(PG_FUNCTION_ARGS);
 
+/* function declarations for benchmarking shard interval lookups */
+extern Datum find_shard_interval_benchmark(PG_FUNCTION_ARGS);
+
+/* function declarations for inspecting the shared connection budget */
+extern Datum shared_connection_count(PG_FUNCTION_ARGS);
+
+/* function declarations for inspecting statements prepared on workers */
+extern Datum remote_prepared_statement_count(PG_FUNCTION_ARGS);
+
 
 #endif /* CITUS_TEST_HELPER_FUNCTIONS_H */
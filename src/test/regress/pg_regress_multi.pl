@@ -231,7 +231,8 @@ for my $option (@userPgOptions)
 %dataTypes = ('dummy_type', '(i integer)',
                'order_side', ' ENUM (\'buy\', \'sell\')',
                'test_composite_type', '(i integer, i2 integer)',
-               'bug_status', ' ENUM (\'new\', \'open\', \'closed\')');
+               'bug_status', ' ENUM (\'new\', \'open\', \'closed\')',
+               'binary_status', ' ENUM (\'active\', \'inactive\')');
 
 # define functions as signature->definition
 %functions = ('fake_fdw_handler()', 'fdw_handler AS \'citus\' LANGUAGE C STRICT;',
@@ -0,0 +1,67 @@
+--
+-- MULTI_AGG_APPROXIMATE_PERCENTILE
+--
+-- Tests for approximating percentile_cont() with percentile sketches.
+
+ALTER SEQUENCE pg_catalog.pg_dist_shardid_seq RESTART 1440000;
+ALTER SEQUENCE pg_catalog.pg_dist_jobid_seq RESTART 1440000;
+
+SET citus.shard_count TO 4;
+
+CREATE TABLE latencies (key integer, latency float8);
+SELECT create_distributed_table('latencies', 'key');
+
+COPY latencies FROM STDIN WITH CSV;
+1,10
+2,20
+3,30
+4,40
+5,50
+6,60
+7,70
+8,80
+9,90
+10,100
+\.
+
+-- exact percentiles cannot be computed on distributed tables
+SELECT percentile_cont(0.5) WITHIN GROUP (ORDER BY latency) FROM latencies;
+
+SET citus.percentile_approximation_compression TO 100;
+
+-- sketches keep small inputs as is, so these percentiles are exact
+SELECT
+	percentile_cont(0.25) WITHIN GROUP (ORDER BY latency) AS p25,
+	percentile_cont(0.5) WITHIN GROUP (ORDER BY latency) AS p50,
+	percentile_cont(0.75) WITHIN GROUP (ORDER BY latency) AS p75,
+	percentile_cont(1.0) WITHIN GROUP (ORDER BY latency) AS p100
+FROM latencies;
+
+SELECT key % 2 AS parity, percentile_cont(0.5) WITHIN GROUP (ORDER BY key)
+FROM latencies GROUP BY parity ORDER BY parity;
+
+SELECT percentile_cont(0.5) WITHIN GROUP (ORDER BY latency) FILTER (WHERE key <= 4)
+FROM latencies;
+
+-- percentiles over no rows are null
+SELECT percentile_cont(0.5) WITHIN GROUP (ORDER BY latency) FROM latencies
+WHERE latency > 1000;
+
+-- sketches of larger inputs are merged into accurate approximations
+SELECT
+	abs(percentile_sketch_value(percentile_sketch_union_agg(sketch), 0.5) - 5000.5) < 50
+		AS accurate_p50,
+	abs(percentile_sketch_value(percentile_sketch_union_agg(sketch), 0.99) - 9900.01) < 10
+		AS accurate_p99
+FROM (SELECT percentile_sketch_add_agg(x, 100) AS sketch
+	  FROM generate_series(1, 10000) x GROUP BY x % 4) sketches;
+
+-- only single fractions of double precision values are approximated
+SELECT percentile_cont(ARRAY[0.25, 0.75]) WITHIN GROUP (ORDER BY latency) FROM latencies;
+SELECT percentile_cont(0.5) WITHIN GROUP (ORDER BY latency * interval '1 ms') FROM latencies;
+SELECT percentile_cont(key / 20.0) WITHIN GROUP (ORDER BY latency) FROM latencies GROUP BY key;
+SELECT percentile_cont(1.5) WITHIN GROUP (ORDER BY latency) FROM latencies;
+
+RESET citus.percentile_approximation_compression;
+
+DROP TABLE latencies;
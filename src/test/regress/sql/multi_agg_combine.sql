@@ -0,0 +1,58 @@
+--
+-- MULTI_AGG_COMBINE
+--
+-- Tests for aggregates that are computed from partial results using their
+-- combine functions.
+
+ALTER SEQUENCE pg_catalog.pg_dist_shardid_seq RESTART 1430000;
+ALTER SEQUENCE pg_catalog.pg_dist_jobid_seq RESTART 1430000;
+
+-- print major version to make version-specific tests clear
+SELECT substring(version(), '\d+\.\d+') AS major_version;
+
+SET citus.shard_count TO 4;
+
+CREATE TABLE agg_combine (key integer, value integer, flag boolean);
+SELECT create_distributed_table('agg_combine', 'key');
+
+COPY agg_combine FROM STDIN WITH CSV;
+1,1,t
+2,2,t
+3,3,t
+4,4,t
+5,5,t
+6,6,t
+7,7,t
+8,8,t
+9,9,t
+10,10,f
+\.
+
+-- aggregates that only have combine functions are computed on worker nodes
+SELECT bool_and(flag), bool_or(flag), every(value > 0), bit_and(value), bit_or(value)
+FROM agg_combine;
+
+SELECT variance(value::float8), stddev(value::float8) FROM agg_combine;
+
+SELECT value % 2 AS parity, bool_and(flag), bit_or(value)
+FROM agg_combine GROUP BY parity ORDER BY parity;
+
+-- filters, having clauses and order by clauses also work
+SELECT value % 2 AS parity, bit_or(value) FILTER (WHERE value > 5)
+FROM agg_combine GROUP BY parity HAVING bool_and(flag) ORDER BY parity;
+
+SELECT value % 3 AS remainder, stddev(value::float8)
+FROM agg_combine GROUP BY remainder ORDER BY 2 DESC LIMIT 1;
+
+-- shards without any rows don't contribute to the result
+SELECT bool_and(flag), bit_or(value) FROM agg_combine WHERE value > 100;
+
+-- aggregates without combine functions are still unsupported
+SELECT json_agg(value) FROM agg_combine;
+
+-- we don't support distinct for aggregates computed from partial results
+SELECT bool_and(DISTINCT flag) FROM agg_combine;
+
+RESET citus.shard_count;
+
+DROP TABLE agg_combine;
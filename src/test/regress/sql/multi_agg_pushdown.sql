@@ -0,0 +1,102 @@
+--
+-- MULTI_AGG_PUSHDOWN
+--
+-- Tests for computing groups and distinct rows on the partition column fully on
+-- the worker nodes.
+
+ALTER SEQUENCE pg_catalog.pg_dist_shardid_seq RESTART 1450000;
+ALTER SEQUENCE pg_catalog.pg_dist_jobid_seq RESTART 1450000;
+
+SET citus.shard_count TO 4;
+
+CREATE TABLE page_views (site_id integer, user_id integer, views integer);
+SELECT create_distributed_table('page_views', 'site_id');
+
+COPY page_views FROM STDIN WITH CSV;
+1,1,10
+1,2,20
+1,2,5
+2,1,7
+2,3,30
+3,4,1
+4,1,2
+4,5,50
+4,5,8
+\.
+
+-- distinct clauses need to include the partition column
+SELECT DISTINCT user_id FROM page_views ORDER BY user_id;
+
+SELECT DISTINCT site_id FROM page_views ORDER BY site_id;
+SELECT DISTINCT site_id, user_id FROM page_views ORDER BY site_id, user_id;
+
+SELECT DISTINCT ON (site_id) site_id, user_id, views FROM page_views
+ORDER BY site_id, views DESC;
+
+-- distinct clauses also need to include the columns that the query groups by
+SELECT DISTINCT site_id FROM page_views GROUP BY site_id, user_id ORDER BY site_id;
+SELECT DISTINCT site_id, user_id FROM page_views GROUP BY site_id, user_id
+ORDER BY site_id, user_id;
+
+-- aggregates without combine functions can't be computed in two phases
+SELECT site_id, string_agg(user_id::text, ',' ORDER BY user_id, views)
+FROM page_views GROUP BY site_id ORDER BY site_id;
+
+SET citus.enable_group_by_pushdown TO on;
+
+-- worker nodes compute the groups on the partition column as they are
+SELECT site_id, string_agg(user_id::text, ',' ORDER BY user_id, views)
+FROM page_views GROUP BY site_id ORDER BY site_id;
+
+SELECT site_id, sum(views) AS total_views FROM page_views
+GROUP BY site_id HAVING count(*) > 1
+ORDER BY total_views DESC, site_id LIMIT 2;
+
+-- worker nodes compute groups, having and distinct clauses, and the master node
+-- doesn't aggregate again
+\a\t
+EXPLAIN (COSTS FALSE)
+SELECT DISTINCT site_id FROM page_views GROUP BY site_id HAVING count(*) > 1;
+\a\t
+
+-- joins of co-located tables push down groups on both partition columns
+CREATE TABLE sites (site_id integer, site_name text);
+SELECT create_distributed_table('sites', 'site_id');
+
+COPY sites FROM STDIN WITH CSV;
+1,a
+2,b
+3,c
+4,d
+\.
+
+SELECT p.site_id, s.site_name, string_agg(p.user_id::text, ',' ORDER BY p.user_id, p.views)
+FROM page_views p, sites s WHERE p.site_id = s.site_id
+GROUP BY p.site_id, s.site_id, s.site_name ORDER BY p.site_id;
+
+SET citus.explain_distributed_queries TO off;
+\a\t
+
+EXPLAIN (COSTS FALSE)
+SELECT p.site_id, count(*) FROM page_views p, sites s WHERE p.site_id = s.site_id
+GROUP BY p.site_id, s.site_id;
+
+-- joins that group by a single partition column are combined on the master node
+EXPLAIN (COSTS FALSE)
+SELECT p.site_id, count(*) FROM page_views p, sites s WHERE p.site_id = s.site_id
+GROUP BY p.site_id;
+
+\a\t
+RESET citus.explain_distributed_queries;
+
+SELECT p.site_id, count(*) FROM page_views p, sites s WHERE p.site_id = s.site_id
+GROUP BY p.site_id ORDER BY p.site_id;
+
+-- groups on other columns are still combined on the master node
+SELECT user_id, count(*) FROM page_views GROUP BY user_id ORDER BY user_id;
+SELECT user_id, string_agg(site_id::text, ',') FROM page_views GROUP BY user_id;
+
+RESET citus.enable_group_by_pushdown;
+
+DROP TABLE page_views;
+DROP TABLE sites;
@@ -0,0 +1,82 @@
+--
+-- MULTI_BINARY_PROTOCOL
+--
+-- Tests for receiving router and streamed real-time results from the workers in
+-- binary format. Types created after initdb have different oids on each node,
+-- so rows with such types are received in text format instead.
+
+ALTER SEQUENCE pg_catalog.pg_dist_shardid_seq RESTART 1490000;
+
+SET citus.task_executor_type TO 'real-time';
+SET citus.shard_count TO 4;
+SET citus.shard_replication_factor TO 1;
+
+-- binary_status is also created on the workers by the test runner
+CREATE TYPE binary_status AS ENUM ('active', 'inactive');
+
+CREATE TABLE binary_values (
+	key integer,
+	small_value smallint,
+	big_value bigint,
+	numeric_value numeric,
+	float_value double precision,
+	text_value text,
+	varchar_value varchar(10),
+	bool_value boolean,
+	date_value date,
+	timestamp_value timestamp,
+	timestamptz_value timestamptz,
+	interval_value interval,
+	bytea_value bytea,
+	array_value integer[],
+	jsonb_value jsonb,
+	status binary_status
+);
+SELECT create_distributed_table('binary_values', 'key');
+
+INSERT INTO binary_values VALUES
+	(1, 1, 10000000000, 12.345, 1.5, 'one', 'uno', true, '2017-01-02',
+	 '2017-01-02 03:04:05.5', '2017-01-02 03:04:05+00', '1 day 02:00:00', '\x0102',
+	 '{1,2,NULL}', '{"a": 1}', 'active');
+INSERT INTO binary_values VALUES
+	(2, -2, -20000000000, -0.001, -2.25, 'two', 'dos', false, '1999-12-31',
+	 '1999-12-31 23:59:59', '1999-12-31 23:59:59-08', '-3 hours', '\x',
+	 '{}', '[1, "b"]', 'inactive');
+INSERT INTO binary_values (key) VALUES (3);
+
+SET citus.enable_binary_protocol TO on;
+
+-- router selects decode each type with its receive function
+SELECT key, small_value, big_value, numeric_value, float_value
+FROM binary_values WHERE key = 1;
+
+SELECT key, text_value, varchar_value, bool_value, bytea_value, array_value, jsonb_value
+FROM binary_values WHERE key = 2;
+
+SELECT key, date_value, timestamp_value, timestamptz_value, interval_value
+FROM binary_values WHERE key = 1;
+
+-- NULL values in every column, received in text format due to the enum column
+SELECT * FROM binary_values WHERE key = 3;
+
+SELECT key, status, numeric_value FROM binary_values WHERE key = 2;
+
+-- streamed real-time tasks receive binary results as well
+SET citus.enable_result_streaming TO on;
+
+SELECT key, small_value, big_value, numeric_value, float_value
+FROM binary_values ORDER BY key;
+
+SELECT key, text_value, varchar_value, bool_value, bytea_value, array_value, jsonb_value
+FROM binary_values ORDER BY key;
+
+SELECT key, date_value, timestamp_value, timestamptz_value, interval_value
+FROM binary_values ORDER BY key;
+
+SELECT key, status FROM binary_values ORDER BY key;
+
+RESET citus.enable_result_streaming;
+RESET citus.enable_binary_protocol;
+
+DROP TABLE binary_values;
+DROP TYPE binary_status;
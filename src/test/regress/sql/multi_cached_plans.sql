@@ -0,0 +1,68 @@
+--
+-- MULTI_CACHED_PLANS
+--
+-- Tests for distributed plans that postgres caches for prepared statements,
+-- and copies for each execution. The executions should see the same plan as
+-- the first one, also after the cached plan is rebuilt.
+
+ALTER SEQUENCE pg_catalog.pg_dist_shardid_seq RESTART 1520000;
+
+SET citus.task_executor_type TO 'real-time';
+SET citus.shard_count TO 4;
+SET citus.shard_replication_factor TO 1;
+
+CREATE TABLE cached_events (event_key integer, event_value integer);
+SELECT create_distributed_table('cached_events', 'event_key');
+
+COPY cached_events FROM STDIN WITH CSV;
+1,10
+2,20
+3,30
+4,40
+5,50
+6,60
+7,70
+8,80
+\.
+
+-- statements without parameters use the same plan for every execution
+PREPARE sorted_events AS
+	SELECT event_key, event_value FROM cached_events ORDER BY event_key LIMIT 3;
+
+PREPARE grouped_events AS
+	SELECT event_value % 20 AS remainder, count(*), sum(event_value)
+	FROM cached_events GROUP BY 1 ORDER BY 1;
+
+EXECUTE sorted_events;
+EXECUTE sorted_events;
+EXECUTE grouped_events;
+EXECUTE grouped_events;
+
+-- lookups with a parameter switch to a generic plan from the 6th execution on
+SET citus.enable_fast_path_router_planner TO on;
+
+PREPARE event_lookup(integer) AS
+	SELECT event_value FROM cached_events WHERE event_key = $1;
+
+EXECUTE event_lookup(1);
+EXECUTE event_lookup(2);
+EXECUTE event_lookup(3);
+EXECUTE event_lookup(4);
+EXECUTE event_lookup(5);
+EXECUTE event_lookup(6);
+EXECUTE event_lookup(7);
+
+-- rebuilding the cached plans gives the same results
+DISCARD PLANS;
+
+EXECUTE sorted_events;
+EXECUTE grouped_events;
+EXECUTE event_lookup(8);
+EXECUTE event_lookup(1);
+
+DEALLOCATE sorted_events;
+DEALLOCATE grouped_events;
+DEALLOCATE event_lookup;
+RESET citus.enable_fast_path_router_planner;
+
+DROP TABLE cached_events;
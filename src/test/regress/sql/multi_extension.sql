@@ -77,6 +77,8 @@ ALTER EXTENSION citus UPDATE TO '6.1-16';
 ALTER EXTENSION citus UPDATE TO '6.1-17';
 ALTER EXTENSION citus UPDATE TO '6.2-1';
 ALTER EXTENSION citus UPDATE TO '6.2-2';
+ALTER EXTENSION citus UPDATE TO '6.2-3';
+ALTER EXTENSION citus UPDATE TO '6.2-4';
 
 -- ensure no objects were created outside pg_catalog
 SELECT COUNT(*)
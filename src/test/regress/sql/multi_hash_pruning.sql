@@ -68,10 +68,23 @@ SELECT count(*) FROM orders_hash_partitioned
 SELECT count(*) FROM
        (SELECT o_orderkey FROM orders_hash_partitioned WHERE o_orderkey = 1) AS orderkeys;
 
--- Check that we don't support pruning for ANY (array expression) and give
--- a notice message when used with the partition column
+-- Check that we prune shards for ANY (array expression) and IN lists on the
+-- partition column
 SELECT count(*) FROM orders_hash_partitioned
 	WHERE o_orderkey = ANY ('{1,2,3}');
+SELECT count(*) FROM orders_hash_partitioned
+	WHERE o_orderkey IN (3, 4);
+
+-- Check that ANY on an empty array or an array of NULLs prunes all shards
+SELECT o_orderkey FROM orders_hash_partitioned
+	WHERE o_orderkey = ANY ('{}');
+SELECT o_orderkey FROM orders_hash_partitioned
+	WHERE o_orderkey = ANY ('{NULL,NULL}');
+
+-- Check that we don't support pruning for ALL (array expression) and give
+-- a notice message when used with the partition column
+SELECT count(*) FROM orders_hash_partitioned
+	WHERE o_orderkey = ALL ('{1,2,3}');
 
 -- Check that we don't show the message if the operator is not
 -- equality operator
@@ -126,6 +126,81 @@ EXPLAIN SELECT count(*) FROM orders_hash, customer
 
 COMMIT;
 
+-- Validate that the cost based join order picks the join order that transfers
+-- the fewest bytes, using the shard lengths in the metadata. Re-partitioning the
+-- small customer table first avoids re-partitioning the large lineitem table
+-- twice.
+CREATE TABLE orders_cost (o_id integer, o_custkey integer, o_partkey integer);
+SELECT master_create_distributed_table('orders_cost', 'o_id', 'hash');
+SELECT master_create_worker_shards('orders_cost', 2, 1);
+
+CREATE TABLE lineitem_cost (l_id integer, l_partkey integer);
+SELECT master_create_distributed_table('lineitem_cost', 'l_id', 'hash');
+SELECT master_create_worker_shards('lineitem_cost', 2, 1);
+
+CREATE TABLE customer_cost (c_id integer, c_custkey integer);
+SELECT master_create_distributed_table('customer_cost', 'c_id', 'hash');
+SELECT master_create_worker_shards('customer_cost', 2, 1);
+
+UPDATE pg_dist_shard_placement SET shardlength = 100000 WHERE shardid IN
+	(SELECT shardid FROM pg_dist_shard WHERE logicalrelid = 'orders_cost'::regclass);
+UPDATE pg_dist_shard_placement SET shardlength = 1000000 WHERE shardid IN
+	(SELECT shardid FROM pg_dist_shard WHERE logicalrelid = 'lineitem_cost'::regclass);
+UPDATE pg_dist_shard_placement SET shardlength = 1000 WHERE shardid IN
+	(SELECT shardid FROM pg_dist_shard WHERE logicalrelid = 'customer_cost'::regclass);
+
+EXPLAIN SELECT count(*) FROM orders_cost, lineitem_cost, customer_cost
+	WHERE o_partkey = l_partkey AND o_custkey = c_custkey;
+
+SET citus.enable_cost_based_join_order TO on;
+
+EXPLAIN SELECT count(*) FROM orders_cost, lineitem_cost, customer_cost
+	WHERE o_partkey = l_partkey AND o_custkey = c_custkey;
+
+RESET citus.enable_cost_based_join_order;
+
+-- Validate that tables whose shard lengths add up to less than the broadcast
+-- size threshold are broadcast regardless of their shard count, while larger
+-- tables are re-partitioned.
+SET citus.broadcast_join_size_threshold TO '100kB';
+
+EXPLAIN SELECT count(*) FROM orders_cost, lineitem_cost, customer_cost
+	WHERE o_partkey = l_partkey AND o_custkey = c_custkey;
+
+RESET citus.broadcast_join_size_threshold;
+
+-- Validate that co-located tables that are joined on their partition columns
+-- are joined locally, even when they have few enough shards to be broadcast.
+SET citus.shard_count TO 2;
+
+CREATE TABLE events_colocated (user_id integer, event_id integer);
+SELECT create_distributed_table('events_colocated', 'user_id');
+
+CREATE TABLE users_colocated (user_id integer, user_name text);
+SELECT create_distributed_table('users_colocated', 'user_id');
+
+CREATE TABLE sessions_colocated (user_id integer, session_id integer);
+SELECT create_distributed_table('sessions_colocated', 'user_id');
+
+RESET citus.shard_count;
+SET citus.large_table_shard_count TO 4;
+
+EXPLAIN SELECT count(*) FROM events_colocated, users_colocated, sessions_colocated
+	WHERE events_colocated.user_id = users_colocated.user_id AND
+		  events_colocated.user_id = sessions_colocated.user_id;
+
+-- Validate that tables without shard statistics fall back to the shard count
+-- rule when a broadcast size threshold is set.
+SET citus.large_table_shard_count TO 2;
+SET citus.broadcast_join_size_threshold TO '100kB';
+
+EXPLAIN SELECT count(*) FROM events_colocated, sessions_colocated
+	WHERE event_id = session_id;
+
+RESET citus.broadcast_join_size_threshold;
+
+SET citus.large_table_shard_count TO 1;
+
 -- Reset client logging level to its previous value
 
 SET client_min_messages TO NOTICE;
@@ -133,3 +208,9 @@ SET client_min_messages TO NOTICE;
 DROP TABLE lineitem_hash;
 DROP TABLE orders_hash;
 DROP TABLE customer_hash;
+DROP TABLE orders_cost;
+DROP TABLE lineitem_cost;
+DROP TABLE customer_cost;
+DROP TABLE events_colocated;
+DROP TABLE users_colocated;
+DROP TABLE sessions_colocated;
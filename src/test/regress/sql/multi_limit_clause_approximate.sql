@@ -27,6 +27,47 @@ SELECT l_partkey, sum(l_partkey * (1 + l_suppkey)) AS aggregate FROM lineitem
 	GROUP BY l_partkey
 	ORDER BY aggregate DESC LIMIT 10;
 
+-- Fetch a multiple of the limit from each task instead. For a limit of 10, this
+-- fetches as many rows as above.
+
+RESET citus.limit_clause_row_fetch_count;
+SET citus.limit_clause_overfetch_factor TO 60;
+
+SELECT l_partkey, sum(l_partkey * (1 + l_suppkey)) AS aggregate FROM lineitem
+	GROUP BY l_partkey
+	ORDER BY aggregate DESC LIMIT 10;
+
+-- When both settings are given, we fetch the larger number of rows
+
+SET citus.limit_clause_row_fetch_count TO 150;
+
+SELECT l_partkey, sum(l_partkey * (1 + l_suppkey)) AS aggregate FROM lineitem
+	GROUP BY l_partkey
+	ORDER BY aggregate DESC LIMIT 10;
+
+-- The factor multiplies the limit plus the offset, and limits that don't fit into
+-- a bigint fetch all rows
+
+RESET citus.limit_clause_row_fetch_count;
+
+SELECT l_partkey, sum(l_partkey * (1 + l_suppkey)) AS aggregate FROM lineitem
+	GROUP BY l_partkey
+	ORDER BY aggregate DESC LIMIT 5 OFFSET 5;
+
+SELECT l_partkey, sum(l_partkey * (1 + l_suppkey)) AS aggregate FROM lineitem
+	GROUP BY l_partkey
+	HAVING sum(l_partkey * (1 + l_suppkey)) > 2700000000
+	ORDER BY aggregate DESC LIMIT 9223372036854775807 OFFSET 5;
+
+-- Limit all asks for all rows, so we don't push down any limit
+
+SELECT l_partkey, sum(l_partkey * (1 + l_suppkey)) AS aggregate FROM lineitem
+	GROUP BY l_partkey
+	HAVING sum(l_partkey * (1 + l_suppkey)) > 2700000000
+	ORDER BY aggregate DESC LIMIT ALL OFFSET 2;
+
+RESET citus.limit_clause_overfetch_factor;
+
 -- Disable limit optimization for our second test. This time, we have a query
 -- that joins several tables, and that groups and orders the results.
 
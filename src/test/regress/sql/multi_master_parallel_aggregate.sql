@@ -0,0 +1,57 @@
+--
+-- MULTI_MASTER_PARALLEL_AGGREGATE
+--
+-- Tests for computing master aggregates with parallel workers. The master
+-- backend and its parallel workers compute partial aggregates over the task
+-- results, which a Gather node above the Citus scan collects.
+
+ALTER SEQUENCE pg_catalog.pg_dist_shardid_seq RESTART 1500000;
+
+-- print major version to make version-specific tests clear
+SELECT substring(version(), '\d+\.\d+') AS major_version;
+
+SET citus.task_executor_type TO 'real-time';
+SET citus.explain_distributed_queries TO on;
+SET citus.shard_count TO 4;
+SET citus.shard_replication_factor TO 1;
+
+CREATE TABLE parallel_events (event_key integer, event_value integer);
+SELECT create_distributed_table('parallel_events', 'event_key');
+
+COPY parallel_events FROM STDIN WITH CSV;
+1,10
+2,20
+3,30
+4,40
+5,50
+6,60
+7,70
+8,80
+\.
+
+SET citus.max_master_parallel_workers TO 2;
+SET max_parallel_workers_per_gather TO 2;
+
+-- the master plan runs the partial aggregation below a Gather node
+EXPLAIN (COSTS FALSE)
+	SELECT count(*), sum(event_value) FROM parallel_events;
+
+SELECT count(*), sum(event_value) FROM parallel_events;
+
+SELECT event_value % 20 AS remainder, count(*), sum(event_value)
+FROM parallel_events GROUP BY 1 ORDER BY 1;
+
+SELECT avg(event_value), max(event_value) FROM parallel_events HAVING count(*) > 4;
+
+-- without parallel workers, the master plan aggregates in a single process
+SET citus.max_master_parallel_workers TO 0;
+
+EXPLAIN (COSTS FALSE)
+	SELECT count(*), sum(event_value) FROM parallel_events;
+
+SELECT count(*), sum(event_value) FROM parallel_events;
+
+RESET max_parallel_workers_per_gather;
+RESET citus.max_master_parallel_workers;
+
+DROP TABLE parallel_events;
@@ -31,6 +31,12 @@ SELECT sum(l_linenumber), avg(l_linenumber) FROM lineitem
 
 SELECT sum(l_linenumber), avg(l_linenumber) FROM lineitem WHERE l_orderkey > 20000;
 
+-- Bounds on the partition column prune shards without checking each of them,
+-- remaining shards are still checked against other partition column clauses
+
+SELECT sum(l_linenumber), avg(l_linenumber) FROM lineitem
+	WHERE l_orderkey > 9030 AND (l_orderkey < 4000 OR l_orderkey > 20000);
+
 -- The tests below verify that we can prune shards partitioned over different
 -- types of columns including varchar, array types, composite types etc. This is
 -- in response to a bug we had where we were not able to resolve correct operator
@@ -37,6 +37,11 @@ CREATE FUNCTION print_sorted_shard_intervals(regclass)
 	AS 'citus'
 	LANGUAGE C STRICT;
 
+CREATE FUNCTION find_shard_interval_benchmark(regclass, integer, boolean)
+	RETURNS float8
+	AS 'citus'
+	LANGUAGE C STRICT;
+
 -- ===================================================================
 -- test shard pruning functionality
 -- ===================================================================
@@ -69,6 +74,11 @@ SELECT prune_using_both_values('pruning', 'tomato', 'rose');
 -- unit test of the equality expression generation code
 SELECT debug_equality_expression('pruning');
 
+-- shard intervals can be found by binary search or, since the hash
+-- distribution is uniform, arithmetically; only check that both ran
+SELECT find_shard_interval_benchmark('pruning', 100000, true) >= 0 AS binary_search;
+SELECT find_shard_interval_benchmark('pruning', 100000, false) >= 0 AS uniform_hash;
+
 -- print the initial ordering of shard intervals
 SELECT print_sorted_shard_intervals('pruning');
 
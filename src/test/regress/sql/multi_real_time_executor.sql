@@ -0,0 +1,178 @@
+--
+-- MULTI_REAL_TIME_EXECUTOR
+--
+-- Tests for how the real-time executor opens and uses connections to the
+-- workers. Each task reports the backend it ran on, so grouping by
+-- pg_backend_pid() returns one row per worker connection the query used.
+
+ALTER SEQUENCE pg_catalog.pg_dist_shardid_seq RESTART 1470000;
+
+SET citus.task_executor_type TO 'real-time';
+SET citus.shard_count TO 8;
+SET citus.shard_replication_factor TO 1;
+
+CREATE TABLE executor_events (event_key integer, event_value integer);
+SELECT create_distributed_table('executor_events', 'event_key');
+
+-- the keys below cover each of the 8 shards
+COPY executor_events FROM STDIN WITH CSV;
+1,10
+2,20
+3,30
+4,40
+5,50
+6,60
+9,90
+28,280
+\.
+
+-- without a limit, each of the 8 tasks gets its own connection
+SELECT count(*) > 0 AS has_rows FROM executor_events GROUP BY pg_backend_pid();
+
+-- with one connection per worker, the tasks for each worker share a connection
+SET citus.max_connections_per_worker TO 1;
+
+SELECT count(*) > 0 AS has_rows FROM executor_events GROUP BY pg_backend_pid();
+
+SELECT count(*), sum(event_value) FROM executor_events;
+
+RESET citus.max_connections_per_worker;
+
+-- slow start begins with one connection per worker, and short queries finish
+-- before the interval passes and more connections are allowed
+SET citus.max_connections_per_worker TO 4;
+SET citus.executor_slow_start_interval TO '10s';
+
+SELECT count(*) > 0 AS has_rows FROM executor_events GROUP BY pg_backend_pid();
+
+SELECT count(*), sum(event_value) FROM executor_events;
+
+-- without slow start, each worker gets up to 4 connections right away
+RESET citus.executor_slow_start_interval;
+
+SELECT count(*) > 0 AS has_rows FROM executor_events GROUP BY pg_backend_pid();
+
+RESET citus.max_connections_per_worker;
+
+-- all backends on the master share a budget of connections per worker; with a
+-- budget of 1, queued tasks wait for the connection in use to be returned
+CREATE FUNCTION shared_connection_count(text, integer)
+	RETURNS integer
+	AS 'citus'
+	LANGUAGE C STRICT;
+
+ALTER SYSTEM SET citus.max_shared_connections_per_worker TO 1;
+SELECT pg_reload_conf();
+SELECT pg_sleep(0.1);
+
+SELECT count(*) > 0 AS has_rows FROM executor_events GROUP BY pg_backend_pid();
+
+SELECT count(*), sum(event_value) FROM executor_events;
+
+-- the reservations are returned once the connections are closed
+SELECT shared_connection_count('localhost', :worker_1_port) AS worker_1_count,
+	   shared_connection_count('localhost', :worker_2_port) AS worker_2_count;
+
+-- connections cached across transactions keep their reservations while idle,
+-- and are reused by later queries without reserving another connection
+SET citus.max_cached_conns_per_worker TO 1;
+SET citus.max_connections_per_worker TO 1;
+
+SELECT min(pg_backend_pid()) AS first_min_pid, max(pg_backend_pid()) AS first_max_pid
+FROM executor_events \gset
+
+SELECT shared_connection_count('localhost', :worker_1_port) AS worker_1_count,
+	   shared_connection_count('localhost', :worker_2_port) AS worker_2_count;
+
+SELECT min(pg_backend_pid()) = :first_min_pid AND
+	   max(pg_backend_pid()) = :first_max_pid AS connections_reused
+FROM executor_events;
+
+SELECT shared_connection_count('localhost', :worker_1_port) AS worker_1_count,
+	   shared_connection_count('localhost', :worker_2_port) AS worker_2_count;
+
+-- connections past their lifetime are closed, and return their reservations
+SET citus.max_cached_connection_lifetime TO 0;
+
+SELECT count(*), sum(event_value) FROM executor_events;
+
+SELECT shared_connection_count('localhost', :worker_1_port) AS worker_1_count,
+	   shared_connection_count('localhost', :worker_2_port) AS worker_2_count;
+
+RESET citus.max_cached_connection_lifetime;
+RESET citus.max_connections_per_worker;
+RESET citus.max_cached_conns_per_worker;
+
+ALTER SYSTEM RESET citus.max_shared_connections_per_worker;
+SELECT pg_reload_conf();
+SELECT pg_sleep(0.1);
+
+-- stream results from the workers, with two executions running interleaved;
+-- cursors that can scan backwards keep the complete results instead
+SET citus.enable_result_streaming TO on;
+
+SELECT count(*), sum(event_value) FROM executor_events;
+
+CREATE FUNCTION interleaved_cursor_sums(OUT first_count int, OUT first_sum int,
+										OUT second_count int, OUT second_sum int)
+AS $$
+DECLARE
+	first_cursor NO SCROLL CURSOR FOR SELECT event_value FROM executor_events;
+	second_cursor NO SCROLL CURSOR FOR SELECT event_value * 2 FROM executor_events;
+	first_value int;
+	second_value int;
+	first_done bool := false;
+	second_done bool := false;
+BEGIN
+	first_count := 0; first_sum := 0;
+	second_count := 0; second_sum := 0;
+	OPEN first_cursor;
+	OPEN second_cursor;
+	WHILE NOT first_done OR NOT second_done LOOP
+		IF NOT first_done THEN
+			FETCH first_cursor INTO first_value;
+			IF FOUND THEN
+				first_count := first_count + 1;
+				first_sum := first_sum + first_value;
+			ELSE
+				first_done := true;
+			END IF;
+		END IF;
+		IF NOT second_done THEN
+			FETCH second_cursor INTO second_value;
+			IF FOUND THEN
+				second_count := second_count + 1;
+				second_sum := second_sum + second_value;
+			ELSE
+				second_done := true;
+			END IF;
+		END IF;
+	END LOOP;
+	CLOSE first_cursor;
+	CLOSE second_cursor;
+END;
+$$ LANGUAGE plpgsql;
+
+SELECT * FROM interleaved_cursor_sums();
+
+-- the same with one connection per worker, so each execution reuses its own
+SET citus.max_connections_per_worker TO 1;
+
+SELECT * FROM interleaved_cursor_sums();
+
+RESET citus.max_connections_per_worker;
+
+-- closing a cursor early stops its execution
+BEGIN;
+DECLARE streamed_cursor NO SCROLL CURSOR FOR
+	SELECT event_key FROM executor_events WHERE event_key = 28;
+DECLARE partial_cursor NO SCROLL CURSOR FOR SELECT event_key FROM executor_events;
+FETCH 1 FROM partial_cursor \gset
+FETCH 1 FROM streamed_cursor;
+CLOSE partial_cursor;
+FETCH 1 FROM streamed_cursor;
+COMMIT;
+
+SELECT count(*), sum(event_value) FROM executor_events;
+
+RESET citus.enable_result_streaming;
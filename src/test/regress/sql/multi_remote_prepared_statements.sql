@@ -0,0 +1,71 @@
+--
+-- MULTI_REMOTE_PREPARED_STATEMENTS
+--
+-- Tests for preparing parameterized router queries on worker connections and
+-- reusing the prepared statements in later executions.
+
+ALTER SEQUENCE pg_catalog.pg_dist_shardid_seq RESTART 1510000;
+
+SET citus.shard_count TO 1;
+SET citus.shard_replication_factor TO 1;
+
+CREATE FUNCTION remote_prepared_statement_count(text, integer)
+	RETURNS integer
+	AS 'citus'
+	LANGUAGE C STRICT;
+
+CREATE TABLE prepared_events (event_key integer, event_value integer);
+SELECT create_distributed_table('prepared_events', 'event_key');
+
+COPY prepared_events FROM STDIN WITH CSV;
+1,10
+2,20
+3,30
+\.
+
+-- keep the connection, and the statements prepared on it, across transactions
+SET citus.max_cached_conns_per_worker TO 1;
+SET citus.max_prepared_statements_per_connection TO 2;
+
+PREPARE prepared_lookup(integer) AS
+	SELECT event_value FROM prepared_events WHERE event_key = $1;
+
+EXECUTE prepared_lookup(1);
+SELECT remote_prepared_statement_count('localhost', :worker_1_port);
+
+-- executing the same command again reuses the prepared statement
+EXECUTE prepared_lookup(1);
+SELECT remote_prepared_statement_count('localhost', :worker_1_port);
+
+EXECUTE prepared_lookup(2);
+SELECT remote_prepared_statement_count('localhost', :worker_1_port);
+
+-- once the limit is reached, other commands are sent without preparing them
+EXECUTE prepared_lookup(3);
+SELECT remote_prepared_statement_count('localhost', :worker_1_port);
+
+EXECUTE prepared_lookup(2);
+EXECUTE prepared_lookup(1);
+SELECT remote_prepared_statement_count('localhost', :worker_1_port);
+SELECT remote_prepared_statement_count('localhost', :worker_2_port);
+
+-- statements go away with the connection they were prepared on
+SET citus.max_cached_conns_per_worker TO 0;
+
+EXECUTE prepared_lookup(3);
+SELECT remote_prepared_statement_count('localhost', :worker_1_port);
+
+-- without caching, statements are reused within a transaction
+BEGIN;
+EXECUTE prepared_lookup(1);
+EXECUTE prepared_lookup(1);
+SELECT remote_prepared_statement_count('localhost', :worker_1_port);
+END;
+
+SELECT remote_prepared_statement_count('localhost', :worker_1_port);
+
+DEALLOCATE prepared_lookup;
+RESET citus.max_prepared_statements_per_connection;
+RESET citus.max_cached_conns_per_worker;
+
+DROP TABLE prepared_events;
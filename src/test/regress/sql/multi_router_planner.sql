@@ -156,8 +156,10 @@ SELECT author_id, sum(word_count) AS corpus_size FROM articles_hash
 	ORDER BY sum(word_count) DESC;
 
 -- query is a single shard query but can't do shard pruning,
--- not router-plannable due to <= and IN
+-- not router-plannable due to <=
 SELECT * FROM articles_hash WHERE author_id <= 1; 
+
+-- IN lists are pruned like equalities, all values are in a single shard
 SELECT * FROM articles_hash WHERE author_id IN (1, 3); 
 
 -- queries with CTEs are supported
@@ -567,7 +569,8 @@ SELECT word_count, rank() OVER (PARTITION BY author_id ORDER BY word_count)
 	FROM articles_hash 
 	WHERE author_id = 1;
 
--- window functions are not supported for not router plannable queries
+-- window functions that are not partitioned by the partition column are not
+-- supported for not router plannable queries
 SELECT id, MIN(id) over (order by word_count)
 	FROM articles_hash
 	WHERE author_id = 1 or author_id = 2;
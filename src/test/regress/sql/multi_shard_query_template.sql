@@ -0,0 +1,54 @@
+--
+-- MULTI_SHARD_QUERY_TEMPLATE
+--
+-- Tests for multi-shard queries whose task query strings are built from a
+-- single deparsed query, with the shard names filled in for each task.
+
+ALTER SEQUENCE pg_catalog.pg_dist_shardid_seq RESTART 1530000;
+
+SET citus.task_executor_type TO 'real-time';
+SET citus.shard_count TO 4;
+SET citus.shard_replication_factor TO 1;
+
+CREATE SCHEMA template_schema;
+
+CREATE TABLE template_schema.template_events (event_key integer, event_name text);
+SELECT create_distributed_table('template_schema.template_events', 'event_key');
+
+CREATE TABLE template_schema.template_users (event_key integer, user_name text);
+SELECT create_distributed_table('template_schema.template_users', 'event_key');
+
+COPY template_schema.template_events FROM STDIN WITH CSV;
+1,first
+2,second
+3,third
+4,citus_fragment_placeholder_1_
+\.
+
+COPY template_schema.template_users FROM STDIN WITH CSV;
+1,alice
+2,bob
+3,carol
+\.
+
+-- shard names keep the schema of their table
+SELECT count(*) FROM template_schema.template_events;
+
+SELECT e.event_key, e.event_name, u.user_name
+FROM template_schema.template_events e, template_schema.template_users u
+WHERE e.event_key = u.event_key
+ORDER BY e.event_key;
+
+SET search_path TO template_schema;
+SELECT count(*) FROM template_events WHERE event_key > 1;
+RESET search_path;
+
+-- constants that contain a placeholder don't get replaced by shard names
+SELECT event_key FROM template_schema.template_events
+WHERE event_name <> 'citus_fragment_placeholder_1_'
+ORDER BY event_key;
+
+SELECT event_key, event_name FROM template_schema.template_events
+WHERE event_name = 'citus_fragment_placeholder_1_';
+
+DROP SCHEMA template_schema CASCADE;
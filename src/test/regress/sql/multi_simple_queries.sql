@@ -296,3 +296,46 @@ SELECT count(*) FROM (
 ) x;
 
 SET client_min_messages to 'NOTICE';
+
+-- single shard lookups can be planned without the postgres planner
+SET citus.enable_fast_path_router_planner TO on;
+SET client_min_messages TO 'DEBUG2';
+
+SELECT title, word_count FROM articles WHERE author_id = 10 AND id = 50;
+
+PREPARE author_articles(bigint) AS
+	SELECT id, title FROM articles WHERE author_id = $1 ORDER BY id;
+
+EXECUTE author_articles(3);
+
+DEALLOCATE author_articles;
+
+-- other single shard queries take the regular planning path
+SELECT id FROM articles WHERE author_id = 1 OR author_id = 17 ORDER BY id;
+
+SELECT a.id, b.word_count
+	FROM articles a, articles b
+	WHERE a.author_id = 10 AND a.author_id = b.author_id AND a.id = b.id
+	ORDER BY a.id;
+
+SET client_min_messages to 'NOTICE';
+
+-- prepared lookups are planned once, and the shard is picked at execution
+PREPARE author_word_count(bigint) AS
+	SELECT sum(word_count) FROM articles WHERE author_id = $1;
+
+EXECUTE author_word_count(1);
+EXECUTE author_word_count(2);
+EXECUTE author_word_count(3);
+EXECUTE author_word_count(4);
+EXECUTE author_word_count(5);
+
+-- from the 6th execution on, the generic plan picks the shard when it runs
+SET client_min_messages TO 'DEBUG2';
+EXECUTE author_word_count(6);
+EXECUTE author_word_count(7);
+EXECUTE author_word_count(2);
+SET client_min_messages to 'NOTICE';
+
+DEALLOCATE author_word_count;
+RESET citus.enable_fast_path_router_planner;
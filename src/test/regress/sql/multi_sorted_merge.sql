@@ -0,0 +1,80 @@
+--
+-- MULTI_SORTED_MERGE
+--
+-- Tests for merging sorted task results on the master node, instead of sorting
+-- all task results again.
+
+ALTER SEQUENCE pg_catalog.pg_dist_shardid_seq RESTART 1480000;
+
+SET citus.task_executor_type TO 'real-time';
+SET citus.shard_count TO 4;
+SET citus.shard_replication_factor TO 1;
+
+CREATE TABLE sorted_events (event_key integer, event_value integer);
+SELECT create_distributed_table('sorted_events', 'event_key');
+
+COPY sorted_events FROM STDIN WITH CSV;
+1,50
+2,
+3,30
+4,10
+5,70
+6,20
+7,60
+8,40
+9,80
+10,0
+11,90
+12,100
+\.
+
+SET citus.enable_sorted_merge TO on;
+
+-- the master plan has no sort node, the tasks sort their results instead
+EXPLAIN (COSTS FALSE)
+	SELECT event_key, event_value FROM sorted_events ORDER BY event_value;
+
+-- merge the complete results, without a limit
+SELECT event_key, event_value FROM sorted_events ORDER BY event_value;
+
+SELECT event_key, event_value FROM sorted_events ORDER BY event_value DESC;
+
+-- sort keys that are not the first column, or not in the target list at all
+SELECT event_value, event_key FROM sorted_events ORDER BY event_key DESC;
+
+SELECT event_key FROM sorted_events ORDER BY event_value NULLS FIRST, event_key;
+
+SELECT event_key, event_value FROM sorted_events ORDER BY event_value LIMIT 3;
+
+-- scans that move backwards merge into the tuple store first
+BEGIN;
+DECLARE sorted_cursor SCROLL CURSOR FOR
+	SELECT event_key, event_value FROM sorted_events ORDER BY event_value;
+FETCH 2 FROM sorted_cursor;
+FETCH LAST FROM sorted_cursor;
+FETCH BACKWARD 2 FROM sorted_cursor;
+COMMIT;
+
+-- with more than 128 tasks, the master sorts the task results instead
+SET citus.shard_count TO 130;
+
+CREATE TABLE many_sorted_events (event_key integer, event_value integer);
+SELECT create_distributed_table('many_sorted_events', 'event_key');
+
+COPY many_sorted_events FROM STDIN WITH CSV;
+1,50
+3,30
+4,10
+6,20
+10,0
+\.
+
+EXPLAIN (COSTS FALSE)
+	SELECT event_key, event_value FROM many_sorted_events ORDER BY event_value;
+
+SELECT event_key, event_value FROM many_sorted_events ORDER BY event_value;
+
+RESET citus.enable_sorted_merge;
+
+DROP TABLE sorted_events;
+DROP TABLE many_sorted_events;
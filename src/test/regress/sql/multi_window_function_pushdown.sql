@@ -0,0 +1,47 @@
+--
+-- MULTI_WINDOW_FUNCTION_PUSHDOWN
+--
+-- Tests for computing window functions that are partitioned by the partition
+-- column fully on the worker nodes.
+
+ALTER SEQUENCE pg_catalog.pg_dist_shardid_seq RESTART 1460000;
+ALTER SEQUENCE pg_catalog.pg_dist_jobid_seq RESTART 1460000;
+
+SET citus.shard_count TO 4;
+
+CREATE TABLE tenant_events (tenant_id integer, event_id integer, amount integer);
+SELECT create_distributed_table('tenant_events', 'tenant_id');
+
+COPY tenant_events FROM STDIN WITH CSV;
+1,1,10
+1,2,20
+1,3,5
+2,1,7
+2,2,30
+3,1,1
+4,1,2
+4,2,50
+4,3,8
+\.
+
+-- per tenant rankings and running totals
+SELECT tenant_id, event_id, rank() OVER (PARTITION BY tenant_id ORDER BY amount DESC)
+FROM tenant_events ORDER BY tenant_id, event_id;
+
+SELECT tenant_id, event_id,
+	sum(amount) OVER (PARTITION BY tenant_id ORDER BY event_id) AS running_total
+FROM tenant_events ORDER BY tenant_id, event_id;
+
+SELECT tenant_id, event_id, row_number() OVER w FROM tenant_events
+WINDOW w AS (PARTITION BY tenant_id, event_id % 2 ORDER BY amount)
+ORDER BY 1, 2 LIMIT 4;
+
+-- window functions over groups on the partition column
+SELECT tenant_id, count(*), sum(sum(amount)) OVER (PARTITION BY tenant_id)
+FROM tenant_events GROUP BY tenant_id ORDER BY tenant_id;
+
+-- windows need to be partitioned by the partition column
+SELECT tenant_id, rank() OVER (ORDER BY amount) FROM tenant_events;
+SELECT event_id, rank() OVER (PARTITION BY event_id ORDER BY amount) FROM tenant_events;
+
+DROP TABLE tenant_events;